@@ -0,0 +1,517 @@
+#include "AssetArchive.h"
+#include "MeshCache.h"
+#include "TextureCooker.h"
+#include <string.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+#define ASSET_ARCHIVE_HASH_BITS  12 // Match finder table of the compressor
+#define ASSET_ARCHIVE_MIN_MATCH  4
+#define ASSET_ARCHIVE_MAX_OFFSET 0xFFFF
+
+namespace
+{
+	struct AssetArchive
+	{
+		MappedFile file;
+		const AssetArchiveHeader* header;
+		const AssetArchiveEntry* entries;
+		const u32* buckets;
+		const char* names;
+	};
+
+	AssetArchive GlobalAssetArchive = {};
+
+	struct AssetArchiveOverlayFile
+	{
+		std::vector<u8> data;
+		u64 timestamp;
+	};
+
+	// Keyed by normalized path. Files are never removed while the archive is mounted, so views stay valid.
+	std::mutex GlobalOverlayMutex;
+	std::unordered_map<std::string, AssetArchiveOverlayFile> GlobalOverlayFiles;
+
+	// Lowercase with forward slashes and without "." or ".." components, so every spelling of a
+	// path the engine builds finds the same entry
+	bool NormalizeArchivePath(const char* filepath, std::string& normalized)
+	{
+		normalized.clear();
+		const char* c = filepath;
+		while (*c)
+		{
+			const char* componentEnd = c;
+			while (*componentEnd && *componentEnd != '/' && *componentEnd != '\\')
+				componentEnd++;
+
+			const size_t length = componentEnd - c;
+			if (length == 0 && c == filepath)
+				return false; // Absolute paths never come from the archive
+			if (length == 2 && c[0] == '.' && c[1] == '.')
+			{
+				if (normalized.empty())
+					return false;
+				size_t separator = normalized.find_last_of('/');
+				normalized.resize(separator == std::string::npos ? 0 : separator);
+			}
+			else if (length > 0 && !(length == 1 && c[0] == '.'))
+			{
+				if (!normalized.empty())
+					normalized += '/';
+				for (const char* k = c; k < componentEnd; ++k)
+					normalized += (char)tolower(*k);
+			}
+
+			c = *componentEnd ? componentEnd + 1 : componentEnd;
+		}
+		return !normalized.empty();
+	}
+
+	u64 HashArchivePath(const std::string& normalized)
+	{
+		u64 hash = 14695981039346656037ull;
+		for (char c : normalized)
+			hash = (hash ^ (u8)c) * 1099511628211ull;
+		return hash;
+	}
+
+#pragma region Compression
+	// LZ4 style sequences: a token with the literal and match lengths, the literals, then a 16 bit
+	// offset back into the output. The last sequence has literals only.
+	void WriteSequenceLength(std::vector<u8>& output, u64 length)
+	{
+		while (length >= 255)
+		{
+			output.push_back(255);
+			length -= 255;
+		}
+		output.push_back((u8)length);
+	}
+
+	void WriteSequence(std::vector<u8>& output, const u8* literals, u64 literalCount, u32 offset, u64 matchLength)
+	{
+		const u64 matchCode = matchLength ? matchLength - ASSET_ARCHIVE_MIN_MATCH : 0;
+		output.push_back((u8)((glm::min(literalCount, (u64)15) << 4) | glm::min(matchCode, (u64)15)));
+		if (literalCount >= 15)
+			WriteSequenceLength(output, literalCount - 15);
+		output.insert(output.end(), literals, literals + literalCount);
+
+		if (matchLength == 0)
+			return;
+
+		output.push_back((u8)(offset & 0xFF));
+		output.push_back((u8)(offset >> 8));
+		if (matchCode >= 15)
+			WriteSequenceLength(output, matchCode - 15);
+	}
+
+	u32 Read32(const u8* data)
+	{
+		u32 value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	// Greedy single probe match finder, fast enough to pack on every build
+	void CompressBlock(const u8* source, u64 size, std::vector<u8>& compressed)
+	{
+		std::vector<u32> table(1 << ASSET_ARCHIVE_HASH_BITS, 0); // Position + 1, 0 when empty
+		compressed.clear();
+		compressed.reserve(size);
+
+		u64 anchor = 0;
+		u64 position = 0;
+		while (position + ASSET_ARCHIVE_MIN_MATCH <= size && position < UINT32_MAX)
+		{
+			const u32 sequence = Read32(source + position);
+			const u32 hash = (sequence * 2654435761u) >> (32 - ASSET_ARCHIVE_HASH_BITS);
+			const u64 candidate = table[hash];
+			table[hash] = (u32)position + 1;
+
+			if (candidate == 0 || position - (candidate - 1) > ASSET_ARCHIVE_MAX_OFFSET || Read32(source + candidate - 1) != sequence)
+			{
+				position++;
+				continue;
+			}
+
+			const u64 reference = candidate - 1;
+			u64 matchLength = ASSET_ARCHIVE_MIN_MATCH;
+			while (position + matchLength < size && source[reference + matchLength] == source[position + matchLength])
+				matchLength++;
+
+			WriteSequence(compressed, source + anchor, position - anchor, (u32)(position - reference), matchLength);
+			position += matchLength;
+			anchor = position;
+		}
+
+		WriteSequence(compressed, source + anchor, size - anchor, 0, 0);
+	}
+
+	bool ReadSequenceLength(const u8*& input, const u8* inputEnd, u64& length)
+	{
+		u8 byte;
+		do
+		{
+			if (input == inputEnd)
+				return false;
+			byte = *input++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	bool DecompressBlock(const u8* input, u64 inputSize, u8* output, u64 outputSize)
+	{
+		const u8* inputEnd = input + inputSize;
+		u64 written = 0;
+
+		while (input < inputEnd)
+		{
+			const u8 token = *input++;
+
+			u64 literalCount = token >> 4;
+			if (literalCount == 15 && !ReadSequenceLength(input, inputEnd, literalCount))
+				return false;
+			if (literalCount > (u64)(inputEnd - input) || literalCount > outputSize - written)
+				return false;
+
+			memcpy(output + written, input, literalCount);
+			input += literalCount;
+			written += literalCount;
+
+			if (input == inputEnd)
+				break;
+
+			if (inputEnd - input < 2)
+				return false;
+			const u64 offset = (u64)input[0] | ((u64)input[1] << 8);
+			input += 2;
+
+			u64 matchLength = token & 15;
+			if (matchLength == 15 && !ReadSequenceLength(input, inputEnd, matchLength))
+				return false;
+			matchLength += ASSET_ARCHIVE_MIN_MATCH;
+
+			if (offset == 0 || offset > written || matchLength > outputSize - written)
+				return false;
+
+			// Matches may overlap the bytes they produce, so they're copied forwards one at a time
+			const u8* match = output + written - offset;
+			for (u64 i = 0; i < matchLength; ++i)
+				output[written + i] = match[i];
+			written += matchLength;
+		}
+
+		return written == outputSize;
+	}
+#pragma endregion
+
+	bool HasExtension(const std::string& filepath, const char* extension)
+	{
+		const size_t length = strlen(extension);
+		return filepath.size() >= length && filepath.compare(filepath.size() - length, length, extension) == 0;
+	}
+
+	// Binaries and files the tools write on their own never go into the archive
+	bool IsArchivable(const std::string& normalized)
+	{
+		static const char* excluded[] = { ".pak", ".dll", ".exe", ".pdb", ".ini", ".rdbg" };
+		for (const char* extension : excluded)
+		{
+			if (HasExtension(normalized, extension))
+				return false;
+		}
+		return true;
+	}
+
+	bool IsCompressible(const std::string& normalized)
+	{
+		static const char* stored[] = { MESH_CACHE_EXTENSION, COOKED_TEXTURE_EXTENSION, ".png", ".jpg", ".jpeg" };
+		for (const char* extension : stored)
+		{
+			if (HasExtension(normalized, extension))
+				return false;
+		}
+		return true;
+	}
+
+	void WriteArchivePadding(FILE* file, u64& offset)
+	{
+		static const u8 zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+		const u64 aligned = (offset + ASSET_ARCHIVE_ALIGNMENT - 1) & ~(u64)(ASSET_ARCHIVE_ALIGNMENT - 1);
+		fwrite(zeros, 1, aligned - offset, file);
+		offset = aligned;
+	}
+}
+
+bool MountAssetArchive(const char* archivePath)
+{
+	UnmountAssetArchive();
+
+	MappedFile file = MapFile(archivePath);
+	if (!file.data)
+		return false;
+
+	const u8* base = (const u8*)file.data;
+	const AssetArchiveHeader* header = (const AssetArchiveHeader*)base;
+	if (file.size < sizeof(AssetArchiveHeader) || header->magic != ASSET_ARCHIVE_MAGIC || header->version != ASSET_ARCHIVE_VERSION)
+	{
+		ELOG("%s is not an asset archive of version %u", archivePath, ASSET_ARCHIVE_VERSION);
+		UnmapFile(file);
+		return false;
+	}
+
+	const bool validLayout =
+		header->bucketCount != 0 && (header->bucketCount & (header->bucketCount - 1)) == 0 && header->bucketCount >= header->entryCount &&
+		header->entriesOffset + (u64)header->entryCount * sizeof(AssetArchiveEntry) <= file.size &&
+		header->bucketsOffset + (u64)header->bucketCount * sizeof(u32) <= file.size &&
+		header->namesOffset + header->namesSize <= file.size;
+
+	const AssetArchiveEntry* entries = (const AssetArchiveEntry*)(base + header->entriesOffset);
+	bool validEntries = validLayout;
+	for (u32 i = 0; validEntries && i < header->entryCount; ++i)
+	{
+		validEntries = entries[i].offset + entries[i].storedSize <= file.size &&
+			(u64)entries[i].nameOffset + entries[i].nameLength <= header->namesSize;
+	}
+
+	if (!validEntries)
+	{
+		ELOG("Asset archive %s is truncated or corrupt", archivePath);
+		UnmapFile(file);
+		return false;
+	}
+
+	GlobalAssetArchive.file = file;
+	GlobalAssetArchive.header = header;
+	GlobalAssetArchive.entries = entries;
+	GlobalAssetArchive.buckets = (const u32*)(base + header->bucketsOffset);
+	GlobalAssetArchive.names = (const char*)(base + header->namesOffset);
+
+	ILOG("Mounted asset archive %s: %u files", archivePath, header->entryCount);
+	return true;
+}
+
+void UnmountAssetArchive()
+{
+	UnmapFile(GlobalAssetArchive.file);
+	GlobalAssetArchive = {};
+
+	std::lock_guard<std::mutex> lock(GlobalOverlayMutex);
+	GlobalOverlayFiles.clear();
+}
+
+bool IsAssetArchiveMounted()
+{
+	return GlobalAssetArchive.header != nullptr;
+}
+
+const AssetArchiveEntry* FindAssetArchiveEntry(const char* filepath)
+{
+	const AssetArchiveHeader* header = GlobalAssetArchive.header;
+	std::string normalized;
+	if (!header || !NormalizeArchivePath(filepath, normalized))
+		return nullptr;
+
+	const u64 hash = HashArchivePath(normalized);
+	const u32 mask = header->bucketCount - 1;
+	for (u32 probe = 0; probe < header->bucketCount; ++probe)
+	{
+		const u32 bucket = GlobalAssetArchive.buckets[(hash + probe) & mask];
+		if (bucket == 0 || bucket > header->entryCount)
+			return nullptr;
+
+		const AssetArchiveEntry& entry = GlobalAssetArchive.entries[bucket - 1];
+		if (entry.hash == hash && entry.nameLength == normalized.size() &&
+			memcmp(GlobalAssetArchive.names + entry.nameOffset, normalized.data(), normalized.size()) == 0)
+			return &entry;
+	}
+	return nullptr;
+}
+
+void AddAssetArchiveOverlayFile(const char* filepath, const void* data, u64 size, u64 timestamp)
+{
+	std::string normalized;
+	if (!GlobalAssetArchive.header || !NormalizeArchivePath(filepath, normalized))
+		return;
+
+	std::lock_guard<std::mutex> lock(GlobalOverlayMutex);
+	AssetArchiveOverlayFile& file = GlobalOverlayFiles[normalized];
+	if (!file.data.empty())
+		return; // Someone may hold a view of it already
+
+	file.data.assign((const u8*)data, (const u8*)data + size);
+	file.timestamp = timestamp;
+}
+
+bool FindAssetArchiveOverlayFile(const char* filepath, MappedFile* file, u64* timestamp)
+{
+	std::string normalized;
+	if (!GlobalAssetArchive.header || !NormalizeArchivePath(filepath, normalized))
+		return false;
+
+	std::lock_guard<std::mutex> lock(GlobalOverlayMutex);
+	auto it = GlobalOverlayFiles.find(normalized);
+	if (it == GlobalOverlayFiles.end() || it->second.data.empty())
+		return false;
+
+	if (file)
+	{
+		*file = {};
+		file->data = it->second.data.data();
+		file->size = it->second.data.size();
+		file->source = MappedFile_Archive;
+	}
+	if (timestamp)
+		*timestamp = it->second.timestamp;
+	return true;
+}
+
+bool OpenAssetArchiveEntry(const AssetArchiveEntry& entry, MappedFile& file)
+{
+	file = {};
+	const u8* stored = (const u8*)GlobalAssetArchive.file.data + entry.offset;
+
+	if (!(entry.flags & AssetArchiveEntry_Compressed))
+	{
+		file.data = (void*)stored;
+		file.size = entry.size;
+		file.source = MappedFile_Archive;
+		return true;
+	}
+
+	u8* memory = (u8*)malloc(entry.size ? entry.size : 1);
+	if (!memory || !DecompressBlock(stored, entry.storedSize, memory, entry.size))
+	{
+		ELOG("Corrupt compressed entry %.*s in the asset archive", (int)entry.nameLength, GlobalAssetArchive.names + entry.nameOffset);
+		free(memory);
+		return false;
+	}
+
+	file.data = memory;
+	file.size = entry.size;
+	file.source = MappedFile_Heap;
+	return true;
+}
+
+bool WriteAssetArchive(const char* archivePath, const char* rootDir)
+{
+	std::vector<std::string> filepaths;
+	ListDirectoryFiles(rootDir, filepaths);
+
+	// Sorted so the same tree always produces the same archive
+	std::vector<std::pair<std::string, std::string>> files; // Normalized name, path on disk
+	std::string root = rootDir;
+	for (const std::string& filepath : filepaths)
+	{
+		std::string normalized;
+		if (NormalizeArchivePath(filepath.c_str(), normalized) && IsArchivable(normalized))
+			files.push_back({ normalized, root + "/" + filepath });
+	}
+	std::sort(files.begin(), files.end());
+
+	FILE* archive = fopen(archivePath, "wb");
+	if (!archive)
+	{
+		ELOG("fopen() failed writing asset archive %s", archivePath);
+		return false;
+	}
+
+	AssetArchiveHeader header = {};
+	fwrite(&header, sizeof(header), 1, archive);
+	u64 offset = sizeof(header);
+
+	std::vector<AssetArchiveEntry> entries;
+	std::string names;
+	std::vector<u8> compressed;
+	u64 totalSize = 0, totalStored = 0;
+	for (const auto& file : files)
+	{
+		MappedFile mapping = MapFile(file.second.c_str());
+		if (!mapping.data && GetFileLastWriteTimestamp(file.second.c_str()) == 0)
+		{
+			ELOG("Cannot read %s, it's left out of the asset archive", file.second.c_str());
+			continue;
+		}
+
+		WriteArchivePadding(archive, offset);
+
+		AssetArchiveEntry entry = {};
+		entry.hash = HashArchivePath(file.first);
+		entry.offset = offset;
+		entry.size = mapping.size; // Empty files can't be mapped and have no data
+		entry.storedSize = mapping.size;
+		entry.timestamp = GetFileLastWriteTimestamp(file.second.c_str());
+		entry.nameOffset = (u32)names.size();
+		entry.nameLength = (u32)file.first.size();
+		names += file.first;
+
+		const u8* data = (const u8*)mapping.data;
+		if (mapping.size > 0 && IsCompressible(file.first))
+		{
+			CompressBlock(data, mapping.size, compressed);
+			if (compressed.size() <= mapping.size - mapping.size / 8)
+			{
+				entry.flags |= AssetArchiveEntry_Compressed;
+				entry.storedSize = compressed.size();
+				data = compressed.data();
+			}
+		}
+
+		if (entry.storedSize > 0)
+			fwrite(data, 1, (size_t)entry.storedSize, archive);
+		offset += entry.storedSize;
+		totalSize += entry.size;
+		totalStored += entry.storedSize;
+
+		entries.push_back(entry);
+		UnmapFile(mapping);
+	}
+
+	header.magic = ASSET_ARCHIVE_MAGIC;
+	header.version = ASSET_ARCHIVE_VERSION;
+	header.entryCount = (u32)entries.size();
+	header.bucketCount = 16;
+	while (header.bucketCount < header.entryCount * 2)
+		header.bucketCount *= 2;
+
+	std::vector<u32> buckets(header.bucketCount, 0);
+	for (u32 i = 0; i < entries.size(); ++i)
+	{
+		u64 bucket = entries[i].hash & (header.bucketCount - 1);
+		while (buckets[bucket] != 0)
+			bucket = (bucket + 1) & (header.bucketCount - 1);
+		buckets[bucket] = i + 1;
+	}
+
+	WriteArchivePadding(archive, offset);
+	header.entriesOffset = offset;
+	fwrite(entries.data(), sizeof(AssetArchiveEntry), entries.size(), archive);
+	offset += entries.size() * sizeof(AssetArchiveEntry);
+
+	header.bucketsOffset = offset;
+	fwrite(buckets.data(), sizeof(u32), buckets.size(), archive);
+	offset += buckets.size() * sizeof(u32);
+
+	header.namesOffset = offset;
+	header.namesSize = names.size();
+	fwrite(names.data(), 1, names.size(), archive);
+
+	fseek(archive, 0, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, archive);
+	bool succeeded = ferror(archive) == 0;
+	fclose(archive);
+
+	if (!succeeded)
+	{
+		ELOG("Error writing asset archive %s", archivePath);
+		remove(archivePath);
+		return false;
+	}
+
+	ILOG("Packed %u files into %s: %.2f MB stored as %.2f MB", header.entryCount, archivePath,
+		totalSize / (1024.0 * 1024.0), totalStored / (1024.0 * 1024.0));
+	return true;
+}
@@ -0,0 +1,91 @@
+//
+// AssetArchive.h: Single file archive of everything the engine loads from WorkingDir. The table
+// of contents is an open addressing hash table keyed by the normalized relative path, entries are
+// aligned so cooked blobs keep the alignment their formats rely on when they're read in place.
+// Entries can be stored compressed, which is worth it for text but not for cooked or image data.
+//
+
+#pragma once
+
+#include "platform.h"
+
+#define ASSET_ARCHIVE_MAGIC     0x4B415041 // "APAK"
+#define ASSET_ARCHIVE_VERSION   1
+#define ASSET_ARCHIVE_ALIGNMENT 64
+#define ASSET_ARCHIVE_FILENAME  "assets.pak"
+
+enum AssetArchiveEntryFlags
+{
+	AssetArchiveEntry_Compressed = 1 << 0,
+};
+
+struct AssetArchiveHeader
+{
+	u32 magic;
+	u32 version;
+	u32 entryCount;
+	u32 bucketCount;   // Power of two, at least twice entryCount
+	u64 entriesOffset;
+	u64 bucketsOffset; // Entry index + 1 per bucket, 0 when empty
+	u64 namesOffset;
+	u64 namesSize;
+};
+
+struct AssetArchiveEntry
+{
+	u64 hash;
+	u64 offset;
+	u64 storedSize; // Bytes in the archive, smaller than size when compressed
+	u64 size;
+	u64 timestamp;  // Last write time of the file that was packed
+	u32 nameOffset;
+	u32 nameLength;
+	u32 flags;
+	u32 padding;
+};
+
+static_assert(sizeof(AssetArchiveHeader) == 48, "AssetArchiveHeader layout changed, bump ASSET_ARCHIVE_VERSION");
+static_assert(sizeof(AssetArchiveEntry) == 56, "AssetArchiveEntry layout changed, bump ASSET_ARCHIVE_VERSION");
+
+/**
+ * Maps the archive and makes MapFile, ReadTextFile and GetFileLastWriteTimestamp look into it
+ * before the disk. Call it once before any asset is loaded, the archive is never modified after
+ * that so lookups are safe from any thread. Returns false if there's no valid archive.
+ */
+bool MountAssetArchive(const char* archivePath);
+
+void UnmountAssetArchive();
+
+bool IsAssetArchiveMounted();
+
+/**
+ * Finds a file by the path the engine would open it with, relative to the working directory.
+ * Returns NULL when no archive is mounted or the file isn't in it.
+ */
+const AssetArchiveEntry* FindAssetArchiveEntry(const char* filepath);
+
+/**
+ * Files extracted at load time from an archived asset, like the embedded images of a .glb,
+ * whose directory may not exist on disk. MapFile and GetFileLastWriteTimestamp find them
+ * before the archive. The bytes are copied, adding a path twice keeps the first copy.
+ */
+void AddAssetArchiveOverlayFile(const char* filepath, const void* data, u64 size, u64 timestamp);
+
+/**
+ * Looks up a file added with AddAssetArchiveOverlayFile. file (optional) becomes a view of
+ * its bytes, valid until the archive is unmounted. Safe from any thread.
+ */
+bool FindAssetArchiveOverlayFile(const char* filepath, MappedFile* file, u64* timestamp);
+
+/**
+ * Points file at the entry inside the archive mapping, or at a heap copy for compressed entries.
+ * The result is released with UnmapFile like any other mapping.
+ */
+bool OpenAssetArchiveEntry(const AssetArchiveEntry& entry, MappedFile& file);
+
+/**
+ * Packs every file under rootDir into an archive, with paths relative to rootDir. Entries are
+ * compressed when that saves at least an eighth of their size, except cooked containers, which
+ * are read in place, and images that are compressed already.
+ */
+bool WriteAssetArchive(const char* archivePath, const char* rootDir);
@@ -0,0 +1,132 @@
+#include "AssetLoader.h"
+
+namespace
+{
+    void PushFinishedJob(AssetLoader& loader, AssetJob* job)
+    {
+        job->finishTime = GetElapsedMilliseconds();
+
+        // Workers only. The GL thread drains this queue every frame, so it is only full for a moment
+        while (!loader.finishedJobs.Push(job))
+            std::this_thread::yield();
+    }
+
+    void PushFinishedInlineJob(AssetLoader& loader, AssetJob* job)
+    {
+        job->finishTime = GetElapsedMilliseconds();
+
+        // The GL thread is the one draining finishedJobs, waiting here for room would never end
+        if (!loader.finishedJobs.Push(job))
+            loader.overflowJobs.push_back(job);
+    }
+
+    void WorkerLoop(AssetLoader* loader)
+    {
+        while (loader->running.load(std::memory_order_acquire))
+        {
+            AssetJob* job = nullptr;
+            if (loader->pendingJobs.Pop(job))
+            {
+                loader->execute(job);
+                PushFinishedJob(*loader, job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(loader->wakeMutex);
+            loader->wakeCondition.wait_for(lock, std::chrono::milliseconds(10));
+        }
+    }
+}
+
+AssetLoader::~AssetLoader()
+{
+    StopAssetLoader(*this);
+}
+
+void StartAssetLoader(AssetLoader& loader, u32 workerCount, AssetJobFunction execute)
+{
+    ASSERT(loader.workers.empty(), "The asset loader is already running");
+
+    loader.execute = execute;
+    loader.running.store(true, std::memory_order_release);
+
+    for (u32 i = 0; i < workerCount; ++i)
+        loader.workers.emplace_back(WorkerLoop, &loader);
+}
+
+void StopAssetLoader(AssetLoader& loader)
+{
+    loader.running.store(false, std::memory_order_release);
+    loader.wakeCondition.notify_all();
+
+    for (std::thread& worker : loader.workers)
+        worker.join();
+    loader.workers.clear();
+
+    // Jobs nobody will commit anymore
+    AssetJob* job = nullptr;
+    while (loader.pendingJobs.Pop(job))
+        delete job;
+    while (loader.finishedJobs.Pop(job))
+        delete job;
+    for (AssetJob* overflowJob : loader.overflowJobs)
+        delete overflowJob;
+    loader.overflowJobs.clear();
+}
+
+void SubmitAssetJob(AssetLoader& loader, AssetJob* job)
+{
+    loader.jobsInFlight.fetch_add(1, std::memory_order_relaxed);
+    job->requestTime = GetElapsedMilliseconds();
+
+    if (loader.workers.empty())
+    {
+        loader.execute(job);
+        PushFinishedInlineJob(loader, job);
+        return;
+    }
+
+    if (!loader.pendingJobs.Push(job))
+    {
+        // Queue full, do the work here rather than dropping the asset
+        loader.execute(job);
+        PushFinishedInlineJob(loader, job);
+        return;
+    }
+
+    loader.wakeCondition.notify_one();
+}
+
+AssetJob* PopFinishedAssetJob(AssetLoader& loader)
+{
+    AssetJob* job = nullptr;
+    if (loader.finishedJobs.Pop(job))
+        return job;
+
+    if (!loader.overflowJobs.empty())
+    {
+        job = loader.overflowJobs.front();
+        loader.overflowJobs.erase(loader.overflowJobs.begin());
+        return job;
+    }
+
+    return nullptr;
+}
+
+void MarkAssetJobCommitted(AssetLoader& loader)
+{
+    loader.jobsInFlight.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool HasPendingAssetJobs(const AssetLoader& loader)
+{
+    return loader.jobsInFlight.load(std::memory_order_relaxed) > 0;
+}
+
+u32 GetDefaultAssetWorkerCount()
+{
+    u32 hardwareThreads = std::thread::hardware_concurrency();
+
+    // Leave one core for the GL thread
+    return hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+}
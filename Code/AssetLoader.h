@@ -0,0 +1,226 @@
+//
+// AssetLoader.h: Asynchronous asset loading. Worker threads read files, decode images and
+// import models into CPU payloads. Finished jobs are handed to the GL thread through a
+// lock-free queue, and the GL thread is the only one that creates GPU objects from them.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+#include "TextureCooker.h"
+#include "TextureStreamer.h"
+#include "VertexPacking.h"
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+struct Image
+{
+    void* pixels;
+    glm::ivec2 size;
+    i32   nchannels;
+    i32   stride;
+    bool  decodedByStb; // Released with stbi_image_free, otherwise the pixels were malloc'd
+};
+
+// Everything a model import produces before touching OpenGL
+struct ImportedModel
+{
+    std::vector<Submesh>         submeshes;
+    std::vector<MaterialDesc>    materials;
+    std::vector<u32>             submeshMaterials; // Indices into materials
+    std::vector<ModelNode>       nodes;            // Only when the hierarchy is preserved
+    std::vector<SubmeshInstance> instances;
+
+    // Packed GPU blobs. They point into the mapping when the model comes from its mesh
+    // cache, or into the packed vectors after an Assimp import.
+    MappedFile      cacheFile;
+    std::vector<u8> packedVertices;
+    std::vector<u8> packedIndices;
+    const void*     vertexData;
+    u32             vertexDataSize;
+    const void*     indexData;
+    u32             indexDataSize;
+
+    glm::vec3 aabbMin;
+    glm::vec3 aabbMax;
+    glm::vec3 positionScale;
+    glm::vec3 positionOffset;
+};
+
+// Block compressed mip chain, either mapped from its .ctex file or cooked in memory
+struct CookedTexture
+{
+    MappedFile        file;
+    std::vector<u8>   memory;
+    CookedTextureView view;
+};
+
+enum AssetJobType
+{
+    AssetJob_Texture,
+    AssetJob_PackedTexture,
+    AssetJob_Model
+};
+
+struct AssetJob
+{
+    AssetJobType    type;
+    u32             assetIdx; // Slot reserved in App::textures or App::models by the request
+    std::string     filepath;
+    bool            succeeded;
+    f64             requestTime; // GetElapsedMilliseconds() when submitted
+    f64             finishTime;  // GetElapsedMilliseconds() when the CPU work was done
+
+    TextureUsage    textureUsage;
+    TexturePackDesc texturePack; // Sources of an AssetJob_PackedTexture
+    bool            compressTexture;
+    bool            streamTexture; // Upload only the coarse levels and keep the chain for streaming
+    Image           image;  // Released once the mip chain is built
+    CookedTexture   cooked;
+    TextureMipChain chain;  // Only the layout is left when the texture isn't streamed
+    TextureUploadRing* uploadRing;
+    TextureUpload   upload; // Written by the worker, consumed by CreateTextureFromUpload
+
+    VertexFormat    vertexFormat;
+    bool            preserveHierarchy;
+    bool            nativeObjImport;
+    ImportedModel   model;
+};
+
+typedef void (*AssetJobFunction)(AssetJob* job);
+
+// Bounded multi-producer multi-consumer queue (Dmitry Vyukov's algorithm).
+// Each cell carries a sequence number telling whether it is ready to be written or read.
+template <typename T, u32 Capacity>
+class LockFreeQueue
+{
+    static_assert(Capacity && !(Capacity & (Capacity - 1)), "Capacity must be a power of 2");
+
+public:
+    LockFreeQueue()
+    {
+        for (u32 i = 0; i < Capacity; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    bool Push(const T& value)
+    {
+        u32 pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells[pos & (Capacity - 1)];
+            u32 sequence = cell.sequence.load(std::memory_order_acquire);
+            i32 diff = (i32)sequence - (i32)pos;
+            if (diff == 0)
+            {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // Full
+            }
+            else
+            {
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool Pop(T& value)
+    {
+        u32 pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = cells[pos & (Capacity - 1)];
+            u32 sequence = cell.sequence.load(std::memory_order_acquire);
+            i32 diff = (i32)sequence - (i32)(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(pos + Capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // Empty
+            }
+            else
+            {
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<u32> sequence;
+        T value;
+    };
+
+    Cell cells[Capacity];
+    alignas(64) std::atomic<u32> enqueuePos;
+    alignas(64) std::atomic<u32> dequeuePos;
+};
+
+#define ASSET_LOADER_QUEUE_SIZE 1024
+
+struct AssetLoader
+{
+    ~AssetLoader();
+
+    std::vector<std::thread> workers;
+    AssetJobFunction         execute = nullptr;
+
+    LockFreeQueue<AssetJob*, ASSET_LOADER_QUEUE_SIZE> pendingJobs;
+    LockFreeQueue<AssetJob*, ASSET_LOADER_QUEUE_SIZE> finishedJobs;
+
+    // Jobs the GL thread ran inline while finishedJobs was full. Only touched by the GL thread.
+    std::vector<AssetJob*>   overflowJobs;
+
+    // Only used to put idle workers to sleep, jobs never go through the lock
+    std::mutex              wakeMutex;
+    std::condition_variable wakeCondition;
+
+    std::atomic<bool> running{ false };
+    std::atomic<u32>  jobsInFlight{ 0 };
+};
+
+/**
+ * Starts the worker threads. With workerCount == 0 the loader runs every job on the
+ * calling thread as soon as it is submitted, which is the serial loading behaviour.
+ */
+void StartAssetLoader(AssetLoader& loader, u32 workerCount, AssetJobFunction execute);
+
+void StopAssetLoader(AssetLoader& loader);
+
+/**
+ * Must be called from the GL thread. Jobs it has to run inline never wait for room in
+ * the finished queue, since the GL thread is the one draining it.
+ */
+void SubmitAssetJob(AssetLoader& loader, AssetJob* job);
+
+/**
+ * Returns the next job whose CPU work is finished, or NULL if there is none yet.
+ * The caller owns the job and must delete it once its results are uploaded.
+ */
+AssetJob* PopFinishedAssetJob(AssetLoader& loader);
+
+void MarkAssetJobCommitted(AssetLoader& loader);
+
+bool HasPendingAssetJobs(const AssetLoader& loader);
+
+u32 GetDefaultAssetWorkerCount();
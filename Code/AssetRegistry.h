@@ -0,0 +1,58 @@
+//
+// AssetRegistry.h: Hashed lookup of the assets already loaded by the engine. Loading the
+// same file twice returns the index of the first load, so GPU memory and load times grow
+// with the number of unique assets instead of the number of entities and lights using them.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+#include <unordered_map>
+
+struct AssetRegistry
+{
+	std::unordered_map<std::string, u32> models;    // Source path -> App::models
+	std::unordered_map<std::string, u32> meshes;    // Source path -> App::meshes
+	std::unordered_map<std::string, u32> materials; // Model directory + material description -> App::materials
+	std::unordered_map<std::string, u32> textures;  // Image path -> App::textures
+};
+
+// Same file, same key: "Patrick\Patrick.obj" and "./Patrick/Patrick.obj" must collide
+inline std::string MakeAssetKey(const char* path)
+{
+	std::string key = path;
+	for (char& c : key)
+	{
+		if (c == '\\')
+			c = '/';
+	}
+
+	while (key.compare(0, 2, "./") == 0)
+		key.erase(0, 2);
+
+	return key;
+}
+
+// Materials have no file of their own. Models in the same directory usually share the
+// material library, but generic names such as "DefaultMaterial" are only the same
+// material if they also point to the same textures.
+inline std::string MakeMaterialKey(const char* directory, const MaterialDesc& material)
+{
+	return MakeAssetKey(directory) + "/" + material.name + "|" +
+		material.albedoTexture + "|" + material.emissiveTexture + "|" + material.specularTexture + "|" +
+		material.normalsTexture + "|" + material.bumpTexture + "|" + material.roughnessTexture + "|" +
+		material.metallicTexture + "|" + material.occlusionTexture + "|" +
+		std::to_string(material.occlusionChannel) + std::to_string(material.roughnessChannel) + std::to_string(material.metallicChannel);
+}
+
+inline u32 FindAsset(const std::unordered_map<std::string, u32>& assets, const std::string& key)
+{
+	auto it = assets.find(key);
+	return it != assets.end() ? it->second : UINT32_MAX;
+}
+
+inline void RegisterAsset(std::unordered_map<std::string, u32>& assets, const std::string& key, u32 index)
+{
+	assets[key] = index;
+}
@@ -3,11 +3,19 @@
 #include "platform.h"
 
 // ------ VBO ------
+enum VertexAttributeFormat
+{
+	VertexAttribute_Float = 0,
+	VertexAttribute_Snorm16, // Normalized to [-1, 1] when fetched
+	VertexAttribute_Half
+};
+
 struct VertexBufferAttribute
 {
 	u8 location;
 	u8 componentCount;
 	u8 offset;
+	u8 format; // VertexAttributeFormat
 };
 
 struct VertexBufferLayout
@@ -18,6 +26,20 @@ struct VertexBufferLayout
 
 // ------ VBO End ------
 
+// ------ Indirect ------
+
+// Layout glDrawElementsIndirect reads from GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand
+{
+	u32 count;
+	u32 instanceCount;
+	u32 firstIndex;
+	i32 baseVertex;
+	u32 baseInstance;
+};
+
+// ------ Indirect End ------
+
 // ------ Shader ------
 
 struct VertexShaderAttribute
@@ -33,13 +55,3 @@ struct VertexShaderLayout
 
 // ------ Shader End ------
 
-// ------ VAO ------
-
-struct Vao
-{
-	u32 handle;
-	u32 programHandle;
-};
-
-// ------ VAO End ------
-
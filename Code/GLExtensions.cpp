@@ -0,0 +1,42 @@
+#include "GLExtensions.h"
+#include "platform.h"
+#include <string.h>
+
+GLExtensions GLExt = {};
+
+bool HasGLExtension(const char* name)
+{
+	GLint extensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+	for (GLint i = 0; i < extensionCount; ++i)
+	{
+		if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, GLuint(i)), name) == 0)
+			return true;
+	}
+	return false;
+}
+
+void LoadGLExtensions(GLADloadproc load)
+{
+	const bool isGL44 = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 4);
+
+	if (isGL44 || HasGLExtension("GL_ARB_buffer_storage"))
+		GLExt.bufferStorage = (PFNGLBUFFERSTORAGEPROC_EXT)load("glBufferStorage");
+
+	if (!GLExt.bufferStorage)
+		ILOG("glBufferStorage is not available, buffers fall back to glBufferData");
+}
+
+bool CreateBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags)
+{
+	if (GLExt.bufferStorage)
+	{
+		GLExt.bufferStorage(target, size, data, flags);
+		return true;
+	}
+
+	// Without the map flags the buffer is only written with glBufferSubData
+	const bool isMapped = (flags & (GL_MAP_WRITE_BIT | GL_MAP_READ_BIT)) != 0;
+	glBufferData(target, size, data, isMapped ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+	return false;
+}
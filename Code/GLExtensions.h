@@ -0,0 +1,40 @@
+//
+// GLExtensions.h: Entry points newer than the OpenGL 4.3 core profile glad was generated for.
+// They are loaded after glad and stay null when the driver does not expose them, so every
+// caller keeps a 4.3 fallback.
+//
+
+#pragma once
+
+#include <glad/glad.h>
+
+// GL 4.4 / ARB_buffer_storage
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT  0x0040
+#define GL_MAP_COHERENT_BIT    0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT  0x0200
+#endif
+
+typedef void (APIENTRYP PFNGLBUFFERSTORAGEPROC_EXT)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+struct GLExtensions
+{
+	PFNGLBUFFERSTORAGEPROC_EXT bufferStorage;
+};
+
+extern GLExtensions GLExt;
+
+/**
+ * Loads the entry points with the same loader glad used. Call it right after glad, with a
+ * current context.
+ */
+void LoadGLExtensions(GLADloadproc load);
+
+bool HasGLExtension(const char* name);
+
+/**
+ * Immutable storage for the buffer bound to target when the driver supports it, a regular
+ * glBufferData otherwise. Returns true if the storage is immutable.
+ */
+bool CreateBufferStorage(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
@@ -0,0 +1,427 @@
+#include "GeometryArena.h"
+#include "GLExtensions.h"
+#include <algorithm>
+
+namespace
+{
+	u32 AlignSize(u32 size, u32 alignment)
+	{
+		return ((size + alignment - 1) / alignment) * alignment;
+	}
+
+	bool IsSameLayout(const VertexBufferLayout& a, const VertexBufferLayout& b)
+	{
+		if (a.stride != b.stride || a.attributes.size() != b.attributes.size())
+			return false;
+
+		for (u32 i = 0; i < a.attributes.size(); ++i)
+		{
+			const VertexBufferAttribute& attributeA = a.attributes[i];
+			const VertexBufferAttribute& attributeB = b.attributes[i];
+			if (attributeA.location != attributeB.location || attributeA.componentCount != attributeB.componentCount ||
+				attributeA.offset != attributeB.offset || attributeA.format != attributeB.format)
+				return false;
+		}
+		return true;
+	}
+
+	u32 CreateLayoutVao(const VertexBufferLayout& layout)
+	{
+		u32 vao = 0;
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+
+		// Every attribute reads from binding 0, which gets the page of each draw
+		for (const VertexBufferAttribute& attribute : layout.attributes)
+		{
+			GLenum type = GL_FLOAT;
+			GLboolean normalized = GL_FALSE;
+			switch (attribute.format)
+			{
+				case VertexAttribute_Snorm16: type = GL_SHORT; normalized = GL_TRUE; break;
+				case VertexAttribute_Half: type = GL_HALF_FLOAT; break;
+				default: break;
+			}
+
+			glEnableVertexAttribArray(attribute.location);
+			glVertexAttribFormat(attribute.location, attribute.componentCount, type, normalized, attribute.offset);
+			glVertexAttribBinding(attribute.location, 0);
+		}
+
+		glBindVertexArray(0);
+		return vao;
+	}
+
+	GeometryPool MakePool(const VertexBufferLayout& layout, u32 alignment)
+	{
+		GeometryPool pool = {};
+		pool.layout = layout;
+		pool.alignment = alignment;
+		return pool;
+	}
+
+	u32 FindOrCreateVertexPool(GeometryArena& arena, const VertexBufferLayout& layout)
+	{
+		for (u32 i = 0; i < arena.vertexPools.size(); ++i)
+		{
+			if (IsSameLayout(arena.vertexPools[i].layout, layout))
+				return i;
+		}
+
+		GeometryPool pool = MakePool(layout, layout.stride);
+		pool.vao = CreateLayoutVao(layout);
+		arena.vertexPools.push_back(pool);
+		return (u32)arena.vertexPools.size() - 1u;
+	}
+
+	GeometryPage CreatePage(u32 size)
+	{
+		GeometryPage page = {};
+		page.size = size;
+		page.freeRanges.push_back(GeometryRange{ 0, size });
+
+		// The copy targets leave the element buffer of the bound VAO alone
+		glGenBuffers(1, &page.handle);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, page.handle);
+		CreateBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return page;
+	}
+
+	// Big allocations get a page of their own, pages are always whole vertices
+	u32 GetPageSize(const GeometryArena& arena, const GeometryPool& pool, u32 size)
+	{
+		u32 pageSize = (arena.pageSize / pool.alignment) * pool.alignment;
+		return glm::max(pageSize, size);
+	}
+
+	u32 AddPage(GeometryPool& pool, u32 size)
+	{
+		GeometryPage page = CreatePage(size);
+		for (u32 i = 0; i < pool.pages.size(); ++i)
+		{
+			if (pool.pages[i].handle == 0)
+			{
+				pool.pages[i] = page;
+				return i;
+			}
+		}
+
+		pool.pages.push_back(page);
+		return (u32)pool.pages.size() - 1u;
+	}
+
+	bool AllocateFromPage(GeometryPage& page, u32 size, u32& offset)
+	{
+		// First fit
+		for (u32 i = 0; i < page.freeRanges.size(); ++i)
+		{
+			GeometryRange& range = page.freeRanges[i];
+			if (range.size < size)
+				continue;
+
+			offset = range.offset;
+			range.offset += size;
+			range.size -= size;
+			if (range.size == 0)
+				page.freeRanges.erase(page.freeRanges.begin() + i);
+
+			page.usedSize += size;
+			return true;
+		}
+		return false;
+	}
+
+	void FreeToPage(GeometryPage& page, u32 offset, u32 size)
+	{
+		auto next = std::lower_bound(page.freeRanges.begin(), page.freeRanges.end(), offset,
+			[](const GeometryRange& range, u32 value) { return range.offset < value; });
+		next = page.freeRanges.insert(next, GeometryRange{ offset, size });
+		page.usedSize -= size;
+
+		// Merge with the following range, then with the previous one
+		if (next + 1 != page.freeRanges.end() && next->offset + next->size == (next + 1)->offset)
+		{
+			next->size += (next + 1)->size;
+			page.freeRanges.erase(next + 1);
+		}
+		if (next != page.freeRanges.begin() && (next - 1)->offset + (next - 1)->size == next->offset)
+		{
+			(next - 1)->size += next->size;
+			page.freeRanges.erase(next);
+		}
+	}
+
+	u32 AllocateRange(GeometryArena& arena, GeometryPool& pool, u32 poolIndex, u32 size)
+	{
+		size = AlignSize(glm::max(size, 1u), pool.alignment);
+
+		GeometryAllocation allocation = {};
+		allocation.pool = poolIndex;
+		allocation.size = size;
+		allocation.isLive = true;
+
+		bool found = false;
+		for (u32 i = 0; i < pool.pages.size() && !found; ++i)
+		{
+			if (pool.pages[i].handle && AllocateFromPage(pool.pages[i], size, allocation.offset))
+			{
+				allocation.page = i;
+				found = true;
+			}
+		}
+
+		if (!found)
+		{
+			allocation.page = AddPage(pool, GetPageSize(arena, pool, size));
+			AllocateFromPage(pool.pages[allocation.page], size, allocation.offset);
+		}
+
+		if (!arena.freeAllocations.empty())
+		{
+			u32 allocationIdx = arena.freeAllocations.back();
+			arena.freeAllocations.pop_back();
+			arena.allocations[allocationIdx] = allocation;
+			return allocationIdx;
+		}
+
+		arena.allocations.push_back(allocation);
+		return (u32)arena.allocations.size() - 1u;
+	}
+
+	void FreeRange(GeometryArena& arena, GeometryPool& pool, u32 allocationIdx)
+	{
+		GeometryAllocation& allocation = arena.allocations[allocationIdx];
+		ASSERT(allocation.isLive, "Geometry range freed twice");
+
+		GeometryPage& page = pool.pages[allocation.page];
+		FreeToPage(page, allocation.offset, allocation.size);
+		allocation.isLive = false;
+		arena.freeAllocations.push_back(allocationIdx);
+
+		// Release emptied pages but keep the last one around for the next load
+		u32 livePages = 0;
+		for (const GeometryPage& other : pool.pages)
+			livePages += other.handle ? 1 : 0;
+
+		if (page.usedSize == 0 && livePages > 1)
+		{
+			glDeleteBuffers(1, &page.handle);
+			page = GeometryPage{};
+		}
+	}
+
+	void UploadRange(const GeometryPool& pool, const GeometryAllocation& allocation, const void* data, u32 size)
+	{
+		glBindBuffer(GL_COPY_WRITE_BUFFER, pool.pages[allocation.page].handle);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.offset, size, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+
+	bool NeedsDefragment(const GeometryPool& pool)
+	{
+		u64 capacity = 0, freeSize = 0;
+		u32 freeRangeCount = 0;
+		for (const GeometryPage& page : pool.pages)
+		{
+			capacity += page.size;
+			freeSize += page.size - page.usedSize;
+			freeRangeCount += (u32)page.freeRanges.size();
+		}
+		return freeRangeCount > 1 && freeSize * 4 >= capacity;
+	}
+
+	void DefragmentPool(GeometryArena& arena, GeometryPool& pool, bool isIndexPool, u32 poolIndex)
+	{
+		std::vector<u32> live;
+		for (u32 i = 0; i < arena.allocations.size(); ++i)
+		{
+			const GeometryAllocation& allocation = arena.allocations[i];
+			const bool inPool = isIndexPool ? allocation.pool == UINT32_MAX : allocation.pool == poolIndex;
+			if (allocation.isLive && inPool)
+				live.push_back(i);
+		}
+
+		// Keep the current order, so ranges drawn together stay together
+		std::sort(live.begin(), live.end(), [&](u32 a, u32 b) {
+			const GeometryAllocation& allocationA = arena.allocations[a];
+			const GeometryAllocation& allocationB = arena.allocations[b];
+			return allocationA.page != allocationB.page ? allocationA.page < allocationB.page : allocationA.offset < allocationB.offset;
+		});
+
+		std::vector<GeometryPage> oldPages;
+		oldPages.swap(pool.pages);
+
+		for (u32 allocationIdx : live)
+		{
+			GeometryAllocation& allocation = arena.allocations[allocationIdx];
+
+			u32 page = UINT32_MAX, offset = 0;
+			if (!pool.pages.empty() && AllocateFromPage(pool.pages.back(), allocation.size, offset))
+			{
+				page = (u32)pool.pages.size() - 1u;
+			}
+			else
+			{
+				pool.pages.push_back(CreatePage(GetPageSize(arena, pool, allocation.size)));
+				page = (u32)pool.pages.size() - 1u;
+				AllocateFromPage(pool.pages[page], allocation.size, offset);
+			}
+
+			glBindBuffer(GL_COPY_READ_BUFFER, oldPages[allocation.page].handle);
+			glBindBuffer(GL_COPY_WRITE_BUFFER, pool.pages[page].handle);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation.offset, offset, allocation.size);
+
+			allocation.page = page;
+			allocation.offset = offset;
+		}
+
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		for (GeometryPage& page : oldPages)
+		{
+			if (page.handle)
+				glDeleteBuffers(1, &page.handle);
+		}
+	}
+}
+
+void InitGeometryArena(GeometryArena& arena, u32 pageSize)
+{
+	arena = GeometryArena{};
+	arena.pageSize = pageSize;
+	arena.indexPool = MakePool(VertexBufferLayout{}, GEOMETRY_INDEX_ALIGNMENT);
+}
+
+void UploadSubmeshGeometry(GeometryArena& arena, Submesh& submesh, const void* vertexData, const void* indexData)
+{
+	const u32 vertexSize = submesh.vertexCount * submesh.vertexBufferLayout.stride;
+	const u32 indexSize = submesh.indexCount * submesh.indexSize;
+
+	u32 poolIdx = FindOrCreateVertexPool(arena, submesh.vertexBufferLayout);
+	GeometryPool& pool = arena.vertexPools[poolIdx];
+	submesh.vertexAllocation = AllocateRange(arena, pool, poolIdx, vertexSize);
+	UploadRange(pool, arena.allocations[submesh.vertexAllocation], vertexData, vertexSize);
+
+	submesh.indexAllocation = AllocateRange(arena, arena.indexPool, UINT32_MAX, indexSize);
+	UploadRange(arena.indexPool, arena.allocations[submesh.indexAllocation], indexData, indexSize);
+}
+
+void FreeSubmeshGeometry(GeometryArena& arena, Submesh& submesh)
+{
+	if (submesh.vertexAllocation != GEOMETRY_INVALID_ALLOCATION)
+	{
+		GeometryAllocation& allocation = arena.allocations[submesh.vertexAllocation];
+		FreeRange(arena, arena.vertexPools[allocation.pool], submesh.vertexAllocation);
+		submesh.vertexAllocation = GEOMETRY_INVALID_ALLOCATION;
+	}
+
+	if (submesh.indexAllocation != GEOMETRY_INVALID_ALLOCATION)
+	{
+		FreeRange(arena, arena.indexPool, submesh.indexAllocation);
+		submesh.indexAllocation = GEOMETRY_INVALID_ALLOCATION;
+	}
+}
+
+void DefragmentGeometryArena(GeometryArena& arena)
+{
+	for (u32 i = 0; i < arena.vertexPools.size(); ++i)
+	{
+		if (NeedsDefragment(arena.vertexPools[i]))
+		{
+			DefragmentPool(arena, arena.vertexPools[i], false, i);
+			arena.defragmentCount++;
+		}
+	}
+
+	if (NeedsDefragment(arena.indexPool))
+	{
+		DefragmentPool(arena, arena.indexPool, true, UINT32_MAX);
+		arena.defragmentCount++;
+	}
+}
+
+void BindSubmeshGeometry(const GeometryArena& arena, const Submesh& submesh, GeometryBinding& binding)
+{
+	const GeometryAllocation& vertices = arena.allocations[submesh.vertexAllocation];
+	const GeometryAllocation& indices = arena.allocations[submesh.indexAllocation];
+	const GeometryPool& pool = arena.vertexPools[vertices.pool];
+
+	if (binding.vao != pool.vao)
+	{
+		glBindVertexArray(pool.vao);
+		binding = GeometryBinding{ pool.vao, 0, 0 };
+	}
+
+	const u32 vertexBuffer = pool.pages[vertices.page].handle;
+	if (binding.vertexBuffer != vertexBuffer)
+	{
+		glBindVertexBuffer(0, vertexBuffer, 0, pool.layout.stride);
+		binding.vertexBuffer = vertexBuffer;
+	}
+
+	const u32 indexBuffer = arena.indexPool.pages[indices.page].handle;
+	if (binding.indexBuffer != indexBuffer)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+		binding.indexBuffer = indexBuffer;
+	}
+}
+
+void DrawSubmeshGeometry(const GeometryArena& arena, const Submesh& submesh, u32 lod, u32 instanceCount)
+{
+	const GeometryAllocation& vertices = arena.allocations[submesh.vertexAllocation];
+	const GeometryAllocation& indices = arena.allocations[submesh.indexAllocation];
+	const SubmeshLod& range = submesh.lods[glm::min(lod, submesh.lodCount - 1)];
+
+	const GLenum indexType = submesh.indexSize == sizeof(u16) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	const GLint baseVertex = GLint(vertices.offset / submesh.vertexBufferLayout.stride);
+	const u64 indexOffset = indices.offset + (u64)range.firstIndex * submesh.indexSize;
+	glDrawElementsInstancedBaseVertex(GL_TRIANGLES, range.indexCount, indexType, (void*)indexOffset, instanceCount, baseVertex);
+}
+
+GeometryLocation GetSubmeshGeometryLocation(const GeometryArena& arena, const Submesh& submesh)
+{
+	const GeometryAllocation& vertices = arena.allocations[submesh.vertexAllocation];
+	const GeometryAllocation& indices = arena.allocations[submesh.indexAllocation];
+
+	GeometryLocation location = {};
+	location.indexBuffer = arena.indexPool.pages[indices.page].handle;
+	location.indexOffset = indices.offset;
+	location.baseVertex = (i32)(vertices.offset / submesh.vertexBufferLayout.stride);
+	return location;
+}
+
+u32 GetSubmeshGeometryKey(const GeometryArena& arena, const Submesh& submesh)
+{
+	const GeometryAllocation& vertices = arena.allocations[submesh.vertexAllocation];
+	const GeometryAllocation& indices = arena.allocations[submesh.indexAllocation];
+	return (glm::min(vertices.pool, 0xFFFu) << 20) | (glm::min(vertices.page, 0x3FFu) << 10) | glm::min(indices.page, 0x3FFu);
+}
+
+GeometryArenaStats GetGeometryArenaStats(const GeometryArena& arena)
+{
+	GeometryArenaStats stats = {};
+	stats.vertexPoolCount = (u32)arena.vertexPools.size();
+
+	auto addPool = [&stats](const GeometryPool& pool) {
+		for (const GeometryPage& page : pool.pages)
+		{
+			if (!page.handle)
+				continue;
+
+			stats.pageCount++;
+			stats.capacity += page.size;
+			stats.usedSize += page.usedSize;
+			for (const GeometryRange& range : page.freeRanges)
+				stats.largestFreeRange = glm::max(stats.largestFreeRange, (u64)range.size);
+		}
+	};
+
+	for (const GeometryPool& pool : arena.vertexPools)
+		addPool(pool);
+	addPool(arena.indexPool);
+
+	return stats;
+}
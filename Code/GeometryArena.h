@@ -0,0 +1,111 @@
+//
+// GeometryArena.h: Every vertex and index of every mesh lives in a few large immutable buffer
+// pages. Vertices are pooled by layout, so each layout needs a single VAO and a submesh is just
+// a range of its pages drawn with a base vertex. Pages are sub-allocated with a free list and
+// compacted when unloading leaves them fragmented.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+#define GEOMETRY_ARENA_PAGE_SIZE    (16 * 1024 * 1024)
+#define GEOMETRY_INDEX_ALIGNMENT    4
+#define GEOMETRY_INVALID_ALLOCATION UINT32_MAX
+
+struct GeometryRange
+{
+	u32 offset;
+	u32 size;
+};
+
+struct GeometryPage
+{
+	u32 handle; // 0 once released, the slot is reused by the next page
+	u32 size;
+	u32 usedSize;
+	std::vector<GeometryRange> freeRanges; // Sorted by offset, neighbours are always merged
+};
+
+// Vertex pools hold a single layout, the index pool holds 16 and 32 bit indices alike
+struct GeometryPool
+{
+	VertexBufferLayout layout;
+	u32 alignment; // Stride of the layout, so page offsets are whole vertices
+	u32 vao;       // Attribute formats of the layout, the page is bound at draw time
+	std::vector<GeometryPage> pages;
+};
+
+struct GeometryAllocation
+{
+	u32 pool; // Index in vertexPools, unused for indices
+	u32 page;
+	u32 offset; // In bytes from the start of the page
+	u32 size;
+	bool isLive;
+};
+
+struct GeometryArena
+{
+	std::vector<GeometryPool> vertexPools;
+	GeometryPool indexPool;
+	std::vector<GeometryAllocation> allocations; // Submeshes keep indices into this, so pages can move
+	std::vector<u32> freeAllocations;
+	u32 pageSize;
+	u32 defragmentCount;
+};
+
+// Buffers bound by the last draw, consecutive draws of the same pages skip the binds
+struct GeometryBinding
+{
+	u32 vao;
+	u32 vertexBuffer;
+	u32 indexBuffer;
+};
+
+// Where the geometry of a submesh is, for passes that read it outside of a draw
+struct GeometryLocation
+{
+	u32 indexBuffer;
+	u32 indexOffset; // In bytes from the start of indexBuffer
+	i32 baseVertex;
+};
+
+struct GeometryArenaStats
+{
+	u32 vertexPoolCount;
+	u32 pageCount;
+	u64 capacity;
+	u64 usedSize;
+	u64 largestFreeRange;
+};
+
+void InitGeometryArena(GeometryArena& arena, u32 pageSize = GEOMETRY_ARENA_PAGE_SIZE);
+
+/**
+ * Allocates the vertex and index ranges of a packed submesh and uploads them. vertexData and
+ * indexData point to the first vertex and index of the submesh. Sets the allocations of the
+ * submesh, its vertex and index offsets stay relative to the packed blobs.
+ */
+void UploadSubmeshGeometry(GeometryArena& arena, Submesh& submesh, const void* vertexData, const void* indexData);
+
+void FreeSubmeshGeometry(GeometryArena& arena, Submesh& submesh);
+
+/**
+ * Compacts the pools whose free space is a quarter or more of their capacity and is split in
+ * several ranges. Live ranges are copied on the GPU into new pages, in their current order.
+ */
+void DefragmentGeometryArena(GeometryArena& arena);
+
+// Binds the VAO of the submesh layout and its pages, skipping what binding says is already bound
+void BindSubmeshGeometry(const GeometryArena& arena, const Submesh& submesh, GeometryBinding& binding);
+
+void DrawSubmeshGeometry(const GeometryArena& arena, const Submesh& submesh, u32 lod = 0, u32 instanceCount = 1);
+
+GeometryLocation GetSubmeshGeometryLocation(const GeometryArena& arena, const Submesh& submesh);
+
+// Sorting draws by this key groups them by VAO, then vertex page, then index page
+u32 GetSubmeshGeometryKey(const GeometryArena& arena, const Submesh& submesh);
+
+GeometryArenaStats GetGeometryArenaStats(const GeometryArena& arena);
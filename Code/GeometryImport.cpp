@@ -0,0 +1,117 @@
+#include "GeometryImport.h"
+
+void GenerateSmoothNormals(const u32* indices, u32 indexCount, const glm::vec3* positions, u32 vertexCount, glm::vec3* normals)
+{
+	for (u32 v = 0; v < vertexCount; ++v)
+		normals[v] = glm::vec3(0.0f);
+
+	// The cross product is twice the area of the triangle, bigger faces weigh more
+	for (u32 i = 0; i + 2 < indexCount; i += 3)
+	{
+		const u32 v0 = indices[i], v1 = indices[i + 1], v2 = indices[i + 2];
+		glm::vec3 faceNormal = glm::cross(positions[v1] - positions[v0], positions[v2] - positions[v0]);
+		normals[v0] += faceNormal;
+		normals[v1] += faceNormal;
+		normals[v2] += faceNormal;
+	}
+
+	for (u32 v = 0; v < vertexCount; ++v)
+	{
+		f32 length = glm::length(normals[v]);
+		normals[v] = length > 0.0f ? normals[v] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+	}
+}
+
+void GenerateTangentFrames(const u32* indices, u32 indexCount, const glm::vec3* positions, const glm::vec3* normals,
+	const glm::vec2* texCoords, u32 vertexCount, glm::vec3* tangents, glm::vec3* bitangents)
+{
+	for (u32 v = 0; v < vertexCount; ++v)
+	{
+		tangents[v] = glm::vec3(0.0f);
+		bitangents[v] = glm::vec3(0.0f);
+	}
+
+	for (u32 i = 0; i + 2 < indexCount; i += 3)
+	{
+		const u32 v0 = indices[i], v1 = indices[i + 1], v2 = indices[i + 2];
+		glm::vec3 edge1 = positions[v1] - positions[v0];
+		glm::vec3 edge2 = positions[v2] - positions[v0];
+		glm::vec2 delta1 = texCoords[v1] - texCoords[v0];
+		glm::vec2 delta2 = texCoords[v2] - texCoords[v0];
+
+		// Triangles without area in texture space can't orient anything
+		f32 determinant = delta1.x * delta2.y - delta2.x * delta1.y;
+		if (fabsf(determinant) < 1e-12f)
+			continue;
+
+		glm::vec3 tangent = (edge1 * delta2.y - edge2 * delta1.y) / determinant;
+		glm::vec3 bitangent = (edge2 * delta1.x - edge1 * delta2.x) / determinant;
+		for (u32 v : { v0, v1, v2 })
+		{
+			tangents[v] += tangent;
+			bitangents[v] += bitangent;
+		}
+	}
+
+	for (u32 v = 0; v < vertexCount; ++v)
+	{
+		glm::vec3 tangent = OrthogonalizeTangent(normals[v], tangents[v]);
+		glm::vec3 bitangent = glm::cross(normals[v], tangent);
+		bitangents[v] = glm::dot(bitangent, bitangents[v]) < 0.0f ? -bitangent : bitangent;
+		tangents[v] = tangent;
+	}
+}
+
+glm::vec3 OrthogonalizeTangent(const glm::vec3& normal, const glm::vec3& tangent)
+{
+	glm::vec3 result = tangent - normal * glm::dot(normal, tangent);
+	if (glm::dot(result, result) < 1e-12f)
+		result = fabsf(normal.x) < 0.9f ? glm::cross(normal, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(normal, glm::vec3(0.0f, 1.0f, 0.0f));
+	return glm::normalize(result);
+}
+
+void BuildImportedSubmesh(const ImportedVertices& vertices, std::vector<u32>& indices, Submesh& submesh)
+{
+	const bool hasTangentSpace = vertices.texCoords && vertices.tangents && vertices.bitangents;
+
+	VertexBufferLayout vertexBufferLayout = {};
+	vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 0, 3, 0, VertexAttribute_Float });
+	vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 1, 3, 3 * sizeof(float), VertexAttribute_Float });
+	vertexBufferLayout.stride = 6 * sizeof(float);
+	if (vertices.texCoords)
+	{
+		vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 2, 2, vertexBufferLayout.stride, VertexAttribute_Float });
+		vertexBufferLayout.stride += 2 * sizeof(float);
+	}
+	if (hasTangentSpace)
+	{
+		vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 3, 3, vertexBufferLayout.stride, VertexAttribute_Float });
+		vertexBufferLayout.stride += 3 * sizeof(float);
+		vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 4, 3, vertexBufferLayout.stride, VertexAttribute_Float });
+		vertexBufferLayout.stride += 3 * sizeof(float);
+	}
+
+	std::vector<float> interleaved;
+	interleaved.reserve(vertices.vertexCount * (vertexBufferLayout.stride / sizeof(float)));
+	for (u32 v = 0; v < vertices.vertexCount; ++v)
+	{
+		const glm::vec3& position = vertices.positions[v];
+		const glm::vec3& normal = vertices.normals[v];
+		interleaved.insert(interleaved.end(), { position.x, position.y, position.z, normal.x, normal.y, normal.z });
+
+		if (vertices.texCoords)
+			interleaved.insert(interleaved.end(), { vertices.texCoords[v].x, vertices.texCoords[v].y });
+
+		if (hasTangentSpace)
+		{
+			const glm::vec3& tangent = vertices.tangents[v];
+			const glm::vec3& bitangent = vertices.bitangents[v];
+			interleaved.insert(interleaved.end(), { tangent.x, tangent.y, tangent.z, bitangent.x, bitangent.y, bitangent.z });
+		}
+	}
+
+	submesh = {};
+	submesh.vertexBufferLayout = vertexBufferLayout;
+	submesh.vertices.swap(interleaved);
+	submesh.indices.swap(indices);
+}
@@ -0,0 +1,41 @@
+//
+// GeometryImport.h: Steps the native importers share. Normals and tangent frames for geometry
+// that doesn't bring its own, and the float vertex layout ProcessAssimpMesh produces, so every
+// importer feeds the same optimizer, packer and mesh cache.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+// Indexed attributes of one submesh, texCoords, tangents and bitangents may be NULL
+struct ImportedVertices
+{
+	u32              vertexCount;
+	const glm::vec3* positions;
+	const glm::vec3* normals;
+	const glm::vec2* texCoords;
+	const glm::vec3* tangents;
+	const glm::vec3* bitangents;
+};
+
+/**
+ * Interleaves position, normal, and with texture coordinates also UV, tangent and bitangent,
+ * the same attributes and locations ProcessAssimpMesh lays out. The indices are moved in.
+ */
+void BuildImportedSubmesh(const ImportedVertices& vertices, std::vector<u32>& indices, Submesh& submesh);
+
+// Area weighted average of the faces around each vertex
+void GenerateSmoothNormals(const u32* indices, u32 indexCount, const glm::vec3* positions, u32 vertexCount, glm::vec3* normals);
+
+/**
+ * Tangents and bitangents from the texture coordinates, summed over the triangles around each
+ * vertex and made orthonormal to its normal. The bitangent keeps the handedness of the mapping,
+ * pointing the way the V coordinate grows, as the engine expects it.
+ */
+void GenerateTangentFrames(const u32* indices, u32 indexCount, const glm::vec3* positions, const glm::vec3* normals,
+	const glm::vec2* texCoords, u32 vertexCount, glm::vec3* tangents, glm::vec3* bitangents);
+
+// Gram-Schmidt of a tangent against its normal, any perpendicular vector if they are parallel
+glm::vec3 OrthogonalizeTangent(const glm::vec3& normal, const glm::vec3& tangent);
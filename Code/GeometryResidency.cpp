@@ -0,0 +1,193 @@
+#include "GeometryResidency.h"
+#include "MeshCache.h"
+#include <string.h>
+
+namespace
+{
+	// Points the view at the blobs of a mapped cache, if the cache still matches the mesh
+	bool ReadCachedGeometry(const MeshGeometrySource& source, const MappedFile& file, MeshGeometryView& view)
+	{
+		MeshCacheView cache = {};
+		if (!ReadMeshCache(file, source.sourceTimestamp, source.importFlags, source.vertexFormat, &cache))
+			return false;
+
+		view.vertexData = cache.vertexData;
+		view.vertexDataSize = cache.header->vertexDataSize;
+		view.indexData = cache.indexData;
+		view.indexDataSize = cache.header->indexDataSize;
+		return true;
+	}
+
+	bool MapCachedGeometry(const MeshGeometrySource& source, MappedFile& file, MeshGeometryView& view)
+	{
+		if (source.cachePath.empty())
+			return false;
+
+		file = MapGeneratedFile(source.cachePath.c_str());
+		if (ReadCachedGeometry(source, file, view))
+			return true;
+
+		UnmapFile(file);
+		return false;
+	}
+
+	void KeepGeometry(MeshGeometrySource& source, const void* vertexData, u64 vertexDataSize, const void* indexData, u64 indexDataSize)
+	{
+		source.vertexData.assign((const u8*)vertexData, (const u8*)vertexData + vertexDataSize);
+		source.indexData.assign((const u8*)indexData, (const u8*)indexData + indexDataSize);
+	}
+
+	void DropKeptGeometry(MeshGeometrySource& source)
+	{
+		std::vector<u8>().swap(source.vertexData);
+		std::vector<u8>().swap(source.indexData);
+	}
+}
+
+const char* GetGeometryResidencyName(GeometryResidency residency)
+{
+	switch (residency)
+	{
+	case GeometryResidency_Discard: return "Discard";
+	case GeometryResidency_Keep:    return "Keep";
+	case GeometryResidency_Mapped:  return "Mapped";
+	default:                        break;
+	}
+	return "Unknown";
+}
+
+void InitMeshGeometrySource(Mesh& mesh, GeometryResidency residency, const char* cachePath, u64 sourceTimestamp, u32 importFlags,
+	u32 vertexFormat, const void* vertexData, u64 vertexDataSize, const void* indexData, u64 indexDataSize)
+{
+	MeshGeometrySource& source = mesh.geometrySource;
+	source.cachePath = cachePath;
+	source.sourceTimestamp = sourceTimestamp;
+	source.importFlags = importFlags;
+	source.vertexFormat = vertexFormat;
+	source.residency = residency;
+
+	if (residency == GeometryResidency_Mapped)
+	{
+		// The cache may not have been written, an archive build or a read-only directory
+		MappedFile file = {};
+		MeshGeometryView view = {};
+		if (MapCachedGeometry(source, file, view))
+		{
+			UnmapFile(file);
+			return;
+		}
+
+		ILOG("No usable mesh cache at %s, keeping the geometry in memory instead", cachePath);
+		source.residency = GeometryResidency_Keep;
+	}
+
+	if (source.residency == GeometryResidency_Keep)
+		KeepGeometry(source, vertexData, vertexDataSize, indexData, indexDataSize);
+}
+
+bool SetMeshGeometryResidency(Mesh& mesh, GeometryResidency residency)
+{
+	MeshGeometrySource& source = mesh.geometrySource;
+	if (residency == source.residency)
+		return true;
+
+	if (source.acquireCount > 0)
+	{
+		ELOG("The geometry of %s is being read, its residency can't change now", source.cachePath.c_str());
+		return false;
+	}
+
+	MappedFile file = {};
+	MeshGeometryView view = {};
+	if (residency == GeometryResidency_Keep)
+	{
+		if (!MapCachedGeometry(source, file, view))
+		{
+			ELOG("The mesh cache %s is gone or stale, its geometry can't be kept", source.cachePath.c_str());
+			return false;
+		}
+
+		KeepGeometry(source, view.vertexData, view.vertexDataSize, view.indexData, view.indexDataSize);
+		UnmapFile(file);
+	}
+	else if (residency == GeometryResidency_Mapped)
+	{
+		if (!MapCachedGeometry(source, file, view))
+		{
+			ELOG("The mesh cache %s is gone or stale, its geometry can't be mapped from it", source.cachePath.c_str());
+			return false;
+		}
+
+		UnmapFile(file);
+		DropKeptGeometry(source);
+	}
+	else
+	{
+		DropKeptGeometry(source);
+	}
+
+	source.residency = residency;
+	return true;
+}
+
+bool AcquireMeshGeometry(Mesh& mesh, MeshGeometryView& view)
+{
+	MeshGeometrySource& source = mesh.geometrySource;
+	switch (source.residency)
+	{
+	case GeometryResidency_Keep:
+		view = { source.vertexData.data(), source.vertexData.size(), source.indexData.data(), source.indexData.size() };
+		source.acquireCount++;
+		return true;
+
+	case GeometryResidency_Mapped:
+		if (source.acquireCount > 0)
+			ReadCachedGeometry(source, source.cacheFile, view);
+		else if (!MapCachedGeometry(source, source.cacheFile, view))
+		{
+			ELOG("The mesh cache %s is gone or stale, its geometry can't be read", source.cachePath.c_str());
+			return false;
+		}
+		source.acquireCount++;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+void ReleaseMeshGeometry(Mesh& mesh)
+{
+	MeshGeometrySource& source = mesh.geometrySource;
+	if (source.acquireCount == 0)
+		return;
+
+	// The mapping goes as soon as nobody reads it
+	if (--source.acquireCount == 0 && source.residency == GeometryResidency_Mapped)
+		UnmapFile(source.cacheFile);
+}
+
+void FreeMeshGeometrySource(Mesh& mesh)
+{
+	MeshGeometrySource& source = mesh.geometrySource;
+	UnmapFile(source.cacheFile);
+	DropKeptGeometry(source);
+	source.acquireCount = 0;
+	source.residency = GeometryResidency_Discard;
+}
+
+void AddMeshGeometryFootprint(const Mesh& mesh, GeometryFootprint& footprint)
+{
+	const MeshGeometrySource& source = mesh.geometrySource;
+	footprint.keptBytes += source.vertexData.capacity() + source.indexData.capacity();
+	for (const Submesh& submesh : mesh.submeshes)
+		footprint.keptBytes += submesh.vertices.capacity() * sizeof(float) + submesh.indices.capacity() * sizeof(u32);
+	footprint.mappedBytes += source.cacheFile.data ? source.cacheFile.size : 0;
+
+	footprint.metadataBytes += sizeof(Mesh) + mesh.submeshes.capacity() * sizeof(Submesh) + source.cachePath.capacity();
+	for (const Submesh& submesh : mesh.submeshes)
+	{
+		footprint.metadataBytes += submesh.vertexBufferLayout.attributes.capacity() * sizeof(VertexBufferAttribute);
+		footprint.metadataBytes += submesh.meshlets.capacity() * sizeof(Meshlet);
+	}
+}
@@ -0,0 +1,55 @@
+//
+// GeometryResidency.h: CPU copies of mesh geometry after the upload. Meshes either drop their
+// packed blobs, keep them, or map them back from their mesh cache only while something on the
+// CPU reads them, so the geometry is not resident twice for the sake of rare queries.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+// Packed blobs of a mesh, the offsets, layouts and index sizes are in its submeshes
+struct MeshGeometryView
+{
+	const u8* vertexData;
+	u64       vertexDataSize;
+	const u8* indexData;
+	u64       indexDataSize;
+};
+
+struct GeometryFootprint
+{
+	u64 keptBytes;     // Blobs held by GeometryResidency_Keep meshes
+	u64 mappedBytes;   // Cache files mapped by queries in flight
+	u64 metadataBytes; // Submeshes, LOD tables and the like
+};
+
+const char* GetGeometryResidencyName(GeometryResidency residency);
+
+/**
+ * GL thread, once the mesh is uploaded. Applies the residency with the blobs the upload read
+ * from, which are copied when they're kept. A mesh whose cache can't be read back falls
+ * back to GeometryResidency_Keep when it asks for GeometryResidency_Mapped.
+ */
+void InitMeshGeometrySource(Mesh& mesh, GeometryResidency residency, const char* cachePath, u64 sourceTimestamp, u32 importFlags,
+	u32 vertexFormat, const void* vertexData, u64 vertexDataSize, const void* indexData, u64 indexDataSize);
+
+/**
+ * Switches the residency of a loaded mesh. Keeping the blobs of a mesh that dropped them reads
+ * them from the cache. Returns false, leaving the mesh as it was, if that's not possible.
+ */
+bool SetMeshGeometryResidency(Mesh& mesh, GeometryResidency residency);
+
+/**
+ * Gives access to the packed blobs of a mesh, mapping its cache if needed. Every successful
+ * call is paired with ReleaseMeshGeometry. Returns false for discarded geometry.
+ */
+bool AcquireMeshGeometry(Mesh& mesh, MeshGeometryView& view);
+
+void ReleaseMeshGeometry(Mesh& mesh);
+
+// Drops whatever the mesh holds, when it's unloaded
+void FreeMeshGeometrySource(Mesh& mesh);
+
+void AddMeshGeometryFootprint(const Mesh& mesh, GeometryFootprint& footprint);
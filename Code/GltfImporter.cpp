@@ -0,0 +1,1026 @@
+#include "GltfImporter.h"
+#include "GeometryImport.h"
+#include "AssetArchive.h"
+#include <string.h>
+#include <stdlib.h>
+
+#define GLB_MAGIC      0x46546C67 // "glTF"
+#define GLB_CHUNK_JSON 0x4E4F534A // "JSON"
+#define GLB_CHUNK_BIN  0x004E4942 // "BIN\0"
+
+namespace
+{
+#pragma region JSON
+	struct JsonValue
+	{
+		enum Type : u8
+		{
+			Null,
+			Bool,
+			Number,
+			String,
+			Array,
+			Object
+		};
+
+		Type type = Null;
+		f64 number = 0.0; // Also 0 or 1 for booleans
+		std::string string;
+		std::vector<JsonValue> elements; // Array elements or object members
+		std::vector<std::string> keys;   // Names of the object members
+
+		const JsonValue* Find(const char* key) const
+		{
+			for (u32 i = 0; i < keys.size(); ++i)
+			{
+				if (keys[i] == key)
+					return &elements[i];
+			}
+			return nullptr;
+		}
+
+		u32 Size() const
+		{
+			return type == Array ? (u32)elements.size() : 0;
+		}
+	};
+
+	struct JsonCursor
+	{
+		const char* text;
+		const char* end;
+	};
+
+	void SkipJsonSpaces(JsonCursor& cursor)
+	{
+		while (cursor.text < cursor.end && (*cursor.text == ' ' || *cursor.text == '\t' || *cursor.text == '\n' || *cursor.text == '\r'))
+			cursor.text++;
+	}
+
+	bool MatchJsonLiteral(JsonCursor& cursor, const char* literal)
+	{
+		size_t length = strlen(literal);
+		if ((size_t)(cursor.end - cursor.text) < length || memcmp(cursor.text, literal, length) != 0)
+			return false;
+		cursor.text += length;
+		return true;
+	}
+
+	void AppendUtf8(std::string& string, u32 codepoint)
+	{
+		if (codepoint < 0x80)
+		{
+			string += (char)codepoint;
+		}
+		else if (codepoint < 0x800)
+		{
+			string += (char)(0xC0 | (codepoint >> 6));
+			string += (char)(0x80 | (codepoint & 0x3F));
+		}
+		else
+		{
+			string += (char)(0xE0 | (codepoint >> 12));
+			string += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+			string += (char)(0x80 | (codepoint & 0x3F));
+		}
+	}
+
+	bool ParseJsonString(JsonCursor& cursor, std::string& string)
+	{
+		if (cursor.text == cursor.end || *cursor.text != '"')
+			return false;
+		cursor.text++;
+
+		while (cursor.text < cursor.end && *cursor.text != '"')
+		{
+			char c = *cursor.text++;
+			if (c != '\\')
+			{
+				string += c;
+				continue;
+			}
+
+			if (cursor.text == cursor.end)
+				return false;
+
+			char escape = *cursor.text++;
+			switch (escape)
+			{
+			case 'b': string += '\b'; break;
+			case 'f': string += '\f'; break;
+			case 'n': string += '\n'; break;
+			case 'r': string += '\r'; break;
+			case 't': string += '\t'; break;
+			case 'u':
+			{
+				if (cursor.end - cursor.text < 4)
+					return false;
+				char hex[5] = { cursor.text[0], cursor.text[1], cursor.text[2], cursor.text[3], '\0' };
+				AppendUtf8(string, (u32)strtoul(hex, nullptr, 16));
+				cursor.text += 4;
+				break;
+			}
+			default: string += escape; break; // Quote, backslash and slash
+			}
+		}
+
+		if (cursor.text == cursor.end)
+			return false;
+		cursor.text++;
+		return true;
+	}
+
+	bool ParseJsonValue(JsonCursor& cursor, JsonValue& value, u32 depth)
+	{
+		SkipJsonSpaces(cursor);
+		if (cursor.text == cursor.end || depth > 256)
+			return false;
+
+		const char c = *cursor.text;
+		if (c == '{' || c == '[')
+		{
+			const bool isObject = c == '{';
+			const char close = isObject ? '}' : ']';
+			value.type = isObject ? JsonValue::Object : JsonValue::Array;
+			cursor.text++;
+
+			SkipJsonSpaces(cursor);
+			if (cursor.text < cursor.end && *cursor.text == close)
+			{
+				cursor.text++;
+				return true;
+			}
+
+			while (true)
+			{
+				if (isObject)
+				{
+					SkipJsonSpaces(cursor);
+					value.keys.emplace_back();
+					if (!ParseJsonString(cursor, value.keys.back()))
+						return false;
+
+					SkipJsonSpaces(cursor);
+					if (cursor.text == cursor.end || *cursor.text++ != ':')
+						return false;
+				}
+
+				value.elements.emplace_back();
+				if (!ParseJsonValue(cursor, value.elements.back(), depth + 1))
+					return false;
+
+				SkipJsonSpaces(cursor);
+				if (cursor.text == cursor.end)
+					return false;
+
+				char separator = *cursor.text++;
+				if (separator == close)
+					return true;
+				if (separator != ',')
+					return false;
+			}
+		}
+
+		if (c == '"')
+		{
+			value.type = JsonValue::String;
+			return ParseJsonString(cursor, value.string);
+		}
+
+		if (MatchJsonLiteral(cursor, "true") || MatchJsonLiteral(cursor, "false"))
+		{
+			value.type = JsonValue::Bool;
+			value.number = cursor.text[-1] == 'e' && cursor.text[-2] == 'u' ? 1.0 : 0.0;
+			return true;
+		}
+
+		if (MatchJsonLiteral(cursor, "null"))
+		{
+			value.type = JsonValue::Null;
+			return true;
+		}
+
+		// Numbers aren't NUL terminated inside the mapping, strtod gets a copy
+		char buffer[64];
+		size_t length = 0;
+		while (cursor.text + length < cursor.end && length < sizeof(buffer) - 1 && strchr("+-0123456789.eE", cursor.text[length]))
+			length++;
+		if (length == 0)
+			return false;
+
+		memcpy(buffer, cursor.text, length);
+		buffer[length] = '\0';
+		value.type = JsonValue::Number;
+		value.number = strtod(buffer, nullptr);
+		cursor.text += length;
+		return true;
+	}
+
+	const JsonValue& GetMember(const JsonValue& object, const char* key)
+	{
+		static const JsonValue missing;
+		const JsonValue* member = object.Find(key);
+		return member ? *member : missing;
+	}
+
+	f64 GetNumber(const JsonValue& object, const char* key, f64 fallback)
+	{
+		const JsonValue* member = object.Find(key);
+		return member && (member->type == JsonValue::Number || member->type == JsonValue::Bool) ? member->number : fallback;
+	}
+
+	// Index into a top level array of the document, UINT32_MAX when missing
+	u32 GetIndex(const JsonValue& object, const char* key)
+	{
+		return (u32)GetNumber(object, key, (f64)UINT32_MAX);
+	}
+
+	std::string GetString(const JsonValue& object, const char* key)
+	{
+		const JsonValue* member = object.Find(key);
+		return member && member->type == JsonValue::String ? member->string : std::string();
+	}
+
+	template <u32 Count>
+	void GetNumbers(const JsonValue& object, const char* key, f32* values)
+	{
+		const JsonValue& array = GetMember(object, key);
+		for (u32 i = 0; i < Count && i < array.Size(); ++i)
+			values[i] = (f32)array.elements[i].number;
+	}
+#pragma endregion
+
+	struct GltfBuffer
+	{
+		const u8* data;
+		u64 size;
+	};
+
+	struct GltfFile
+	{
+		std::string directory; // With its trailing separator
+		JsonValue json;
+		MappedFile file;
+		std::vector<MappedFile> externalFiles;
+		std::vector<std::vector<u8>> decodedBuffers; // From data URIs
+		std::vector<GltfBuffer> buffers;
+	};
+
+	// Vertices of a primitive as the file stores them, before any node transform
+	struct GltfPrimitive
+	{
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec2> texCoords;
+		std::vector<glm::vec4> tangents; // w is the handedness
+		std::vector<u32> indices;
+		u32 material;
+	};
+
+	void CloseGltf(GltfFile& gltf)
+	{
+		for (MappedFile& file : gltf.externalFiles)
+			UnmapFile(file);
+		if (gltf.file.data)
+			UnmapFile(gltf.file);
+	}
+
+	std::string DecodeUri(const std::string& uri)
+	{
+		std::string result;
+		for (size_t i = 0; i < uri.size(); ++i)
+		{
+			if (uri[i] == '%' && i + 2 < uri.size())
+			{
+				char hex[3] = { uri[i + 1], uri[i + 2], '\0' };
+				result += (char)strtoul(hex, nullptr, 16);
+				i += 2;
+			}
+			else
+			{
+				result += uri[i];
+			}
+		}
+		return result;
+	}
+
+	bool DecodeBase64(const char* text, const char* end, std::vector<u8>& bytes)
+	{
+		auto value = [](char c) -> i32
+		{
+			if (c >= 'A' && c <= 'Z') return c - 'A';
+			if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+			if (c >= '0' && c <= '9') return c - '0' + 52;
+			if (c == '+') return 62;
+			if (c == '/') return 63;
+			return -1;
+		};
+
+		u32 accumulator = 0, bits = 0;
+		for (; text < end && *text != '='; ++text)
+		{
+			i32 digit = value(*text);
+			if (digit < 0)
+				return false;
+
+			accumulator = (accumulator << 6) | (u32)digit;
+			bits += 6;
+			if (bits >= 8)
+			{
+				bits -= 8;
+				bytes.push_back((u8)(accumulator >> bits));
+			}
+		}
+		return true;
+	}
+
+	// Data URIs are decoded, anything else is a file next to the model
+	bool LoadGltfUri(GltfFile& gltf, const std::string& uri, GltfBuffer& buffer)
+	{
+		if (uri.compare(0, 5, "data:") == 0)
+		{
+			size_t comma = uri.find(";base64,");
+			if (comma == std::string::npos)
+				return false;
+
+			gltf.decodedBuffers.emplace_back();
+			std::vector<u8>& bytes = gltf.decodedBuffers.back();
+			if (!DecodeBase64(uri.c_str() + comma + 8, uri.c_str() + uri.size(), bytes))
+				return false;
+
+			buffer = GltfBuffer{ bytes.data(), bytes.size() };
+			return true;
+		}
+
+		MappedFile file = MapFile((gltf.directory + DecodeUri(uri)).c_str());
+		if (!file.data)
+			return false;
+
+		gltf.externalFiles.push_back(file);
+		buffer = GltfBuffer{ (const u8*)file.data, file.size };
+		return true;
+	}
+
+	bool OpenGltf(const char* filename, GltfFile& gltf)
+	{
+		gltf.directory = filename;
+		size_t separator = gltf.directory.find_last_of("/\\");
+		gltf.directory = separator == std::string::npos ? std::string() : gltf.directory.substr(0, separator + 1);
+
+		gltf.file = MapFile(filename);
+		if (!gltf.file.data)
+		{
+			ELOG("Error loading mesh %s: the file cannot be mapped", filename);
+			return false;
+		}
+
+		const u8* data = (const u8*)gltf.file.data;
+		const u8* jsonBegin = data;
+		const u8* jsonEnd = data + gltf.file.size;
+		GltfBuffer binChunk = {};
+
+		u32 magic = 0;
+		if (gltf.file.size >= 12)
+			memcpy(&magic, data, sizeof(magic));
+
+		if (magic == GLB_MAGIC)
+		{
+			// Header, then 8 byte aligned chunks: JSON first, the optional binary buffer after it
+			u32 header[3];
+			memcpy(header, data, sizeof(header));
+			if (header[1] != 2 || header[2] > gltf.file.size)
+			{
+				ELOG("Error loading mesh %s: unsupported GLB version %u", filename, header[1]);
+				return false;
+			}
+
+			jsonBegin = jsonEnd = nullptr;
+			for (u64 offset = 12; offset + 8 <= header[2];)
+			{
+				u32 chunk[2];
+				memcpy(chunk, data + offset, sizeof(chunk));
+				const u8* chunkData = data + offset + 8;
+				if (offset + 8 + chunk[0] > header[2])
+					break;
+
+				if (chunk[1] == GLB_CHUNK_JSON && !jsonBegin)
+				{
+					jsonBegin = chunkData;
+					jsonEnd = chunkData + chunk[0];
+				}
+				else if (chunk[1] == GLB_CHUNK_BIN && !binChunk.data)
+				{
+					binChunk = GltfBuffer{ chunkData, chunk[0] };
+				}
+				offset += 8 + ((chunk[0] + 3) & ~3u);
+			}
+
+			if (!jsonBegin)
+			{
+				ELOG("Error loading mesh %s: the GLB file has no JSON chunk", filename);
+				return false;
+			}
+		}
+
+		JsonCursor cursor = { (const char*)jsonBegin, (const char*)jsonEnd };
+		if (!ParseJsonValue(cursor, gltf.json, 0) || gltf.json.type != JsonValue::Object)
+		{
+			ELOG("Error loading mesh %s: malformed JSON near byte %u", filename, (u32)(cursor.text - (const char*)jsonBegin));
+			return false;
+		}
+
+		const JsonValue& asset = GetMember(gltf.json, "asset");
+		if (GetString(asset, "version").compare(0, 1, "2") != 0)
+		{
+			ELOG("Error loading mesh %s: only glTF 2.0 is supported", filename);
+			return false;
+		}
+
+		// A buffer without URI is the binary chunk of the GLB
+		const JsonValue& buffers = GetMember(gltf.json, "buffers");
+		gltf.buffers.resize(buffers.Size());
+		for (u32 i = 0; i < buffers.Size(); ++i)
+		{
+			std::string uri = GetString(buffers.elements[i], "uri");
+			bool loaded = uri.empty() ? binChunk.data != nullptr : LoadGltfUri(gltf, uri, gltf.buffers[i]);
+			if (uri.empty())
+				gltf.buffers[i] = binChunk;
+
+			if (!loaded || gltf.buffers[i].size < (u64)GetNumber(buffers.elements[i], "byteLength", 0.0))
+			{
+				ELOG("Error loading mesh %s: buffer %u is missing or too short", filename, i);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	u32 GetComponentSize(u32 componentType)
+	{
+		switch (componentType)
+		{
+		case 5120: case 5121: return 1; // BYTE, UNSIGNED_BYTE
+		case 5122: case 5123: return 2; // SHORT, UNSIGNED_SHORT
+		case 5125: case 5126: return 4; // UNSIGNED_INT, FLOAT
+		default: return 0;
+		}
+	}
+
+	u32 GetTypeComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR") return 1;
+		if (type == "VEC2") return 2;
+		if (type == "VEC3") return 3;
+		if (type == "VEC4") return 4;
+		return 0;
+	}
+
+	f32 ReadComponent(const u8* data, u32 componentType, bool normalized)
+	{
+		switch (componentType)
+		{
+		case 5120: { i8 v; memcpy(&v, data, 1); return normalized ? glm::max(v / 127.0f, -1.0f) : (f32)v; }
+		case 5121: { u8 v = *data; return normalized ? v / 255.0f : (f32)v; }
+		case 5122: { i16 v; memcpy(&v, data, 2); return normalized ? glm::max(v / 32767.0f, -1.0f) : (f32)v; }
+		case 5123: { u16 v; memcpy(&v, data, 2); return normalized ? v / 65535.0f : (f32)v; }
+		case 5125: { u32 v; memcpy(&v, data, 4); return (f32)v; }
+		default:   { f32 v; memcpy(&v, data, 4); return v; }
+		}
+	}
+
+	// Where the elements of an accessor are in their buffer. Accessors without a view are all zeros.
+	struct GltfAccessorView
+	{
+		const u8* data;
+		u32 count;
+		u32 componentType;
+		u32 componentCount;
+		u32 stride;
+		bool normalized;
+	};
+
+	bool GetAccessorView(const GltfFile& gltf, u32 accessorIdx, GltfAccessorView& view)
+	{
+		const JsonValue& accessors = GetMember(gltf.json, "accessors");
+		if (accessorIdx >= accessors.Size())
+			return false;
+
+		const JsonValue& accessor = accessors.elements[accessorIdx];
+		view = {};
+		view.count = (u32)GetNumber(accessor, "count", 0.0);
+		view.componentType = (u32)GetNumber(accessor, "componentType", 0.0);
+		view.componentCount = GetTypeComponentCount(GetString(accessor, "type"));
+		view.normalized = GetNumber(accessor, "normalized", 0.0) != 0.0;
+
+		const u32 componentSize = GetComponentSize(view.componentType);
+		if (componentSize == 0 || view.componentCount == 0)
+			return false;
+		// The base values alone are the wrong geometry, Assimp applies the sparse ones
+		if (accessor.Find("sparse"))
+		{
+			ELOG("Sparse accessor %u is not supported by the native importer", accessorIdx);
+			return false;
+		}
+
+		const u32 bufferViewIdx = GetIndex(accessor, "bufferView");
+		if (bufferViewIdx == UINT32_MAX)
+			return true;
+
+		const JsonValue& bufferViews = GetMember(gltf.json, "bufferViews");
+		if (bufferViewIdx >= bufferViews.Size())
+			return false;
+
+		const JsonValue& bufferView = bufferViews.elements[bufferViewIdx];
+		const u32 bufferIdx = GetIndex(bufferView, "buffer");
+		if (bufferIdx >= gltf.buffers.size())
+			return false;
+
+		const u32 elementSize = componentSize * view.componentCount;
+		const u64 offset = (u64)GetNumber(bufferView, "byteOffset", 0.0) + (u64)GetNumber(accessor, "byteOffset", 0.0);
+		view.stride = (u32)GetNumber(bufferView, "byteStride", (f64)elementSize);
+		if (view.stride < elementSize)
+			return false;
+
+		const GltfBuffer& buffer = gltf.buffers[bufferIdx];
+		if (view.count > 0 && offset + (u64)view.stride * (view.count - 1) + elementSize > buffer.size)
+			return false;
+
+		view.data = buffer.data + offset;
+		return true;
+	}
+
+	/**
+	 * Reads Count floats per element, converting and denormalizing other component types. Tightly
+	 * packed float views are copied in one go straight out of the mapping.
+	 */
+	template <u32 Count, typename T>
+	bool ReadAccessor(const GltfFile& gltf, u32 accessorIdx, std::vector<T>& values)
+	{
+		static_assert(sizeof(T) == Count * sizeof(f32), "Elements must be Count packed floats");
+
+		GltfAccessorView view;
+		if (!GetAccessorView(gltf, accessorIdx, view) || view.componentCount < Count)
+			return false;
+
+		values.assign(view.count, T(0.0f));
+		if (!view.data || view.count == 0)
+			return true;
+
+		f32* output = (f32*)values.data();
+		if (view.componentType == 5126 && view.componentCount == Count && view.stride == Count * sizeof(f32))
+		{
+			memcpy(output, view.data, (size_t)view.count * Count * sizeof(f32));
+			return true;
+		}
+
+		const u32 componentSize = GetComponentSize(view.componentType);
+		for (u32 i = 0; i < view.count; ++i)
+		{
+			const u8* element = view.data + (size_t)i * view.stride;
+			for (u32 c = 0; c < Count; ++c)
+				output[i * Count + c] = ReadComponent(element + c * componentSize, view.componentType, view.normalized);
+		}
+		return true;
+	}
+
+	bool ReadIndices(const GltfFile& gltf, u32 accessorIdx, std::vector<u32>& indices)
+	{
+		GltfAccessorView view;
+		if (!GetAccessorView(gltf, accessorIdx, view) || view.componentCount != 1 || !view.data)
+			return false;
+
+		indices.resize(view.count);
+		const u32 componentSize = GetComponentSize(view.componentType);
+		if (view.componentType == 5125 && view.stride == 4)
+		{
+			memcpy(indices.data(), view.data, (size_t)view.count * 4);
+			return true;
+		}
+
+		for (u32 i = 0; i < view.count; ++i)
+		{
+			const u8* element = view.data + (size_t)i * view.stride;
+			if (componentSize == 1)
+				indices[i] = *element;
+			else if (componentSize == 2)
+				indices[i] = (u32)element[0] | ((u32)element[1] << 8);
+			else
+				memcpy(&indices[i], element, 4);
+		}
+		return true;
+	}
+
+	bool ReadGltfPrimitive(const GltfFile& gltf, const JsonValue& primitive, GltfPrimitive& result)
+	{
+		const JsonValue& attributes = GetMember(primitive, "attributes");
+		if (!ReadAccessor<3>(gltf, GetIndex(attributes, "POSITION"), result.positions))
+			return false;
+
+		const u32 vertexCount = (u32)result.positions.size();
+		if (attributes.Find("NORMAL") && !ReadAccessor<3>(gltf, GetIndex(attributes, "NORMAL"), result.normals))
+			return false;
+		if (attributes.Find("TEXCOORD_0") && !ReadAccessor<2>(gltf, GetIndex(attributes, "TEXCOORD_0"), result.texCoords))
+			return false;
+		if (attributes.Find("TANGENT") && !ReadAccessor<4>(gltf, GetIndex(attributes, "TANGENT"), result.tangents))
+			return false;
+
+		// Attributes of a primitive must all have one element per vertex
+		if ((!result.normals.empty() && result.normals.size() != vertexCount) ||
+			(!result.texCoords.empty() && result.texCoords.size() != vertexCount) ||
+			(!result.tangents.empty() && result.tangents.size() != vertexCount))
+			return false;
+
+		if (primitive.Find("indices"))
+		{
+			if (!ReadIndices(gltf, GetIndex(primitive, "indices"), result.indices))
+				return false;
+			for (u32 index : result.indices)
+			{
+				if (index >= vertexCount)
+					return false;
+			}
+		}
+		else
+		{
+			result.indices.resize(vertexCount);
+			for (u32 i = 0; i < vertexCount; ++i)
+				result.indices[i] = i;
+		}
+		result.indices.resize(result.indices.size() / 3 * 3);
+
+		// glTF puts the origin of the texture space at the top left, images are loaded flipped
+		for (glm::vec2& texCoord : result.texCoords)
+			texCoord.y = 1.0f - texCoord.y;
+
+		result.material = GetIndex(primitive, "material");
+		return true;
+	}
+
+	// Lays out a primitive, moved by transform when the node tree is flattened
+	void BuildGltfSubmesh(const GltfPrimitive& primitive, const glm::mat4& transform, Submesh& submesh)
+	{
+		const u32 vertexCount = (u32)primitive.positions.size();
+		const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(transform)));
+
+		std::vector<glm::vec3> positions(vertexCount);
+		for (u32 v = 0; v < vertexCount; ++v)
+			positions[v] = glm::vec3(transform * glm::vec4(primitive.positions[v], 1.0f));
+
+		// Mirroring transforms turn the triangles inside out
+		std::vector<u32> indices = primitive.indices;
+		if (glm::determinant(glm::mat3(transform)) < 0.0f)
+		{
+			for (u32 i = 0; i + 2 < indices.size(); i += 3)
+				std::swap(indices[i + 1], indices[i + 2]);
+		}
+
+		std::vector<glm::vec3> normals(vertexCount);
+		if (primitive.normals.empty())
+		{
+			GenerateSmoothNormals(indices.data(), (u32)indices.size(), positions.data(), vertexCount, normals.data());
+		}
+		else
+		{
+			for (u32 v = 0; v < vertexCount; ++v)
+			{
+				glm::vec3 normal = normalMatrix * primitive.normals[v];
+				f32 length = glm::length(normal);
+				normals[v] = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			}
+		}
+
+		ImportedVertices vertices = {};
+		vertices.vertexCount = vertexCount;
+		vertices.positions = positions.data();
+		vertices.normals = normals.data();
+
+		std::vector<glm::vec3> tangents, bitangents;
+		if (!primitive.texCoords.empty())
+		{
+			tangents.resize(vertexCount);
+			bitangents.resize(vertexCount);
+			if (primitive.tangents.empty())
+			{
+				GenerateTangentFrames(indices.data(), (u32)indices.size(), positions.data(), normals.data(),
+					primitive.texCoords.data(), vertexCount, tangents.data(), bitangents.data());
+			}
+			else
+			{
+				// The file's bitangent is cross(normal, tangent) * w
+				for (u32 v = 0; v < vertexCount; ++v)
+				{
+					const glm::vec4& tangent = primitive.tangents[v];
+					tangents[v] = OrthogonalizeTangent(normals[v], glm::mat3(transform) * glm::vec3(tangent));
+					bitangents[v] = glm::cross(normals[v], tangents[v]) * (tangent.w < 0.0f ? -1.0f : 1.0f);
+				}
+			}
+
+			vertices.texCoords = primitive.texCoords.data();
+			vertices.tangents = tangents.data();
+			vertices.bitangents = bitangents.data();
+		}
+
+		BuildImportedSubmesh(vertices, indices, submesh);
+	}
+
+	glm::mat4 GetGltfNodeTransform(const JsonValue& node)
+	{
+		if (node.Find("matrix"))
+		{
+			f32 matrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+			GetNumbers<16>(node, "matrix", matrix);
+			return glm::make_mat4(matrix); // Column major, as glm
+		}
+
+		f32 translation[3] = { 0, 0, 0 };
+		f32 rotation[4] = { 0, 0, 0, 1 };
+		f32 scale[3] = { 1, 1, 1 };
+		GetNumbers<3>(node, "translation", translation);
+		GetNumbers<4>(node, "rotation", rotation);
+		GetNumbers<3>(node, "scale", scale);
+
+		glm::quat orientation(rotation[3], rotation[0], rotation[1], rotation[2]);
+		return glm::translate(glm::make_vec3(translation)) * glm::mat4_cast(orientation) * glm::scale(glm::make_vec3(scale));
+	}
+
+	// Parents are added before their children, as ComputeNodeModelTransforms expects
+	void AddGltfNode(const JsonValue& gltfNodes, u32 gltfNodeIdx, u32 parent, u32 depth, std::vector<ModelNode>& nodes, std::vector<u32>& nodeMeshes)
+	{
+		if (gltfNodeIdx >= gltfNodes.Size() || depth > GLTF_MAX_NODE_DEPTH)
+			return;
+
+		const JsonValue& gltfNode = gltfNodes.elements[gltfNodeIdx];
+		ModelNode node = {};
+		node.name = GetString(gltfNode, "name");
+		node.parent = parent;
+		node.transform = GetGltfNodeTransform(gltfNode);
+
+		const u32 nodeIdx = (u32)nodes.size();
+		nodes.push_back(node);
+		nodeMeshes.push_back(GetIndex(gltfNode, "mesh"));
+
+		const JsonValue& children = GetMember(gltfNode, "children");
+		for (u32 i = 0; i < children.Size(); ++i)
+			AddGltfNode(gltfNodes, (u32)children.elements[i].number, nodeIdx, depth + 1, nodes, nodeMeshes);
+	}
+
+	/**
+	 * Filename of an image next to the model. Images stored in a buffer view or a data URI are
+	 * written beside the model once, and again only when the model is newer than them.
+	 */
+	std::string GetGltfImageFilename(GltfFile& gltf, const char* filename, u32 imageIdx)
+	{
+		const JsonValue& images = GetMember(gltf.json, "images");
+		if (imageIdx >= images.Size())
+			return std::string();
+
+		const JsonValue& image = images.elements[imageIdx];
+		std::string uri = GetString(image, "uri");
+		if (!uri.empty() && uri.compare(0, 5, "data:") != 0)
+			return DecodeUri(uri);
+
+		GltfBuffer bytes = {};
+		if (!uri.empty())
+		{
+			if (!LoadGltfUri(gltf, uri, bytes))
+				return std::string();
+		}
+		else
+		{
+			const JsonValue& bufferViews = GetMember(gltf.json, "bufferViews");
+			const u32 bufferViewIdx = GetIndex(image, "bufferView");
+			if (bufferViewIdx >= bufferViews.Size())
+				return std::string();
+
+			const JsonValue& bufferView = bufferViews.elements[bufferViewIdx];
+			const u32 bufferIdx = GetIndex(bufferView, "buffer");
+			const u64 offset = (u64)GetNumber(bufferView, "byteOffset", 0.0);
+			const u64 length = (u64)GetNumber(bufferView, "byteLength", 0.0);
+			if (bufferIdx >= gltf.buffers.size() || offset + length > gltf.buffers[bufferIdx].size)
+				return std::string();
+
+			bytes = GltfBuffer{ gltf.buffers[bufferIdx].data + offset, length };
+		}
+
+		std::string modelName = filename;
+		size_t separator = modelName.find_last_of("/\\");
+		if (separator != std::string::npos)
+			modelName = modelName.substr(separator + 1);
+
+		const bool isJpeg = GetString(image, "mimeType") == "image/jpeg" || uri.compare(0, 15, "data:image/jpeg") == 0;
+		std::string imageFilename = modelName + ".image" + std::to_string(imageIdx) + (isJpeg ? ".jpg" : ".png");
+		std::string imagePath = gltf.directory + imageFilename;
+
+		const u64 modelTimestamp = GetFileLastWriteTimestamp(filename);
+		if (GetFileLastWriteTimestamp(imagePath.c_str()) >= modelTimestamp)
+			return imageFilename;
+
+		FILE* file = fopen(imagePath.c_str(), "wb");
+		if (!file)
+		{
+			// The directory of an archived model may not exist on disk, the image decodes from memory then.
+			// The mesh cache can't be written there either, so the model is imported again next launch.
+			if (FindAssetArchiveEntry(filename))
+			{
+				AddAssetArchiveOverlayFile(imagePath.c_str(), bytes.data, bytes.size, modelTimestamp);
+				return imageFilename;
+			}
+
+			ELOG("Cannot write the embedded image %s", imagePath.c_str());
+			return std::string();
+		}
+		fwrite(bytes.data, 1, (size_t)bytes.size, file);
+		fclose(file);
+
+		return imageFilename;
+	}
+
+	std::string GetGltfTextureFilename(GltfFile& gltf, const char* filename, const JsonValue& textureInfo)
+	{
+		const JsonValue& textures = GetMember(gltf.json, "textures");
+		const u32 textureIdx = GetIndex(textureInfo, "index");
+		if (textureIdx >= textures.Size())
+			return std::string();
+
+		if (GetNumber(textureInfo, "texCoord", 0.0) != 0.0)
+			ELOG("%s: textures on a second UV set are sampled with the first one", filename);
+
+		return GetGltfImageFilename(gltf, filename, GetIndex(textures.elements[textureIdx], "source"));
+	}
+
+	MaterialDesc ReadGltfMaterial(GltfFile& gltf, const char* filename, const JsonValue& material)
+	{
+		const JsonValue& pbr = GetMember(material, "pbrMetallicRoughness");
+
+		MaterialDesc desc = {};
+		desc.name = GetString(material, "name");
+		f32 baseColor[4] = { 1, 1, 1, 1 };
+		GetNumbers<4>(pbr, "baseColorFactor", baseColor);
+		desc.albedo = glm::make_vec3(baseColor);
+		GetNumbers<3>(material, "emissiveFactor", &desc.emissive.x);
+		desc.smoothness = 1.0f - (f32)GetNumber(pbr, "roughnessFactor", 1.0);
+
+		desc.albedoTexture = GetGltfTextureFilename(gltf, filename, GetMember(pbr, "baseColorTexture"));
+		desc.emissiveTexture = GetGltfTextureFilename(gltf, filename, GetMember(material, "emissiveTexture"));
+		desc.normalsTexture = GetGltfTextureFilename(gltf, filename, GetMember(material, "normalTexture"));
+		desc.occlusionTexture = GetGltfTextureFilename(gltf, filename, GetMember(material, "occlusionTexture"));
+
+		// One texture holds roughness in green and metallic in blue
+		desc.roughnessTexture = GetGltfTextureFilename(gltf, filename, GetMember(pbr, "metallicRoughnessTexture"));
+		desc.metallicTexture = desc.roughnessTexture;
+		desc.roughnessChannel = 1;
+		desc.metallicChannel = 2;
+		return desc;
+	}
+}
+
+bool IsGltfFile(const char* filename)
+{
+	const char* extension = strrchr(filename, '.');
+	if (!extension)
+		return false;
+
+	std::string lower = extension;
+	for (char& c : lower)
+		c = (char)tolower(c);
+	return lower == ".glb" || lower == ".gltf";
+}
+
+bool ImportGltf(const char* filename, bool preserveHierarchy, Mesh& mesh, std::vector<u32>& submeshMaterials,
+	std::vector<MaterialDesc>& materials, std::vector<ModelNode>& nodes, std::vector<SubmeshInstance>& instances)
+{
+	GltfFile gltf = {};
+	if (!OpenGltf(filename, gltf))
+	{
+		CloseGltf(gltf);
+		return false;
+	}
+
+	const JsonValue& gltfMaterials = GetMember(gltf.json, "materials");
+	materials.clear();
+	for (u32 i = 0; i < gltfMaterials.Size(); ++i)
+		materials.push_back(ReadGltfMaterial(gltf, filename, gltfMaterials.elements[i]));
+
+	// Primitives without a material get the default one of the spec, plain white
+	const u32 defaultMaterial = (u32)materials.size();
+	materials.push_back(MaterialDesc{});
+	materials.back().name = "DefaultMaterial";
+	materials.back().albedo = glm::vec3(1.0f);
+
+	// Every primitive is read once, however many nodes place its mesh
+	const JsonValue& gltfMeshes = GetMember(gltf.json, "meshes");
+	std::vector<std::vector<GltfPrimitive>> meshPrimitives(gltfMeshes.Size());
+	for (u32 m = 0; m < gltfMeshes.Size(); ++m)
+	{
+		const JsonValue& primitives = GetMember(gltfMeshes.elements[m], "primitives");
+		for (u32 p = 0; p < primitives.Size(); ++p)
+		{
+			const JsonValue& primitive = primitives.elements[p];
+			if (GetNumber(primitive, "mode", 4.0) != 4.0)
+			{
+				ILOG("%s: mesh %u primitive %u isn't made of triangles, skipped", filename, m, p);
+				continue;
+			}
+
+			GltfPrimitive result = {};
+			if (!ReadGltfPrimitive(gltf, primitive, result))
+			{
+				ELOG("Error loading mesh %s: mesh %u primitive %u has invalid accessors", filename, m, p);
+				CloseGltf(gltf);
+				return false;
+			}
+			if (result.material >= defaultMaterial)
+				result.material = defaultMaterial;
+			meshPrimitives[m].push_back(std::move(result));
+		}
+	}
+
+	// Nodes of the default scene, or every root when the file has no scenes
+	const JsonValue& gltfNodes = GetMember(gltf.json, "nodes");
+	const JsonValue& scenes = GetMember(gltf.json, "scenes");
+	std::vector<u32> roots;
+	if (scenes.Size() > 0)
+	{
+		u32 sceneIdx = glm::min((u32)GetNumber(gltf.json, "scene", 0.0), scenes.Size() - 1);
+		const JsonValue& sceneNodes = GetMember(scenes.elements[sceneIdx], "nodes");
+		for (u32 i = 0; i < sceneNodes.Size(); ++i)
+			roots.push_back((u32)sceneNodes.elements[i].number);
+	}
+	else
+	{
+		std::vector<bool> isChild(gltfNodes.Size(), false);
+		for (u32 i = 0; i < gltfNodes.Size(); ++i)
+		{
+			const JsonValue& children = GetMember(gltfNodes.elements[i], "children");
+			for (u32 c = 0; c < children.Size(); ++c)
+			{
+				if ((u32)children.elements[c].number < isChild.size())
+					isChild[(u32)children.elements[c].number] = true;
+			}
+		}
+		for (u32 i = 0; i < gltfNodes.Size(); ++i)
+		{
+			if (!isChild[i])
+				roots.push_back(i);
+		}
+	}
+
+	std::vector<ModelNode> sceneNodes;
+	std::vector<u32> nodeMeshes;
+	for (u32 root : roots)
+		AddGltfNode(gltfNodes, root, UINT32_MAX, 0, sceneNodes, nodeMeshes);
+
+	const u32 firstSubmesh = (u32)mesh.submeshes.size();
+	if (preserveHierarchy)
+	{
+		std::vector<u32> meshFirstSubmesh(meshPrimitives.size());
+		for (u32 m = 0; m < meshPrimitives.size(); ++m)
+		{
+			meshFirstSubmesh[m] = (u32)mesh.submeshes.size() - firstSubmesh;
+			for (const GltfPrimitive& primitive : meshPrimitives[m])
+			{
+				mesh.submeshes.emplace_back();
+				BuildGltfSubmesh(primitive, glm::mat4(1.0f), mesh.submeshes.back());
+				submeshMaterials.push_back(primitive.material);
+			}
+		}
+
+		for (u32 n = 0; n < sceneNodes.size(); ++n)
+		{
+			if (nodeMeshes[n] >= meshPrimitives.size())
+				continue;
+			for (u32 p = 0; p < meshPrimitives[nodeMeshes[n]].size(); ++p)
+				instances.push_back(SubmeshInstance{ meshFirstSubmesh[nodeMeshes[n]] + p, n });
+		}
+		nodes.swap(sceneNodes);
+	}
+	else
+	{
+		std::vector<glm::mat4> transforms(sceneNodes.size());
+		for (u32 n = 0; n < sceneNodes.size(); ++n)
+		{
+			const ModelNode& node = sceneNodes[n];
+			transforms[n] = node.parent == UINT32_MAX ? node.transform : transforms[node.parent] * node.transform;
+			if (nodeMeshes[n] >= meshPrimitives.size())
+				continue;
+
+			for (const GltfPrimitive& primitive : meshPrimitives[nodeMeshes[n]])
+			{
+				mesh.submeshes.emplace_back();
+				BuildGltfSubmesh(primitive, transforms[n], mesh.submeshes.back());
+				submeshMaterials.push_back(primitive.material);
+			}
+		}
+	}
+
+	CloseGltf(gltf);
+
+	if (mesh.submeshes.size() == firstSubmesh)
+	{
+		ELOG("Error loading mesh %s: the scene has no triangles", filename);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,24 @@
+//
+// GltfImporter.h: glTF 2.0 models, binary .glb files and .gltf files with external or embedded
+// buffers. The file is mapped and accessors are read in place from its binary chunk, tightly
+// packed float and 32 bit index views are copied as a block. Every primitive becomes a submesh
+// with the layout ProcessAssimpMesh produces, materials come from the metallic-roughness PBR slots.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+#define GLTF_MAX_NODE_DEPTH 64 // Deeper trees are assumed to be cycles
+
+/**
+ * Imports the default scene of a glTF file. With preserveHierarchy the primitives of every mesh
+ * are imported once and nodes place them as instances, otherwise every placement is baked into
+ * its own submesh like aiProcess_PreTransformVertices does. Images embedded in the file are
+ * written next to it, so materials refer to textures by filename as with other formats.
+ */
+bool ImportGltf(const char* filename, bool preserveHierarchy, Mesh& mesh, std::vector<u32>& submeshMaterials,
+	std::vector<MaterialDesc>& materials, std::vector<ModelNode>& nodes, std::vector<SubmeshInstance>& instances);
+
+bool IsGltfFile(const char* filename);
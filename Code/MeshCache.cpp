@@ -0,0 +1,369 @@
+#include "MeshCache.h"
+#include <float.h>
+
+namespace
+{
+	u64 AlignOffset(u64 value, u64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	void CopyCacheString(char* dst, u32 dstSize, const std::string& src)
+	{
+		if (src.size() >= dstSize)
+			ELOG("Mesh cache string truncated: %s", src.c_str());
+
+		strncpy(dst, src.c_str(), dstSize - 1);
+		dst[dstSize - 1] = '\0';
+	}
+
+	void WritePadding(FILE* file, u64 currentOffset, u64 targetOffset)
+	{
+		static const u8 zeros[MESH_CACHE_BLOB_ALIGNMENT] = {};
+		fwrite(zeros, 1, targetOffset - currentOffset, file);
+	}
+
+	// Every range a submesh refers to has to lie inside the blobs and tables of the file
+	bool IsCachedSubmeshValid(const MeshCacheHeader& header, const MeshCacheSubmesh& submesh)
+	{
+		if (submesh.stride == 0 || submesh.vertexSize % submesh.stride != 0 || (submesh.indexSize != 2 && submesh.indexSize != 4))
+			return false;
+
+		if ((u64)submesh.vertexOffset + submesh.vertexSize > header.vertexDataSize ||
+			(u64)submesh.indexOffset + (u64)submesh.indexCount * submesh.indexSize > header.indexDataSize)
+			return false;
+
+		if (submesh.attributeCount > MESH_CACHE_MAX_ATTRIBUTES || submesh.lodCount > MESH_MAX_LODS ||
+			submesh.materialIndex >= header.materialCount ||
+			(u64)submesh.firstMeshlet + submesh.meshletCount > header.meshletCount)
+			return false;
+
+		for (u32 i = 0; i < submesh.lodCount; ++i)
+		{
+			if ((u64)submesh.lods[i].firstIndex + submesh.lods[i].indexCount > submesh.indexCount)
+				return false;
+		}
+
+		return true;
+	}
+}
+
+std::string GetMeshCachePath(const char* sourcePath)
+{
+	return std::string(sourcePath) + MESH_CACHE_EXTENSION;
+}
+
+bool ReadMeshCache(const MappedFile& file, u64 sourceTimestamp, u32 importFlags, u32 vertexFormat, MeshCacheView* view)
+{
+	if (!file.data || file.size < sizeof(MeshCacheHeader))
+		return false;
+
+	const u8* base = (const u8*)file.data;
+	const MeshCacheHeader* header = (const MeshCacheHeader*)base;
+
+	if (header->magic != MESH_CACHE_MAGIC || header->version != MESH_CACHE_VERSION)
+		return false;
+
+	// The cache is stale if the source file or the import settings changed
+	if (header->sourceTimestamp != sourceTimestamp || header->importFlags != importFlags || header->vertexFormat != vertexFormat)
+		return false;
+
+	const u64 submeshTableEnd = header->submeshTableOffset + header->submeshCount * sizeof(MeshCacheSubmesh);
+	const u64 materialTableEnd = header->materialTableOffset + header->materialCount * sizeof(MeshCacheMaterial);
+	const u64 meshletTableEnd = header->meshletTableOffset + header->meshletCount * sizeof(MeshCacheMeshlet);
+	const u64 nodeTableEnd = header->nodeTableOffset + header->nodeCount * sizeof(MeshCacheNode);
+	const u64 instanceTableEnd = header->instanceTableOffset + header->instanceCount * sizeof(MeshCacheInstance);
+	if (submeshTableEnd > file.size || materialTableEnd > file.size || meshletTableEnd > file.size ||
+		nodeTableEnd > file.size || instanceTableEnd > file.size ||
+		header->vertexDataOffset + header->vertexDataSize > file.size ||
+		header->indexDataOffset + header->indexDataSize > file.size)
+	{
+		ELOG("Mesh cache is truncated");
+		return false;
+	}
+
+	const MeshCacheSubmesh* submeshes = (const MeshCacheSubmesh*)(base + header->submeshTableOffset);
+	for (u32 i = 0; i < header->submeshCount; ++i)
+	{
+		if (!IsCachedSubmeshValid(*header, submeshes[i]))
+		{
+			ELOG("Mesh cache submesh %u is out of the bounds of its data", i);
+			return false;
+		}
+	}
+
+	const MeshCacheInstance* instances = (const MeshCacheInstance*)(base + header->instanceTableOffset);
+	for (u32 i = 0; i < header->instanceCount; ++i)
+	{
+		if (instances[i].submesh >= header->submeshCount || (header->nodeCount && instances[i].node >= header->nodeCount))
+		{
+			ELOG("Mesh cache instance %u refers to a missing submesh or node", i);
+			return false;
+		}
+	}
+
+	view->header = header;
+	view->submeshes = submeshes;
+	view->materials = (const MeshCacheMaterial*)(base + header->materialTableOffset);
+	view->meshlets = (const MeshCacheMeshlet*)(base + header->meshletTableOffset);
+	view->nodes = (const MeshCacheNode*)(base + header->nodeTableOffset);
+	view->instances = instances;
+	view->vertexData = base + header->vertexDataOffset;
+	view->indexData = base + header->indexDataOffset;
+
+	return true;
+}
+
+bool PeekMeshCacheBounds(const char* cachePath, u64 sourceTimestamp, u32 importFlags, u32 vertexFormat, glm::vec3& aabbMin, glm::vec3& aabbMax)
+{
+	// Mapped like the full read, so caches inside the asset archive are found too
+	MappedFile file = MapGeneratedFile(cachePath);
+	if (!file.data)
+		return false;
+
+	MeshCacheHeader header = {};
+	bool valid = file.size >= sizeof(header);
+	if (valid)
+		memcpy(&header, file.data, sizeof(header));
+	UnmapFile(file);
+
+	valid = valid && header.magic == MESH_CACHE_MAGIC && header.version == MESH_CACHE_VERSION &&
+		header.sourceTimestamp == sourceTimestamp && header.importFlags == importFlags && header.vertexFormat == vertexFormat;
+
+	if (valid)
+	{
+		aabbMin = glm::vec3(header.aabbMin[0], header.aabbMin[1], header.aabbMin[2]);
+		aabbMax = glm::vec3(header.aabbMax[0], header.aabbMax[1], header.aabbMax[2]);
+	}
+
+	return valid;
+}
+
+void ComputeMeshBounds(const Mesh& mesh, glm::vec3& aabbMin, glm::vec3& aabbMax)
+{
+	aabbMin = glm::vec3(FLT_MAX);
+	aabbMax = glm::vec3(-FLT_MAX);
+
+	for (const Submesh& submesh : mesh.submeshes)
+	{
+		const u32 floatStride = submesh.vertexBufferLayout.stride / sizeof(float);
+		for (u32 i = 0; i + 2 < submesh.vertices.size(); i += floatStride)
+		{
+			glm::vec3 position(submesh.vertices[i], submesh.vertices[i + 1], submesh.vertices[i + 2]);
+			aabbMin = glm::min(aabbMin, position);
+			aabbMax = glm::max(aabbMax, position);
+		}
+	}
+
+	if (aabbMin.x > aabbMax.x)
+	{
+		aabbMin = glm::vec3(0.0f);
+		aabbMax = glm::vec3(0.0f);
+	}
+}
+
+bool WriteMeshCache(const char* cachePath, u64 sourceTimestamp, u32 importFlags, u32 vertexFormat, const Mesh& mesh,
+	const std::vector<u32>& submeshMaterials, const std::vector<MaterialDesc>& materials,
+	const std::vector<ModelNode>& nodes, const std::vector<SubmeshInstance>& instances,
+	const std::vector<u8>& vertexData, const std::vector<u8>& indexData, const glm::vec3& aabbMin, const glm::vec3& aabbMax,
+	const glm::vec3& positionScale, const glm::vec3& positionOffset)
+{
+	std::vector<MeshCacheSubmesh> submeshTable(mesh.submeshes.size());
+	std::vector<MeshCacheMaterial> materialTable(materials.size());
+	std::vector<MeshCacheMeshlet> meshletTable;
+	std::vector<MeshCacheNode> nodeTable(nodes.size());
+	std::vector<MeshCacheInstance> instanceTable(instances.size());
+
+	for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+	{
+		const Submesh& submesh = mesh.submeshes[i];
+		MeshCacheSubmesh& entry = submeshTable[i];
+		entry = {};
+
+		if (submesh.vertexBufferLayout.attributes.size() > MESH_CACHE_MAX_ATTRIBUTES)
+		{
+			ELOG("Mesh cache can't store more than %d vertex attributes", MESH_CACHE_MAX_ATTRIBUTES);
+			return false;
+		}
+
+		entry.vertexOffset = submesh.vertexOffset;
+		entry.vertexSize = submesh.vertexCount * submesh.vertexBufferLayout.stride;
+		entry.indexOffset = submesh.indexOffset;
+		entry.indexCount = submesh.indexCount;
+		entry.materialIndex = submeshMaterials[i];
+		entry.stride = submesh.vertexBufferLayout.stride;
+		entry.attributeCount = (u8)submesh.vertexBufferLayout.attributes.size();
+		entry.indexSize = submesh.indexSize;
+		entry.acmrBefore = submesh.cacheStats.acmrBefore;
+		entry.acmrAfter = submesh.cacheStats.acmrAfter;
+		entry.atvrBefore = submesh.cacheStats.atvrBefore;
+		entry.atvrAfter = submesh.cacheStats.atvrAfter;
+		entry.lodCount = (u8)submesh.lodCount;
+		for (u32 j = 0; j < submesh.lodCount; ++j)
+			entry.lods[j] = { submesh.lods[j].firstIndex, submesh.lods[j].indexCount, submesh.lods[j].error };
+
+		entry.firstMeshlet = (u32)meshletTable.size();
+		entry.meshletCount = (u32)submesh.meshlets.size();
+		for (const Meshlet& meshlet : submesh.meshlets)
+		{
+			MeshCacheMeshlet cached = {};
+			memcpy(cached.center, glm::value_ptr(meshlet.center), sizeof(cached.center));
+			cached.radius = meshlet.radius;
+			memcpy(cached.coneAxis, glm::value_ptr(meshlet.coneAxis), sizeof(cached.coneAxis));
+			cached.coneCutoff = meshlet.coneCutoff;
+			cached.firstIndex = meshlet.firstIndex;
+			cached.indexCount = meshlet.indexCount;
+			meshletTable.push_back(cached);
+		}
+
+		for (u32 j = 0; j < entry.attributeCount; ++j)
+		{
+			const VertexBufferAttribute& attribute = submesh.vertexBufferLayout.attributes[j];
+			entry.attributes[j] = { attribute.location, attribute.componentCount, attribute.offset, attribute.format };
+		}
+	}
+
+	for (u32 i = 0; i < materials.size(); ++i)
+	{
+		const MaterialDesc& material = materials[i];
+		MeshCacheMaterial& entry = materialTable[i];
+		entry = {};
+
+		CopyCacheString(entry.name, MESH_CACHE_MAX_NAME, material.name);
+		memcpy(entry.albedo, glm::value_ptr(material.albedo), sizeof(entry.albedo));
+		memcpy(entry.emissive, glm::value_ptr(material.emissive), sizeof(entry.emissive));
+		entry.smoothness = material.smoothness;
+
+		CopyCacheString(entry.texturePaths[MeshCacheTexture_Albedo], MESH_CACHE_MAX_PATH, material.albedoTexture);
+		CopyCacheString(entry.texturePaths[MeshCacheTexture_Emissive], MESH_CACHE_MAX_PATH, material.emissiveTexture);
+		CopyCacheString(entry.texturePaths[MeshCacheTexture_Specular], MESH_CACHE_MAX_PATH, material.specularTexture);
+		CopyCacheString(entry.texturePaths[MeshCacheTexture_Normals], MESH_CACHE_MAX_PATH, material.normalsTexture);
+		CopyCacheString(entry.texturePaths[MeshCacheTexture_Bump], MESH_CACHE_MAX_PATH, material.bumpTexture);
+		CopyCacheString(entry.texturePaths[MeshCacheTexture_Roughness], MESH_CACHE_MAX_PATH, material.roughnessTexture);
+		CopyCacheString(entry.texturePaths[MeshCacheTexture_Metallic], MESH_CACHE_MAX_PATH, material.metallicTexture);
+		CopyCacheString(entry.texturePaths[MeshCacheTexture_Occlusion], MESH_CACHE_MAX_PATH, material.occlusionTexture);
+		entry.occlusionChannel = material.occlusionChannel;
+		entry.roughnessChannel = material.roughnessChannel;
+		entry.metallicChannel = material.metallicChannel;
+	}
+
+	for (u32 i = 0; i < nodes.size(); ++i)
+	{
+		MeshCacheNode& entry = nodeTable[i];
+		entry = {};
+		CopyCacheString(entry.name, MESH_CACHE_MAX_NAME, nodes[i].name);
+		entry.parent = nodes[i].parent;
+		memcpy(entry.transform, glm::value_ptr(nodes[i].transform), sizeof(entry.transform));
+	}
+
+	for (u32 i = 0; i < instances.size(); ++i)
+		instanceTable[i] = { instances[i].submesh, instances[i].node };
+
+	MeshCacheHeader header = {};
+	header.magic = MESH_CACHE_MAGIC;
+	header.version = MESH_CACHE_VERSION;
+	header.importFlags = importFlags;
+	header.submeshCount = (u32)submeshTable.size();
+	header.sourceTimestamp = sourceTimestamp;
+	header.materialCount = (u32)materialTable.size();
+	header.vertexFormat = vertexFormat;
+	header.submeshTableOffset = sizeof(MeshCacheHeader);
+	header.materialTableOffset = header.submeshTableOffset + submeshTable.size() * sizeof(MeshCacheSubmesh);
+	header.meshletTableOffset = header.materialTableOffset + materialTable.size() * sizeof(MeshCacheMaterial);
+	header.meshletCount = (u32)meshletTable.size();
+	header.nodeTableOffset = header.meshletTableOffset + meshletTable.size() * sizeof(MeshCacheMeshlet);
+	header.nodeCount = (u32)nodeTable.size();
+	header.instanceTableOffset = header.nodeTableOffset + nodeTable.size() * sizeof(MeshCacheNode);
+	header.instanceCount = (u32)instanceTable.size();
+	header.vertexDataOffset = AlignOffset(header.instanceTableOffset + instanceTable.size() * sizeof(MeshCacheInstance), MESH_CACHE_BLOB_ALIGNMENT);
+	header.vertexDataSize = vertexData.size();
+	header.indexDataOffset = AlignOffset(header.vertexDataOffset + vertexData.size(), MESH_CACHE_BLOB_ALIGNMENT);
+	header.indexDataSize = indexData.size();
+	memcpy(header.aabbMin, glm::value_ptr(aabbMin), sizeof(header.aabbMin));
+	memcpy(header.aabbMax, glm::value_ptr(aabbMax), sizeof(header.aabbMax));
+	memcpy(header.positionScale, glm::value_ptr(positionScale), sizeof(header.positionScale));
+	memcpy(header.positionOffset, glm::value_ptr(positionOffset), sizeof(header.positionOffset));
+
+	FILE* file = fopen(cachePath, "wb");
+	if (!file)
+	{
+		ELOG("fopen() failed writing mesh cache %s", cachePath);
+		return false;
+	}
+
+	fwrite(&header, sizeof(header), 1, file);
+	fwrite(submeshTable.data(), sizeof(MeshCacheSubmesh), submeshTable.size(), file);
+	fwrite(materialTable.data(), sizeof(MeshCacheMaterial), materialTable.size(), file);
+	fwrite(meshletTable.data(), sizeof(MeshCacheMeshlet), meshletTable.size(), file);
+	fwrite(nodeTable.data(), sizeof(MeshCacheNode), nodeTable.size(), file);
+	fwrite(instanceTable.data(), sizeof(MeshCacheInstance), instanceTable.size(), file);
+	WritePadding(file, header.instanceTableOffset + instanceTable.size() * sizeof(MeshCacheInstance), header.vertexDataOffset);
+	fwrite(vertexData.data(), 1, vertexData.size(), file);
+	WritePadding(file, header.vertexDataOffset + vertexData.size(), header.indexDataOffset);
+	fwrite(indexData.data(), 1, indexData.size(), file);
+
+	bool success = ferror(file) == 0;
+	fclose(file);
+
+	if (!success)
+	{
+		ELOG("Failed writing mesh cache %s", cachePath);
+		remove(cachePath);
+	}
+
+	return success;
+}
+
+VertexBufferLayout GetCachedVertexLayout(const MeshCacheSubmesh& submesh)
+{
+	VertexBufferLayout layout = {};
+	layout.stride = submesh.stride;
+	for (u32 i = 0; i < submesh.attributeCount; ++i)
+	{
+		const MeshCacheAttribute& attribute = submesh.attributes[i];
+		layout.attributes.push_back(VertexBufferAttribute{ attribute.location, attribute.componentCount, attribute.offset, attribute.format });
+	}
+	return layout;
+}
+
+MaterialDesc GetCachedMaterial(const MeshCacheMaterial& material)
+{
+	MaterialDesc desc = {};
+	desc.name = material.name;
+	desc.albedo = glm::vec3(material.albedo[0], material.albedo[1], material.albedo[2]);
+	desc.emissive = glm::vec3(material.emissive[0], material.emissive[1], material.emissive[2]);
+	desc.smoothness = material.smoothness;
+	desc.albedoTexture = material.texturePaths[MeshCacheTexture_Albedo];
+	desc.emissiveTexture = material.texturePaths[MeshCacheTexture_Emissive];
+	desc.specularTexture = material.texturePaths[MeshCacheTexture_Specular];
+	desc.normalsTexture = material.texturePaths[MeshCacheTexture_Normals];
+	desc.bumpTexture = material.texturePaths[MeshCacheTexture_Bump];
+	desc.roughnessTexture = material.texturePaths[MeshCacheTexture_Roughness];
+	desc.metallicTexture = material.texturePaths[MeshCacheTexture_Metallic];
+	desc.occlusionTexture = material.texturePaths[MeshCacheTexture_Occlusion];
+	desc.occlusionChannel = material.occlusionChannel;
+	desc.roughnessChannel = material.roughnessChannel;
+	desc.metallicChannel = material.metallicChannel;
+	return desc;
+}
+
+Meshlet GetCachedMeshlet(const MeshCacheMeshlet& meshlet)
+{
+	Meshlet result = {};
+	result.center = glm::vec3(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+	result.radius = meshlet.radius;
+	result.coneAxis = glm::vec3(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+	result.coneCutoff = meshlet.coneCutoff;
+	result.firstIndex = meshlet.firstIndex;
+	result.indexCount = meshlet.indexCount;
+	return result;
+}
+
+ModelNode GetCachedNode(const MeshCacheNode& node)
+{
+	ModelNode result = {};
+	result.name = node.name;
+	result.parent = node.parent;
+	result.transform = glm::make_mat4(node.transform);
+	return result;
+}
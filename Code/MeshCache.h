@@ -0,0 +1,186 @@
+//
+// MeshCache.h: Cooked binary mesh format. The first time a model is imported through Assimp
+// the final interleaved vertex/index blobs, the vertex layouts and the material table are
+// written next to the source file. Following launches map that file and upload it directly.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+#define MESH_CACHE_MAGIC          0x4348534D // "MSHC"
+#define MESH_CACHE_VERSION        10
+#define MESH_CACHE_EXTENSION      ".meshcache"
+#define MESH_CACHE_MAX_ATTRIBUTES 8
+#define MESH_CACHE_MAX_NAME       64
+#define MESH_CACHE_MAX_PATH       128
+#define MESH_CACHE_BLOB_ALIGNMENT 16
+
+enum MeshCacheTextureSlot
+{
+	MeshCacheTexture_Albedo = 0,
+	MeshCacheTexture_Emissive,
+	MeshCacheTexture_Specular,
+	MeshCacheTexture_Normals,
+	MeshCacheTexture_Bump,
+	MeshCacheTexture_Roughness,
+	MeshCacheTexture_Metallic,
+	MeshCacheTexture_Occlusion,
+	MeshCacheTexture_Count
+};
+
+struct MeshCacheHeader
+{
+	u32 magic;
+	u32 version;
+	u32 importFlags;
+	u32 submeshCount;
+	u64 sourceTimestamp;
+	u32 materialCount;
+	u32 vertexFormat; // VertexFormat of the vertex blob
+	u64 submeshTableOffset;
+	u64 materialTableOffset;
+	u64 vertexDataOffset;
+	u64 vertexDataSize;
+	u64 indexDataOffset;
+	u64 indexDataSize;
+	f32 aabbMin[3];    // Model space bounds of the placed instances
+	f32 aabbMax[3];
+	u64 meshletTableOffset;
+	u32 meshletCount;
+	u32 nodeCount;     // Node tree, empty when the import flattened it
+	u64 nodeTableOffset;
+	u64 instanceTableOffset;
+	u32 instanceCount;
+	u32 reserved;
+	f32 positionScale[3];  // Dequantization of the vertex blob, from the bounds of the stored vertices
+	f32 positionOffset[3];
+};
+
+struct MeshCacheAttribute
+{
+	u8 location;
+	u8 componentCount;
+	u8 offset;
+	u8 format;
+};
+
+struct MeshCacheLod
+{
+	u32 firstIndex; // Relative to the first index of the submesh
+	u32 indexCount;
+	f32 error;
+};
+
+struct MeshCacheMeshlet
+{
+	f32 center[3];
+	f32 radius;
+	f32 coneAxis[3];
+	f32 coneCutoff;
+	u32 firstIndex; // Relative to the first index of the submesh
+	u32 indexCount;
+};
+
+struct MeshCacheSubmesh
+{
+	u32 vertexOffset;  // In bytes, relative to the vertex blob
+	u32 vertexSize;
+	u32 indexOffset;   // In bytes, relative to the index blob
+	u32 indexCount;
+	u32 materialIndex; // Relative to the material table of this file
+	u8  stride;
+	u8  attributeCount;
+	u8  indexSize;
+	u8  lodCount;
+	MeshCacheAttribute attributes[MESH_CACHE_MAX_ATTRIBUTES];
+	f32 acmrBefore;    // Vertex cache stats of the import optimizer
+	f32 acmrAfter;
+	f32 atvrBefore;
+	f32 atvrAfter;
+	MeshCacheLod lods[MESH_MAX_LODS];
+	u32 firstMeshlet;  // In the meshlet table of this file
+	u32 meshletCount;
+};
+
+struct MeshCacheNode
+{
+	char name[MESH_CACHE_MAX_NAME];
+	u32  parent;
+	f32  transform[16]; // Relative to the parent, column major
+};
+
+struct MeshCacheInstance
+{
+	u32 submesh;
+	u32 node;
+};
+
+struct MeshCacheMaterial
+{
+	char name[MESH_CACHE_MAX_NAME];
+	f32  albedo[3];
+	f32  emissive[3];
+	f32  smoothness;
+	char texturePaths[MeshCacheTexture_Count][MESH_CACHE_MAX_PATH];
+	u8   occlusionChannel;
+	u8   roughnessChannel;
+	u8   metallicChannel;
+	u8   padding;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 168, "MeshCacheHeader layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(MeshCacheSubmesh) == 128, "MeshCacheSubmesh layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(MeshCacheMeshlet) == 40, "MeshCacheMeshlet layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(MeshCacheNode) == 132, "MeshCacheNode layout changed, bump MESH_CACHE_VERSION");
+static_assert(sizeof(MeshCacheMaterial) == 1120, "MeshCacheMaterial layout changed, bump MESH_CACHE_VERSION");
+
+// Pointers into a mapped cache file, valid while the file stays mapped
+struct MeshCacheView
+{
+	const MeshCacheHeader*   header;
+	const MeshCacheSubmesh*  submeshes;
+	const MeshCacheMaterial* materials;
+	const MeshCacheMeshlet*  meshlets;
+	const MeshCacheNode*     nodes;
+	const MeshCacheInstance* instances;
+	const u8*                vertexData;
+	const u8*                indexData;
+};
+
+std::string GetMeshCachePath(const char* sourcePath);
+
+/**
+ * Validates a mapped cache file against the source timestamp, import flags and vertex format
+ * it has to match. On success, fills the view with pointers to the tables and blobs inside the file.
+ */
+bool ReadMeshCache(const MappedFile& file, u64 sourceTimestamp, u32 importFlags, u32 vertexFormat, MeshCacheView* view);
+
+/**
+ * Reads only the header of a cache file to get the bounds of the mesh, so a proxy can be
+ * drawn while the whole file is still being loaded. Returns false if the cache is stale.
+ */
+bool PeekMeshCacheBounds(const char* cachePath, u64 sourceTimestamp, u32 importFlags, u32 vertexFormat, glm::vec3& aabbMin, glm::vec3& aabbMax);
+
+/**
+ * Writes the cooked version of an imported mesh. The submeshes must already be packed into
+ * vertexData and indexData (see PackMeshGeometry). submeshMaterials are indices into the
+ * materials vector.
+ */
+bool WriteMeshCache(const char* cachePath, u64 sourceTimestamp, u32 importFlags, u32 vertexFormat, const Mesh& mesh,
+	const std::vector<u32>& submeshMaterials, const std::vector<MaterialDesc>& materials,
+	const std::vector<ModelNode>& nodes, const std::vector<SubmeshInstance>& instances,
+	const std::vector<u8>& vertexData, const std::vector<u8>& indexData, const glm::vec3& aabbMin, const glm::vec3& aabbMax,
+	const glm::vec3& positionScale, const glm::vec3& positionOffset);
+
+// Bounds of the positions of every submesh (location 0, three floats), before it is packed
+void ComputeMeshBounds(const Mesh& mesh, glm::vec3& aabbMin, glm::vec3& aabbMax);
+
+VertexBufferLayout GetCachedVertexLayout(const MeshCacheSubmesh& submesh);
+
+MaterialDesc GetCachedMaterial(const MeshCacheMaterial& material);
+
+Meshlet GetCachedMeshlet(const MeshCacheMeshlet& meshlet);
+
+ModelNode GetCachedNode(const MeshCacheNode& node);
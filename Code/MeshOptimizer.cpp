@@ -0,0 +1,284 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+
+namespace
+{
+	// Triangles using each vertex, as offsets into one flat list
+	struct VertexAdjacency
+	{
+		std::vector<u32> offsets;   // vertexCount + 1
+		std::vector<u32> triangles;
+	};
+
+	void BuildAdjacency(const u32* indices, u32 indexCount, u32 vertexCount, VertexAdjacency& adjacency)
+	{
+		adjacency.offsets.assign(vertexCount + 1, 0);
+		for (u32 i = 0; i < indexCount; ++i)
+			adjacency.offsets[indices[i] + 1]++;
+
+		for (u32 v = 0; v < vertexCount; ++v)
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+		std::vector<u32> cursor(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		adjacency.triangles.resize(indexCount);
+		for (u32 i = 0; i < indexCount; ++i)
+			adjacency.triangles[cursor[indices[i]]++] = i / 3;
+	}
+
+	i32 SkipDeadEnd(std::vector<u32>& deadEnd, const std::vector<u32>& liveTriangles, u32& cursor, u32 vertexCount)
+	{
+		// Recently used vertices first, they are likely still in the cache
+		while (!deadEnd.empty())
+		{
+			u32 vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[vertex] > 0)
+				return (i32)vertex;
+		}
+
+		for (; cursor < vertexCount; ++cursor)
+		{
+			if (liveTriangles[cursor] > 0)
+				return (i32)cursor;
+		}
+		return -1;
+	}
+
+	i32 FindPositionOffset(const VertexBufferLayout& layout)
+	{
+		for (const VertexBufferAttribute& attribute : layout.attributes)
+		{
+			if (attribute.location == 0)
+				return attribute.offset / sizeof(float);
+		}
+		return -1;
+	}
+}
+
+void ComputeVertexCacheStats(const u32* indices, u32 indexCount, u32 vertexCount, f32& acmr, f32& atvr)
+{
+	// Entries are the time a vertex entered the FIFO, misses push everything one slot further
+	std::vector<u32> cacheTime(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	u32 time = MESH_OPTIMIZER_CACHE_SIZE + 1;
+	u32 misses = 0, referencedCount = 0;
+
+	for (u32 i = 0; i < indexCount; ++i)
+	{
+		u32 vertex = indices[i];
+		if (time - cacheTime[vertex] > MESH_OPTIMIZER_CACHE_SIZE)
+		{
+			cacheTime[vertex] = time++;
+			misses++;
+		}
+
+		if (!referenced[vertex])
+		{
+			referenced[vertex] = true;
+			referencedCount++;
+		}
+	}
+
+	const u32 triangleCount = indexCount / 3;
+	acmr = triangleCount ? (f32)misses / triangleCount : 0.0f;
+	atvr = referencedCount ? (f32)misses / referencedCount : 0.0f;
+}
+
+void OptimizeVertexCache(const u32* indices, u32 indexCount, u32 vertexCount, u32 cacheSize,
+	std::vector<u32>& result, std::vector<u32>& clusterStarts)
+{
+	result.clear();
+	clusterStarts.clear();
+	if (indexCount == 0)
+		return;
+
+	VertexAdjacency adjacency;
+	BuildAdjacency(indices, indexCount, vertexCount, adjacency);
+
+	std::vector<u32> liveTriangles(vertexCount);
+	for (u32 v = 0; v < vertexCount; ++v)
+		liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+	std::vector<u32> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(indexCount / 3, false);
+	std::vector<u32> deadEnd;
+	std::vector<u32> candidates;
+	u32 time = cacheSize + 1;
+	u32 cursor = 1;
+
+	result.reserve(indexCount);
+	clusterStarts.push_back(0);
+
+	i32 fanning = 0;
+	while (fanning >= 0)
+	{
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		for (u32 i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; ++i)
+		{
+			u32 triangle = adjacency.triangles[i];
+			if (emitted[triangle])
+				continue;
+
+			for (u32 k = 0; k < 3; ++k)
+			{
+				u32 vertex = indices[triangle * 3 + k];
+				result.push_back(vertex);
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+
+				if (time - cacheTime[vertex] > cacheSize)
+					cacheTime[vertex] = time++;
+			}
+			emitted[triangle] = true;
+		}
+
+		// Next fanning vertex: the oldest candidate that will still be in the cache once its
+		// remaining triangles are emitted
+		i32 next = -1;
+		i32 bestPriority = -1;
+		for (u32 vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+
+			i32 priority = 0;
+			if (time - cacheTime[vertex] + 2 * liveTriangles[vertex] <= cacheSize)
+				priority = (i32)(time - cacheTime[vertex]);
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = (i32)vertex;
+			}
+		}
+
+		// Nothing around is worth fanning, whatever comes next starts a new cluster
+		if (next < 0)
+		{
+			next = SkipDeadEnd(deadEnd, liveTriangles, cursor, vertexCount);
+			if (next >= 0 && result.size() / 3 != clusterStarts.back())
+				clusterStarts.push_back((u32)result.size() / 3);
+		}
+
+		fanning = next;
+	}
+
+	assert(result.size() == indexCount);
+}
+
+void OptimizeOverdraw(const u32* indices, u32 indexCount, const float* positions, u32 positionStride,
+	const std::vector<u32>& clusterStarts, std::vector<u32>& result)
+{
+	const u32 triangleCount = indexCount / 3;
+	const u32 clusterCount = (u32)clusterStarts.size();
+
+	struct Cluster
+	{
+		u32 firstTriangle;
+		u32 triangleCount;
+		f32 sortKey;
+	};
+
+	std::vector<Cluster> clusters(clusterCount);
+	std::vector<glm::vec3> centroids(clusterCount, glm::vec3(0.0f));
+	std::vector<glm::vec3> normals(clusterCount, glm::vec3(0.0f));
+	std::vector<f32> areas(clusterCount, 0.0f);
+
+	glm::vec3 meshCentroid(0.0f);
+	f32 meshArea = 0.0f;
+
+	for (u32 c = 0; c < clusterCount; ++c)
+	{
+		clusters[c].firstTriangle = clusterStarts[c];
+		clusters[c].triangleCount = (c + 1 < clusterCount ? clusterStarts[c + 1] : triangleCount) - clusterStarts[c];
+
+		for (u32 t = clusters[c].firstTriangle; t < clusters[c].firstTriangle + clusters[c].triangleCount; ++t)
+		{
+			glm::vec3 p0 = glm::make_vec3(positions + indices[t * 3 + 0] * positionStride);
+			glm::vec3 p1 = glm::make_vec3(positions + indices[t * 3 + 1] * positionStride);
+			glm::vec3 p2 = glm::make_vec3(positions + indices[t * 3 + 2] * positionStride);
+
+			// Twice the area, weights both the centroid and the normal
+			glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+			f32 area = glm::length(normal);
+			glm::vec3 center = (p0 + p1 + p2) / 3.0f;
+
+			centroids[c] += center * area;
+			normals[c] += normal;
+			areas[c] += area;
+		}
+
+		meshCentroid += centroids[c];
+		meshArea += areas[c];
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	// Clusters far out along their own normal occlude the rest of the mesh, draw them first
+	for (u32 c = 0; c < clusterCount; ++c)
+	{
+		glm::vec3 centroid = areas[c] > 0.0f ? centroids[c] / areas[c] : meshCentroid;
+		f32 normalLength = glm::length(normals[c]);
+		glm::vec3 normal = normalLength > 0.0f ? normals[c] / normalLength : glm::vec3(0.0f);
+		clusters[c].sortKey = glm::dot(centroid - meshCentroid, normal);
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+	result.clear();
+	result.reserve(indexCount);
+	for (const Cluster& cluster : clusters)
+	{
+		const u32* first = indices + cluster.firstTriangle * 3;
+		result.insert(result.end(), first, first + cluster.triangleCount * 3);
+	}
+}
+
+void OptimizeVertexFetch(std::vector<float>& vertices, u32 floatStride, std::vector<u32>& indices)
+{
+	const u32 vertexCount = (u32)(vertices.size() / floatStride);
+	std::vector<u32> remap(vertexCount, UINT32_MAX);
+	std::vector<float> remapped;
+	remapped.reserve(vertices.size());
+
+	u32 nextVertex = 0;
+	for (u32& index : indices)
+	{
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = nextVertex++;
+			const float* vertex = &vertices[index * floatStride];
+			remapped.insert(remapped.end(), vertex, vertex + floatStride);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(remapped);
+}
+
+void OptimizeSubmesh(Submesh& submesh)
+{
+	const u32 floatStride = submesh.vertexBufferLayout.stride / sizeof(float);
+	const i32 positionOffset = FindPositionOffset(submesh.vertexBufferLayout);
+	if (submesh.indices.size() < 3 || floatStride == 0 || positionOffset < 0)
+		return;
+
+	u32 vertexCount = (u32)(submesh.vertices.size() / floatStride);
+	VertexCacheStats& stats = submesh.cacheStats;
+	ComputeVertexCacheStats(submesh.indices.data(), (u32)submesh.indices.size(), vertexCount, stats.acmrBefore, stats.atvrBefore);
+
+	std::vector<u32> cacheOrder, clusterStarts;
+	OptimizeVertexCache(submesh.indices.data(), (u32)submesh.indices.size(), vertexCount, MESH_OPTIMIZER_CACHE_SIZE, cacheOrder, clusterStarts);
+
+	OptimizeOverdraw(cacheOrder.data(), (u32)cacheOrder.size(), submesh.vertices.data() + positionOffset, floatStride,
+		clusterStarts, submesh.indices);
+
+	OptimizeVertexFetch(submesh.vertices, floatStride, submesh.indices);
+
+	vertexCount = (u32)(submesh.vertices.size() / floatStride);
+	ComputeVertexCacheStats(submesh.indices.data(), (u32)submesh.indices.size(), vertexCount, stats.acmrAfter, stats.atvrAfter);
+}
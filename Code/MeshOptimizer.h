@@ -0,0 +1,36 @@
+//
+// MeshOptimizer.h: Import-time reordering of the triangles and vertices of a submesh. Triangles
+// are sorted for the post-transform vertex cache (Tipsify), the clusters it produces are then
+// sorted front to back from the outside of the mesh to cut overdraw, and finally vertices are
+// renumbered in the order they are first fetched.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+#define MESH_OPTIMIZER_CACHE_SIZE 16 // Entries of the FIFO cache reordering targets and stats simulate
+
+/**
+ * Average cache miss ratio (misses per triangle, 0.5 at best) and average transform to vertex
+ * ratio (misses per referenced vertex, 1.0 at best) of an index buffer.
+ */
+void ComputeVertexCacheStats(const u32* indices, u32 indexCount, u32 vertexCount, f32& acmr, f32& atvr);
+
+/**
+ * Optimizes the float vertices and 32 bit indices of a submesh in place, before it is packed,
+ * and stores the cache stats of the index order before and after.
+ */
+void OptimizeSubmesh(Submesh& submesh);
+
+// Tipsify. clusterStarts receives the first triangle of every cluster it produced.
+void OptimizeVertexCache(const u32* indices, u32 indexCount, u32 vertexCount, u32 cacheSize,
+	std::vector<u32>& result, std::vector<u32>& clusterStarts);
+
+// Sorts the clusters so the ones facing away from the center of the mesh are drawn first
+void OptimizeOverdraw(const u32* indices, u32 indexCount, const float* positions, u32 positionStride,
+	const std::vector<u32>& clusterStarts, std::vector<u32>& result);
+
+// Renumbers vertices in order of first use and drops the ones no triangle references
+void OptimizeVertexFetch(std::vector<float>& vertices, u32 floatStride, std::vector<u32>& indices);
@@ -0,0 +1,306 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <float.h>
+#include <unordered_map>
+
+namespace
+{
+	// Symmetric 4x4 matrix, the sum of squared distances to a set of planes
+	struct Quadric
+	{
+		f64 a00, a01, a02, a03;
+		f64 a11, a12, a13;
+		f64 a22, a23;
+		f64 a33;
+	};
+
+	Quadric MakePlaneQuadric(const glm::dvec3& normal, f64 distance, f64 weight)
+	{
+		Quadric q;
+		q.a00 = weight * normal.x * normal.x;
+		q.a01 = weight * normal.x * normal.y;
+		q.a02 = weight * normal.x * normal.z;
+		q.a03 = weight * normal.x * distance;
+		q.a11 = weight * normal.y * normal.y;
+		q.a12 = weight * normal.y * normal.z;
+		q.a13 = weight * normal.y * distance;
+		q.a22 = weight * normal.z * normal.z;
+		q.a23 = weight * normal.z * distance;
+		q.a33 = weight * distance * distance;
+		return q;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02; q.a03 += other.a03;
+		q.a11 += other.a11; q.a12 += other.a12; q.a13 += other.a13;
+		q.a22 += other.a22; q.a23 += other.a23;
+		q.a33 += other.a33;
+	}
+
+	f64 EvaluateQuadric(const Quadric& q, const glm::dvec3& p)
+	{
+		f64 result = q.a00 * p.x * p.x + 2.0 * q.a01 * p.x * p.y + 2.0 * q.a02 * p.x * p.z + 2.0 * q.a03 * p.x +
+			q.a11 * p.y * p.y + 2.0 * q.a12 * p.y * p.z + 2.0 * q.a13 * p.y +
+			q.a22 * p.z * p.z + 2.0 * q.a23 * p.z +
+			q.a33;
+		return glm::max(result, 0.0);
+	}
+
+	struct Collapse
+	{
+		u32 from; // Indices, from moves onto to
+		u32 to;
+		f64 cost;
+	};
+
+	u64 MakeEdgeKey(u32 a, u32 b)
+	{
+		return a < b ? ((u64)a << 32) | b : ((u64)b << 32) | a;
+	}
+
+	// Vertices at the same position share one id, so seams between UV islands are found
+	u32 WeldPositions(const float* positions, u32 positionStride, u32 vertexCount, std::vector<u32>& welded)
+	{
+		struct PositionHash
+		{
+			size_t operator()(const glm::vec3& p) const
+			{
+				const u32* bits = (const u32*)&p;
+				return (size_t)(bits[0] * 73856093u ^ bits[1] * 19349663u ^ bits[2] * 83492791u);
+			}
+		};
+
+		std::unordered_map<glm::vec3, u32, PositionHash> firstVertex;
+		firstVertex.reserve(vertexCount);
+		welded.resize(vertexCount);
+
+		for (u32 v = 0; v < vertexCount; ++v)
+		{
+			glm::vec3 position = glm::make_vec3(positions + v * positionStride);
+			welded[v] = firstVertex.emplace(position, v).first->second;
+		}
+		return (u32)firstVertex.size();
+	}
+}
+
+f32 SimplifyMesh(const u32* indices, u32 indexCount, const float* positions, u32 positionStride, u32 vertexCount,
+	u32 targetIndexCount, std::vector<u32>& result)
+{
+	result.assign(indices, indices + indexCount);
+	if (indexCount <= targetIndexCount)
+		return 0.0f;
+
+	auto position = [&](u32 v) { return glm::dvec3(glm::make_vec3(positions + v * positionStride)); };
+
+	std::vector<u32> welded;
+	WeldPositions(positions, positionStride, vertexCount, welded);
+
+	// Seams: one position used by several vertices of the index buffer
+	std::vector<u32> wedge(vertexCount, UINT32_MAX);
+	std::vector<bool> locked(vertexCount, false);
+	for (u32 i = 0; i < indexCount; ++i)
+	{
+		u32 vertex = indices[i];
+		u32& first = wedge[welded[vertex]];
+		if (first == UINT32_MAX)
+			first = vertex;
+		else if (first != vertex)
+			locked[welded[vertex]] = true;
+	}
+
+	// Borders and non-manifold edges: used by other than two triangles
+	std::unordered_map<u64, u32> edgeUse;
+	edgeUse.reserve(indexCount);
+	for (u32 i = 0; i < indexCount; i += 3)
+	{
+		for (u32 k = 0; k < 3; ++k)
+			edgeUse[MakeEdgeKey(welded[indices[i + k]], welded[indices[i + (k + 1) % 3]])]++;
+	}
+	for (const auto& edge : edgeUse)
+	{
+		if (edge.second != 2)
+		{
+			locked[(u32)(edge.first >> 32)] = true;
+			locked[(u32)(edge.first & 0xFFFFFFFF)] = true;
+		}
+	}
+
+	// Quadrics of the planes around each position, weighted by area
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	glm::dvec3 boundsMin(DBL_MAX), boundsMax(-DBL_MAX);
+	for (u32 i = 0; i < indexCount; i += 3)
+	{
+		glm::dvec3 p0 = position(indices[i]), p1 = position(indices[i + 1]), p2 = position(indices[i + 2]);
+		glm::dvec3 normal = glm::cross(p1 - p0, p2 - p0);
+		f64 area = glm::length(normal);
+		if (area > 0.0)
+			normal /= area;
+
+		Quadric q = MakePlaneQuadric(normal, -glm::dot(normal, p0), area);
+		for (u32 k = 0; k < 3; ++k)
+		{
+			AddQuadric(quadrics[welded[indices[i + k]]], q);
+			boundsMin = glm::min(boundsMin, position(indices[i + k]));
+			boundsMax = glm::max(boundsMax, position(indices[i + k]));
+		}
+	}
+
+	std::vector<Collapse> collapses;
+	std::vector<u32> collapseTo(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<u32> adjacencyOffsets, adjacency;
+	f64 maxError = 0.0;
+
+	while (result.size() > targetIndexCount)
+	{
+		const u32 resultCount = (u32)result.size();
+
+		// Triangles around each vertex, to check collapses for flipped triangles
+		adjacencyOffsets.assign(vertexCount + 1, 0);
+		for (u32 index : result)
+			adjacencyOffsets[index + 1]++;
+		for (u32 v = 0; v < vertexCount; ++v)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		adjacency.resize(resultCount);
+		std::vector<u32> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (u32 i = 0; i < resultCount; ++i)
+			adjacency[cursor[result[i]]++] = i / 3;
+
+		collapses.clear();
+		for (u32 i = 0; i < resultCount; i += 3)
+		{
+			for (u32 k = 0; k < 3; ++k)
+			{
+				u32 a = result[i + k], b = result[i + (k + 1) % 3];
+				if (!locked[welded[a]])
+					collapses.push_back(Collapse{ a, b, EvaluateQuadric(quadrics[welded[a]], position(b)) });
+				if (!locked[welded[b]])
+					collapses.push_back(Collapse{ b, a, EvaluateQuadric(quadrics[welded[b]], position(a)) });
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+		for (u32 v = 0; v < vertexCount; ++v)
+			collapseTo[v] = v;
+		std::fill(touched.begin(), touched.end(), false);
+
+		u32 remainingTriangles = resultCount / 3;
+		u32 collapseCount = 0;
+		for (const Collapse& collapse : collapses)
+		{
+			if (remainingTriangles * 3 <= targetIndexCount)
+				break;
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			// Reject collapses that flip a triangle or would touch a vertex already moved in this pass
+			bool isValid = true;
+			u32 removedTriangles = 0;
+			const glm::dvec3 target = position(collapse.to);
+			for (u32 j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1] && isValid; ++j)
+			{
+				const u32* triangle = &result[adjacency[j] * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					removedTriangles++;
+					continue;
+				}
+
+				u32 k = triangle[0] == collapse.from ? 0 : triangle[1] == collapse.from ? 1 : 2;
+				u32 b = triangle[(k + 1) % 3], c = triangle[(k + 2) % 3];
+				if (touched[b] || touched[c])
+				{
+					isValid = false;
+					break;
+				}
+
+				glm::dvec3 pb = position(b), pc = position(c);
+				glm::dvec3 before = glm::cross(pb - position(collapse.from), pc - position(collapse.from));
+				glm::dvec3 after = glm::cross(pb - target, pc - target);
+				isValid = glm::dot(before, after) > 0.0;
+			}
+
+			if (!isValid || removedTriangles == 0)
+				continue;
+
+			for (u32 j = adjacencyOffsets[collapse.from]; j < adjacencyOffsets[collapse.from + 1]; ++j)
+			{
+				const u32* triangle = &result[adjacency[j] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+			}
+
+			collapseTo[collapse.from] = collapse.to;
+			AddQuadric(quadrics[welded[collapse.to]], quadrics[welded[collapse.from]]);
+			remainingTriangles -= removedTriangles;
+			maxError = glm::max(maxError, collapse.cost);
+			collapseCount++;
+		}
+
+		if (collapseCount == 0)
+			break;
+
+		// Apply the collapses and drop the triangles that lost an edge
+		u32 writeIndex = 0;
+		for (u32 i = 0; i < resultCount; i += 3)
+		{
+			u32 a = collapseTo[result[i]], b = collapseTo[result[i + 1]], c = collapseTo[result[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+
+			result[writeIndex++] = a;
+			result[writeIndex++] = b;
+			result[writeIndex++] = c;
+		}
+		result.resize(writeIndex);
+	}
+
+	f64 extent = glm::max(glm::length(boundsMax - boundsMin), 1e-12);
+	return (f32)(sqrt(maxError) / extent);
+}
+
+void GenerateSubmeshLods(Submesh& submesh)
+{
+	const u32 floatStride = submesh.vertexBufferLayout.stride / sizeof(float);
+	const u32 baseIndexCount = (u32)submesh.indices.size();
+
+	submesh.lodCount = 1;
+	submesh.lods[0] = SubmeshLod{ 0, baseIndexCount, 0.0f };
+
+	i32 positionOffset = -1;
+	for (const VertexBufferAttribute& attribute : submesh.vertexBufferLayout.attributes)
+	{
+		if (attribute.location == 0)
+			positionOffset = attribute.offset / sizeof(float);
+	}
+	if (positionOffset < 0 || floatStride == 0)
+		return;
+
+	const u32 vertexCount = (u32)(submesh.vertices.size() / floatStride);
+	const f32 ratios[] = MESH_LOD_RATIOS;
+	std::vector<u32> simplified, reordered, clusterStarts;
+
+	for (u32 level = 1; level < MESH_MAX_LODS && level <= ARRAY_COUNT(ratios); ++level)
+	{
+		const SubmeshLod& previous = submesh.lods[level - 1];
+		const u32 targetIndexCount = (u32)(baseIndexCount / 3 * ratios[level - 1]) * 3;
+
+		f32 error = SimplifyMesh(submesh.indices.data() + previous.firstIndex, previous.indexCount,
+			submesh.vertices.data() + positionOffset, floatStride, vertexCount, targetIndexCount, simplified);
+
+		// Not worth its memory if it barely removes anything
+		if (simplified.empty() || simplified.size() * 10 > previous.indexCount * 9)
+			break;
+
+		OptimizeVertexCache(simplified.data(), (u32)simplified.size(), vertexCount, MESH_OPTIMIZER_CACHE_SIZE, reordered, clusterStarts);
+
+		SubmeshLod& lod = submesh.lods[level];
+		lod.firstIndex = (u32)submesh.indices.size();
+		lod.indexCount = (u32)reordered.size();
+		lod.error = glm::max(error, previous.error);
+		submesh.indices.insert(submesh.indices.end(), reordered.begin(), reordered.end());
+		submesh.lodCount = level + 1;
+	}
+}
@@ -0,0 +1,27 @@
+//
+// MeshSimplifier.h: Quadric error edge collapse, used to build the LOD chain of every submesh
+// at import. Collapses only move a vertex onto one of its neighbours, so every LOD is just
+// another index range over the vertices of the base mesh.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+#define MESH_LOD_RATIOS { 0.5f, 0.25f, 0.12f } // Triangles of LOD 1, 2 and 3 relative to the base mesh
+
+/**
+ * Simplifies the triangles in indices until at most targetIndexCount indices are left, or no
+ * collapse is possible. UV seams, borders and non-manifold edges are kept in place. Returns
+ * the largest collapse error, as a distance relative to the size of the mesh.
+ */
+f32 SimplifyMesh(const u32* indices, u32 indexCount, const float* positions, u32 positionStride, u32 vertexCount,
+	u32 targetIndexCount, std::vector<u32>& result);
+
+/**
+ * Appends the LODs of a submesh to its 32 bit indices, each one simplified from the previous
+ * to MESH_LOD_RATIOS of the base triangles and reordered for the vertex cache, and fills its
+ * LOD table. Stops early when a level no longer removes enough triangles.
+ */
+void GenerateSubmeshLods(Submesh& submesh);
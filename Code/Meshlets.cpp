@@ -0,0 +1,204 @@
+#include "Meshlets.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <float.h>
+
+namespace
+{
+	glm::vec3 GetTriangleNormal(const u32* triangle, const float* positions, u32 positionStride)
+	{
+		glm::vec3 p0 = glm::make_vec3(positions + triangle[0] * positionStride);
+		glm::vec3 p1 = glm::make_vec3(positions + triangle[1] * positionStride);
+		glm::vec3 p2 = glm::make_vec3(positions + triangle[2] * positionStride);
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		f32 area = glm::length(normal);
+		return area > 0.0f ? normal / area : glm::vec3(0.0f);
+	}
+}
+
+void BuildMeshlets(const u32* indices, u32 indexCount, const float* positions, u32 positionStride, u32 vertexCount,
+	std::vector<u32>& result, std::vector<Meshlet>& meshlets)
+{
+	const u32 triangleCount = indexCount / 3;
+	result.clear();
+	result.reserve(triangleCount * 3);
+	meshlets.clear();
+
+	// Triangles around each vertex
+	std::vector<u32> adjacencyOffsets(vertexCount + 1, 0), adjacency(triangleCount * 3);
+	for (u32 i = 0; i < triangleCount * 3; ++i)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (u32 v = 0; v < vertexCount; ++v)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	std::vector<u32> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (u32 i = 0; i < triangleCount * 3; ++i)
+		adjacency[cursor[indices[i]]++] = i / 3;
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<u32> vertexMeshlet(vertexCount, UINT32_MAX); // Last meshlet that used the vertex
+	std::vector<u32> meshletVertices;
+	u32 nextSeed = 0;
+
+	while (true)
+	{
+		// New meshlets start from the first triangle left in the optimized order
+		while (nextSeed < triangleCount && emitted[nextSeed])
+			nextSeed++;
+		if (nextSeed == triangleCount)
+			break;
+
+		const u32 meshletIdx = (u32)meshlets.size();
+		Meshlet meshlet = {};
+		meshlet.firstIndex = (u32)result.size();
+		meshletVertices.clear();
+		glm::vec3 normalSum(0.0f);
+
+		u32 triangle = nextSeed;
+		while (triangle != UINT32_MAX)
+		{
+			const u32* corners = indices + triangle * 3;
+			for (u32 k = 0; k < 3; ++k)
+			{
+				if (vertexMeshlet[corners[k]] != meshletIdx)
+				{
+					vertexMeshlet[corners[k]] = meshletIdx;
+					meshletVertices.push_back(corners[k]);
+				}
+				result.push_back(corners[k]);
+			}
+			emitted[triangle] = true;
+			meshlet.indexCount += 3;
+			normalSum += GetTriangleNormal(corners, positions, positionStride);
+
+			if (meshlet.indexCount / 3 == MESHLET_MAX_TRIANGLES)
+				break;
+
+			// Next, the neighbour that adds the fewest vertices, then the one closest to the average normal
+			const glm::vec3 averageNormal = glm::length(normalSum) > 0.0f ? glm::normalize(normalSum) : glm::vec3(0.0f);
+			u32 bestTriangle = UINT32_MAX;
+			u32 bestNewVertices = 4;
+			f32 bestDot = -FLT_MAX;
+			for (u32 vertex : meshletVertices)
+			{
+				for (u32 j = adjacencyOffsets[vertex]; j < adjacencyOffsets[vertex + 1]; ++j)
+				{
+					const u32 candidate = adjacency[j];
+					if (emitted[candidate])
+						continue;
+
+					const u32* candidateCorners = indices + candidate * 3;
+					u32 newVertices = 0;
+					for (u32 k = 0; k < 3; ++k)
+					{
+						const bool repeated = (k > 0 && candidateCorners[0] == candidateCorners[k]) || (k > 1 && candidateCorners[1] == candidateCorners[k]);
+						newVertices += vertexMeshlet[candidateCorners[k]] != meshletIdx && !repeated ? 1 : 0;
+					}
+					if (meshletVertices.size() + newVertices > MESHLET_MAX_VERTICES || newVertices > bestNewVertices)
+						continue;
+
+					f32 dot = glm::dot(GetTriangleNormal(candidateCorners, positions, positionStride), averageNormal);
+					if (newVertices < bestNewVertices || dot > bestDot)
+					{
+						bestTriangle = candidate;
+						bestNewVertices = newVertices;
+						bestDot = dot;
+					}
+				}
+			}
+			triangle = bestTriangle;
+		}
+
+		meshlets.push_back(meshlet);
+	}
+
+	for (Meshlet& meshlet : meshlets)
+		ComputeMeshletBounds(result.data(), positions, positionStride, meshlet);
+}
+
+void ComputeMeshletBounds(const u32* indices, const float* positions, u32 positionStride, Meshlet& meshlet)
+{
+	auto position = [&](u32 v) { return glm::make_vec3(positions + v * positionStride); };
+	const u32* triangles = indices + meshlet.firstIndex;
+
+	// Sphere around the center of the bounds, loose but cheap and never too small
+	glm::vec3 boundsMin(FLT_MAX), boundsMax(-FLT_MAX);
+	for (u32 i = 0; i < meshlet.indexCount; ++i)
+	{
+		boundsMin = glm::min(boundsMin, position(triangles[i]));
+		boundsMax = glm::max(boundsMax, position(triangles[i]));
+	}
+
+	meshlet.center = 0.5f * (boundsMin + boundsMax);
+	meshlet.radius = 0.0f;
+	for (u32 i = 0; i < meshlet.indexCount; ++i)
+		meshlet.radius = glm::max(meshlet.radius, glm::length(position(triangles[i]) - meshlet.center));
+
+	// Cone around the average normal that contains every triangle normal
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.indexCount / 3);
+	glm::vec3 normalSum(0.0f);
+	for (u32 i = 0; i < meshlet.indexCount; i += 3)
+	{
+		glm::vec3 p0 = position(triangles[i]), p1 = position(triangles[i + 1]), p2 = position(triangles[i + 2]);
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		f32 area = glm::length(normal);
+		if (area <= 0.0f)
+			continue;
+
+		normals.push_back(normal / area);
+		normalSum += normals.back();
+	}
+
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 1.0f;
+
+	const f32 axisLength = glm::length(normalSum);
+	if (axisLength <= 1e-6f)
+		return;
+
+	meshlet.coneAxis = normalSum / axisLength;
+	f32 minDot = 1.0f;
+	for (const glm::vec3& normal : normals)
+		minDot = glm::min(minDot, glm::dot(normal, meshlet.coneAxis));
+
+	// Past about 85 degrees the cone is so wide it would almost never cull anything
+	if (minDot > 0.1f)
+		meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+void BuildSubmeshMeshlets(Submesh& submesh)
+{
+	submesh.meshlets.clear();
+
+	const u32 floatStride = submesh.vertexBufferLayout.stride / sizeof(float);
+	i32 positionOffset = -1;
+	for (const VertexBufferAttribute& attribute : submesh.vertexBufferLayout.attributes)
+	{
+		if (attribute.location == 0)
+			positionOffset = attribute.offset / sizeof(float);
+	}
+	if (positionOffset < 0 || floatStride == 0 || submesh.lodCount == 0)
+		return;
+
+	const u32 vertexCount = (u32)(submesh.vertices.size() / floatStride);
+	const SubmeshLod& lod = submesh.lods[0];
+	std::vector<u32> reordered;
+	BuildMeshlets(submesh.indices.data() + lod.firstIndex, lod.indexCount, submesh.vertices.data() + positionOffset, floatStride,
+		vertexCount, reordered, submesh.meshlets);
+
+	// Growing by neighbours loses some of the vertex cache order, sort the triangles of each meshlet again
+	std::vector<u32> meshletIndices, clusterStarts;
+	for (const Meshlet& meshlet : submesh.meshlets)
+	{
+		OptimizeVertexCache(reordered.data() + meshlet.firstIndex, meshlet.indexCount, vertexCount, MESH_OPTIMIZER_CACHE_SIZE, meshletIndices, clusterStarts);
+		std::copy(meshletIndices.begin(), meshletIndices.end(), reordered.begin() + meshlet.firstIndex);
+	}
+
+	// LOD 0 is drawn in meshlet order, culled or not
+	std::copy(reordered.begin(), reordered.end(), submesh.indices.begin() + lod.firstIndex);
+	for (Meshlet& meshlet : submesh.meshlets)
+		meshlet.firstIndex += lod.firstIndex;
+
+	ComputeVertexCacheStats(submesh.indices.data() + lod.firstIndex, lod.indexCount, vertexCount,
+		submesh.cacheStats.acmrAfter, submesh.cacheStats.atvrAfter);
+}
@@ -0,0 +1,29 @@
+//
+// Meshlets.h: Splits the base LOD of a submesh into small clusters of triangles, each with a
+// bounding sphere and a cone around its normals. The base LOD is rewritten in meshlet order, so
+// every meshlet is a contiguous index range the GPU culling pass copies as a whole or skips.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+/**
+ * Grows each meshlet from the first triangle left in the current order, adding the neighbour
+ * that brings the fewest new vertices and, among those, the one closest to its average normal.
+ * Meshlets close at MESHLET_MAX_VERTICES vertices or MESHLET_MAX_TRIANGLES triangles. result
+ * receives the indices in meshlet order, firstIndex of the meshlets is relative to it.
+ */
+void BuildMeshlets(const u32* indices, u32 indexCount, const float* positions, u32 positionStride, u32 vertexCount,
+	std::vector<u32>& result, std::vector<Meshlet>& meshlets);
+
+// Bounding sphere and normal cone of the triangles indices[firstIndex, firstIndex + indexCount)
+void ComputeMeshletBounds(const u32* indices, const float* positions, u32 positionStride, Meshlet& meshlet);
+
+// Meshlets of LOD 0, from the float vertices and 32 bit indices of a submesh before it is packed.
+// Reorders the indices of LOD 0 and updates the cache stats of the final order.
+void BuildSubmeshMeshlets(Submesh& submesh);
@@ -3,10 +3,69 @@
 #include "platform.h"
 #include "Buffers.h"
 
+#define MESH_MAX_LODS 4
+
+// Node of the scene tree of an imported file
+struct ModelNode
+{
+	std::string name;
+	u32 parent;          // UINT32_MAX for the root, parents always come before their children
+	glm::mat4 transform; // Relative to the parent
+};
+
+// A submesh placed by a node. Submeshes placed by several nodes share their geometry.
+struct SubmeshInstance
+{
+	u32 submesh;
+	u32 node;
+};
+
+// Model space transforms of the instances of a submesh, in the node instance buffer of the app
+struct NodeInstanceRange
+{
+	u32 first;
+	u32 count;
+};
+
 struct Model
 {
 	u32 meshIdx;
 	std::vector<u32> materialIdx;
+	u32 impostorIdx = UINT32_MAX; // Baked once the model and its textures are loaded
+
+	// Node tree and the instances of every submesh, empty when the import flattened the
+	// tree into the vertices. Each submesh is then drawn once, with the identity transform.
+	std::vector<ModelNode> nodes;
+	std::vector<NodeInstanceRange> submeshInstances;
+};
+
+// Post-transform vertex cache efficiency of the index order, see MeshOptimizer.h
+struct VertexCacheStats
+{
+	f32 acmrBefore;
+	f32 acmrAfter;
+	f32 atvrBefore;
+	f32 atvrAfter;
+};
+
+// One level of detail, an index range inside the index range of its submesh
+struct SubmeshLod
+{
+	u32 firstIndex;
+	u32 indexCount;
+	f32 error; // Largest collapse error, relative to the size of the mesh
+};
+
+// Cluster of LOD 0 triangles, see Meshlets.h. Same layout as the Meshlet of meshletCulling.glsl
+struct Meshlet
+{
+	glm::vec3 center; // Bounding sphere in model space
+	f32 radius;
+	glm::vec3 coneAxis;
+	f32 coneCutoff;   // Sine of the cone half angle, 1 when the normals are too spread to cull
+	u32 firstIndex;   // Relative to the first index of the submesh
+	u32 indexCount;
+	u32 padding[2];
 };
 
 struct Submesh
@@ -14,16 +73,70 @@ struct Submesh
 	VertexBufferLayout vertexBufferLayout;
 	std::vector<float> vertices;
 	std::vector<u32> indices;
-	u32 vertexOffset;
-	u32 indexOffset;
-	std::vector<Vao> vaos;
+	u32 vertexOffset; // In bytes, relative to the packed vertex blob
+	u32 vertexCount;
+	u32 indexOffset;  // In bytes, relative to the packed index blob
+	u32 indexCount;   // Every LOD included
+	u8 indexSize; // 2 or 4 bytes
+	VertexCacheStats cacheStats;
+
+	// LOD 0 is the full mesh, the others follow it in the same index range
+	u32 lodCount;
+	SubmeshLod lods[MESH_MAX_LODS];
+
+	// Ranges in the geometry arena once uploaded
+	u32 vertexAllocation = UINT32_MAX;
+	u32 indexAllocation = UINT32_MAX;
+
+	// Filled by the importer, moved into the meshlet buffer of the app once uploaded
+	std::vector<Meshlet> meshlets;
+	u32 firstMeshlet;
+	u32 meshletCount;
+};
+
+// What stays on the CPU once a mesh is in the geometry arena, see GeometryResidency.h
+enum GeometryResidency
+{
+	GeometryResidency_Discard = 0, // Nothing, CPU queries fail
+	GeometryResidency_Keep,        // The packed vertex and index blobs stay in memory
+	GeometryResidency_Mapped,      // The blobs are mapped from the mesh cache while queried
+	GeometryResidency_Count
+};
+
+struct MeshGeometrySource
+{
+	GeometryResidency residency;
+	std::string cachePath;
+	u64 sourceTimestamp;
+	u32 importFlags;
+	u32 vertexFormat;
+
+	std::vector<u8> vertexData; // GeometryResidency_Keep
+	std::vector<u8> indexData;
+	MappedFile cacheFile;       // GeometryResidency_Mapped, while acquired
+	u32 acquireCount;
 };
 
 struct Mesh
 {
 	std::vector<Submesh> submeshes;
-	u32 vertexBufferHandle;
-	u32 indexBufferHandle;
+	MeshGeometrySource geometrySource;
+
+	glm::vec3 aabbMin;
+	glm::vec3 aabbMax;
+
+	// Quantized positions are decoded as position * positionScale + positionOffset
+	glm::vec3 positionScale;
+	glm::vec3 positionOffset;
+
+	bool isLoaded; // False while the import is still running on a worker
+};
+
+// Array and layer a material texture sits in when textures are pooled, see TextureArrays.h
+struct MaterialTextureLayer
+{
+	u32 pool;
+	u32 layer;
 };
 
 struct Material
@@ -35,8 +148,40 @@ struct Material
 	u32 albedoTextureIdx;
 	u32 emissiveTextureIdx;
 	u32 specularTextureIdx;
-	u32 normalsTextureIdx;
-	u32 bumpTextureIdx;
+	u32 ormTextureIdx;          // Packed occlusion/roughness/metallic
+	u32 normalHeightTextureIdx; // Packed normal in rgb, height in alpha
+
+	// Parallax occlusion of the relief shader
+	f32 bumpiness;
+	f32 minLayers;
+	f32 maxLayers;
+
+	// What the mesh shader samples with texture arrays, the placeholders' while loading
+	MaterialTextureLayer albedoLayer;
+	MaterialTextureLayer ormLayer;
+};
+
+// Material as it comes out of the importer, before its textures are loaded.
+// Texture paths are relative to the directory of the model.
+struct MaterialDesc
+{
+	std::string name;
+	glm::vec3 albedo;
+	glm::vec3 emissive;
+	f32 smoothness;
+	std::string albedoTexture;
+	std::string emissiveTexture;
+	std::string specularTexture;
+	std::string normalsTexture;
+	std::string bumpTexture;
+	std::string roughnessTexture;
+	std::string metallicTexture;
+	std::string occlusionTexture;
+
+	// Channel each scalar map is read from, glTF keeps roughness in green and metallic in blue
+	u8 occlusionChannel;
+	u8 roughnessChannel;
+	u8 metallicChannel;
 };
 
 struct Entity
@@ -60,6 +205,9 @@ struct Entity
 
 	glm::mat4 worldMatrix;
 	u32 modelIndex;
+	u32 lod; // Chosen by projected size, kept until the size is clearly past a threshold
+	bool isImpostor; // Beyond the impostor distance this frame, drawn as a quad
+	u32 localParamsBuffer; // Uniform ring page the block was written to this frame
 	u32 localParamsOffset;
 	u32 localParamsSize;
 
@@ -68,13 +216,9 @@ struct Entity
 	glm::vec3 scale;
 
 	u32 textureIdx;
-	u32 normalIdx;
-	u32 bumpIdx;
+	u32 normalHeightIdx; // Normal in rgb, height in alpha
 
-	// Relief options
-	float bumpiness;
-	float minLayers;
-	float maxLayers;
+	u32 reliefMaterialIdx; // Owns the relief parameters, the textures are the entity's
 
 	bool hasRelief;
 };
\ No newline at end of file
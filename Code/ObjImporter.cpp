@@ -0,0 +1,743 @@
+#include "ObjImporter.h"
+#include "GeometryImport.h"
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define OBJ_USE_SSE2 1
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define OBJ_USE_SSE2 0
+#endif
+
+namespace
+{
+	// Face corner as written in the file: position, texture coordinate and normal
+	struct ObjCorner
+	{
+		i32 indices[3]; // 0 based, -1 when the corner doesn't have it
+		u32 relative;   // Bit k set while indices[k] still counts from the start of its chunk
+	};
+
+	struct ObjMaterialRun
+	{
+		u32 firstCorner;
+		u32 material; // Into ObjChunk::materialNames, then into the model materials
+	};
+
+	struct ObjChunk
+	{
+		const char* begin;
+		const char* end;
+
+		std::vector<glm::vec3> positions;
+		std::vector<glm::vec2> texCoords;
+		std::vector<glm::vec3> normals;
+		std::vector<ObjCorner> corners; // Faces are triangulated as fans
+		std::vector<ObjMaterialRun> materialRuns;
+		std::vector<std::string> materialNames;
+		std::vector<std::string> materialLibraries;
+	};
+
+	// Triangles of one material, gathered from every chunk
+	struct ObjSubmeshSource
+	{
+		u32 material;
+		std::vector<const ObjCorner*> corners;
+	};
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	const char* SkipSpaces(const char* text, const char* end)
+	{
+		while (text < end && IsSpace(*text))
+			++text;
+		return text;
+	}
+
+	std::string TrimmedString(const char* text, const char* end)
+	{
+		text = SkipSpaces(text, end);
+		while (end > text && IsSpace(end[-1]))
+			--end;
+		return std::string(text, end);
+	}
+
+	// The rest of the line after keyword, or NULL when the line starts with something else
+	const char* MatchKeyword(const char* text, const char* end, const char* keyword)
+	{
+		size_t length = strlen(keyword);
+		if ((size_t)(end - text) <= length || memcmp(text, keyword, length) != 0 || !IsSpace(text[length]))
+			return nullptr;
+		return text + length;
+	}
+
+	const char* FindLineEnd(const char* text, const char* end)
+	{
+#if OBJ_USE_SSE2
+		const __m128i newline = _mm_set1_epi8('\n');
+		while (end - text >= 16)
+		{
+			u32 mask = (u32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)text), newline));
+			if (mask != 0)
+			{
+#if defined(_MSC_VER)
+				unsigned long bit;
+				_BitScanForward(&bit, mask);
+				return text + bit;
+#else
+				return text + __builtin_ctz(mask);
+#endif
+			}
+			text += 16;
+		}
+#endif
+		const char* lineEnd = (const char*)memchr(text, '\n', end - text);
+		return lineEnd ? lineEnd : end;
+	}
+
+	// Eight ASCII digits read as a little endian u64 (SWAR, one multiply per halving)
+	bool IsEightDigits(u64 chunk)
+	{
+		return ((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+	}
+
+	u32 ParseEightDigits(u64 chunk)
+	{
+		chunk = ((chunk & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+		chunk = ((chunk & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+		return (u32)(((chunk & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32);
+	}
+
+	// Appends digits to mantissa while it can hold them, the ones that don't fit are only counted
+	const char* ParseDigits(const char* text, const char* end, u64& mantissa, u32& digitCount, u32& droppedCount)
+	{
+		while (end - text >= 8 && digitCount + 8 <= 19)
+		{
+			u64 chunk;
+			memcpy(&chunk, text, sizeof(chunk));
+			if (!IsEightDigits(chunk))
+				break;
+
+			mantissa = mantissa * 100000000ull + ParseEightDigits(chunk);
+			digitCount += 8;
+			text += 8;
+		}
+
+		while (text < end && IsDigit(*text))
+		{
+			if (digitCount < 19)
+			{
+				mantissa = mantissa * 10 + (u64)(*text - '0');
+				digitCount += mantissa != 0 ? 1 : 0; // Leading zeros don't use up precision
+			}
+			else
+			{
+				droppedCount++;
+			}
+			++text;
+		}
+		return text;
+	}
+
+	const char* ParseInt(const char* text, const char* end, i32& value)
+	{
+		bool negative = text < end && *text == '-';
+		const char* digits = text < end && (*text == '-' || *text == '+') ? text + 1 : text;
+
+		i64 result = 0;
+		const char* cursor = digits;
+		while (cursor < end && IsDigit(*cursor) && result < INT32_MAX)
+			result = result * 10 + (*cursor++ - '0');
+
+		if (cursor == digits)
+			return text;
+
+		value = (i32)(negative ? -result : result);
+		return cursor;
+	}
+
+	// Parses up to count floats separated by spaces, the ones missing are left untouched
+	void ParseFloats(const char* text, const char* end, f32* values, u32 count)
+	{
+		for (u32 i = 0; i < count; ++i)
+		{
+			text = SkipSpaces(text, end);
+			const char* next = ParseObjFloat(text, end, values[i]);
+			if (next == text)
+				return;
+			text = next;
+		}
+	}
+
+	void ParseObjFace(const char* text, const char* end, ObjChunk& chunk)
+	{
+		const i32 localCounts[3] = { (i32)chunk.positions.size(), (i32)chunk.texCoords.size(), (i32)chunk.normals.size() };
+
+		ObjCorner first = {}, previous = {};
+		u32 cornerCount = 0;
+		text = SkipSpaces(text, end);
+		while (text < end)
+		{
+			const char* cornerStart = text;
+			ObjCorner corner = { { -1, -1, -1 }, 0 };
+			for (u32 k = 0; k < 3; ++k)
+			{
+				if (k > 0)
+				{
+					if (text == end || *text != '/')
+						break;
+					++text;
+				}
+
+				i32 index = 0;
+				text = ParseInt(text, end, index);
+				if (index > 0)
+				{
+					corner.indices[k] = index - 1;
+				}
+				else if (index < 0)
+				{
+					corner.indices[k] = localCounts[k] + index;
+					corner.relative |= 1u << k;
+				}
+			}
+
+			// Anything but a corner ends the face
+			if (text == cornerStart)
+				break;
+			text = SkipSpaces(text, end);
+
+			if (cornerCount == 0)
+			{
+				first = corner;
+			}
+			else if (cornerCount >= 2)
+			{
+				chunk.corners.push_back(first);
+				chunk.corners.push_back(previous);
+				chunk.corners.push_back(corner);
+			}
+			previous = corner;
+			cornerCount++;
+		}
+	}
+
+	void ParseObjLine(const char* text, const char* end, ObjChunk& chunk)
+	{
+		text = SkipSpaces(text, end);
+		if (end - text < 2)
+			return;
+
+		const char* rest = nullptr;
+		if (text[0] == 'v' && IsSpace(text[1]))
+		{
+			glm::vec3 position(0.0f);
+			ParseFloats(text + 2, end, &position.x, 3);
+			chunk.positions.push_back(position);
+		}
+		else if (text[0] == 'v' && text[1] == 't')
+		{
+			glm::vec2 texCoord(0.0f);
+			ParseFloats(text + 2, end, &texCoord.x, 2);
+			chunk.texCoords.push_back(texCoord);
+		}
+		else if (text[0] == 'v' && text[1] == 'n')
+		{
+			glm::vec3 normal(0.0f);
+			ParseFloats(text + 2, end, &normal.x, 3);
+			chunk.normals.push_back(normal);
+		}
+		else if (text[0] == 'f' && IsSpace(text[1]))
+		{
+			ParseObjFace(text + 2, end, chunk);
+		}
+		else if ((rest = MatchKeyword(text, end, "usemtl")) != nullptr)
+		{
+			std::string name = TrimmedString(rest, end);
+			u32 material = 0;
+			while (material < chunk.materialNames.size() && chunk.materialNames[material] != name)
+				material++;
+			if (material == chunk.materialNames.size())
+				chunk.materialNames.push_back(name);
+
+			chunk.materialRuns.push_back(ObjMaterialRun{ (u32)chunk.corners.size(), material });
+		}
+		else if ((rest = MatchKeyword(text, end, "mtllib")) != nullptr)
+		{
+			chunk.materialLibraries.push_back(TrimmedString(rest, end));
+		}
+		// Groups, objects, smoothing groups, lines and points don't change the submeshes
+	}
+
+	void ParseObjChunk(ObjChunk& chunk)
+	{
+		const char* line = chunk.begin;
+		while (line < chunk.end)
+		{
+			const char* lineEnd = FindLineEnd(line, chunk.end);
+			ParseObjLine(line, lineEnd, chunk);
+			line = lineEnd + 1;
+		}
+	}
+
+	// Runs body(i) for every i in [0, count) on up to threadCount threads, the calling one included
+	template <typename Body>
+	void ParallelFor(u32 count, u32 threadCount, const Body& body)
+	{
+		std::atomic<u32> next{ 0 };
+		auto work = [&]()
+		{
+			for (u32 i = next++; i < count; i = next++)
+				body(i);
+		};
+
+		std::vector<std::thread> threads;
+		for (u32 t = 1; t < glm::min(threadCount, count); ++t)
+			threads.emplace_back(work);
+		work();
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	MaterialDesc MakeDefaultObjMaterial(const std::string& name)
+	{
+		// Same defaults Assimp gives OBJ materials
+		MaterialDesc material = {};
+		material.name = name;
+		material.albedo = glm::vec3(0.6f);
+		return material;
+	}
+
+	// Texture statements may carry options before the filename, like -bm 1.0
+	std::string GetMtlTextureFilename(const char* text, const char* end)
+	{
+		std::string arguments = TrimmedString(text, end);
+		size_t separator = arguments.find_last_of(" \t");
+		return separator == std::string::npos ? arguments : arguments.substr(separator + 1);
+	}
+
+	// Same texture slots the Assimp OBJ importer fills, see ProcessAssimpMaterial
+	void ParseMtl(const char* text, const char* end, std::vector<MaterialDesc>& materials)
+	{
+		MaterialDesc* material = nullptr;
+		while (text < end)
+		{
+			const char* lineEnd = FindLineEnd(text, end);
+			const char* line = SkipSpaces(text, lineEnd);
+			text = lineEnd + 1;
+
+			const char* rest = nullptr;
+			if ((rest = MatchKeyword(line, lineEnd, "newmtl")) != nullptr)
+			{
+				materials.push_back(MakeDefaultObjMaterial(TrimmedString(rest, lineEnd)));
+				material = &materials.back();
+			}
+			else if (!material)
+			{
+				continue;
+			}
+			else if ((rest = MatchKeyword(line, lineEnd, "Kd")) != nullptr)
+			{
+				ParseFloats(rest, lineEnd, &material->albedo.x, 3);
+			}
+			else if ((rest = MatchKeyword(line, lineEnd, "Ke")) != nullptr)
+			{
+				ParseFloats(rest, lineEnd, &material->emissive.x, 3);
+			}
+			else if ((rest = MatchKeyword(line, lineEnd, "Ns")) != nullptr)
+			{
+				f32 shininess = 0.0f;
+				ParseFloats(rest, lineEnd, &shininess, 1);
+				material->smoothness = shininess / 256.0f;
+			}
+			else if ((rest = MatchKeyword(line, lineEnd, "map_Kd")) != nullptr)
+				material->albedoTexture = GetMtlTextureFilename(rest, lineEnd);
+			else if ((rest = MatchKeyword(line, lineEnd, "map_Ke")) != nullptr)
+				material->emissiveTexture = GetMtlTextureFilename(rest, lineEnd);
+			else if ((rest = MatchKeyword(line, lineEnd, "map_Ks")) != nullptr)
+				material->specularTexture = GetMtlTextureFilename(rest, lineEnd);
+			else if ((rest = MatchKeyword(line, lineEnd, "norm")) != nullptr || (rest = MatchKeyword(line, lineEnd, "map_Kn")) != nullptr)
+				material->normalsTexture = GetMtlTextureFilename(rest, lineEnd);
+			else if ((rest = MatchKeyword(line, lineEnd, "map_Bump")) != nullptr || (rest = MatchKeyword(line, lineEnd, "map_bump")) != nullptr ||
+				(rest = MatchKeyword(line, lineEnd, "bump")) != nullptr)
+				material->bumpTexture = GetMtlTextureFilename(rest, lineEnd);
+			else if ((rest = MatchKeyword(line, lineEnd, "map_Ns")) != nullptr)
+				material->roughnessTexture = GetMtlTextureFilename(rest, lineEnd);
+			else if ((rest = MatchKeyword(line, lineEnd, "map_refl")) != nullptr || (rest = MatchKeyword(line, lineEnd, "refl")) != nullptr)
+				material->metallicTexture = GetMtlTextureFilename(rest, lineEnd);
+			else if ((rest = MatchKeyword(line, lineEnd, "map_Ka")) != nullptr)
+				material->occlusionTexture = GetMtlTextureFilename(rest, lineEnd);
+		}
+	}
+
+	bool LoadMtl(const std::string& filepath, std::vector<MaterialDesc>& materials)
+	{
+		MappedFile file = MapFile(filepath.c_str());
+		if (!file.data)
+			return false;
+
+		ParseMtl((const char*)file.data, (const char*)file.data + file.size, materials);
+		UnmapFile(file);
+		return true;
+	}
+
+	u32 HashCorner(const ObjCorner& corner)
+	{
+		u32 hash = (u32)corner.indices[0] * 0x9E3779B1u;
+		hash = (hash ^ (u32)corner.indices[1]) * 0x85EBCA77u;
+		hash = (hash ^ (u32)corner.indices[2]) * 0xC2B2AE3Du;
+		return hash ^ (hash >> 16);
+	}
+
+	// Welds the corners of one material into an indexed submesh with the layout of ProcessAssimpMesh
+	void BuildObjSubmesh(const ObjSubmeshSource& source, const std::vector<glm::vec3>& positions,
+		const std::vector<glm::vec2>& texCoords, const std::vector<glm::vec3>& normals, Submesh& submesh)
+	{
+		bool hasTexCoords = false;
+		bool needsNormals = false;
+		for (const ObjCorner* corner : source.corners)
+		{
+			hasTexCoords |= corner->indices[1] >= 0;
+			needsNormals |= corner->indices[2] < 0;
+		}
+
+		// Open addressing table from the corner to its welded vertex
+		u32 tableSize = 1;
+		while (tableSize < source.corners.size() * 2)
+			tableSize <<= 1;
+		std::vector<u32> table(tableSize, UINT32_MAX);
+		std::vector<ObjCorner> uniqueCorners;
+		uniqueCorners.reserve(source.corners.size() / 2);
+
+		std::vector<u32> indices(source.corners.size());
+		for (u32 i = 0; i < source.corners.size(); ++i)
+		{
+			ObjCorner key = *source.corners[i];
+			key.relative = 0;
+			if (!hasTexCoords)
+				key.indices[1] = -1;
+
+			u32 slot = HashCorner(key) & (tableSize - 1);
+			while (table[slot] != UINT32_MAX && memcmp(uniqueCorners[table[slot]].indices, key.indices, sizeof(key.indices)) != 0)
+				slot = (slot + 1) & (tableSize - 1);
+
+			if (table[slot] == UINT32_MAX)
+			{
+				table[slot] = (u32)uniqueCorners.size();
+				uniqueCorners.push_back(key);
+			}
+			indices[i] = table[slot];
+		}
+
+		const u32 vertexCount = (u32)uniqueCorners.size();
+		std::vector<glm::vec3> vertexPositions(vertexCount), vertexNormals(vertexCount);
+		std::vector<glm::vec2> vertexTexCoords(hasTexCoords ? vertexCount : 0);
+		for (u32 v = 0; v < vertexCount; ++v)
+		{
+			const ObjCorner& corner = uniqueCorners[v];
+			vertexPositions[v] = positions[corner.indices[0]];
+			if (corner.indices[2] >= 0)
+			{
+				f32 length = glm::length(normals[corner.indices[2]]);
+				vertexNormals[v] = length > 0.0f ? normals[corner.indices[2]] / length : glm::vec3(0.0f, 1.0f, 0.0f);
+			}
+			if (hasTexCoords)
+				vertexTexCoords[v] = corner.indices[1] >= 0 ? texCoords[corner.indices[1]] : glm::vec2(0.0f);
+		}
+
+		// Corners without a normal take the average of the faces around their position, not only
+		// the ones sharing their texture coordinates
+		if (needsNormals)
+		{
+			std::vector<u32> positionIndices(source.corners.size());
+			for (u32 i = 0; i < source.corners.size(); ++i)
+				positionIndices[i] = (u32)source.corners[i]->indices[0];
+
+			std::vector<glm::vec3> smoothNormals(positions.size());
+			GenerateSmoothNormals(positionIndices.data(), (u32)positionIndices.size(), positions.data(), (u32)positions.size(), smoothNormals.data());
+			for (u32 v = 0; v < vertexCount; ++v)
+			{
+				if (uniqueCorners[v].indices[2] < 0)
+					vertexNormals[v] = smoothNormals[uniqueCorners[v].indices[0]];
+			}
+		}
+
+		std::vector<glm::vec3> tangents, bitangents;
+		if (hasTexCoords)
+		{
+			tangents.resize(vertexCount);
+			bitangents.resize(vertexCount);
+			GenerateTangentFrames(indices.data(), (u32)indices.size(), vertexPositions.data(), vertexNormals.data(),
+				vertexTexCoords.data(), vertexCount, tangents.data(), bitangents.data());
+		}
+
+		ImportedVertices vertices = {};
+		vertices.vertexCount = vertexCount;
+		vertices.positions = vertexPositions.data();
+		vertices.normals = vertexNormals.data();
+		vertices.texCoords = hasTexCoords ? vertexTexCoords.data() : nullptr;
+		vertices.tangents = hasTexCoords ? tangents.data() : nullptr;
+		vertices.bitangents = hasTexCoords ? bitangents.data() : nullptr;
+		BuildImportedSubmesh(vertices, indices, submesh);
+	}
+}
+
+const char* ParseObjFloat(const char* text, const char* end, f32& value)
+{
+	static const f64 powersOf10[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const char* start = text;
+	bool negative = text < end && *text == '-';
+	if (text < end && (*text == '-' || *text == '+'))
+		++text;
+
+	u64 mantissa = 0;
+	u32 digitCount = 0, droppedCount = 0;
+	const char* integerStart = text;
+	text = ParseDigits(text, end, mantissa, digitCount, droppedCount);
+	i32 exponent = (i32)droppedCount;
+	bool hasDigits = text != integerStart;
+
+	if (text < end && *text == '.')
+	{
+		const char* fractionStart = ++text;
+		u32 integerDropped = droppedCount;
+		text = ParseDigits(text, end, mantissa, digitCount, droppedCount);
+		hasDigits |= text != fractionStart;
+
+		// Every fraction digit that made it into the mantissa, leading zeros included, shifts it once
+		exponent -= (i32)((u32)(text - fractionStart) - (droppedCount - integerDropped));
+	}
+
+	if (!hasDigits)
+		return start;
+
+	if (text < end && (*text == 'e' || *text == 'E'))
+	{
+		i32 explicitExponent = 0;
+		const char* next = ParseInt(text + 1, end, explicitExponent);
+		if (next != text + 1)
+		{
+			exponent += explicitExponent;
+			text = next;
+		}
+	}
+
+	// Exact when the mantissa and the power of 10 are both exact doubles (Clinger's fast path)
+	if (mantissa <= (1ull << 53) && exponent >= -22 && exponent <= 22)
+	{
+		f64 result = (f64)mantissa;
+		result = exponent < 0 ? result / powersOf10[-exponent] : result * powersOf10[exponent];
+		value = (f32)(negative ? -result : result);
+		return text;
+	}
+
+	char buffer[64];
+	size_t length = glm::min((size_t)(text - start), sizeof(buffer) - 1);
+	memcpy(buffer, start, length);
+	buffer[length] = '\0';
+	value = (f32)strtod(buffer, nullptr);
+	return text;
+}
+
+bool ImportObj(const char* filename, Mesh& mesh, std::vector<u32>& submeshMaterials, std::vector<MaterialDesc>& materials,
+	ObjImportStats* stats)
+{
+	f64 startTime = GetElapsedMilliseconds();
+
+	MappedFile file = MapFile(filename);
+	if (!file.data)
+	{
+		ELOG("Error loading mesh %s: the file cannot be mapped", filename);
+		return false;
+	}
+
+	const char* data = (const char*)file.data;
+	const char* dataEnd = data + file.size;
+
+	// Chunks start after a line break, so no line is split between two of them
+	u32 threadCount = glm::max(std::thread::hardware_concurrency(), 1u);
+	u32 chunkCount = glm::clamp((u32)(file.size / OBJ_IMPORTER_MIN_CHUNK_SIZE), 1u, threadCount);
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* chunkBegin = data;
+	for (u32 i = 0; i < chunkCount; ++i)
+	{
+		const char* chunkEnd = dataEnd;
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = std::max(data + file.size * (i + 1) / chunkCount, chunkBegin);
+			chunkEnd = std::min(FindLineEnd(chunkEnd, dataEnd) + 1, dataEnd);
+		}
+		chunks[i].begin = chunkBegin;
+		chunks[i].end = chunkEnd;
+		chunkBegin = chunkEnd;
+	}
+
+	ParallelFor(chunkCount, chunkCount, [&](u32 i) { ParseObjChunk(chunks[i]); });
+
+	// Indices counting back from a corner become absolute once the chunks before are known
+	std::vector<glm::vec3> positions, normals;
+	std::vector<glm::vec2> texCoords;
+	std::vector<i32> bases(chunkCount * 3);
+	for (u32 i = 0; i < chunkCount; ++i)
+	{
+		bases[i * 3 + 0] = (i32)positions.size();
+		bases[i * 3 + 1] = (i32)texCoords.size();
+		bases[i * 3 + 2] = (i32)normals.size();
+		positions.insert(positions.end(), chunks[i].positions.begin(), chunks[i].positions.end());
+		texCoords.insert(texCoords.end(), chunks[i].texCoords.begin(), chunks[i].texCoords.end());
+		normals.insert(normals.end(), chunks[i].normals.begin(), chunks[i].normals.end());
+	}
+
+	const i32 counts[3] = { (i32)positions.size(), (i32)texCoords.size(), (i32)normals.size() };
+	std::atomic<bool> validIndices{ true };
+	ParallelFor(chunkCount, chunkCount, [&](u32 i)
+	{
+		for (ObjCorner& corner : chunks[i].corners)
+		{
+			for (u32 k = 0; k < 3; ++k)
+			{
+				if (corner.relative & (1u << k))
+					corner.indices[k] += bases[i * 3 + k];
+				if (corner.indices[k] >= counts[k] || (corner.indices[k] < 0 && (corner.relative & (1u << k))) || (k == 0 && corner.indices[0] < 0))
+					validIndices = false;
+			}
+			corner.relative = 0;
+		}
+	});
+
+	f64 parseTime = GetElapsedMilliseconds();
+	if (!validIndices)
+	{
+		ELOG("Error loading mesh %s: a face uses a vertex the file doesn't have", filename);
+		UnmapFile(file);
+		return false;
+	}
+
+	// Material libraries are looked up next to the .obj
+	std::string directory = filename;
+	size_t separator = directory.find_last_of("/\\");
+	directory = separator == std::string::npos ? std::string() : directory.substr(0, separator + 1);
+
+	materials.clear();
+	for (const ObjChunk& chunk : chunks)
+	{
+		for (const std::string& library : chunk.materialLibraries)
+		{
+			if (!LoadMtl(directory + library, materials))
+				ELOG("Cannot open material library %s%s", directory.c_str(), library.c_str());
+		}
+	}
+
+	auto findMaterial = [&](const std::string& name)
+	{
+		for (u32 i = 0; i < materials.size(); ++i)
+		{
+			if (materials[i].name == name)
+				return i;
+		}
+		return UINT32_MAX;
+	};
+
+	// Corners of each material in file order, faces before any usemtl or with an unknown one get the default
+	std::vector<ObjSubmeshSource> sources;
+	std::vector<u32> materialSources(materials.size(), UINT32_MAX);
+	u32 currentMaterial = UINT32_MAX;
+	for (const ObjChunk& chunk : chunks)
+	{
+		u32 run = 0;
+		auto applyMaterialRuns = [&](u32 corner)
+		{
+			while (run < chunk.materialRuns.size() && chunk.materialRuns[run].firstCorner <= corner)
+			{
+				currentMaterial = findMaterial(chunk.materialNames[chunk.materialRuns[run].material]);
+				run++;
+			}
+		};
+
+		for (u32 i = 0; i < chunk.corners.size(); i += 3)
+		{
+			applyMaterialRuns(i);
+
+			if (currentMaterial == UINT32_MAX)
+			{
+				currentMaterial = findMaterial("DefaultMaterial");
+				if (currentMaterial == UINT32_MAX)
+				{
+					currentMaterial = (u32)materials.size();
+					materials.push_back(MakeDefaultObjMaterial("DefaultMaterial"));
+					materialSources.push_back(UINT32_MAX);
+				}
+			}
+
+			if (materialSources[currentMaterial] == UINT32_MAX)
+			{
+				materialSources[currentMaterial] = (u32)sources.size();
+
+				ObjSubmeshSource source = {};
+				source.material = currentMaterial;
+				sources.push_back(std::move(source));
+			}
+
+			std::vector<const ObjCorner*>& corners = sources[materialSources[currentMaterial]].corners;
+			corners.insert(corners.end(), { &chunk.corners[i], &chunk.corners[i + 1], &chunk.corners[i + 2] });
+		}
+
+		// A usemtl after the last face of the chunk applies to the next one
+		applyMaterialRuns(UINT32_MAX);
+	}
+
+	// Materials are independent, each one is welded on its own thread
+	const u32 firstSubmesh = (u32)mesh.submeshes.size();
+	mesh.submeshes.resize(firstSubmesh + sources.size());
+	ParallelFor((u32)sources.size(), threadCount, [&](u32 i)
+	{
+		BuildObjSubmesh(sources[i], positions, texCoords, normals, mesh.submeshes[firstSubmesh + i]);
+	});
+
+	u32 cornerCount = 0, vertexCount = 0;
+	for (u32 i = 0; i < sources.size(); ++i)
+	{
+		submeshMaterials.push_back(sources[i].material);
+		cornerCount += (u32)sources[i].corners.size();
+		vertexCount += (u32)(mesh.submeshes[firstSubmesh + i].vertices.size() / (mesh.submeshes[firstSubmesh + i].vertexBufferLayout.stride / sizeof(float)));
+	}
+
+	UnmapFile(file);
+
+	if (stats)
+	{
+		stats->threadCount = chunkCount;
+		stats->cornerCount = cornerCount;
+		stats->vertexCount = vertexCount;
+		stats->parseMs = parseTime - startTime;
+		stats->buildMs = GetElapsedMilliseconds() - parseTime;
+	}
+
+	if (sources.empty())
+	{
+		ELOG("Error loading mesh %s: the file has no faces", filename);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,33 @@
+//
+// ObjImporter.h: Fast path for Wavefront .obj files and their .mtl libraries. The file is mapped
+// and cut into chunks at line boundaries that are parsed on their own threads, then every
+// material becomes one submesh with welded vertices, smooth normals where the file has none and
+// a tangent space. The submeshes have the same layout ProcessAssimpMesh produces.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+#define OBJ_IMPORTER_MIN_CHUNK_SIZE (256 * 1024) // Smaller files are parsed on the calling thread
+
+struct ObjImportStats
+{
+	u32 threadCount;
+	u32 cornerCount; // Triangle corners before welding
+	u32 vertexCount; // After welding
+	f64 parseMs;     // Mapping and parsing the chunks
+	f64 buildMs;     // Welding, normals and tangents
+};
+
+/**
+ * Imports an .obj file into one submesh per material, in the order the materials are first used.
+ * submeshMaterials receives the index in materials of every submesh. Materials come from the
+ * libraries the file names, plus "DefaultMaterial" for faces without a known one.
+ */
+bool ImportObj(const char* filename, Mesh& mesh, std::vector<u32>& submeshMaterials, std::vector<MaterialDesc>& materials,
+	ObjImportStats* stats = nullptr);
+
+// Parses a decimal float as written by exporters, fast for up to 19 significant digits
+const char* ParseObjFloat(const char* text, const char* end, f32& value);
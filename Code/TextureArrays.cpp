@@ -0,0 +1,126 @@
+#include "TextureArrays.h"
+#include "GLExtensions.h"
+
+namespace
+{
+	void SetArraySampling(GLenum target, u32 mipCount)
+	{
+		glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, mipCount - 1);
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	u32 CreateArrayStorage(const TextureArrayPool& pool, u32 layerCapacity)
+	{
+		GLuint handle;
+		glGenTextures(1, &handle);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, handle);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, pool.mipCount, GetTextureUploadInternalFormat(pool.format), pool.width, pool.height, layerCapacity);
+		SetArraySampling(GL_TEXTURE_2D_ARRAY, pool.mipCount);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		return handle;
+	}
+
+	// Array storage is immutable, growing means a new array and a GPU copy of every level
+	void GrowPool(TextureArrays& arrays, TextureArrayPool& pool)
+	{
+		const u32 layerCapacity = glm::min(pool.layerCapacity * 2, arrays.maxLayers);
+		const u32 handle = CreateArrayStorage(pool, layerCapacity);
+
+		const u32 layerCount = (u32)pool.layerOwners.size();
+		for (u32 level = 0; level < pool.mipCount; ++level)
+		{
+			const u32 width = glm::max(pool.width >> level, 1u);
+			const u32 height = glm::max(pool.height >> level, 1u);
+			glCopyImageSubData(pool.handle, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0,
+				handle, GL_TEXTURE_2D_ARRAY, level, 0, 0, 0, width, height, layerCount);
+		}
+
+		glDeleteTextures(1, &pool.handle);
+		pool.handle = handle;
+		pool.layerCapacity = layerCapacity;
+		arrays.growCount++;
+	}
+}
+
+TextureArraySlot AddTextureToArray(TextureArrays& arrays, TextureUploadRing& ring, TextureUpload& upload, u32 owner)
+{
+	if (arrays.maxLayers == 0)
+	{
+		GLint maxLayers = 0;
+		glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+		arrays.maxLayers = (u32)glm::max(maxLayers, 1);
+	}
+
+	TextureArraySlot slot = {};
+	slot.pool = TEXTURE_ARRAY_INVALID_POOL;
+	for (u32 i = 0; i < arrays.pools.size(); ++i)
+	{
+		const TextureArrayPool& pool = arrays.pools[i];
+		if (pool.format == upload.format && pool.width == upload.width && pool.height == upload.height &&
+			pool.mipCount == upload.mipCount && pool.layerOwners.size() < arrays.maxLayers)
+		{
+			slot.pool = i;
+			break;
+		}
+	}
+
+	if (slot.pool == TEXTURE_ARRAY_INVALID_POOL)
+	{
+		TextureArrayPool pool = {};
+		pool.format = upload.format;
+		pool.width = upload.width;
+		pool.height = upload.height;
+		pool.mipCount = upload.mipCount;
+		pool.layerCapacity = glm::min((u32)TEXTURE_ARRAY_INITIAL_LAYERS, arrays.maxLayers);
+		pool.handle = CreateArrayStorage(pool, pool.layerCapacity);
+		slot.pool = (u32)arrays.pools.size();
+		arrays.pools.push_back(pool);
+	}
+
+	TextureArrayPool& pool = arrays.pools[slot.pool];
+	if (pool.layerOwners.size() == pool.layerCapacity)
+	{
+		GrowPool(arrays, pool);
+		slot.grown = true;
+	}
+
+	slot.layer = (u32)pool.layerOwners.size();
+	pool.layerOwners.push_back(owner);
+	UploadTextureArrayLayer(ring, upload, pool.handle, slot.layer);
+	return slot;
+}
+
+u32 CreateTextureArrayLayerView(const TextureArrayPool& pool, u32 layer)
+{
+	GLuint view;
+	glGenTextures(1, &view);
+	glTextureView(view, GL_TEXTURE_2D, pool.handle, GetTextureUploadInternalFormat(pool.format), 0, pool.mipCount, layer, 1);
+	glBindTexture(GL_TEXTURE_2D, view);
+	SetArraySampling(GL_TEXTURE_2D, pool.mipCount);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return view;
+}
+
+u64 GetTextureArrayPoolSize(const TextureArrayPool& pool)
+{
+	u64 layerSize = 0;
+	for (u32 level = 0; level < pool.mipCount; ++level)
+	{
+		const u64 width = glm::max(pool.width >> level, 1u);
+		const u64 height = glm::max(pool.height >> level, 1u);
+		switch (pool.format)
+		{
+		case TextureUpload_RGB8:  layerSize += width * height * 3; break;
+		case TextureUpload_RGBA8: layerSize += width * height * 4; break;
+		case TextureUpload_BC1:
+		case TextureUpload_BC4:   layerSize += ((width + 3) / 4) * ((height + 3) / 4) * 8; break;
+		default:                  layerSize += ((width + 3) / 4) * ((height + 3) / 4) * 16; break;
+		}
+	}
+	return layerSize * pool.layerCapacity;
+}
@@ -0,0 +1,51 @@
+//
+// TextureArrays.h: Pools of array textures for batching. Textures with the same size, format
+// and mip count share a GL_TEXTURE_2D_ARRAY, so draws with different materials keep the same
+// textures bound and only change the layers they sample. Every layer also gets a 2D texture
+// view over the same storage, for the code that samples a texture on its own.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "TextureStreamer.h"
+
+#define TEXTURE_ARRAY_INITIAL_LAYERS 4
+#define TEXTURE_ARRAY_INVALID_POOL   UINT32_MAX
+
+struct TextureArrayPool
+{
+	u32 handle; // GL_TEXTURE_2D_ARRAY
+	TextureUploadFormat format;
+	u32 width;
+	u32 height;
+	u32 mipCount;
+	u32 layerCapacity;
+	std::vector<u32> layerOwners; // Id the caller gave each layer, in layer order
+};
+
+struct TextureArrays
+{
+	std::vector<TextureArrayPool> pools;
+	u32 maxLayers; // GL_MAX_ARRAY_TEXTURE_LAYERS, a full pool is followed by another one
+	u32 growCount; // Times a pool was reallocated with more layers
+};
+
+struct TextureArraySlot
+{
+	u32 pool;
+	u32 layer;
+	bool grown; // The storage of the pool was replaced, every view of it has to be recreated
+};
+
+/**
+ * GL thread. Copies the upload into a free layer of the pool matching its size, format and
+ * mip count. Pools are created on demand and double their layers when full, copying the
+ * layers they had on the GPU. owner identifies the layer in TextureArrayPool::layerOwners.
+ */
+TextureArraySlot AddTextureToArray(TextureArrays& arrays, TextureUploadRing& ring, TextureUpload& upload, u32 owner);
+
+// GL thread. 2D texture sharing the storage of one layer, with the same sampling as the pool.
+u32 CreateTextureArrayLayerView(const TextureArrayPool& pool, u32 layer);
+
+u64 GetTextureArrayPoolSize(const TextureArrayPool& pool);
@@ -0,0 +1,658 @@
+#include "TextureCooker.h"
+#include <thread>
+#include <float.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define COOKER_USE_SSE2 1
+#include <emmintrin.h>
+#else
+#define COOKER_USE_SSE2 0
+#endif
+
+namespace
+{
+	// 4x4 texels in structure of arrays form, values in [0, 255]
+	struct Block
+	{
+		alignas(16) float r[16];
+		alignas(16) float g[16];
+		alignas(16) float b[16];
+		alignas(16) float a[16];
+	};
+
+	struct MipImage
+	{
+		u32 width;
+		u32 height;
+		std::vector<u8> rgba;
+	};
+
+	u64 AlignOffset(u64 value, u64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	void FetchBlock(const MipImage& mip, u32 blockX, u32 blockY, Block& block)
+	{
+		for (u32 y = 0; y < 4; ++y)
+		{
+			// Mips smaller than a block repeat their last row/column
+			u32 py = glm::min(blockY * 4 + y, mip.height - 1);
+			for (u32 x = 0; x < 4; ++x)
+			{
+				u32 px = glm::min(blockX * 4 + x, mip.width - 1);
+				const u8* texel = &mip.rgba[(py * mip.width + px) * 4];
+				u32 i = y * 4 + x;
+				block.r[i] = texel[0];
+				block.g[i] = texel[1];
+				block.b[i] = texel[2];
+				block.a[i] = texel[3];
+			}
+		}
+	}
+
+	void MinMax16(const float* values, float& minValue, float& maxValue)
+	{
+#if COOKER_USE_SSE2
+		__m128 v0 = _mm_load_ps(values + 0);
+		__m128 v1 = _mm_load_ps(values + 4);
+		__m128 v2 = _mm_load_ps(values + 8);
+		__m128 v3 = _mm_load_ps(values + 12);
+		__m128 vmin = _mm_min_ps(_mm_min_ps(v0, v1), _mm_min_ps(v2, v3));
+		__m128 vmax = _mm_max_ps(_mm_max_ps(v0, v1), _mm_max_ps(v2, v3));
+		vmin = _mm_min_ps(vmin, _mm_shuffle_ps(vmin, vmin, _MM_SHUFFLE(1, 0, 3, 2)));
+		vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(1, 0, 3, 2)));
+		vmin = _mm_min_ps(vmin, _mm_shuffle_ps(vmin, vmin, _MM_SHUFFLE(2, 3, 0, 1)));
+		vmax = _mm_max_ps(vmax, _mm_shuffle_ps(vmax, vmax, _MM_SHUFFLE(2, 3, 0, 1)));
+		minValue = _mm_cvtss_f32(vmin);
+		maxValue = _mm_cvtss_f32(vmax);
+#else
+		minValue = values[0];
+		maxValue = values[0];
+		for (u32 i = 1; i < 16; ++i)
+		{
+			minValue = glm::min(minValue, values[i]);
+			maxValue = glm::max(maxValue, values[i]);
+		}
+#endif
+	}
+
+	u16 PackRGB565(const glm::vec3& color)
+	{
+		u32 r = (u32)glm::clamp(color.r * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+		u32 g = (u32)glm::clamp(color.g * 63.0f / 255.0f + 0.5f, 0.0f, 63.0f);
+		u32 b = (u32)glm::clamp(color.b * 31.0f / 255.0f + 0.5f, 0.0f, 31.0f);
+		return (u16)((r << 11) | (g << 5) | b);
+	}
+
+	glm::vec3 UnpackRGB565(u16 packed)
+	{
+		u32 r = (packed >> 11) & 31;
+		u32 g = (packed >> 5) & 63;
+		u32 b = packed & 31;
+		return glm::vec3((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2));
+	}
+
+	void EncodeBC1(const Block& block, u8* output)
+	{
+		glm::vec3 minColor, maxColor;
+		MinMax16(block.r, minColor.r, maxColor.r);
+		MinMax16(block.g, minColor.g, maxColor.g);
+		MinMax16(block.b, minColor.b, maxColor.b);
+
+		// The bounding box diagonal goes from min to max on every channel. Flip the channels
+		// that are anti-correlated with the widest one so the diagonal follows the colors.
+		glm::vec3 range = maxColor - minColor;
+		u32 mainChannel = range.r >= range.g && range.r >= range.b ? 0 : (range.g >= range.b ? 1 : 2);
+		const float* channels[3] = { block.r, block.g, block.b };
+		glm::vec3 mean = (minColor + maxColor) * 0.5f;
+		for (u32 c = 0; c < 3; ++c)
+		{
+			if (c == mainChannel)
+				continue;
+
+			float covariance = 0.0f;
+			for (u32 i = 0; i < 16; ++i)
+				covariance += (channels[mainChannel][i] - mean[mainChannel]) * (channels[c][i] - mean[c]);
+
+			if (covariance < 0.0f)
+				std::swap(minColor[c], maxColor[c]);
+		}
+
+		// Inset the endpoints a bit, extremes are rarely worth a full palette entry
+		glm::vec3 inset = (maxColor - minColor) / 16.0f;
+		u16 color0 = PackRGB565(maxColor - inset);
+		u16 color1 = PackRGB565(minColor + inset);
+
+		u32 indices = 0;
+		if (color0 != color1)
+		{
+			glm::vec3 endpoint0 = UnpackRGB565(color0);
+			glm::vec3 endpoint1 = UnpackRGB565(color1);
+			glm::vec3 direction = endpoint1 - endpoint0;
+			float scale = 3.0f / glm::max(glm::dot(direction, direction), 1.0f);
+
+			// Position along the palette line (0 = color0, 3 = color1) to BC1 index
+			static const u32 paletteOrder[4] = { 0, 2, 3, 1 };
+			alignas(16) i32 steps[16];
+
+#if COOKER_USE_SSE2
+			const __m128 dirR = _mm_set1_ps(direction.r * scale);
+			const __m128 dirG = _mm_set1_ps(direction.g * scale);
+			const __m128 dirB = _mm_set1_ps(direction.b * scale);
+			const __m128 e0R = _mm_set1_ps(endpoint0.r);
+			const __m128 e0G = _mm_set1_ps(endpoint0.g);
+			const __m128 e0B = _mm_set1_ps(endpoint0.b);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 three = _mm_set1_ps(3.0f);
+			for (u32 i = 0; i < 16; i += 4)
+			{
+				__m128 t = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.r + i), e0R), dirR);
+				t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.g + i), e0G), dirG));
+				t = _mm_add_ps(t, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(block.b + i), e0B), dirB));
+				t = _mm_min_ps(_mm_max_ps(t, zero), three);
+				_mm_store_si128((__m128i*)(steps + i), _mm_cvtps_epi32(t));
+			}
+#else
+			for (u32 i = 0; i < 16; ++i)
+			{
+				glm::vec3 color(block.r[i], block.g[i], block.b[i]);
+				float t = glm::clamp(glm::dot(color - endpoint0, direction) * scale, 0.0f, 3.0f);
+				steps[i] = (i32)(t + 0.5f);
+			}
+#endif
+
+			for (u32 i = 0; i < 16; ++i)
+				indices |= paletteOrder[steps[i]] << (2 * i);
+
+			// Four color mode needs color0 > color1, swapping the endpoints swaps 0<->1 and 2<->3
+			if (color0 < color1)
+			{
+				std::swap(color0, color1);
+				indices ^= 0x55555555;
+			}
+		}
+
+		output[0] = color0 & 0xFF;
+		output[1] = color0 >> 8;
+		output[2] = color1 & 0xFF;
+		output[3] = color1 >> 8;
+		output[4] = indices & 0xFF;
+		output[5] = (indices >> 8) & 0xFF;
+		output[6] = (indices >> 16) & 0xFF;
+		output[7] = (indices >> 24) & 0xFF;
+	}
+
+	void EncodeBC4(const float* values, u8* output)
+	{
+		float minValue, maxValue;
+		MinMax16(values, minValue, maxValue);
+
+		u8 value0 = (u8)glm::clamp(maxValue + 0.5f, 0.0f, 255.0f);
+		u8 value1 = (u8)glm::clamp(minValue + 0.5f, 0.0f, 255.0f);
+
+		u64 indices = 0;
+		if (value0 != value1)
+		{
+			// Eight value mode: 0 = value0, 1 = value1, 2..7 interpolate from value0 to value1
+			float scale = 7.0f / (float)(value0 - value1);
+			alignas(16) i32 steps[16];
+
+#if COOKER_USE_SSE2
+			const __m128 v0 = _mm_set1_ps(value0);
+			const __m128 vscale = _mm_set1_ps(scale);
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 seven = _mm_set1_ps(7.0f);
+			for (u32 i = 0; i < 16; i += 4)
+			{
+				__m128 t = _mm_mul_ps(_mm_sub_ps(v0, _mm_load_ps(values + i)), vscale);
+				t = _mm_min_ps(_mm_max_ps(t, zero), seven);
+				_mm_store_si128((__m128i*)(steps + i), _mm_cvtps_epi32(t));
+			}
+#else
+			for (u32 i = 0; i < 16; ++i)
+				steps[i] = (i32)(glm::clamp((value0 - values[i]) * scale, 0.0f, 7.0f) + 0.5f);
+#endif
+
+			for (u32 i = 0; i < 16; ++i)
+			{
+				u64 index = steps[i] == 0 ? 0 : (steps[i] == 7 ? 1 : steps[i] + 1);
+				indices |= index << (3 * i);
+			}
+		}
+
+		output[0] = value0;
+		output[1] = value1;
+		for (u32 i = 0; i < 6; ++i)
+			output[2 + i] = (indices >> (8 * i)) & 0xFF;
+	}
+
+	void EncodeBlock(CookedTextureFormat format, const Block& block, u8* output)
+	{
+		switch (format)
+		{
+		case CookedTexture_BC1:
+			EncodeBC1(block, output);
+			break;
+		case CookedTexture_BC3:
+			EncodeBC4(block.a, output);
+			EncodeBC1(block, output + 8);
+			break;
+		case CookedTexture_BC4:
+			EncodeBC4(block.r, output);
+			break;
+		case CookedTexture_BC5:
+			EncodeBC4(block.r, output);
+			EncodeBC4(block.g, output + 8);
+			break;
+		}
+	}
+
+	void EncodeMip(const MipImage& mip, CookedTextureFormat format, TextureUsage usage, u8* output)
+	{
+		const u32 blocksX = (mip.width + 3) / 4;
+		const u32 blocksY = (mip.height + 3) / 4;
+		const u32 blockSize = GetCookedTextureBlockSize(format);
+
+		auto encodeRows = [&](u32 firstRow, u32 lastRow)
+		{
+			Block block;
+			for (u32 by = firstRow; by < lastRow; ++by)
+			{
+				for (u32 bx = 0; bx < blocksX; ++bx)
+				{
+					FetchBlock(mip, bx, by, block);
+
+					// The shader rebuilds z, so the color endpoints only have to fit red and green
+					if (usage == TextureUsage_NormalHeight)
+						memset(block.b, 0, sizeof(block.b));
+
+					EncodeBlock(format, block, output + (by * blocksX + bx) * blockSize);
+				}
+			}
+		};
+
+		// Small mips aren't worth a thread
+		const u32 rowsPerThread = 16;
+		u32 threadCount = glm::min(glm::max(std::thread::hardware_concurrency(), 1u), (blocksY + rowsPerThread - 1) / rowsPerThread);
+		if (threadCount <= 1)
+		{
+			encodeRows(0, blocksY);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		u32 rowsPerSlice = (blocksY + threadCount - 1) / threadCount;
+		for (u32 t = 0; t < threadCount; ++t)
+		{
+			u32 firstRow = t * rowsPerSlice;
+			u32 lastRow = glm::min(firstRow + rowsPerSlice, blocksY);
+			if (firstRow < lastRow)
+				threads.emplace_back(encodeRows, firstRow, lastRow);
+		}
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	MipImage DownsampleMip(const MipImage& source, TextureUsage usage)
+	{
+		MipImage mip = {};
+		mip.width = glm::max(source.width / 2, 1u);
+		mip.height = glm::max(source.height / 2, 1u);
+		mip.rgba.resize(mip.width * mip.height * 4);
+
+		for (u32 y = 0; y < mip.height; ++y)
+		{
+			for (u32 x = 0; x < mip.width; ++x)
+			{
+				glm::vec4 sum(0.0f);
+				for (u32 sy = 0; sy < 2; ++sy)
+				{
+					for (u32 sx = 0; sx < 2; ++sx)
+					{
+						u32 px = glm::min(x * 2 + sx, source.width - 1);
+						u32 py = glm::min(y * 2 + sy, source.height - 1);
+						const u8* texel = &source.rgba[(py * source.width + px) * 4];
+						sum += glm::vec4(texel[0], texel[1], texel[2], texel[3]);
+					}
+				}
+
+				glm::vec4 average = sum * 0.25f;
+				if (usage == TextureUsage_Normal || usage == TextureUsage_NormalHeight)
+				{
+					// Averaged normals get shorter, keep them unit length
+					glm::vec3 normal = glm::vec3(average) / 127.5f - 1.0f;
+					float length = glm::length(normal);
+					if (length > 0.0001f)
+						normal /= length;
+					average = glm::vec4((normal + 1.0f) * 127.5f, average.a);
+				}
+
+				u8* texel = &mip.rgba[(y * mip.width + x) * 4];
+				for (u32 c = 0; c < 4; ++c)
+					texel[c] = (u8)glm::clamp(average[c] + 0.5f, 0.0f, 255.0f);
+			}
+		}
+
+		return mip;
+	}
+
+	bool IsGrayscale(const u8* pixels, u32 width, u32 height, u32 channels)
+	{
+		if (channels < 3)
+			return true;
+
+		const u32 texelCount = width * height;
+		const u32 step = glm::max(texelCount / 4096, 1u);
+		for (u32 i = 0; i < texelCount; i += step)
+		{
+			const u8* texel = pixels + i * channels;
+			if (abs(texel[0] - texel[1]) > 8 || abs(texel[1] - texel[2]) > 8)
+				return false;
+		}
+		return true;
+	}
+
+	// Assimp puts OBJ map_Bump in the height slot even when it points to a normal map
+	TextureUsage ResolveUsage(const MipImage& image, u32 channels, TextureUsage usage)
+	{
+		// Gray and gray+alpha sources are always heights, the latter doesn't expand to equal RGB
+		if (usage != TextureUsage_Height || channels < 3 || IsGrayscale(image.rgba.data(), image.width, image.height, 4))
+			return usage;
+
+		return LooksLikeNormalMap(image.rgba.data(), image.width, image.height, 4) ? TextureUsage_Normal : TextureUsage_Color;
+	}
+
+	CookedTextureFormat ChooseFormat(const MipImage& image, u32 channels, TextureUsage usage)
+	{
+		switch (usage)
+		{
+		case TextureUsage_Normal:
+			return CookedTexture_BC5;
+		case TextureUsage_Height:
+			return CookedTexture_BC4;
+		case TextureUsage_NormalHeight:
+			return CookedTexture_BC3;
+		default:
+			break;
+		}
+
+		if (channels == 4)
+		{
+			for (u32 i = 0; i < image.width * image.height; ++i)
+			{
+				if (image.rgba[i * 4 + 3] < 250)
+					return CookedTexture_BC3;
+			}
+		}
+
+		return CookedTexture_BC1;
+	}
+}
+
+std::string GetCookedTexturePath(const char* sourcePath)
+{
+	return std::string(sourcePath) + COOKED_TEXTURE_EXTENSION;
+}
+
+TexturePackDesc MakeOrmPackDesc(const std::string& occlusion, const std::string& roughness, const std::string& metallic)
+{
+	TexturePackDesc desc = {};
+	desc.sources[0] = occlusion;
+	desc.sources[1] = roughness;
+	desc.sources[2] = metallic;
+	desc.defaults[0] = 255;
+	desc.defaults[1] = 128;
+	desc.defaults[2] = 0;
+	desc.defaults[3] = 255;
+	return desc;
+}
+
+TexturePackDesc MakeNormalHeightPackDesc(const std::string& normal, const std::string& height)
+{
+	TexturePackDesc desc = {};
+	desc.sources[0] = normal;
+	desc.sources[1] = normal;
+	desc.sources[2] = normal;
+	desc.sources[3] = height;
+	desc.sourceChannels[0] = 0;
+	desc.sourceChannels[1] = 1;
+	desc.sourceChannels[2] = 2;
+	desc.defaults[0] = 128;
+	desc.defaults[1] = 128;
+	desc.defaults[2] = 255;
+	desc.defaults[3] = 0;
+	return desc;
+}
+
+std::string GetTexturePackKey(const TexturePackDesc& desc)
+{
+	std::string key = "pack";
+	for (u32 c = 0; c < 4; ++c)
+		key += "|" + desc.sources[c] + ":" + std::to_string(desc.sourceChannels[c]) + ":" + std::to_string(desc.defaults[c]);
+	return key;
+}
+
+std::string GetCookedTexturePackPath(const TexturePackDesc& desc)
+{
+	for (u32 c = 0; c < 4; ++c)
+	{
+		if (desc.sources[c].empty())
+			continue;
+
+		// FNV-1a of the key keeps different packs of the same source apart
+		u32 hash = 2166136261u;
+		for (char ch : GetTexturePackKey(desc))
+			hash = (hash ^ (u8)ch) * 16777619u;
+
+		char suffix[16];
+		snprintf(suffix, sizeof(suffix), ".%08x", hash);
+		return desc.sources[c] + suffix + COOKED_TEXTURE_EXTENSION;
+	}
+	return std::string();
+}
+
+bool PackTextureChannels(const TexturePackDesc& desc, const TexturePackSource sources[4], std::vector<u8>& rgba, u32& width, u32& height)
+{
+	width = 1;
+	height = 1;
+	for (u32 c = 0; c < 4; ++c)
+	{
+		if (!sources[c].pixels)
+			continue;
+
+		if (desc.sourceChannels[c] >= sources[c].channels && sources[c].channels != 1)
+		{
+			ELOG("Texture pack source %s has no channel %u", desc.sources[c].c_str(), desc.sourceChannels[c]);
+			return false;
+		}
+
+		width = glm::max(width, sources[c].width);
+		height = glm::max(height, sources[c].height);
+	}
+
+	rgba.resize(width * height * 4);
+	for (u32 c = 0; c < 4; ++c)
+	{
+		const TexturePackSource& source = sources[c];
+		if (!source.pixels)
+		{
+			for (u32 i = 0; i < width * height; ++i)
+				rgba[i * 4 + c] = desc.defaults[c];
+			continue;
+		}
+
+		// Single channel sources are read the same whatever channel was asked for
+		const u32 channel = source.channels == 1 ? 0 : desc.sourceChannels[c];
+		for (u32 y = 0; y < height; ++y)
+		{
+			const u32 sy = y * source.height / height;
+			for (u32 x = 0; x < width; ++x)
+			{
+				const u32 sx = x * source.width / width;
+				rgba[(y * width + x) * 4 + c] = source.pixels[(sy * source.width + sx) * source.channels + channel];
+			}
+		}
+	}
+
+	return true;
+}
+
+bool LooksLikeNormalMap(const u8* pixels, u32 width, u32 height, u32 channels)
+{
+	if (channels < 3 || IsGrayscale(pixels, width, height, channels))
+		return false;
+
+	u64 blueSum = 0;
+	u32 samples = 0;
+	const u32 texelCount = width * height;
+	const u32 step = glm::max(texelCount / 4096, 1u);
+	for (u32 i = 0; i < texelCount; i += step, ++samples)
+		blueSum += pixels[i * channels + 2];
+
+	return blueSum / glm::max(samples, 1u) > 200;
+}
+
+u32 GetCookedTextureBlockSize(CookedTextureFormat format)
+{
+	return format == CookedTexture_BC1 || format == CookedTexture_BC4 ? 8 : 16;
+}
+
+const char* GetCookedTextureFormatName(CookedTextureFormat format)
+{
+	switch (format)
+	{
+	case CookedTexture_BC1: return "BC1";
+	case CookedTexture_BC3: return "BC3";
+	case CookedTexture_BC4: return "BC4";
+	case CookedTexture_BC5: return "BC5";
+	}
+	return "Unknown";
+}
+
+bool CookTexture(const u8* pixels, u32 width, u32 height, u32 channels, TextureUsage usage, u64 sourceTimestamp, std::vector<u8>& container)
+{
+	if (!pixels || width == 0 || height == 0 || channels < 1 || channels > 4)
+		return false;
+
+	// Work in RGBA8, single channel images are replicated so r/g/b stay meaningful
+	MipImage baseMip = {};
+	baseMip.width = width;
+	baseMip.height = height;
+	baseMip.rgba.resize(width * height * 4);
+	for (u32 i = 0; i < width * height; ++i)
+	{
+		const u8* src = pixels + i * channels;
+		u8* dst = &baseMip.rgba[i * 4];
+		dst[0] = src[0];
+		dst[1] = channels > 1 ? src[1] : src[0];
+		dst[2] = channels > 2 ? src[2] : src[0];
+		dst[3] = channels == 4 ? src[3] : (channels == 2 ? src[1] : 255);
+	}
+
+	const TextureUsage requestedUsage = usage;
+	usage = ResolveUsage(baseMip, channels, usage);
+	CookedTextureFormat format = ChooseFormat(baseMip, channels, usage);
+	const u32 blockSize = GetCookedTextureBlockSize(format);
+	const u32 uncompressedTexelSize = channels == 4 ? 4 : 3;
+
+	u32 mipCount = 1;
+	while (mipCount < COOKED_TEXTURE_MAX_MIPS && ((width >> mipCount) || (height >> mipCount)))
+		++mipCount;
+
+	CookedTextureHeader header = {};
+	header.magic = COOKED_TEXTURE_MAGIC;
+	header.version = COOKED_TEXTURE_VERSION;
+	header.sourceTimestamp = sourceTimestamp;
+	header.format = format;
+	header.width = width;
+	header.height = height;
+	header.mipCount = mipCount;
+	header.sourceChannels = channels;
+
+	std::vector<CookedTextureMip> mips(mipCount);
+	u64 offset = AlignOffset(sizeof(CookedTextureHeader) + mipCount * sizeof(CookedTextureMip), 16);
+	for (u32 level = 0; level < mipCount; ++level)
+	{
+		CookedTextureMip& mip = mips[level];
+		mip.width = glm::max(width >> level, 1u);
+		mip.height = glm::max(height >> level, 1u);
+		mip.offset = offset;
+		mip.size = (u64)((mip.width + 3) / 4) * ((mip.height + 3) / 4) * blockSize;
+		offset = AlignOffset(offset + mip.size, 16);
+
+		header.uncompressedSize += (u64)mip.width * mip.height * uncompressedTexelSize;
+	}
+
+	container.assign(offset, 0);
+
+	MipImage currentMip = std::move(baseMip);
+	for (u32 level = 0; level < mipCount; ++level)
+	{
+		if (level > 0)
+			currentMip = DownsampleMip(currentMip, usage);
+
+		EncodeMip(currentMip, format, usage, container.data() + mips[level].offset);
+	}
+
+	// The usage that was asked for is the cache key, even if the image turned out to be something else
+	header.usage = requestedUsage;
+	memcpy(container.data(), &header, sizeof(header));
+	memcpy(container.data() + sizeof(header), mips.data(), mipCount * sizeof(CookedTextureMip));
+
+	return true;
+}
+
+bool ReadCookedTexture(const void* data, u64 size, u64 sourceTimestamp, TextureUsage usage, CookedTextureView& view)
+{
+	if (!data || size < sizeof(CookedTextureHeader))
+		return false;
+
+	const u8* base = (const u8*)data;
+	const CookedTextureHeader* header = (const CookedTextureHeader*)base;
+
+	if (header->magic != COOKED_TEXTURE_MAGIC || header->version != COOKED_TEXTURE_VERSION ||
+		header->sourceTimestamp != sourceTimestamp || header->usage != (u32)usage || header->mipCount == 0 || header->mipCount > COOKED_TEXTURE_MAX_MIPS)
+		return false;
+
+	const CookedTextureMip* mips = (const CookedTextureMip*)(base + sizeof(CookedTextureHeader));
+	if (sizeof(CookedTextureHeader) + header->mipCount * sizeof(CookedTextureMip) > size)
+		return false;
+
+	for (u32 i = 0; i < header->mipCount; ++i)
+	{
+		if (mips[i].offset + mips[i].size > size)
+		{
+			ELOG("Cooked texture is truncated");
+			return false;
+		}
+	}
+
+	view.header = header;
+	view.mips = mips;
+	view.base = base;
+
+	return true;
+}
+
+bool WriteCookedTexture(const char* cookedPath, const std::vector<u8>& container)
+{
+	FILE* file = fopen(cookedPath, "wb");
+	if (!file)
+	{
+		ELOG("fopen() failed writing cooked texture %s", cookedPath);
+		return false;
+	}
+
+	fwrite(container.data(), 1, container.size(), file);
+	bool success = ferror(file) == 0;
+	fclose(file);
+
+	if (!success)
+	{
+		ELOG("Failed writing cooked texture %s", cookedPath);
+		remove(cookedPath);
+	}
+
+	return success;
+}
@@ -0,0 +1,125 @@
+//
+// TextureCooker.h: Block compression of textures. Images are converted once into a cooked
+// container (.ctex) next to the source file holding the whole BC1/BC3/BC4/BC5 mip chain,
+// which the engine uploads with glCompressedTexImage2D instead of decoding PNGs/JPGs.
+//
+
+#pragma once
+
+#include "platform.h"
+
+#define COOKED_TEXTURE_MAGIC     0x58455443 // "CTEX"
+#define COOKED_TEXTURE_VERSION   1
+#define COOKED_TEXTURE_EXTENSION ".ctex"
+#define COOKED_TEXTURE_MAX_MIPS  16
+
+// What the texture is sampled for, decides the block format
+enum TextureUsage
+{
+	TextureUsage_Color = 0, // BC1, or BC3 when it has a meaningful alpha channel
+	TextureUsage_Normal,    // BC5, the shader rebuilds z from x and y
+	TextureUsage_Height,    // BC4, single channel
+	TextureUsage_NormalHeight, // BC3, normal x/y in red/green and height in alpha
+	TextureUsage_Count
+};
+
+enum CookedTextureFormat
+{
+	CookedTexture_BC1 = 0,
+	CookedTexture_BC3,
+	CookedTexture_BC4,
+	CookedTexture_BC5
+};
+
+struct CookedTextureHeader
+{
+	u32 magic;
+	u32 version;
+	u64 sourceTimestamp;
+	u32 usage;
+	u32 format;
+	u32 width;
+	u32 height;
+	u32 mipCount;
+	u32 sourceChannels;
+	u64 uncompressedSize; // Size of the same mip chain as RGB8/RGBA8, for the memory report
+};
+
+struct CookedTextureMip
+{
+	u32 width;
+	u32 height;
+	u64 offset; // From the start of the container
+	u64 size;
+};
+
+static_assert(sizeof(CookedTextureHeader) == 48, "CookedTextureHeader layout changed, bump COOKED_TEXTURE_VERSION");
+
+// Pointers into a cooked container, valid while its memory is alive
+struct CookedTextureView
+{
+	const CookedTextureHeader* header;
+	const CookedTextureMip*    mips;
+	const u8*                  base;
+};
+
+// Scalar maps combined into the channels of a single texture. Channels without a
+// source are filled with their default value.
+struct TexturePackDesc
+{
+	std::string sources[4];
+	u8          sourceChannels[4]; // Channel read from each source
+	u8          defaults[4];
+};
+
+// Decoded source of a pack, pixels is NULL for missing sources
+struct TexturePackSource
+{
+	const u8* pixels;
+	u32       width;
+	u32       height;
+	u32       channels;
+};
+
+std::string GetCookedTexturePath(const char* sourcePath);
+
+/**
+ * Occlusion/roughness/metallic in red/green/blue. Materials without a map for one of them
+ * get full occlusion, medium roughness and no metal.
+ */
+TexturePackDesc MakeOrmPackDesc(const std::string& occlusion, const std::string& roughness, const std::string& metallic);
+
+// Normal in red/green/blue and height in alpha
+TexturePackDesc MakeNormalHeightPackDesc(const std::string& normal, const std::string& height);
+
+std::string GetTexturePackKey(const TexturePackDesc& desc);
+
+// Cooked container of a pack, beside its first source. Empty if the pack has no sources.
+std::string GetCookedTexturePackPath(const TexturePackDesc& desc);
+
+/**
+ * Builds the RGBA8 image of a pack. Sources with different sizes are resampled to the
+ * largest one.
+ */
+bool PackTextureChannels(const TexturePackDesc& desc, const TexturePackSource sources[4], std::vector<u8>& rgba, u32& width, u32& height);
+
+// Tangent space normal maps are mostly blue, with red and green around the middle
+bool LooksLikeNormalMap(const u8* pixels, u32 width, u32 height, u32 channels);
+
+/**
+ * Encodes every mip level of an 8 bit image (1 to 4 channels) into a cooked container.
+ * Blocks are encoded with SSE2 where available, spread over several threads.
+ */
+bool CookTexture(const u8* pixels, u32 width, u32 height, u32 channels, TextureUsage usage, u64 sourceTimestamp, std::vector<u8>& container);
+
+/**
+ * Validates a cooked container against its source timestamp and usage. On success, fills
+ * the view with pointers to the header, the mip table and the block data.
+ */
+bool ReadCookedTexture(const void* data, u64 size, u64 sourceTimestamp, TextureUsage usage, CookedTextureView& view);
+
+bool WriteCookedTexture(const char* cookedPath, const std::vector<u8>& container);
+
+const char* GetCookedTextureFormatName(CookedTextureFormat format);
+
+u32 GetCookedTextureBlockSize(CookedTextureFormat format);
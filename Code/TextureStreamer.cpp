@@ -0,0 +1,504 @@
+#include "TextureStreamer.h"
+#include "GLExtensions.h"
+#include <string.h>
+
+// glad is generated for the 4.3 core profile, which has RGTC (BC4/BC5) but not S3TC
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#define TEXTURE_UPLOAD_MIP_ALIGNMENT 16
+
+namespace
+{
+	u64 AlignSize(u64 size, u64 alignment)
+	{
+		return (size + alignment - 1) / alignment * alignment;
+	}
+
+	TextureUploadFormat GetCookedUploadFormat(CookedTextureFormat format)
+	{
+		switch (format)
+		{
+			case CookedTexture_BC1: return TextureUpload_BC1;
+			case CookedTexture_BC3: return TextureUpload_BC3;
+			case CookedTexture_BC4: return TextureUpload_BC4;
+			case CookedTexture_BC5: return TextureUpload_BC5;
+		}
+		return TextureUpload_BC1;
+	}
+
+	// Reserves a contiguous range of the buffer for the whole chain, a range that would cross the
+	// end of the buffer starts over at 0 and the skipped bytes go with it. Chains larger than half
+	// the ring are never put in it, they'd stall every other upload while they wait for room.
+	bool AllocateUploadBlock(TextureUploadRing& ring, TextureUpload& upload)
+	{
+		const u64 size = AlignSize(upload.size, TEXTURE_UPLOAD_ALIGNMENT);
+		if (!ring.mapped || size > ring.size / 2)
+			return false;
+
+		std::lock_guard<std::mutex> lock(ring.mutex);
+
+		const u64 physical = ring.head % ring.size;
+		const u64 padding = physical + size > ring.size ? ring.size - physical : 0;
+		const u64 tail = ring.blocks.empty() ? ring.head : ring.blocks.front().start;
+		if (ring.head + padding + size - tail > ring.size)
+			return false;
+
+		upload.ringBlock = ring.firstBlockId + (u32)ring.blocks.size();
+		upload.ringOffset = (ring.head + padding) % ring.size;
+		ring.blocks.push_back(TextureUploadBlock{ ring.head, padding + size, nullptr });
+		ring.head += padding + size;
+		return true;
+	}
+
+	void AddChainMip(TextureMipChain& chain, u32 width, u32 height, u64 size)
+	{
+		TextureUploadMip& mip = chain.mips[chain.mipCount++];
+		mip.width = width;
+		mip.height = height;
+		mip.offset = AlignSize(chain.size, TEXTURE_UPLOAD_MIP_ALIGNMENT);
+		mip.size = size;
+		chain.size = mip.offset + size;
+	}
+
+	const u8* GetMipChainData(const TextureMipChain& chain)
+	{
+		const u8* base = chain.memory.empty() ? (const u8*)chain.file.data : chain.memory.data();
+		return base + chain.dataOffset;
+	}
+
+	// Layer is only used by array textures, the level goes to the texture bound to target
+	void UploadTextureLevel(GLenum target, u32 layer, TextureUploadFormat format, u32 level, const TextureUploadMip& mip, const u8* data)
+	{
+		const bool isArray = target == GL_TEXTURE_2D_ARRAY;
+		if (format == TextureUpload_RGB8 || format == TextureUpload_RGBA8)
+		{
+			const GLenum dataFormat = format == TextureUpload_RGB8 ? GL_RGB : GL_RGBA;
+			if (isArray)
+				glTexSubImage3D(target, level, 0, 0, layer, mip.width, mip.height, 1, dataFormat, GL_UNSIGNED_BYTE, data);
+			else
+				glTexSubImage2D(target, level, 0, 0, mip.width, mip.height, dataFormat, GL_UNSIGNED_BYTE, data);
+		}
+		else
+		{
+			const GLenum internalFormat = GetTextureUploadInternalFormat(format);
+			if (isArray)
+				glCompressedTexSubImage3D(target, level, 0, 0, layer, mip.width, mip.height, 1, internalFormat, (GLsizei)mip.size, data);
+			else
+				glCompressedTexSubImage2D(target, level, 0, 0, mip.width, mip.height, internalFormat, (GLsizei)mip.size, data);
+		}
+	}
+
+	// Copies every level of the upload into the texture bound to target, from the ring or from memory
+	void CopyUploadLevels(TextureUploadRing& ring, TextureUpload& upload, GLenum target, u32 layer)
+	{
+		const bool fromRing = upload.ringBlock != TEXTURE_UPLOAD_INVALID_BLOCK;
+
+		// With a pixel unpack buffer bound the data pointers are offsets into it
+		const u8* base = upload.memory.data();
+		if (fromRing)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer);
+			base = (const u8*)(uintptr_t)upload.ringOffset;
+		}
+
+		// Rows of RGB8 mips are tightly packed
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (u32 level = 0; level < upload.mipCount; ++level)
+			UploadTextureLevel(target, layer, upload.format, level, upload.mips[level], base + upload.mips[level].offset);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+		if (fromRing)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+			GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			std::lock_guard<std::mutex> lock(ring.mutex);
+			ring.blocks[upload.ringBlock - ring.firstBlockId].fence = fence;
+		}
+		else
+		{
+			ring.memoryUploads++;
+		}
+
+		ring.frameBytes += upload.size;
+		ring.frameTextures++;
+		ring.totalBytes += upload.size;
+		ring.totalTextures++;
+
+		upload.memory.clear();
+		upload.memory.shrink_to_fit();
+		upload.ringBlock = TEXTURE_UPLOAD_INVALID_BLOCK;
+	}
+
+	void SetTextureSampling(u32 mipCount)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, mipCount - 1);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	}
+
+	// 2x2 box filter, the same glGenerateMipmap does on most drivers
+	void DownsampleUploadMip(const u8* source, u32 sourceWidth, u32 sourceHeight, u32 channels, u8* destination, u32 width, u32 height)
+	{
+		for (u32 y = 0; y < height; ++y)
+		{
+			const u32 y0 = glm::min(y * 2, sourceHeight - 1);
+			const u32 y1 = glm::min(y * 2 + 1, sourceHeight - 1);
+			for (u32 x = 0; x < width; ++x)
+			{
+				const u32 x0 = glm::min(x * 2, sourceWidth - 1);
+				const u32 x1 = glm::min(x * 2 + 1, sourceWidth - 1);
+				const u8* a = source + (y0 * sourceWidth + x0) * channels;
+				const u8* b = source + (y0 * sourceWidth + x1) * channels;
+				const u8* c = source + (y1 * sourceWidth + x0) * channels;
+				const u8* d = source + (y1 * sourceWidth + x1) * channels;
+				u8* texel = destination + (y * width + x) * channels;
+				for (u32 k = 0; k < channels; ++k)
+					texel[k] = (u8)((a[k] + b[k] + c[k] + d[k] + 2) / 4);
+			}
+		}
+	}
+}
+
+u32 GetTextureUploadInternalFormat(TextureUploadFormat format)
+{
+	switch (format)
+	{
+	case TextureUpload_RGB8:  return GL_RGB8;
+	case TextureUpload_RGBA8: return GL_RGBA8;
+	case TextureUpload_BC1:   return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+	case TextureUpload_BC3:   return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	case TextureUpload_BC4:   return GL_COMPRESSED_RED_RGTC1;
+	case TextureUpload_BC5:   return GL_COMPRESSED_RG_RGTC2;
+	}
+	return GL_NONE;
+}
+
+void InitTextureUploadRing(TextureUploadRing& ring, u64 size)
+{
+	ring.size = AlignSize(size, TEXTURE_UPLOAD_ALIGNMENT);
+	ring.head = 0;
+	ring.firstBlockId = 0;
+
+	if (!GLExt.bufferStorage)
+	{
+		ILOG("Persistent mapping is not available, textures are uploaded from client memory");
+		return;
+	}
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glGenBuffers(1, &ring.buffer);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer);
+	CreateBufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)ring.size, nullptr, flags);
+	ring.mapped = (u8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)ring.size, flags);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	if (!ring.mapped)
+	{
+		ELOG("glMapBufferRange() failed on the texture upload ring, textures are uploaded from client memory");
+		glDeleteBuffers(1, &ring.buffer);
+		ring.buffer = 0;
+	}
+}
+
+void DestroyTextureUploadRing(TextureUploadRing& ring)
+{
+	std::lock_guard<std::mutex> lock(ring.mutex);
+	for (TextureUploadBlock& block : ring.blocks)
+	{
+		if (block.fence)
+			glDeleteSync((GLsync)block.fence);
+	}
+	ring.blocks.clear();
+
+	if (ring.buffer)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, ring.buffer);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &ring.buffer);
+	}
+	ring.buffer = 0;
+	ring.mapped = nullptr;
+}
+
+void TakeCookedTextureMipChain(const CookedTextureView& cooked, MappedFile& file, std::vector<u8>& memory, TextureMipChain& chain)
+{
+	const CookedTextureHeader* header = cooked.header;
+	chain.format = GetCookedUploadFormat((CookedTextureFormat)header->format);
+	chain.width = header->width;
+	chain.height = header->height;
+	chain.mipCount = header->mipCount;
+	chain.size = 0;
+	chain.uncompressedSize = header->uncompressedSize;
+	for (u32 level = 0; level < header->mipCount; ++level)
+	{
+		chain.mips[level] = { cooked.mips[level].width, cooked.mips[level].height, cooked.mips[level].offset, cooked.mips[level].size };
+		chain.size = glm::max(chain.size, chain.mips[level].offset + chain.mips[level].size);
+	}
+
+	// The mips are read in place, wherever the container lives
+	chain.file = file;
+	chain.memory.swap(memory);
+	file = {};
+	memory.clear();
+	const u8* base = chain.memory.empty() ? (const u8*)chain.file.data : chain.memory.data();
+	chain.dataOffset = cooked.base - base;
+}
+
+void BuildImageTextureMipChain(const u8* pixels, u32 width, u32 height, u32 channels, TextureMipChain& chain)
+{
+	const u32 uploadChannels = channels == 3 ? 3 : 4;
+	chain.format = uploadChannels == 3 ? TextureUpload_RGB8 : TextureUpload_RGBA8;
+	chain.width = width;
+	chain.height = height;
+	chain.mipCount = 0;
+	chain.size = 0;
+
+	u32 mipWidth = width, mipHeight = height;
+	while (chain.mipCount < COOKED_TEXTURE_MAX_MIPS)
+	{
+		AddChainMip(chain, mipWidth, mipHeight, (u64)mipWidth * mipHeight * uploadChannels);
+		if (mipWidth == 1 && mipHeight == 1)
+			break;
+		mipWidth = glm::max(mipWidth / 2, 1u);
+		mipHeight = glm::max(mipHeight / 2, 1u);
+	}
+	chain.uncompressedSize = chain.size;
+
+	// Filtered in memory, mapped buffers are usually write combined and shouldn't be read back
+	chain.file = {};
+	chain.dataOffset = 0;
+	chain.memory.resize(chain.size);
+	u8* base = chain.memory.data();
+	if (channels == uploadChannels)
+	{
+		memcpy(base, pixels, chain.mips[0].size);
+	}
+	else
+	{
+		for (u64 i = 0; i < (u64)width * height; ++i)
+		{
+			const u8* source = pixels + i * channels;
+			u8* texel = base + i * 4;
+			texel[0] = source[0];
+			texel[1] = channels > 2 ? source[1] : source[0];
+			texel[2] = channels > 2 ? source[2] : source[0];
+			texel[3] = channels == 2 ? source[1] : channels == 4 ? source[3] : 255;
+		}
+	}
+
+	for (u32 level = 1; level < chain.mipCount; ++level)
+	{
+		const TextureUploadMip& source = chain.mips[level - 1];
+		const TextureUploadMip& mip = chain.mips[level];
+		DownsampleUploadMip(base + source.offset, source.width, source.height, uploadChannels, base + mip.offset, mip.width, mip.height);
+	}
+}
+
+void ReleaseTextureMipChain(TextureMipChain& chain)
+{
+	UnmapFile(chain.file);
+	chain = {};
+}
+
+u32 GetInitialStreamedMip(const TextureMipChain& chain)
+{
+	u32 mip = 0;
+	while (mip + 1 < chain.mipCount && glm::max(chain.mips[mip].width, chain.mips[mip].height) > TEXTURE_STREAMING_INITIAL_SIZE)
+		mip++;
+	return mip;
+}
+
+u64 GetMipChainSize(const TextureMipChain& chain, u32 mip)
+{
+	u64 size = 0;
+	for (u32 level = mip; level < chain.mipCount; ++level)
+		size += chain.mips[level].size;
+	return size;
+}
+
+void PrepareTextureUpload(TextureUploadRing& ring, const TextureMipChain& chain, u32 firstMip, TextureUpload& upload)
+{
+	upload.format = chain.format;
+	upload.width = chain.mips[firstMip].width;
+	upload.height = chain.mips[firstMip].height;
+	upload.firstMip = firstMip;
+	upload.mipCount = chain.mipCount - firstMip;
+
+	// Same layout as the chain, shifted to the first level uploaded
+	const u64 start = chain.mips[firstMip].offset;
+	upload.size = 0;
+	for (u32 level = 0; level < upload.mipCount; ++level)
+	{
+		upload.mips[level] = chain.mips[firstMip + level];
+		upload.mips[level].offset -= start;
+		upload.size = glm::max(upload.size, upload.mips[level].offset + upload.mips[level].size);
+	}
+
+	u8* destination;
+	if (AllocateUploadBlock(ring, upload))
+	{
+		destination = ring.mapped + upload.ringOffset;
+	}
+	else
+	{
+		upload.ringBlock = TEXTURE_UPLOAD_INVALID_BLOCK;
+		upload.memory.resize(upload.size);
+		destination = upload.memory.data();
+	}
+
+	const u8* data = GetMipChainData(chain);
+	for (u32 level = 0; level < upload.mipCount; ++level)
+		memcpy(destination + upload.mips[level].offset, data + chain.mips[firstMip + level].offset, upload.mips[level].size);
+}
+
+void BeginTextureUploadFrame(TextureUploadRing& ring)
+{
+	ring.frameBytes = 0;
+	ring.frameTextures = 0;
+
+	std::lock_guard<std::mutex> lock(ring.mutex);
+
+	// Fences signal in the order they were issued, the first one still pending stops the walk
+	while (!ring.blocks.empty() && ring.blocks.front().fence)
+	{
+		GLsync fence = (GLsync)ring.blocks.front().fence;
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+			break;
+
+		glDeleteSync(fence);
+		ring.blocks.pop_front();
+		ring.firstBlockId++;
+	}
+}
+
+u32 CreateTextureFromUpload(TextureUploadRing& ring, TextureUpload& upload)
+{
+	GLuint texHandle;
+	glGenTextures(1, &texHandle);
+	glBindTexture(GL_TEXTURE_2D, texHandle);
+	glTexStorage2D(GL_TEXTURE_2D, upload.mipCount, GetTextureUploadInternalFormat(upload.format), upload.width, upload.height);
+
+	CopyUploadLevels(ring, upload, GL_TEXTURE_2D, 0);
+
+	SetTextureSampling(upload.mipCount);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return texHandle;
+}
+
+void UploadTextureArrayLayer(TextureUploadRing& ring, TextureUpload& upload, u32 arrayHandle, u32 layer)
+{
+	glBindTexture(GL_TEXTURE_2D_ARRAY, arrayHandle);
+	CopyUploadLevels(ring, upload, GL_TEXTURE_2D_ARRAY, layer);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+u64 GetTextureUploadRingUsage(TextureUploadRing& ring)
+{
+	std::lock_guard<std::mutex> lock(ring.mutex);
+	return ring.blocks.empty() ? 0 : ring.head - ring.blocks.front().start;
+}
+
+const char* GetTextureUploadFormatName(TextureUploadFormat format)
+{
+	switch (format)
+	{
+	case TextureUpload_RGB8:  return "RGB8";
+	case TextureUpload_RGBA8: return "RGBA8";
+	case TextureUpload_BC1:   return "BC1";
+	case TextureUpload_BC3:   return "BC3";
+	case TextureUpload_BC4:   return "BC4";
+	case TextureUpload_BC5:   return "BC5";
+	}
+	return "Unknown";
+}
+
+void BeginTextureResidencyFrame(TextureResidency& residency)
+{
+	residency.wantedMip = residency.chain.mipCount > 0 ? residency.chain.mipCount - 1 : 0;
+}
+
+u32 GetTextureMipForScreenSize(const TextureResidency& residency, f32 pixelSize)
+{
+	const TextureMipChain& chain = residency.chain;
+	if (chain.mipCount == 0)
+		return 0;
+
+	// One level per halving of the texels that land on each pixel
+	const f32 texels = (f32)glm::max(chain.width, chain.height);
+	const f32 level = glm::log2(texels / glm::max(pixelSize, 1.0f));
+	return (u32)glm::clamp(level, 0.0f, (f32)(chain.mipCount - 1));
+}
+
+void RequestTextureMip(TextureResidency& residency, u32 mip, u64 frame)
+{
+	residency.wantedMip = glm::min(residency.wantedMip, mip);
+	residency.lastUsedFrame = frame;
+}
+
+u32 SetTextureResidentMip(TextureUploadRing& ring, u32 handle, TextureResidency& residency, u32 mip)
+{
+	const TextureMipChain& chain = residency.chain;
+	const u32 levelCount = chain.mipCount - mip;
+	const TextureUploadMip& top = chain.mips[mip];
+
+	GLuint texHandle;
+	glGenTextures(1, &texHandle);
+	glBindTexture(GL_TEXTURE_2D, texHandle);
+	glTexStorage2D(GL_TEXTURE_2D, levelCount, GetTextureUploadInternalFormat(chain.format), top.width, top.height);
+
+	// Levels the old texture has already, whole levels so block compressed tails copy too
+	for (u32 level = glm::max(mip, residency.residentMip); level < chain.mipCount; ++level)
+	{
+		const TextureUploadMip& source = chain.mips[level];
+		glCopyImageSubData(handle, GL_TEXTURE_2D, level - residency.residentMip, 0, 0, 0,
+			texHandle, GL_TEXTURE_2D, level - mip, 0, 0, 0, source.width, source.height, 1);
+	}
+
+	// Finer levels come straight from the chain
+	const u8* data = GetMipChainData(chain);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (u32 level = mip; level < residency.residentMip; ++level)
+	{
+		UploadTextureLevel(GL_TEXTURE_2D, 0, chain.format, level - mip, chain.mips[level], data + chain.mips[level].offset);
+		ring.frameBytes += chain.mips[level].size;
+		ring.totalBytes += chain.mips[level].size;
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	// New levels start out looking like the old finest one and sharpen over a few frames
+	if (mip < residency.residentMip)
+		residency.fadeLod += (f32)(residency.residentMip - mip);
+	residency.fadeLod = glm::min(residency.fadeLod, (f32)(levelCount - 1));
+
+	SetTextureSampling(levelCount);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, residency.fadeLod);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glDeleteTextures(1, &handle);
+	residency.residentMip = mip;
+	return texHandle;
+}
+
+bool UpdateTextureFade(u32 handle, TextureResidency& residency)
+{
+	if (residency.fadeLod <= 0.0f)
+		return false;
+
+	residency.fadeLod = glm::max(residency.fadeLod - 1.0f / TEXTURE_STREAMING_FADE_FRAMES, 0.0f);
+	glBindTexture(GL_TEXTURE_2D, handle);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, residency.fadeLod);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	return residency.fadeLod > 0.0f;
+}
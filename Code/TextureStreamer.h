@@ -0,0 +1,187 @@
+//
+// TextureStreamer.h: Asynchronous texture uploads through a persistently mapped pixel unpack
+// buffer. Asset workers lay out the whole mip chain of a texture and write it straight into a
+// block of the ring. The GL thread creates immutable textures, copies the mips from the buffer
+// and fences the copies, so the blocks are reused once the GPU is done with them.
+// Streamed textures keep their source chain and only the coarse levels are resident at first,
+// finer ones are brought in while something on screen needs them and a video memory budget allows.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "TextureCooker.h"
+#include <deque>
+#include <mutex>
+
+#define TEXTURE_UPLOAD_RING_SIZE     (64 * 1024 * 1024)
+#define TEXTURE_UPLOAD_ALIGNMENT     256
+#define TEXTURE_UPLOAD_INVALID_BLOCK UINT32_MAX
+
+#define TEXTURE_STREAMING_INITIAL_SIZE 64 // Longest side of the finest level loaded up front
+#define TEXTURE_STREAMING_FADE_FRAMES  16 // Frames a newly resident level takes to blend in
+
+enum TextureUploadFormat
+{
+	TextureUpload_RGB8 = 0,
+	TextureUpload_RGBA8,
+	TextureUpload_BC1,
+	TextureUpload_BC3,
+	TextureUpload_BC4,
+	TextureUpload_BC5
+};
+
+struct TextureUploadMip
+{
+	u32 width;
+	u32 height;
+	u64 offset; // From the start of the texture's data
+	u64 size;
+};
+
+// Every level of a texture as the workers produce it. The data is in the cooked container,
+// mapped or in memory, or in the chain the worker filtered from an image.
+struct TextureMipChain
+{
+	TextureUploadFormat format;
+	u32 width;
+	u32 height;
+	u32 mipCount;
+	TextureUploadMip mips[COOKED_TEXTURE_MAX_MIPS]; // Offsets from the start of the data
+	u64 size;
+	u64 uncompressedSize; // The same chain as RGB8/RGBA8, for the memory report
+
+	MappedFile file;
+	std::vector<u8> memory;
+	u64 dataOffset; // Of level 0, in memory if it's not empty or else in the file
+};
+
+// Part of a mip chain ready for the GL thread, in a ring block or in memory when the ring had no room
+struct TextureUpload
+{
+	TextureUploadFormat format;
+	u32 width;  // Of mips[0]
+	u32 height;
+	u32 firstMip; // Level of the chain mips[0] is
+	u32 mipCount;
+	TextureUploadMip mips[COOKED_TEXTURE_MAX_MIPS];
+	u64 size;
+
+	u32 ringBlock;  // TEXTURE_UPLOAD_INVALID_BLOCK when the data is in memory
+	u64 ringOffset; // Of the first mip in the ring buffer
+	std::vector<u8> memory;
+};
+
+struct TextureUploadBlock
+{
+	u64 start; // Position in the stream of bytes ever allocated, wrap padding included
+	u64 size;
+	void* fence; // GLsync after the copies out of the block, NULL while a worker still writes it
+};
+
+struct TextureUploadRing
+{
+	u32 buffer;
+	u8* mapped; // NULL without glBufferStorage, every upload then comes from memory
+	u64 size;
+
+	// Workers allocate and the GL thread retires, both under the mutex
+	std::mutex mutex;
+	u64 head;
+	u32 firstBlockId; // Id of blocks.front()
+	std::deque<TextureUploadBlock> blocks; // In allocation order, which is also the order they free up
+
+	// Stats of the current frame and totals since startup
+	u64 frameBytes;
+	u32 frameTextures;
+	u64 totalBytes;
+	u32 totalTextures;
+	u32 memoryUploads; // Textures that didn't find room in the ring
+};
+
+// GL thread, before any texture job is submitted
+void InitTextureUploadRing(TextureUploadRing& ring, u64 size = TEXTURE_UPLOAD_RING_SIZE);
+
+void DestroyTextureUploadRing(TextureUploadRing& ring);
+
+/**
+ * Any thread. Takes the cooked container, the file mapping or the memory it was cooked into,
+ * as the data of the chain.
+ */
+void TakeCookedTextureMipChain(const CookedTextureView& cooked, MappedFile& file, std::vector<u8>& memory, TextureMipChain& chain);
+
+/**
+ * Any thread. Builds the box filtered mip chain of an 8 bit image on the CPU, so the GL thread
+ * doesn't need glGenerateMipmap. Images with other than 3 channels are expanded to RGBA.
+ */
+void BuildImageTextureMipChain(const u8* pixels, u32 width, u32 height, u32 channels, TextureMipChain& chain);
+
+void ReleaseTextureMipChain(TextureMipChain& chain);
+
+// Finest level loaded up front when the texture is streamed, see TEXTURE_STREAMING_INITIAL_SIZE
+u32 GetInitialStreamedMip(const TextureMipChain& chain);
+
+// Bytes of the levels from mip to the end of the chain
+u64 GetMipChainSize(const TextureMipChain& chain, u32 mip);
+
+/**
+ * Any thread. Copies the levels of the chain from firstMip on into a ring block, or into
+ * upload.memory when the ring is full or unavailable.
+ */
+void PrepareTextureUpload(TextureUploadRing& ring, const TextureMipChain& chain, u32 firstMip, TextureUpload& upload);
+
+// GL thread, at the start of a frame. Frees the blocks whose fences have signaled and resets the frame stats.
+void BeginTextureUploadFrame(TextureUploadRing& ring);
+
+/**
+ * GL thread. Creates an immutable texture with glTexStorage2D and copies every mip from the
+ * ring buffer, or from memory, then fences the copies so the block can be reused. Returns the
+ * texture handle, the upload can be discarded after.
+ */
+u32 CreateTextureFromUpload(TextureUploadRing& ring, TextureUpload& upload);
+
+/**
+ * GL thread. Copies every level of the upload into a layer of an array texture allocated with
+ * the same format, size and level count, fenced like CreateTextureFromUpload.
+ */
+void UploadTextureArrayLayer(TextureUploadRing& ring, TextureUpload& upload, u32 arrayHandle, u32 layer);
+
+// Sized internal format textures of the format are allocated with
+u32 GetTextureUploadInternalFormat(TextureUploadFormat format);
+
+// Bytes of the ring held by blocks being written or read by the GPU
+u64 GetTextureUploadRingUsage(TextureUploadRing& ring);
+
+const char* GetTextureUploadFormatName(TextureUploadFormat format);
+
+// Residency of a streamed texture, driven by the entities that sample it
+struct TextureResidency
+{
+	TextureMipChain chain; // mipCount is 0 for textures that aren't streamed
+	u32 residentMip;       // Finest level in video memory, level 0 of the GL texture
+	u32 wantedMip;         // Finest level asked for since the last BeginTextureResidencyFrame
+	u64 lastUsedFrame;
+	f32 fadeLod;           // GL_TEXTURE_MIN_LOD, eases newly resident levels in
+};
+
+// Forgets the requests of the previous frame
+void BeginTextureResidencyFrame(TextureResidency& residency);
+
+/**
+ * Level something covering pixelSize pixels on screen needs, assuming the texture is
+ * stretched across it once.
+ */
+u32 GetTextureMipForScreenSize(const TextureResidency& residency, f32 pixelSize);
+
+void RequestTextureMip(TextureResidency& residency, u32 mip, u64 frame);
+
+/**
+ * GL thread. Makes mip the finest resident level. Immutable storage can't gain or drop levels,
+ * so the texture is reallocated: the levels both have are copied on the GPU, finer ones are
+ * uploaded from the chain. Returns the new handle, the old one is deleted. The uploaded bytes
+ * count towards the frame stats of the ring.
+ */
+u32 SetTextureResidentMip(TextureUploadRing& ring, u32 handle, TextureResidency& residency, u32 mip);
+
+// GL thread. Steps the fade of newly resident levels, returns false once it's over.
+bool UpdateTextureFade(u32 handle, TextureResidency& residency);
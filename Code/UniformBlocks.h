@@ -0,0 +1,91 @@
+//
+// UniformBlocks.h: C++ mirrors of the uniform and storage blocks the shaders declare. The offsets
+// are checked against the std140/std430 rules when this compiles. They give the size of each block
+// and the layout the field by field pushes in Update follow.
+//
+
+#pragma once
+
+#include "platform.h"
+#include <stddef.h>
+
+#define UNIFORM_MAX_LIGHTS 16 // Length of uLight in GlobalParams
+
+// std140: a vec3 is aligned to 16 bytes but takes 12, and the members of an array of structs
+// start every 16 bytes, so every vec3 here carries its own padding
+struct alignas(16) LightBlock
+{
+	u32 type;
+	u32 padding0[3];
+	glm::vec3 color;
+	f32 padding1;
+	glm::vec3 direction;
+	f32 padding2;
+	glm::vec3 position;
+	f32 padding3;
+	glm::vec3 intensity;
+	f32 padding4;
+};
+
+static_assert(offsetof(LightBlock, type) == 0, "std140 layout of Light");
+static_assert(offsetof(LightBlock, color) == 16, "std140 layout of Light");
+static_assert(offsetof(LightBlock, direction) == 32, "std140 layout of Light");
+static_assert(offsetof(LightBlock, position) == 48, "std140 layout of Light");
+static_assert(offsetof(LightBlock, intensity) == 64, "std140 layout of Light");
+static_assert(sizeof(LightBlock) == 80, "std140 array stride of Light");
+
+// layout(binding = 0, std140) uniform GlobalParams
+struct alignas(16) GlobalParamsBlock
+{
+	glm::vec3 cameraPosition;
+	u32 lightCount; // Fits in the tail of the vec3
+	u32 directionalLightCount; // Directional lights come first, point lights after them
+	u32 padding0[3];
+	LightBlock lights[UNIFORM_MAX_LIGHTS];
+};
+
+static_assert(offsetof(GlobalParamsBlock, cameraPosition) == 0, "std140 layout of GlobalParams");
+static_assert(offsetof(GlobalParamsBlock, lightCount) == 12, "std140 layout of GlobalParams");
+static_assert(offsetof(GlobalParamsBlock, directionalLightCount) == 16, "std140 layout of GlobalParams");
+static_assert(offsetof(GlobalParamsBlock, lights) == 32, "std140 layout of GlobalParams");
+static_assert(sizeof(GlobalParamsBlock) == 32 + 80 * UNIFORM_MAX_LIGHTS, "std140 size of GlobalParams");
+
+// layout(binding = 1, std140) uniform LocalParams. The deferred shader declares the matrices only.
+struct alignas(16) LocalParamsBlock
+{
+	glm::mat4 worldMatrix;
+	glm::mat4 worldViewProjectionMatrix;
+	glm::mat4 worldViewMatrix;
+	glm::vec3 positionScale; // Dequantization of compressed positions
+	f32 padding0;
+	glm::vec3 positionOffset;
+	f32 padding1;
+};
+
+static_assert(offsetof(LocalParamsBlock, worldMatrix) == 0, "std140 layout of LocalParams");
+static_assert(offsetof(LocalParamsBlock, worldViewProjectionMatrix) == 64, "std140 layout of LocalParams");
+static_assert(offsetof(LocalParamsBlock, worldViewMatrix) == 128, "std140 layout of LocalParams");
+static_assert(offsetof(LocalParamsBlock, positionScale) == 192, "std140 layout of LocalParams");
+static_assert(offsetof(LocalParamsBlock, positionOffset) == 208, "std140 layout of LocalParams");
+static_assert(sizeof(LocalParamsBlock) == 224, "std140 size of LocalParams");
+
+// layout(binding = 5, std430) readonly buffer Materials, one per entry of App::materials. std430
+// rounds the struct up to the alignment of its vec3s, the scalars fill their tails.
+struct alignas(16) MaterialParamsBlock
+{
+	glm::vec3 albedo;
+	f32 smoothness;
+	glm::vec3 emissive;
+	f32 bumpiness; // Relief materials only
+	f32 minLayers;
+	f32 maxLayers;
+	f32 padding0[2];
+};
+
+static_assert(offsetof(MaterialParamsBlock, albedo) == 0, "std430 layout of MaterialParams");
+static_assert(offsetof(MaterialParamsBlock, smoothness) == 12, "std430 layout of MaterialParams");
+static_assert(offsetof(MaterialParamsBlock, emissive) == 16, "std430 layout of MaterialParams");
+static_assert(offsetof(MaterialParamsBlock, bumpiness) == 28, "std430 layout of MaterialParams");
+static_assert(offsetof(MaterialParamsBlock, minLayers) == 32, "std430 layout of MaterialParams");
+static_assert(offsetof(MaterialParamsBlock, maxLayers) == 36, "std430 layout of MaterialParams");
+static_assert(sizeof(MaterialParamsBlock) == 48, "std430 array stride of MaterialParams");
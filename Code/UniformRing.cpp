@@ -0,0 +1,181 @@
+#include "UniformRing.h"
+#include "GLExtensions.h"
+
+namespace
+{
+	u8* GetSlotData(const UniformRing& ring, const UniformRingPage& page)
+	{
+		return ring.persistent ? page.mapped + (u64)ring.slot * ring.pageSize : page.mapped;
+	}
+
+	void CreatePage(UniformRing& ring)
+	{
+		UniformRingPage page = {};
+		const GLsizeiptr size = (GLsizeiptr)ring.pageSize * UNIFORM_RING_FRAMES;
+		glGenBuffers(1, &page.buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, page.buffer);
+		if (ring.persistent)
+		{
+			const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			CreateBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+			page.mapped = (u8*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags);
+		}
+		else
+		{
+			glBufferData(GL_COPY_WRITE_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+		if (ring.persistent && !page.mapped)
+		{
+			// Every page falls back to being mapped for each frame, written blocks stay valid
+			ELOG("glMapBufferRange() failed on a uniform ring page, uniforms are mapped every frame");
+			ring.persistent = false;
+			for (UniformRingPage& other : ring.pages)
+			{
+				glBindBuffer(GL_COPY_WRITE_BUFFER, other.buffer);
+				glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+				other.mapped = nullptr;
+			}
+			glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		}
+		ring.pages.push_back(page);
+	}
+
+	// The GPU may still read the other slots, so the range is mapped without synchronizing
+	void MapPageSlot(UniformRing& ring, UniformRingPage& page)
+	{
+		if (ring.persistent || page.mapped)
+			return;
+
+		const GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, page.buffer);
+		page.mapped = (u8*)glMapBufferRange(GL_COPY_WRITE_BUFFER, (GLintptr)ring.slot * ring.pageSize, ring.pageSize, access);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	}
+}
+
+void InitUniformRing(UniformRing& ring, u32 alignment, u32 pageSize)
+{
+	ring.alignment = alignment;
+	ring.pageSize = (pageSize + alignment - 1) / alignment * alignment;
+	ring.persistent = GLExt.bufferStorage != nullptr;
+	ring.slot = UNIFORM_RING_FRAMES - 1;
+	ring.page = 0;
+	ring.head = 0;
+	for (u32 i = 0; i < UNIFORM_RING_FRAMES; ++i)
+		ring.fences[i] = nullptr;
+
+	if (!ring.persistent)
+		ILOG("Persistent mapping is not available, uniform pages are mapped every frame");
+
+	CreatePage(ring);
+}
+
+void DestroyUniformRing(UniformRing& ring)
+{
+	for (u32 i = 0; i < UNIFORM_RING_FRAMES; ++i)
+	{
+		if (ring.fences[i])
+			glDeleteSync((GLsync)ring.fences[i]);
+		ring.fences[i] = nullptr;
+	}
+
+	for (UniformRingPage& page : ring.pages)
+	{
+		if (page.mapped)
+		{
+			glBindBuffer(GL_COPY_WRITE_BUFFER, page.buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+		glDeleteBuffers(1, &page.buffer);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+	ring.pages.clear();
+}
+
+void BeginUniformRingFrame(UniformRing& ring)
+{
+	ring.slot = (ring.slot + 1) % UNIFORM_RING_FRAMES;
+	ring.page = 0;
+	ring.head = 0;
+	ring.writing = true;
+	ring.framePages = 1;
+	ring.frameBytes = 0;
+	ring.frameWaits = 0;
+
+	GLsync fence = (GLsync)ring.fences[ring.slot];
+	if (fence)
+	{
+		GLenum status = glClientWaitSync(fence, 0, 0);
+		if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+		{
+			ring.frameWaits++;
+			ring.totalWaits++;
+			do
+			{
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (status == GL_TIMEOUT_EXPIRED);
+		}
+		glDeleteSync(fence);
+		ring.fences[ring.slot] = nullptr;
+	}
+
+	MapPageSlot(ring, ring.pages[0]);
+}
+
+UniformBlock AllocateUniformBlock(UniformRing& ring, u32 size)
+{
+	ASSERT(ring.writing, "BeginUniformRingFrame() must be called before allocating blocks");
+	ASSERT(size <= ring.pageSize, "A uniform block must fit in a page");
+
+	u32 offset = (ring.head + ring.alignment - 1) / ring.alignment * ring.alignment;
+	if (offset + size > ring.pageSize)
+	{
+		ring.page++;
+		ring.framePages++;
+		if (ring.page == ring.pages.size())
+			CreatePage(ring);
+		MapPageSlot(ring, ring.pages[ring.page]);
+		offset = 0;
+	}
+	ring.head = offset + size;
+	ring.frameBytes += size;
+
+	UniformRingPage& page = ring.pages[ring.page];
+	UniformBlock block;
+	block.buffer = page.buffer;
+	block.offset = ring.slot * ring.pageSize + offset;
+	block.data = GetSlotData(ring, page) + offset;
+	return block;
+}
+
+void FinishUniformRingWrites(UniformRing& ring)
+{
+	ring.writing = false;
+	if (ring.persistent)
+		return; // Coherent, the writes are visible to the draws that follow
+
+	for (u32 i = 0; i <= ring.page && i < ring.pages.size(); ++i)
+	{
+		UniformRingPage& page = ring.pages[i];
+		if (!page.mapped)
+			continue;
+		glBindBuffer(GL_COPY_WRITE_BUFFER, page.buffer);
+		glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		page.mapped = nullptr;
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void EndUniformRingFrame(UniformRing& ring)
+{
+	if (ring.fences[ring.slot])
+		glDeleteSync((GLsync)ring.fences[ring.slot]);
+	ring.fences[ring.slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+u64 GetUniformRingSize(const UniformRing& ring)
+{
+	return (u64)ring.pages.size() * ring.pageSize * UNIFORM_RING_FRAMES;
+}
@@ -0,0 +1,75 @@
+//
+// UniformRing.h: Per frame uniform data in persistently mapped buffers. Every page is split in
+// UNIFORM_RING_FRAMES slots, a frame writes only its own slot of each page and fences it once the
+// draws that read it are submitted, so the CPU fills the next frame while the GPU reads the last
+// ones. A frame that needs more than a page spills into further pages, each block is bound with
+// the handle of the page it landed in.
+//
+
+#pragma once
+
+#include "platform.h"
+
+#define UNIFORM_RING_FRAMES    3
+#define UNIFORM_RING_PAGE_SIZE (1024 * 1024) // Per frame slot, blocks are never larger than GL_MAX_UNIFORM_BLOCK_SIZE
+
+struct UniformRingPage
+{
+	u32 buffer;
+	u8* mapped; // Whole buffer while persistent, else the slot of the current frame between writes
+};
+
+struct UniformRing
+{
+	u32 pageSize;
+	u32 alignment; // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+	bool persistent; // False without glBufferStorage, pages are mapped unsynchronized every frame
+
+	std::vector<UniformRingPage> pages;
+	void* fences[UNIFORM_RING_FRAMES]; // GLsync after the draws of the frame that wrote the slot
+	u32 slot;
+	u32 page;  // Being written this frame
+	u32 head;  // In the slot of the current page
+	bool writing;
+
+	// Stats of the current frame and totals since startup
+	u32 framePages;
+	u32 frameBytes;
+	u32 frameWaits; // Slots that were still read by the GPU when the frame began
+	u32 totalWaits;
+};
+
+// Where a block was written, what glBindBufferRange needs
+struct UniformBlock
+{
+	u32 buffer;
+	u32 offset;
+	u8* data;
+};
+
+// GL thread, after the context is created
+void InitUniformRing(UniformRing& ring, u32 alignment, u32 pageSize = UNIFORM_RING_PAGE_SIZE);
+
+void DestroyUniformRing(UniformRing& ring);
+
+/**
+ * GL thread, before any block of the frame is allocated. Moves to the next slot and waits for
+ * the GPU to be done with the frame that wrote it, which with three slots is rarely a wait.
+ */
+void BeginUniformRingFrame(UniformRing& ring);
+
+/**
+ * Reserves size bytes at the alignment the driver wants for buffer ranges. A block that doesn't
+ * fit in what's left of the page goes to the next one, which is created the first time a frame
+ * needs it.
+ */
+UniformBlock AllocateUniformBlock(UniformRing& ring, u32 size);
+
+// GL thread, after the last block of the frame is written and before the draws that read them
+void FinishUniformRingWrites(UniformRing& ring);
+
+// GL thread, after the draws of the frame are submitted. Fences the slot.
+void EndUniformRingFrame(UniformRing& ring);
+
+// Video memory of every page, all slots included
+u64 GetUniformRingSize(const UniformRing& ring);
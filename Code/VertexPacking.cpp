@@ -0,0 +1,193 @@
+#include "VertexPacking.h"
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+	struct FloatVertexReader
+	{
+		i32 offsets[5]; // In floats, -1 if the attribute is missing
+		u32 floatStride;
+	};
+
+	FloatVertexReader MakeFloatVertexReader(const VertexBufferLayout& layout)
+	{
+		FloatVertexReader reader = {};
+		reader.floatStride = layout.stride / sizeof(float);
+		for (u32 i = 0; i < ARRAY_COUNT(reader.offsets); ++i)
+			reader.offsets[i] = -1;
+
+		for (const VertexBufferAttribute& attribute : layout.attributes)
+		{
+			if (attribute.location < ARRAY_COUNT(reader.offsets))
+				reader.offsets[attribute.location] = attribute.offset / sizeof(float);
+		}
+		return reader;
+	}
+
+	i16 QuantizeSnorm16(float value)
+	{
+		return (i16)glm::round(glm::clamp(value, -1.0f, 1.0f) * 32767.0f);
+	}
+
+	template <typename T>
+	void Append(std::vector<u8>& blob, const T& value)
+	{
+		const u8* bytes = (const u8*)&value;
+		blob.insert(blob.end(), bytes, bytes + sizeof(T));
+	}
+
+	void AlignBlob(std::vector<u8>& blob, u32 alignment)
+	{
+		while (blob.size() % alignment)
+			blob.push_back(0);
+	}
+
+	VertexBufferLayout MakeCompressedLayout(bool hasTexCoords, bool hasTangentSpace)
+	{
+		VertexBufferLayout layout = {};
+		layout.attributes.push_back(VertexBufferAttribute{ 0, 4, 0, VertexAttribute_Snorm16 });
+		layout.attributes.push_back(VertexBufferAttribute{ 1, 2, 8, VertexAttribute_Snorm16 });
+		layout.stride = 12;
+		if (hasTexCoords)
+		{
+			layout.attributes.push_back(VertexBufferAttribute{ 2, 2, layout.stride, VertexAttribute_Half });
+			layout.stride += 4;
+		}
+		if (hasTangentSpace)
+		{
+			layout.attributes.push_back(VertexBufferAttribute{ 3, 2, layout.stride, VertexAttribute_Snorm16 });
+			layout.stride += 4;
+		}
+		return layout;
+	}
+
+	void PackCompressedVertices(Submesh& submesh, const glm::vec3& scale, const glm::vec3& offset, std::vector<u8>& vertexData)
+	{
+		const FloatVertexReader reader = MakeFloatVertexReader(submesh.vertexBufferLayout);
+		const bool hasTexCoords = reader.offsets[2] >= 0;
+		const bool hasTangentSpace = reader.offsets[3] >= 0 && reader.offsets[4] >= 0;
+
+		for (u32 v = 0; v < submesh.vertexCount; ++v)
+		{
+			const float* vertex = &submesh.vertices[v * reader.floatStride];
+			glm::vec3 position = glm::make_vec3(vertex + reader.offsets[0]);
+			glm::vec3 normal = glm::normalize(glm::make_vec3(vertex + reader.offsets[1]));
+
+			// The bitangent is rebuilt from the normal and tangent, only its handedness is kept
+			float bitangentSign = 1.0f;
+			glm::vec3 tangent(1.0f, 0.0f, 0.0f);
+			if (hasTangentSpace)
+			{
+				tangent = glm::make_vec3(vertex + reader.offsets[3]);
+				glm::vec3 bitangent = glm::make_vec3(vertex + reader.offsets[4]);
+				bitangentSign = glm::dot(glm::cross(normal, tangent), bitangent) < 0.0f ? -1.0f : 1.0f;
+			}
+
+			glm::vec3 quantized = (position - offset) / scale;
+			Append(vertexData, QuantizeSnorm16(quantized.x));
+			Append(vertexData, QuantizeSnorm16(quantized.y));
+			Append(vertexData, QuantizeSnorm16(quantized.z));
+			Append(vertexData, QuantizeSnorm16(bitangentSign));
+
+			glm::vec2 octNormal = EncodeOctahedral(normal);
+			Append(vertexData, QuantizeSnorm16(octNormal.x));
+			Append(vertexData, QuantizeSnorm16(octNormal.y));
+
+			if (hasTexCoords)
+			{
+				Append(vertexData, glm::packHalf1x16(vertex[reader.offsets[2]]));
+				Append(vertexData, glm::packHalf1x16(vertex[reader.offsets[2] + 1]));
+			}
+
+			if (hasTangentSpace)
+			{
+				glm::vec2 octTangent = EncodeOctahedral(tangent);
+				Append(vertexData, QuantizeSnorm16(octTangent.x));
+				Append(vertexData, QuantizeSnorm16(octTangent.y));
+			}
+		}
+
+		submesh.vertexBufferLayout = MakeCompressedLayout(hasTexCoords, hasTangentSpace);
+	}
+}
+
+void GetPositionDequantization(VertexFormat format, const glm::vec3& aabbMin, const glm::vec3& aabbMax, glm::vec3& scale, glm::vec3& offset)
+{
+	if (format != VertexFormat_Compressed)
+	{
+		scale = glm::vec3(1.0f);
+		offset = glm::vec3(0.0f);
+		return;
+	}
+
+	// Flat meshes still need a non-zero scale on their flat axis
+	offset = 0.5f * (aabbMin + aabbMax);
+	scale = glm::max(0.5f * (aabbMax - aabbMin), glm::vec3(1e-6f));
+}
+
+void PackMeshGeometry(Mesh& mesh, VertexFormat format, const glm::vec3& aabbMin, const glm::vec3& aabbMax,
+	std::vector<u8>& vertexData, std::vector<u8>& indexData)
+{
+	glm::vec3 scale, offset;
+	GetPositionDequantization(format, aabbMin, aabbMax, scale, offset);
+
+	for (Submesh& submesh : mesh.submeshes)
+	{
+		submesh.vertexCount = submesh.vertices.size() / (submesh.vertexBufferLayout.stride / sizeof(float));
+		submesh.vertexOffset = (u32)vertexData.size();
+
+		if (format == VertexFormat_Compressed)
+		{
+			PackCompressedVertices(submesh, scale, offset, vertexData);
+		}
+		else
+		{
+			const u8* bytes = (const u8*)submesh.vertices.data();
+			vertexData.insert(vertexData.end(), bytes, bytes + submesh.vertices.size() * sizeof(float));
+		}
+
+		// Every submesh keeps its own vertex offset, so indices are relative to the submesh
+		submesh.indexSize = format == VertexFormat_Compressed && submesh.vertexCount <= 0xFFFF ? sizeof(u16) : sizeof(u32);
+		AlignBlob(indexData, submesh.indexSize);
+		submesh.indexOffset = (u32)indexData.size();
+		submesh.indexCount = (u32)submesh.indices.size();
+		if (submesh.lodCount == 0)
+		{
+			submesh.lodCount = 1;
+			submesh.lods[0] = SubmeshLod{ 0, submesh.indexCount, 0.0f };
+		}
+
+		for (u32 index : submesh.indices)
+		{
+			if (submesh.indexSize == sizeof(u16))
+				Append(indexData, (u16)index);
+			else
+				Append(indexData, index);
+		}
+
+		std::vector<float>().swap(submesh.vertices);
+		std::vector<u32>().swap(submesh.indices);
+	}
+}
+
+glm::vec2 EncodeOctahedral(glm::vec3 direction)
+{
+	direction /= glm::abs(direction.x) + glm::abs(direction.y) + glm::abs(direction.z);
+
+	glm::vec2 encoded(direction.x, direction.y);
+	if (direction.z < 0.0f)
+	{
+		glm::vec2 signs(encoded.x >= 0.0f ? 1.0f : -1.0f, encoded.y >= 0.0f ? 1.0f : -1.0f);
+		encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * signs;
+	}
+	return encoded;
+}
+
+glm::vec3 DecodeOctahedral(glm::vec2 encoded)
+{
+	glm::vec3 direction(encoded.x, encoded.y, 1.0f - glm::abs(encoded.x) - glm::abs(encoded.y));
+	float t = glm::max(-direction.z, 0.0f);
+	direction.x += direction.x >= 0.0f ? -t : t;
+	direction.y += direction.y >= 0.0f ? -t : t;
+	return glm::normalize(direction);
+}
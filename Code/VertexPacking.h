@@ -0,0 +1,42 @@
+//
+// VertexPacking.h: Layout of the vertex and index buffers. Imports produce full precision
+// floats and 32 bit indices, which are then packed either as they are or into a compressed
+// layout of quantized positions, octahedral normals/tangents and half float UVs.
+//
+
+#pragma once
+
+#include "platform.h"
+#include "Models.h"
+
+enum VertexFormat
+{
+	VertexFormat_Float = 0,  // 3 float position, normal, tangent, bitangent and 2 float UV
+	VertexFormat_Compressed, // See PackMeshGeometry
+	VertexFormat_Count
+};
+
+/**
+ * Compressed positions are stored in [-1, 1] relative to the bounds of the whole mesh.
+ * Returns the values that decode them, identity for float vertices.
+ */
+void GetPositionDequantization(VertexFormat format, const glm::vec3& aabbMin, const glm::vec3& aabbMax, glm::vec3& scale, glm::vec3& offset);
+
+/**
+ * Packs the float vertices and 32 bit indices of every submesh into one vertex and one
+ * index blob, laid out as the GPU buffers. Updates the layout, offsets and index size of
+ * each submesh and releases its CPU arrays. The bounds must contain every position.
+ *
+ * The compressed layout is 20 bytes per vertex instead of 56:
+ *   location 0: 4 x snorm16, position in the mesh bounds, w is the bitangent sign
+ *   location 1: 2 x snorm16, octahedral normal
+ *   location 2: 2 x half, UV
+ *   location 3: 2 x snorm16, octahedral tangent
+ * and uses 16 bit indices for submeshes with fewer than 65536 vertices.
+ */
+void PackMeshGeometry(Mesh& mesh, VertexFormat format, const glm::vec3& aabbMin, const glm::vec3& aabbMax,
+	std::vector<u8>& vertexData, std::vector<u8>& indexData);
+
+glm::vec2 EncodeOctahedral(glm::vec3 direction);
+
+glm::vec3 DecodeOctahedral(glm::vec2 encoded);
@@ -11,9 +11,21 @@
 #include <stb_image_write.h>
 
 #include <assimp/cimport.h>
+#include <assimp/cfileio.h>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include "BufferUtilities.h"
+#include "MeshCache.h"
+#include "VertexPacking.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Meshlets.h"
+#include "ObjImporter.h"
+#include "GltfImporter.h"
+#include "GeometryResidency.h"
+#include "UniformBlocks.h"
+#include <float.h>
+#include <algorithm>
 
 #define CreateConstantBuffer(size) CreateBuffer(size, GL_UNIFORM_BUFFER, GL_STREAM_DRAW)
 #define CreateStaticVertexBuffer(size) CreateBuffer(size, GL_ARRAY_BUFFER, GL_STATIC_DRAW)
@@ -25,6 +37,22 @@
 #define PushMat3(buffer, value) PushAlignedData(buffer, value_ptr(value), sizeof(value), sizeof(glm::vec4))
 #define PushMat4(buffer, value) PushAlignedData(buffer, value_ptr(value), sizeof(value), sizeof(glm::vec4))
 
+// Part of the mesh cache key, changing any of these invalidates the cooked meshes
+#define MODEL_IMPORT_FLAGS (aiProcess_Triangulate | \
+                            aiProcess_GenSmoothNormals | \
+                            aiProcess_CalcTangentSpace | \
+                            aiProcess_JoinIdenticalVertices | \
+                            aiProcess_PreTransformVertices | \
+                            aiProcess_OptimizeMeshes | \
+                            aiProcess_SortByPType)
+
+// Keeps the node tree: each mesh of the file is imported once, however many nodes place it
+#define MODEL_HIERARCHY_IMPORT_FLAGS (aiProcess_Triangulate | \
+                                      aiProcess_GenSmoothNormals | \
+                                      aiProcess_CalcTangentSpace | \
+                                      aiProcess_JoinIdenticalVertices | \
+                                      aiProcess_SortByPType)
+
 
 
 bool IsPowerOf2(u32 value)
@@ -103,7 +131,7 @@ namespace Utils
 
 
 
-GLuint CreateProgramFromSource(String programSource, const char* shaderName)
+GLuint CreateProgramFromSource(String programSource, const char* shaderName, const char* defines)
 {
     GLchar  infoLogBuffer[1024] = {};
     GLsizei infoLogBufferSize = sizeof(infoLogBuffer);
@@ -119,24 +147,28 @@ GLuint CreateProgramFromSource(String programSource, const char* shaderName)
     const GLchar* vertexShaderSource[] = {
         versionString,
         shaderNameDefine,
+        defines,
         vertexShaderDefine,
         programSource.str
     };
     const GLint vertexShaderLengths[] = {
         (GLint) strlen(versionString),
         (GLint) strlen(shaderNameDefine),
+        (GLint) strlen(defines),
         (GLint) strlen(vertexShaderDefine),
         (GLint) programSource.len
     };
     const GLchar* fragmentShaderSource[] = {
         versionString,
         shaderNameDefine,
+        defines,
         fragmentShaderDefine,
         programSource.str
     };
     const GLint fragmentShaderLengths[] = {
         (GLint) strlen(versionString),
         (GLint) strlen(shaderNameDefine),
+        (GLint) strlen(defines),
         (GLint) strlen(fragmentShaderDefine),
         (GLint) programSource.len
     };
@@ -185,12 +217,129 @@ GLuint CreateProgramFromSource(String programSource, const char* shaderName)
     return programHandle;
 }
 
-u32 LoadProgram(App* app, const char* filepath, const char* programName)
+GLuint CreateComputeProgramFromSource(String programSource, const char* shaderName, const char* defines)
+{
+    GLchar  infoLogBuffer[1024] = {};
+    GLsizei infoLogBufferSize = sizeof(infoLogBuffer);
+    GLsizei infoLogSize;
+    GLint   success;
+
+    char versionString[] = "#version 430\n";
+    char shaderNameDefine[128];
+    sprintf(shaderNameDefine, "#define %s\n", shaderName);
+    char computeShaderDefine[] = "#define COMPUTE\n";
+
+    const GLchar* computeShaderSource[] = {
+        versionString,
+        shaderNameDefine,
+        defines,
+        computeShaderDefine,
+        programSource.str
+    };
+    const GLint computeShaderLengths[] = {
+        (GLint) strlen(versionString),
+        (GLint) strlen(shaderNameDefine),
+        (GLint) strlen(defines),
+        (GLint) strlen(computeShaderDefine),
+        (GLint) programSource.len
+    };
+
+    GLuint cshader = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(cshader, ARRAY_COUNT(computeShaderSource), computeShaderSource, computeShaderLengths);
+    glCompileShader(cshader);
+    glGetShaderiv(cshader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        glGetShaderInfoLog(cshader, infoLogBufferSize, &infoLogSize, infoLogBuffer);
+        ELOG("glCompileShader() failed with compute shader %s\nReported message:\n%s\n", shaderName, infoLogBuffer);
+        assert(success);
+    }
+
+    GLuint programHandle = glCreateProgram();
+    glAttachShader(programHandle, cshader);
+    glLinkProgram(programHandle);
+    glGetProgramiv(programHandle, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        glGetProgramInfoLog(programHandle, infoLogBufferSize, &infoLogSize, infoLogBuffer);
+        ELOG("glLinkProgram() failed with program %s\nReported message:\n%s\n", shaderName, infoLogBuffer);
+    }
+
+    glDetachShader(programHandle, cshader);
+    glDeleteShader(cshader);
+
+    return programHandle;
+}
+
+// Looks up every active uniform and uniform block once, uploads go through the table after that
+void ReflectProgramUniforms(Program& program)
+{
+    GLint uniformCount = 0;
+    glGetProgramiv(program.handle, GL_ACTIVE_UNIFORMS, &uniformCount);
+    for (GLint i = 0; i < uniformCount; ++i)
+    {
+        char uniformName[128] = {};
+        GLsizei nameLength = 0;
+        ProgramUniform uniform = {};
+        glGetActiveUniform(program.handle, i, ARRAY_COUNT(uniformName), &nameLength, &uniform.arraySize, &uniform.type, uniformName);
+
+        // Members of uniform blocks have no location, they're written through the buffers
+        uniform.location = glGetUniformLocation(program.handle, uniformName);
+        if (uniform.location < 0)
+            continue;
+
+        // Arrays are reported as name[0], callers use the bare name
+        if (nameLength > 3 && strcmp(uniformName + nameLength - 3, "[0]") == 0)
+            uniformName[nameLength - 3] = '\0';
+
+        uniform.name = uniformName;
+        if (!program.uniforms.insert(std::make_pair(HashUniformName(uniformName), uniform)).second)
+            ELOG("Uniform %s of program %s collides with another name, it can't be uploaded by name", uniformName, program.programName.c_str());
+    }
+
+    GLint blockCount = 0;
+    glGetProgramiv(program.handle, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+    for (GLint i = 0; i < blockCount; ++i)
+    {
+        char blockName[128] = {};
+        ProgramUniformBlock block = {};
+        glGetActiveUniformBlockName(program.handle, i, ARRAY_COUNT(blockName), nullptr, blockName);
+        glGetActiveUniformBlockiv(program.handle, i, GL_UNIFORM_BLOCK_BINDING, &block.binding);
+        glGetActiveUniformBlockiv(program.handle, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.dataSize);
+        block.name = blockName;
+        program.uniformBlocks.push_back(block);
+    }
+}
+
+// Same file layout as the other programs, with a COMPUTE section instead of VERTEX and FRAGMENT
+u32 LoadComputeProgram(App* app, const char* filepath, const char* programName)
+{
+    String programSource = ReadTextFile(filepath);
+
+    Program program = {};
+    program.handle = CreateComputeProgramFromSource(programSource, programName, "");
+    program.filepath = filepath;
+    program.programName = programName;
+    program.lastWriteTimestamp = GetFileLastWriteTimestamp(filepath);
+    ReflectProgramUniforms(program);
+
+    app->programs.push_back(program);
+
+    return app->programs.size() - 1;
+}
+
+u32 LoadProgram(App* app, const char* filepath, const char* programName, const char* extraDefines = "")
 {
     String programSource = ReadTextFile(filepath);
 
     Program program = {};
-    program.handle = CreateProgramFromSource(programSource, programName);
+    // Mesh shaders decode the vertex format every mesh is packed with, and sample arrays when textures are pooled
+    std::string defines = extraDefines;
+    if (app->vertexFormat == VertexFormat_Compressed)
+        defines += "#define COMPRESSED_VERTICES\n";
+    if (app->textureArrays)
+        defines += "#define TEXTURE_ARRAYS\n";
+    program.handle = CreateProgramFromSource(programSource, programName, defines.c_str());
     program.filepath = filepath;
     program.programName = programName;
     program.lastWriteTimestamp = GetFileLastWriteTimestamp(filepath);
@@ -210,6 +359,7 @@ u32 LoadProgram(App* app, const char* filepath, const char* programName)
         program.vertexInputLayout.attributes.push_back({ location, Utils::GlToShader(type)});
 
     }
+    ReflectProgramUniforms(program);
 
 
     app->programs.push_back(program);
@@ -217,14 +367,114 @@ u32 LoadProgram(App* app, const char* filepath, const char* programName)
     return app->programs.size() - 1;
 }
 
+#pragma region Shader permutations
+u32 MakeShaderPermutationKey(const App* app, bool directionalLights, bool pointLights)
+{
+    u32 key = (u32)app->renderTarget & SHADER_KEY_RENDER_TARGET_MASK;
+    if (directionalLights)
+        key |= SHADER_KEY_DIRECTIONAL_LIGHTS;
+    if (pointLights)
+        key |= SHADER_KEY_POINT_LIGHTS;
+    if (app->exposureActive)
+        key |= SHADER_KEY_EXPOSURE;
+    key |= ((u32)app->reliefQuality << SHADER_KEY_RELIEF_QUALITY_SHIFT) & SHADER_KEY_RELIEF_QUALITY_MASK;
+    return key;
+}
+
+// Bits of a key that select a different variant of a program with these features
+u32 GetShaderFeatureMask(u32 features)
+{
+    u32 mask = 0;
+    if (features & ShaderFeature_RenderTarget)
+        mask |= SHADER_KEY_RENDER_TARGET_MASK;
+    if (features & ShaderFeature_LightTypes)
+        mask |= SHADER_KEY_DIRECTIONAL_LIGHTS | SHADER_KEY_POINT_LIGHTS;
+    if (features & ShaderFeature_Exposure)
+        mask |= SHADER_KEY_EXPOSURE;
+    if (features & ShaderFeature_ReliefQuality)
+        mask |= SHADER_KEY_RELIEF_QUALITY_MASK;
+    return mask;
+}
+
+std::string GetShaderFeatureDefines(u32 features, u32 key)
+{
+    char define[64];
+    std::string defines;
+    if (features & ShaderFeature_RenderTarget)
+    {
+        sprintf(define, "#define RENDER_TARGET %u\n", key & SHADER_KEY_RENDER_TARGET_MASK);
+        defines += define;
+    }
+    if ((features & ShaderFeature_LightTypes) && (key & SHADER_KEY_DIRECTIONAL_LIGHTS))
+        defines += "#define DIRECTIONAL_LIGHTS\n";
+    if ((features & ShaderFeature_LightTypes) && (key & SHADER_KEY_POINT_LIGHTS))
+        defines += "#define POINT_LIGHTS\n";
+    if ((features & ShaderFeature_Exposure) && (key & SHADER_KEY_EXPOSURE))
+        defines += "#define EXPOSURE\n";
+    if (features & ShaderFeature_ReliefQuality)
+    {
+        sprintf(define, "#define RELIEF_QUALITY %u\n", (key & SHADER_KEY_RELIEF_QUALITY_MASK) >> SHADER_KEY_RELIEF_QUALITY_SHIFT);
+        defines += define;
+    }
+    return defines;
+}
+
+/**
+ * Index in app->programs of the variant the current shader key needs. A key seen for the
+ * first time is compiled here, which pushes into app->programs, so callers look up every
+ * variant they need before taking references to programs.
+ */
+u32 GetProgramVariant(App* app, u32 permutationsIdx)
+{
+    ProgramPermutations& permutations = app->programPermutations[permutationsIdx];
+    const u32 key = app->shaderKey & GetShaderFeatureMask(permutations.features);
+
+    auto it = permutations.variants.find(key);
+    if (it != permutations.variants.end())
+        return it->second;
+
+    const std::string defines = GetShaderFeatureDefines(permutations.features, key);
+    const u32 programIdx = LoadProgram(app, permutations.filepath.c_str(), permutations.programName.c_str(), defines.c_str());
+    permutations.variants[key] = programIdx;
+    if (permutations.variants.size() > 1)
+        ILOG("Compiled variant %u of %s for key 0x%x", (u32)permutations.variants.size(), permutations.programName.c_str(), key);
+    return programIdx;
+}
+
+/**
+ * Program whose ShaderFeature defines are picked at draw time with GetProgramVariant instead of
+ * uniforms the shader branches on. The variant of the current key is compiled right away, the
+ * others the first time they're drawn with. Returns an index in app->programPermutations.
+ */
+u32 LoadProgramPermutations(App* app, const char* filepath, const char* programName, u32 features)
+{
+    ProgramPermutations permutations;
+    permutations.filepath = filepath;
+    permutations.programName = programName;
+    permutations.features = features;
+    app->programPermutations.push_back(permutations);
+
+    const u32 permutationsIdx = app->programPermutations.size() - 1;
+    GetProgramVariant(app, permutationsIdx);
+    return permutationsIdx;
+}
+#pragma endregion
+
 Image LoadImage(const char* filename)
 {
     Image img = {};
-    stbi_set_flip_vertically_on_load(true);
-    img.pixels = stbi_load(filename, &img.size.x, &img.size.y, &img.nchannels, 0);
+    stbi_set_flip_vertically_on_load_thread(true);
+    // Mapped so images inside the asset archive decode straight from it
+    MappedFile file = MapFile(filename);
+    if (file.data)
+    {
+        img.pixels = stbi_load_from_memory((const stbi_uc*)file.data, (int)file.size, &img.size.x, &img.size.y, &img.nchannels, 0);
+        UnmapFile(file);
+    }
     if (img.pixels)
     {
         img.stride = img.size.x * img.nchannels;
+        img.decodedByStb = true;
     }
     else
     {
@@ -235,65 +485,334 @@ Image LoadImage(const char* filename)
 
 void FreeImage(Image image)
 {
-    stbi_image_free(image.pixels);
+    if (image.decodedByStb)
+        stbi_image_free(image.pixels);
+    else
+        free(image.pixels);
 }
 
-GLuint CreateTexture2DFromImage(Image image)
+bool MapCookedTexture(const std::string& cookedPath, u64 sourceTimestamp, TextureUsage usage, CookedTexture& cooked)
 {
-    GLenum internalFormat = GL_RGB8;
-    GLenum dataFormat     = GL_RGB;
-    GLenum dataType       = GL_UNSIGNED_BYTE;
+    cooked.file = MapGeneratedFile(cookedPath.c_str());
+    if (ReadCookedTexture(cooked.file.data, cooked.file.size, sourceTimestamp, usage, cooked.view))
+        return true;
+
+    UnmapFile(cooked.file);
+    return false;
+}
 
-    switch (image.nchannels)
+// Cooks decoded pixels into the job and writes the container for the next run. The pixels
+// are left alone, returns false if they have to be uploaded uncompressed instead.
+bool CookJobTexture(AssetJob* job, const u8* pixels, u32 width, u32 height, u32 channels, u64 sourceTimestamp, const std::string& cookedPath)
+{
+    CookedTexture& cooked = job->cooked;
+    if (!CookTexture(pixels, width, height, channels, job->textureUsage, sourceTimestamp, cooked.memory) ||
+        !ReadCookedTexture(cooked.memory.data(), cooked.memory.size(), sourceTimestamp, job->textureUsage, cooked.view))
     {
-        case 3: dataFormat = GL_RGB; internalFormat = GL_RGB8; break;
-        case 4: dataFormat = GL_RGBA; internalFormat = GL_RGBA8; break;
-        default: ELOG("LoadTexture2D() - Unsupported number of channels");
+        ELOG("Could not cook texture %s, uploading it uncompressed", job->filepath.c_str());
+        cooked = {};
+        return false;
     }
 
-    GLuint texHandle;
-    glGenTextures(1, &texHandle);
-    glBindTexture(GL_TEXTURE_2D, texHandle);
-    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, image.size.x, image.size.y, 0, dataFormat, dataType, image.pixels);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    glBindTexture(GL_TEXTURE_2D, 0);
-
-    return texHandle;
+    if (!cookedPath.empty())
+        WriteCookedTexture(cookedPath.c_str(), cooked.memory);
+    return true;
 }
 
-u32 LoadTexture2D(App* app, const char* filepath)
+// Runs on a worker. Uses the cooked container if it's up to date, otherwise decodes the
+// image, cooks it and writes the container for the next run.
+bool LoadCookedTexture(AssetJob* job)
 {
-    for (u32 texIdx = 0; texIdx < app->textures.size(); ++texIdx)
-        if (app->textures[texIdx].filepath == filepath)
-            return texIdx;
+    const char* filepath = job->filepath.c_str();
+    u64 sourceTimestamp = GetFileLastWriteTimestamp(filepath);
+    std::string cookedPath = GetCookedTexturePath(filepath);
+
+    if (MapCookedTexture(cookedPath, sourceTimestamp, job->textureUsage, job->cooked))
+        return true;
 
     Image image = LoadImage(filepath);
+    if (!image.pixels)
+        return false;
+
+    if (CookJobTexture(job, (const u8*)image.pixels, image.size.x, image.size.y, image.nchannels, sourceTimestamp, cookedPath))
+        FreeImage(image);
+    else
+        job->image = image;
+
+    return true;
+}
+
+// Runs on a worker. Decodes every source of the pack once and combines them into one
+// RGBA image, which is cooked like any other texture.
+bool LoadPackedTexture(AssetJob* job)
+{
+    const TexturePackDesc& pack = job->texturePack;
+    std::string cookedPath = GetCookedTexturePackPath(pack);
 
-    if (image.pixels)
+    u64 sourceTimestamp = 0;
+    for (u32 c = 0; c < 4; ++c)
     {
-        Texture tex = {};
-        tex.handle = CreateTexture2DFromImage(image);
-        tex.filepath = filepath;
+        if (!pack.sources[c].empty())
+            sourceTimestamp = glm::max(sourceTimestamp, GetFileLastWriteTimestamp(pack.sources[c].c_str()));
+    }
 
-        u32 texIdx = app->textures.size();
-        app->textures.push_back(tex);
+    if (job->compressTexture && !cookedPath.empty() && MapCookedTexture(cookedPath, sourceTimestamp, job->textureUsage, job->cooked))
+        return true;
 
-        FreeImage(image);
-        return texIdx;
+    Image images[4] = {};
+    TexturePackSource sources[4] = {};
+    for (u32 c = 0; c < 4; ++c)
+    {
+        if (pack.sources[c].empty())
+            continue;
+
+        // Normal maps feed three channels from the same file
+        u32 decoded = c;
+        for (u32 previous = 0; previous < c; ++previous)
+        {
+            if (pack.sources[previous] == pack.sources[c])
+                decoded = previous;
+        }
+
+        if (decoded == c)
+            images[c] = LoadImage(pack.sources[c].c_str());
+
+        const Image& image = images[decoded];
+        if (image.pixels)
+            sources[c] = { (const u8*)image.pixels, (u32)image.size.x, (u32)image.size.y, (u32)image.nchannels };
     }
-    else
+
+    // OBJ materials often reference their normal map as map_Bump, which lands in the height slot
+    if (job->textureUsage == TextureUsage_NormalHeight && !sources[0].pixels && sources[3].pixels &&
+        LooksLikeNormalMap(sources[3].pixels, sources[3].width, sources[3].height, sources[3].channels))
+    {
+        for (u32 c = 0; c < 3; ++c)
+            sources[c] = sources[3];
+        sources[3] = {};
+    }
+
+    std::vector<u8> rgba;
+    u32 width = 0, height = 0;
+    bool packed = PackTextureChannels(pack, sources, rgba, width, height);
+
+    for (u32 c = 0; c < 4; ++c)
+    {
+        if (images[c].pixels)
+            FreeImage(images[c]);
+    }
+
+    if (!packed)
+        return false;
+
+    if (job->compressTexture && CookJobTexture(job, rgba.data(), width, height, 4, sourceTimestamp, cookedPath))
+        return true;
+
+    job->image.size = glm::ivec2(width, height);
+    job->image.nchannels = 4;
+    job->image.stride = width * 4;
+    job->image.pixels = malloc(rgba.size());
+    memcpy(job->image.pixels, rgba.data(), rgba.size());
+    return true;
+}
+
+u32 LoadTexture2D(App* app, const char* filepath, TextureUsage usage = TextureUsage_Color)
+{
+    std::string key = MakeAssetKey(filepath);
+    u32 existingTexIdx = FindAsset(app->assets.textures, key);
+    if (existingTexIdx != UINT32_MAX)
+        return existingTexIdx;
+
+    // Reserve the slot now, the handle is created once a worker has decoded the image
+    Texture tex = {};
+    tex.filepath = filepath;
+    tex.usage = usage;
+
+    u32 texIdx = app->textures.size();
+    app->textures.push_back(tex);
+    RegisterAsset(app->assets.textures, key, texIdx);
+
+    AssetJob* job = new AssetJob{};
+    job->type = AssetJob_Texture;
+    job->assetIdx = texIdx;
+    job->filepath = filepath;
+    job->textureUsage = usage;
+    job->compressTexture = app->compressTextures;
+    job->streamTexture = app->textureStreaming && !app->textureArrays;
+    job->uploadRing = &app->textureUploadRing;
+    SubmitAssetJob(app->assetLoader, job);
+
+    return texIdx;
+}
+
+/**
+ * Combines single channel maps into one texture, see TexturePackDesc. The pack is
+ * registered under the key of its sources so materials sharing them share the texture.
+ */
+u32 LoadPackedTexture2D(App* app, const TexturePackDesc& pack, TextureUsage usage)
+{
+    std::string key = MakeAssetKey(GetTexturePackKey(pack).c_str());
+    u32 existingTexIdx = FindAsset(app->assets.textures, key);
+    if (existingTexIdx != UINT32_MAX)
+        return existingTexIdx;
+
+    Texture tex = {};
+    tex.filepath = key;
+    tex.usage = usage;
+
+    u32 texIdx = app->textures.size();
+    app->textures.push_back(tex);
+    RegisterAsset(app->assets.textures, key, texIdx);
+
+    AssetJob* job = new AssetJob{};
+    job->type = AssetJob_PackedTexture;
+    job->assetIdx = texIdx;
+    job->filepath = key;
+    job->textureUsage = usage;
+    job->texturePack = pack;
+    job->compressTexture = app->compressTextures;
+    job->streamTexture = app->textureStreaming && !app->textureArrays;
+    job->uploadRing = &app->textureUploadRing;
+    SubmitAssetJob(app->assetLoader, job);
+
+    return texIdx;
+}
+
+// Puts the texture in the array pool of its size and format, its handle becomes a view of the layer
+void AddTextureToPool(App* app, u32 texIdx, TextureUpload& upload)
+{
+    Texture& tex = app->textures[texIdx];
+    TextureArraySlot slot = AddTextureToArray(app->texturePools, app->textureUploadRing, upload, texIdx);
+    TextureArrayPool& pool = app->texturePools.pools[slot.pool];
+    tex.arrayPool = slot.pool;
+    tex.arrayLayer = slot.layer;
+
+    // Views keep the storage they were made from alive, so a grown pool needs new ones
+    if (slot.grown)
     {
-        return UINT32_MAX;
+        for (u32 layer = 0; layer < slot.layer; ++layer)
+        {
+            Texture& layerTex = app->textures[pool.layerOwners[layer]];
+            glDeleteTextures(1, &layerTex.handle);
+            layerTex.handle = CreateTextureArrayLayerView(pool, layer);
+        }
     }
+
+    tex.handle = CreateTextureArrayLayerView(pool, slot.layer);
+    app->materialLayersDirty = true;
 }
 
+void CommitTexture(App* app, AssetJob* job)
+{
+    if (!job->succeeded)
+        return;
+
+    Texture& tex = app->textures[job->assetIdx];
+    const TextureUpload& upload = job->upload;
+    const TextureMipChain& chain = job->chain;
+    if (app->textureArrays)
+        AddTextureToPool(app, job->assetIdx, job->upload);
+    else
+        tex.handle = CreateTextureFromUpload(app->textureUploadRing, job->upload);
+    tex.fullSize = GetMipChainSize(chain, 0);
+    tex.gpuSize = GetMipChainSize(chain, upload.firstMip);
+    tex.uncompressedSize = chain.uncompressedSize;
+
+    if (tex.fullSize < tex.uncompressedSize)
+    {
+        ILOG("Texture %s: %s %ux%u, %u mips, %.2f MB instead of %.2f MB",
+            tex.filepath.c_str(), GetTextureUploadFormatName(chain.format),
+            chain.width, chain.height, chain.mipCount,
+            tex.fullSize / (1024.0 * 1024.0), tex.uncompressedSize / (1024.0 * 1024.0));
+    }
+
+    // Streamed textures keep the chain, their finer levels come in once something needs them
+    tex.residency = TextureResidency{};
+    tex.residency.residentMip = upload.firstMip;
+    if (job->streamTexture)
+    {
+        tex.residency.chain = std::move(job->chain);
+        BeginTextureResidencyFrame(tex.residency);
+    }
+}
 
 #pragma region ModelLoad
+// Assimp opens the model and every file it references through MapFile, so models inside the asset archive load too
+struct AssimpFile
+{
+    MappedFile mapping;
+    size_t     cursor;
+};
+
+size_t AssimpFileRead(aiFile* file, char* buffer, size_t size, size_t count)
+{
+    AssimpFile* assimpFile = (AssimpFile*)file->UserData;
+    if (size == 0)
+        return 0;
+
+    count = glm::min(count, (size_t)(assimpFile->mapping.size - assimpFile->cursor) / size);
+    memcpy(buffer, (const u8*)assimpFile->mapping.data + assimpFile->cursor, size * count);
+    assimpFile->cursor += size * count;
+    return count;
+}
+
+size_t AssimpFileWrite(aiFile*, const char*, size_t, size_t)
+{
+    // Imports never write, and AssimpFileOpen refuses write modes
+    return 0;
+}
+
+size_t AssimpFileTell(aiFile* file)
+{
+    return ((AssimpFile*)file->UserData)->cursor;
+}
+
+size_t AssimpFileSize(aiFile* file)
+{
+    return (size_t)((AssimpFile*)file->UserData)->mapping.size;
+}
+
+aiReturn AssimpFileSeek(aiFile* file, size_t offset, aiOrigin origin)
+{
+    AssimpFile* assimpFile = (AssimpFile*)file->UserData;
+    size_t base = origin == aiOrigin_CUR ? assimpFile->cursor : origin == aiOrigin_END ? (size_t)assimpFile->mapping.size : 0;
+    if (base + offset > assimpFile->mapping.size)
+        return aiReturn_FAILURE;
+
+    assimpFile->cursor = base + offset;
+    return aiReturn_SUCCESS;
+}
+
+void AssimpFileFlush(aiFile*)
+{
+}
+
+aiFile* AssimpFileOpen(aiFileIO*, const char* filepath, const char* mode)
+{
+    if (strchr(mode, 'w') || strchr(mode, 'a'))
+        return nullptr;
+
+    MappedFile mapping = MapFile(filepath);
+    if (!mapping.data)
+        return nullptr;
+
+    AssimpFile* assimpFile = new AssimpFile{ mapping, 0 };
+    return new aiFile{ AssimpFileRead, AssimpFileWrite, AssimpFileTell, AssimpFileSize, AssimpFileSeek, AssimpFileFlush, (aiUserData)assimpFile };
+}
+
+void AssimpFileClose(aiFileIO*, aiFile* file)
+{
+    AssimpFile* assimpFile = (AssimpFile*)file->UserData;
+    UnmapFile(assimpFile->mapping);
+    delete assimpFile;
+    delete file;
+}
+
+const aiScene* ImportAssimpScene(const char* filename, u32 importFlags)
+{
+    aiFileIO fileSystem = { AssimpFileOpen, AssimpFileClose, nullptr };
+    return aiImportFileEx(filename, importFlags, &fileSystem);
+}
+
 void ProcessAssimpMesh(const aiScene* scene, aiMesh* mesh, Mesh* myMesh, u32 baseMeshMaterialIndex, std::vector<u32>& submeshMaterialIndices)
 {
     std::vector<float> vertices;
@@ -302,6 +821,9 @@ void ProcessAssimpMesh(const aiScene* scene, aiMesh* mesh, Mesh* myMesh, u32 bas
     bool hasTexCoords = false;
     bool hasTangentSpace = false;
 
+    vertices.reserve(mesh->mNumVertices * 14);
+    indices.reserve(mesh->mNumFaces * 3);
+
     // process vertices
     for (unsigned int i = 0; i < mesh->mNumVertices; i++)
     {
@@ -355,20 +877,20 @@ void ProcessAssimpMesh(const aiScene* scene, aiMesh* mesh, Mesh* myMesh, u32 bas
 
     // create the vertex format
     VertexBufferLayout vertexBufferLayout = {};
-    vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 0, 3, 0 });
-    vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 1, 3, 3 * sizeof(float) });
+    vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 0, 3, 0, VertexAttribute_Float });
+    vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 1, 3, 3 * sizeof(float), VertexAttribute_Float });
     vertexBufferLayout.stride = 6 * sizeof(float);
     if (hasTexCoords)
     {
-        vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 2, 2, vertexBufferLayout.stride });
+        vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 2, 2, vertexBufferLayout.stride, VertexAttribute_Float });
         vertexBufferLayout.stride += 2 * sizeof(float);
     }
     if (hasTangentSpace)
     {
-        vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 3, 3, vertexBufferLayout.stride });
+        vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 3, 3, vertexBufferLayout.stride, VertexAttribute_Float });
         vertexBufferLayout.stride += 3 * sizeof(float);
 
-        vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 4, 3, vertexBufferLayout.stride });
+        vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 4, 3, vertexBufferLayout.stride, VertexAttribute_Float });
         vertexBufferLayout.stride += 3 * sizeof(float);
     }
 
@@ -380,7 +902,7 @@ void ProcessAssimpMesh(const aiScene* scene, aiMesh* mesh, Mesh* myMesh, u32 bas
     myMesh->submeshes.push_back(submesh);
 }
 
-void ProcessAssimpMaterial(App* app, aiMaterial* material, Material& myMaterial, String directory)
+void ProcessAssimpMaterial(aiMaterial* material, MaterialDesc& myMaterial)
 {
     aiString name;
     aiColor3D diffuseColor;
@@ -398,46 +920,125 @@ void ProcessAssimpMaterial(App* app, aiMaterial* material, Material& myMaterial,
     myMaterial.emissive = vec3(emissiveColor.r, emissiveColor.g, emissiveColor.b);
     myMaterial.smoothness = shininess / 256.0f;
 
+    // Textures are only recorded here, CreateMaterial loads them
     aiString aiFilename;
     if (material->GetTextureCount(aiTextureType_DIFFUSE) > 0)
     {
         material->GetTexture(aiTextureType_DIFFUSE, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.albedoTextureIdx = LoadTexture2D(app, filepath.str);
+        myMaterial.albedoTexture = aiFilename.C_Str();
     }
     if (material->GetTextureCount(aiTextureType_EMISSIVE) > 0)
     {
         material->GetTexture(aiTextureType_EMISSIVE, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.emissiveTextureIdx = LoadTexture2D(app, filepath.str);
+        myMaterial.emissiveTexture = aiFilename.C_Str();
     }
     if (material->GetTextureCount(aiTextureType_SPECULAR) > 0)
     {
         material->GetTexture(aiTextureType_SPECULAR, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.specularTextureIdx = LoadTexture2D(app, filepath.str);
+        myMaterial.specularTexture = aiFilename.C_Str();
     }
     if (material->GetTextureCount(aiTextureType_NORMALS) > 0)
     {
         material->GetTexture(aiTextureType_NORMALS, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.normalsTextureIdx = LoadTexture2D(app, filepath.str);
+        myMaterial.normalsTexture = aiFilename.C_Str();
     }
     if (material->GetTextureCount(aiTextureType_HEIGHT) > 0)
     {
         material->GetTexture(aiTextureType_HEIGHT, 0, &aiFilename);
-        String filename = MakeString(aiFilename.C_Str());
-        String filepath = MakePath(directory, filename);
-        myMaterial.bumpTextureIdx = LoadTexture2D(app, filepath.str);
+        myMaterial.bumpTexture = aiFilename.C_Str();
+    }
+
+    // Blender exports roughness as map_Ns and metallic as map_refl. Ambient occlusion comes
+    // as map_Ka in OBJ, or as a lightmap from other formats.
+    if (material->GetTextureCount(aiTextureType_SHININESS) > 0)
+    {
+        material->GetTexture(aiTextureType_SHININESS, 0, &aiFilename);
+        myMaterial.roughnessTexture = aiFilename.C_Str();
+    }
+    if (material->GetTextureCount(aiTextureType_REFLECTION) > 0)
+    {
+        material->GetTexture(aiTextureType_REFLECTION, 0, &aiFilename);
+        myMaterial.metallicTexture = aiFilename.C_Str();
+    }
+    if (material->GetTextureCount(aiTextureType_AMBIENT) > 0)
+    {
+        material->GetTexture(aiTextureType_AMBIENT, 0, &aiFilename);
+        myMaterial.occlusionTexture = aiFilename.C_Str();
+    }
+    else if (material->GetTextureCount(aiTextureType_LIGHTMAP) > 0)
+    {
+        material->GetTexture(aiTextureType_LIGHTMAP, 0, &aiFilename);
+        myMaterial.occlusionTexture = aiFilename.C_Str();
     }
 
     //myMaterial.createNormalFromBump();
 }
 
+u32 LoadMaterialTexture(App* app, String directory, const std::string& filename, TextureUsage usage = TextureUsage_Color)
+{
+    if (filename.empty())
+        return 0;
+
+    String filepath = MakePath(directory, MakeString(filename.c_str()));
+    return LoadTexture2D(app, filepath.str, usage);
+}
+
+std::string MakeMaterialTexturePath(String directory, const std::string& filename)
+{
+    if (filename.empty())
+        return std::string();
+
+    return MakePath(directory, MakeString(filename.c_str())).str;
+}
+
+void CreateMaterial(App* app, const MaterialDesc& desc, String directory, Material& myMaterial)
+{
+    myMaterial.name = desc.name;
+    myMaterial.albedo = desc.albedo;
+    myMaterial.emissive = desc.emissive;
+    myMaterial.smoothness = desc.smoothness;
+    myMaterial.albedoTextureIdx = LoadMaterialTexture(app, directory, desc.albedoTexture);
+    myMaterial.emissiveTextureIdx = LoadMaterialTexture(app, directory, desc.emissiveTexture);
+    myMaterial.specularTextureIdx = LoadMaterialTexture(app, directory, desc.specularTexture);
+
+    // Scalar maps are packed so the shaders sample one texture instead of three
+    myMaterial.ormTextureIdx = UINT32_MAX;
+    if (!desc.occlusionTexture.empty() || !desc.roughnessTexture.empty() || !desc.metallicTexture.empty())
+    {
+        TexturePackDesc orm = MakeOrmPackDesc(MakeMaterialTexturePath(directory, desc.occlusionTexture),
+            MakeMaterialTexturePath(directory, desc.roughnessTexture), MakeMaterialTexturePath(directory, desc.metallicTexture));
+        orm.sourceChannels[0] = desc.occlusionChannel;
+        orm.sourceChannels[1] = desc.roughnessChannel;
+        orm.sourceChannels[2] = desc.metallicChannel;
+        myMaterial.ormTextureIdx = LoadPackedTexture2D(app, orm, TextureUsage_Color);
+    }
+
+    myMaterial.normalHeightTextureIdx = UINT32_MAX;
+    if (!desc.normalsTexture.empty() || !desc.bumpTexture.empty())
+    {
+        TexturePackDesc normalHeight = MakeNormalHeightPackDesc(MakeMaterialTexturePath(directory, desc.normalsTexture),
+            MakeMaterialTexturePath(directory, desc.bumpTexture));
+        myMaterial.normalHeightTextureIdx = LoadPackedTexture2D(app, normalHeight, TextureUsage_NormalHeight);
+    }
+}
+
+u32 FindOrCreateMaterial(App* app, const MaterialDesc& desc, String directory)
+{
+    std::string key = MakeMaterialKey(directory.str, desc);
+    u32 materialIdx = FindAsset(app->assets.materials, key);
+    if (materialIdx != UINT32_MAX)
+        return materialIdx;
+
+    app->materials.push_back(Material{});
+    CreateMaterial(app, desc, directory, app->materials.back());
+    app->materialLayersDirty = true;
+    app->materialParamsDirty = true;
+
+    materialIdx = (u32)app->materials.size() - 1u;
+    RegisterAsset(app->assets.materials, key, materialIdx);
+    return materialIdx;
+}
+
 void ProcessAssimpNode(const aiScene* scene, aiNode* node, Mesh* myMesh, u32 baseMeshMaterialIndex, std::vector<u32>& submeshMaterialIndices)
 {
     // process all the node's meshes (if any)
@@ -454,136 +1055,1436 @@ void ProcessAssimpNode(const aiScene* scene, aiNode* node, Mesh* myMesh, u32 bas
     }
 }
 
-u32 LoadModel(App* app, const char* filename)
+// Walks the node tree, parents before children, recording which submeshes every node places.
+// Submesh i is mesh i of the scene.
+void ProcessAssimpHierarchy(aiNode* node, u32 parent, std::vector<ModelNode>& nodes, std::vector<SubmeshInstance>& instances)
 {
-    const aiScene* scene = aiImportFile(filename,
-        aiProcess_Triangulate |
-        aiProcess_GenSmoothNormals |
-        aiProcess_CalcTangentSpace |
-        aiProcess_JoinIdenticalVertices |
-        aiProcess_PreTransformVertices |
-        aiProcess_ImproveCacheLocality |
-        aiProcess_OptimizeMeshes |
-        aiProcess_SortByPType);
+    ModelNode myNode = {};
+    myNode.name = node->mName.C_Str();
+    myNode.parent = parent;
+    myNode.transform = glm::transpose(glm::make_mat4(&node->mTransformation.a1)); // Assimp matrices are row major
 
-    if (!scene)
+    u32 nodeIdx = (u32)nodes.size();
+    nodes.push_back(myNode);
+
+    for (unsigned int i = 0; i < node->mNumMeshes; i++)
     {
-        ELOG("Error loading mesh %s: %s", filename, aiGetErrorString());
-        return UINT32_MAX;
+        instances.push_back(SubmeshInstance{ node->mMeshes[i], nodeIdx });
     }
 
-    app->meshes.push_back(Mesh{});
-    Mesh& mesh = app->meshes.back();
-    u32 meshIdx = (u32)app->meshes.size() - 1u;
+    for (unsigned int i = 0; i < node->mNumChildren; i++)
+    {
+        ProcessAssimpHierarchy(node->mChildren[i], nodeIdx, nodes, instances);
+    }
+}
 
-    app->models.push_back(Model{});
-    Model& model = app->models.back();
-    model.meshIdx = meshIdx;
-    u32 modelIdx = (u32)app->models.size() - 1u;
+// Model space transform of every node
+void ComputeNodeModelTransforms(const std::vector<ModelNode>& nodes, std::vector<glm::mat4>& transforms)
+{
+    transforms.resize(nodes.size());
+    for (u32 i = 0; i < nodes.size(); ++i)
+    {
+        const ModelNode& node = nodes[i];
+        transforms[i] = node.parent == UINT32_MAX ? node.transform : transforms[node.parent] * node.transform;
+    }
+}
+
+// Only the placed instances count, the node local vertices on their own are nowhere in the model
+void ComputeInstanceBounds(const Mesh& mesh, const std::vector<ModelNode>& nodes, const std::vector<SubmeshInstance>& instances,
+    glm::vec3& aabbMin, glm::vec3& aabbMax)
+{
+    std::vector<glm::mat4> transforms;
+    ComputeNodeModelTransforms(nodes, transforms);
 
-    String directory = GetDirectoryPart(MakeString(filename));
+    aabbMin = glm::vec3(FLT_MAX);
+    aabbMax = glm::vec3(-FLT_MAX);
 
-    // Create a list of materials
-    u32 baseMeshMaterialIndex = (u32)app->materials.size();
-    for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+    for (const SubmeshInstance& instance : instances)
     {
-        app->materials.push_back(Material{});
-        Material& material = app->materials.back();
-        ProcessAssimpMaterial(app, scene->mMaterials[i], material, directory);
+        const Submesh& submesh = mesh.submeshes[instance.submesh];
+        const u32 floatStride = submesh.vertexBufferLayout.stride / sizeof(float);
+        for (u32 i = 0; i + 2 < submesh.vertices.size(); i += floatStride)
+        {
+            glm::vec3 position = glm::vec3(transforms[instance.node] * glm::vec4(glm::make_vec3(&submesh.vertices[i]), 1.0f));
+            aabbMin = glm::min(aabbMin, position);
+            aabbMax = glm::max(aabbMax, position);
+        }
     }
 
-    ProcessAssimpNode(scene, scene->mRootNode, &mesh, baseMeshMaterialIndex, model.materialIdx);
+    if (aabbMin.x > aabbMax.x)
+    {
+        aabbMin = glm::vec3(0.0f);
+        aabbMax = glm::vec3(0.0f);
+    }
+}
 
-    aiReleaseImport(scene);
+void UploadMesh(App* app, Mesh& mesh, const void* vertexData, const void* indexData)
+{
+    for (Submesh& submesh : mesh.submeshes)
+    {
+        const u8* submeshVertices = (const u8*)vertexData + submesh.vertexOffset;
+        const u8* submeshIndices = (const u8*)indexData + submesh.indexOffset;
+        UploadSubmeshGeometry(app->geometryArena, submesh, submeshVertices, submeshIndices);
+
+        submesh.firstMeshlet = (u32)app->meshlets.size();
+        submesh.meshletCount = (u32)submesh.meshlets.size();
+        app->meshlets.insert(app->meshlets.end(), submesh.meshlets.begin(), submesh.meshlets.end());
+        std::vector<Meshlet>().swap(submesh.meshlets);
+        app->meshletBufferDirty = true;
+    }
+}
+
+u32 GetModelImportFlags(bool preserveHierarchy)
+{
+    return preserveHierarchy ? MODEL_HIERARCHY_IMPORT_FLAGS : MODEL_IMPORT_FLAGS;
+}
 
-    u32 vertexBufferSize = 0;
-    u32 indexBufferSize = 0;
+// Runs on the asset workers: no OpenGL and no frame arena in here
+bool ImportModelFromCache(const char* filename, u64 sourceTimestamp, VertexFormat vertexFormat, u32 importFlags, ImportedModel& imported)
+{
+    std::string cachePath = GetMeshCachePath(filename);
 
-    for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+    MappedFile cacheFile = MapGeneratedFile(cachePath.c_str());
+    MeshCacheView cache = {};
+    if (!ReadMeshCache(cacheFile, sourceTimestamp, importFlags, vertexFormat, &cache))
+    {
+        UnmapFile(cacheFile);
+        return false;
+    }
+
+    for (u32 i = 0; i < cache.header->materialCount; ++i)
+    {
+        imported.materials.push_back(GetCachedMaterial(cache.materials[i]));
+    }
+
+    for (u32 i = 0; i < cache.header->submeshCount; ++i)
     {
-        vertexBufferSize += mesh.submeshes[i].vertices.size() * sizeof(float);
-        indexBufferSize += mesh.submeshes[i].indices.size() * sizeof(u32);
+        const MeshCacheSubmesh& cachedSubmesh = cache.submeshes[i];
+
+        Submesh submesh = {};
+        submesh.vertexBufferLayout = GetCachedVertexLayout(cachedSubmesh);
+        submesh.vertexOffset = cachedSubmesh.vertexOffset;
+        submesh.vertexCount = cachedSubmesh.vertexSize / cachedSubmesh.stride;
+        submesh.indexOffset = cachedSubmesh.indexOffset;
+        submesh.indexCount = cachedSubmesh.indexCount;
+        submesh.indexSize = cachedSubmesh.indexSize;
+        submesh.cacheStats = { cachedSubmesh.acmrBefore, cachedSubmesh.acmrAfter, cachedSubmesh.atvrBefore, cachedSubmesh.atvrAfter };
+        submesh.lodCount = glm::clamp((u32)cachedSubmesh.lodCount, 1u, (u32)MESH_MAX_LODS);
+        for (u32 j = 0; j < submesh.lodCount; ++j)
+            submesh.lods[j] = SubmeshLod{ cachedSubmesh.lods[j].firstIndex, cachedSubmesh.lods[j].indexCount, cachedSubmesh.lods[j].error };
+        for (u32 j = 0; j < cachedSubmesh.meshletCount; ++j)
+            submesh.meshlets.push_back(GetCachedMeshlet(cache.meshlets[cachedSubmesh.firstMeshlet + j]));
+        imported.submeshes.push_back(submesh);
+
+        imported.submeshMaterials.push_back(cachedSubmesh.materialIndex);
     }
 
-    glGenBuffers(1, &mesh.vertexBufferHandle);
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferHandle);
-    glBufferData(GL_ARRAY_BUFFER, vertexBufferSize, NULL, GL_STATIC_DRAW);
+    for (u32 i = 0; i < cache.header->nodeCount; ++i)
+        imported.nodes.push_back(GetCachedNode(cache.nodes[i]));
+    for (u32 i = 0; i < cache.header->instanceCount; ++i)
+        imported.instances.push_back(SubmeshInstance{ cache.instances[i].submesh, cache.instances[i].node });
+
+    imported.aabbMin = glm::make_vec3(cache.header->aabbMin);
+    imported.aabbMax = glm::make_vec3(cache.header->aabbMax);
+    imported.positionScale = glm::make_vec3(cache.header->positionScale);
+    imported.positionOffset = glm::make_vec3(cache.header->positionOffset);
 
-    glGenBuffers(1, &mesh.indexBufferHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferHandle);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBufferSize, NULL, GL_STATIC_DRAW);
+    // The blobs are already laid out as the GPU buffers, the GL thread uploads them straight from the mapping
+    imported.cacheFile = cacheFile;
+    imported.vertexData = cache.vertexData;
+    imported.vertexDataSize = (u32)cache.header->vertexDataSize;
+    imported.indexData = cache.indexData;
+    imported.indexDataSize = (u32)cache.header->indexDataSize;
 
-    u32 indicesOffset = 0;
-    u32 verticesOffset = 0;
+    return true;
+}
 
+// Whatever importer read the file, the result is optimized, packed and cooked the same way
+void CookImportedMesh(const char* filename, u64 sourceTimestamp, VertexFormat vertexFormat, u32 importFlags, Mesh& mesh, ImportedModel& imported)
+{
+    // Vertex cache, overdraw and fetch order, then the LOD chain and the meshlets, stored as is in the cooked mesh
     for (u32 i = 0; i < mesh.submeshes.size(); ++i)
     {
-        const void* verticesData = mesh.submeshes[i].vertices.data();
-        const u32   verticesSize = mesh.submeshes[i].vertices.size() * sizeof(float);
-        glBufferSubData(GL_ARRAY_BUFFER, verticesOffset, verticesSize, verticesData);
-        mesh.submeshes[i].vertexOffset = verticesOffset;
-        verticesOffset += verticesSize;
+        Submesh& submesh = mesh.submeshes[i];
+        OptimizeSubmesh(submesh);
+        ILOG("%s submesh %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", filename, i,
+            submesh.cacheStats.acmrBefore, submesh.cacheStats.acmrAfter, submesh.cacheStats.atvrBefore, submesh.cacheStats.atvrAfter);
 
-        const void* indicesData = mesh.submeshes[i].indices.data();
-        const u32   indicesSize = mesh.submeshes[i].indices.size() * sizeof(u32);
-        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indicesOffset, indicesSize, indicesData);
-        mesh.submeshes[i].indexOffset = indicesOffset;
-        indicesOffset += indicesSize;
-    }
+        GenerateSubmeshLods(submesh);
+        for (u32 j = 1; j < submesh.lodCount; ++j)
+        {
+            ILOG("%s submesh %u: LOD %u has %u of %u triangles, error %.4f", filename, i, j,
+                submesh.lods[j].indexCount / 3, submesh.lods[0].indexCount / 3, submesh.lods[j].error);
+        }
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+        BuildSubmeshMeshlets(submesh);
+        ILOG("%s submesh %u: %u meshlets", filename, i, (u32)submesh.meshlets.size());
+    }
 
-    return modelIdx;
+    // Positions are quantized over the stored vertices, while the model bounds cover where the instances place them
+    glm::vec3 vertexMin, vertexMax;
+    ComputeMeshBounds(mesh, vertexMin, vertexMax);
+    GetPositionDequantization(vertexFormat, vertexMin, vertexMax, imported.positionScale, imported.positionOffset);
+    PackMeshGeometry(mesh, vertexFormat, vertexMin, vertexMax, imported.packedVertices, imported.packedIndices);
+
+    imported.aabbMin = vertexMin;
+    imported.aabbMax = vertexMax;
+    if (!imported.nodes.empty() && !imported.instances.empty())
+        ComputeInstanceBounds(mesh, imported.nodes, imported.instances, imported.aabbMin, imported.aabbMax);
+
+    imported.vertexData = imported.packedVertices.data();
+    imported.vertexDataSize = (u32)imported.packedVertices.size();
+    imported.indexData = imported.packedIndices.data();
+    imported.indexDataSize = (u32)imported.packedIndices.size();
+
+    // Cook the result so next launches skip Assimp
+    std::string cachePath = GetMeshCachePath(filename);
+    WriteMeshCache(cachePath.c_str(), sourceTimestamp, importFlags, vertexFormat, mesh, imported.submeshMaterials, imported.materials,
+        imported.nodes, imported.instances, imported.packedVertices, imported.packedIndices, imported.aabbMin, imported.aabbMax,
+        imported.positionScale, imported.positionOffset);
+
+    imported.submeshes.swap(mesh.submeshes);
 }
-#pragma endregion
-u32 FindVao(Mesh& mesh, u32 submeshIndex, const Program& program)
+
+bool ImportModelFromAssimp(const char* filename, u64 sourceTimestamp, VertexFormat vertexFormat, u32 importFlags, ImportedModel& imported)
 {
-    Submesh& submesh = mesh.submeshes[submeshIndex];
+    const aiScene* scene = ImportAssimpScene(filename, importFlags);
+
+    if (!scene)
+    {
+        ELOG("Error loading mesh %s: %s", filename, aiGetErrorString());
+        return false;
+    }
 
-    for (u32 i = 0; i < (u32)submesh.vaos.size(); ++i)
+    imported.materials.resize(scene->mNumMaterials);
+    for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+    {
+        ProcessAssimpMaterial(scene->mMaterials[i], imported.materials[i]);
+    }
+
+    Mesh mesh = {};
+    if (importFlags & aiProcess_PreTransformVertices)
+    {
+        ProcessAssimpNode(scene, scene->mRootNode, &mesh, 0, imported.submeshMaterials);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < scene->mNumMeshes; ++i)
+        {
+            ProcessAssimpMesh(scene, scene->mMeshes[i], &mesh, 0, imported.submeshMaterials);
+        }
+        ProcessAssimpHierarchy(scene->mRootNode, UINT32_MAX, imported.nodes, imported.instances);
+        ILOG("%s: %u nodes place %u unique submeshes %u times", filename, (u32)imported.nodes.size(),
+            (u32)mesh.submeshes.size(), (u32)imported.instances.size());
+    }
+
+    aiReleaseImport(scene);
+
+    CookImportedMesh(filename, sourceTimestamp, vertexFormat, importFlags, mesh, imported);
+
+    return true;
+}
+
+bool IsObjFile(const char* filename)
+{
+    const char* extension = strrchr(filename, '.');
+    if (!extension || strlen(extension) != 4)
+        return false;
+
+    return tolower(extension[1]) == 'o' && tolower(extension[2]) == 'b' && tolower(extension[3]) == 'j';
+}
+
+// OBJ files have no node tree worth keeping, the native parser always produces the flattened layout
+bool ImportModelFromObj(const char* filename, u64 sourceTimestamp, VertexFormat vertexFormat, u32 importFlags, ImportedModel& imported)
+{
+    Mesh mesh = {};
+    ObjImportStats stats = {};
+    if (!ImportObj(filename, mesh, imported.submeshMaterials, imported.materials, &stats))
+    {
+        imported.submeshMaterials.clear();
+        imported.materials.clear();
+        return false;
+    }
+
+    ILOG("%s: parsed in %.2f ms on %u threads, %u corners welded into %u vertices in %.2f ms", filename,
+        stats.parseMs, stats.threadCount, stats.cornerCount, stats.vertexCount, stats.buildMs);
+
+    CookImportedMesh(filename, sourceTimestamp, vertexFormat, importFlags, mesh, imported);
+    return true;
+}
+
+bool ImportModelFromGltf(const char* filename, u64 sourceTimestamp, VertexFormat vertexFormat, u32 importFlags, bool preserveHierarchy, ImportedModel& imported)
+{
+    Mesh mesh = {};
+    if (!ImportGltf(filename, preserveHierarchy, mesh, imported.submeshMaterials, imported.materials, imported.nodes, imported.instances))
+    {
+        imported.submeshMaterials.clear();
+        imported.materials.clear();
+        imported.nodes.clear();
+        imported.instances.clear();
+        return false;
+    }
+
+    ILOG("%s: %u submeshes, %u nodes place them %u times", filename, (u32)mesh.submeshes.size(),
+        (u32)imported.nodes.size(), (u32)imported.instances.size());
+
+    CookImportedMesh(filename, sourceTimestamp, vertexFormat, importFlags, mesh, imported);
+    return true;
+}
+
+bool ImportModel(const char* filename, VertexFormat vertexFormat, bool preserveHierarchy, bool nativeObjImport, ImportedModel& imported)
+{
+    u64 sourceTimestamp = GetFileLastWriteTimestamp(filename);
+    u32 importFlags = GetModelImportFlags(preserveHierarchy);
+
+    if (ImportModelFromCache(filename, sourceTimestamp, vertexFormat, importFlags, imported))
+        return true;
+
+    // Files the native parsers can't read still get a chance with Assimp
+    if (nativeObjImport && IsObjFile(filename) && ImportModelFromObj(filename, sourceTimestamp, vertexFormat, importFlags, imported))
+        return true;
+
+    if (IsGltfFile(filename) && ImportModelFromGltf(filename, sourceTimestamp, vertexFormat, importFlags, preserveHierarchy, imported))
+        return true;
+
+    return ImportModelFromAssimp(filename, sourceTimestamp, vertexFormat, importFlags, imported);
+}
+
+/**
+ * Imports every loaded .obj again with the native parser and with Assimp, up to the submeshes
+ * both produce, and keeps the best time of a few runs of each. The mesh cache is bypassed.
+ */
+void BenchmarkObjImport(App* app)
+{
+    const u32 runCount = 3;
+
+    app->objImportBenchmarks.clear();
+    for (const auto& asset : app->assets.models)
+    {
+        const char* filepath = asset.first.c_str();
+        if (!IsObjFile(filepath))
+            continue;
+
+        ObjImportBenchmark benchmark = {};
+        benchmark.filepath = asset.first;
+        benchmark.nativeMs = DBL_MAX;
+        benchmark.assimpMs = DBL_MAX;
+        for (u32 run = 0; run < runCount; ++run)
+        {
+            f64 startTime = GetElapsedMilliseconds();
+            Mesh mesh = {};
+            std::vector<u32> submeshMaterials;
+            std::vector<MaterialDesc> materials;
+            ObjImportStats stats = {};
+            ImportObj(filepath, mesh, submeshMaterials, materials, &stats);
+            benchmark.nativeMs = glm::min(benchmark.nativeMs, GetElapsedMilliseconds() - startTime);
+            benchmark.threadCount = stats.threadCount;
+
+            startTime = GetElapsedMilliseconds();
+            const aiScene* scene = ImportAssimpScene(filepath, MODEL_IMPORT_FLAGS);
+            if (scene)
+            {
+                Mesh assimpMesh = {};
+                std::vector<u32> assimpSubmeshMaterials;
+                std::vector<MaterialDesc> assimpMaterials(scene->mNumMaterials);
+                for (unsigned int i = 0; i < scene->mNumMaterials; ++i)
+                    ProcessAssimpMaterial(scene->mMaterials[i], assimpMaterials[i]);
+                ProcessAssimpNode(scene, scene->mRootNode, &assimpMesh, 0, assimpSubmeshMaterials);
+                aiReleaseImport(scene);
+            }
+            benchmark.assimpMs = glm::min(benchmark.assimpMs, GetElapsedMilliseconds() - startTime);
+        }
+
+        ILOG("OBJ import of %s: native %.2f ms on %u threads, Assimp %.2f ms (%.1fx)", filepath,
+            benchmark.nativeMs, benchmark.threadCount, benchmark.assimpMs, benchmark.assimpMs / glm::max(benchmark.nativeMs, 0.001));
+        app->objImportBenchmarks.push_back(benchmark);
+    }
+
+    std::sort(app->objImportBenchmarks.begin(), app->objImportBenchmarks.end(),
+        [](const ObjImportBenchmark& a, const ObjImportBenchmark& b) { return a.filepath < b.filepath; });
+}
+
+void CommitModel(App* app, AssetJob* job)
+{
+    ImportedModel& imported = job->model;
+    Model& model = app->models[job->assetIdx];
+    Mesh& mesh = app->meshes[model.meshIdx];
+
+    // A failed import stays an empty mesh rather than a proxy forever
+    mesh.isLoaded = true;
+    if (!job->succeeded)
+        return;
+
+    mesh.aabbMin = imported.aabbMin;
+    mesh.aabbMax = imported.aabbMax;
+    mesh.positionScale = imported.positionScale;
+    mesh.positionOffset = imported.positionOffset;
+
+    String directory = GetDirectoryPart(MakeString(job->filepath.c_str()));
+
+    std::vector<u32> materialIndices(imported.materials.size());
+    for (u32 i = 0; i < imported.materials.size(); ++i)
+    {
+        materialIndices[i] = FindOrCreateMaterial(app, imported.materials[i], directory);
+    }
+
+    for (u32 i = 0; i < imported.submeshes.size(); ++i)
+    {
+        model.materialIdx.push_back(materialIndices[imported.submeshMaterials[i]]);
+    }
+
+    mesh.submeshes.swap(imported.submeshes);
+
+    // Instances of each submesh are contiguous in the node instance buffer, for one instanced draw
+    if (!imported.nodes.empty())
+    {
+        std::vector<glm::mat4> transforms;
+        ComputeNodeModelTransforms(imported.nodes, transforms);
+
+        model.submeshInstances.resize(mesh.submeshes.size());
+        for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+        {
+            model.submeshInstances[i] = NodeInstanceRange{ (u32)app->nodeInstances.size(), 0 };
+            for (const SubmeshInstance& instance : imported.instances)
+            {
+                if (instance.submesh != i)
+                    continue;
+
+                app->nodeInstances.push_back(transforms[instance.node]);
+                model.submeshInstances[i].count++;
+            }
+        }
+
+        model.nodes.swap(imported.nodes);
+        app->nodeInstanceBufferDirty = true;
+    }
+
+    UploadMesh(app, mesh, imported.vertexData, imported.indexData);
+
+    const char* filepath = job->filepath.c_str();
+    InitMeshGeometrySource(mesh, app->geometryResidency, GetMeshCachePath(filepath).c_str(), GetFileLastWriteTimestamp(filepath),
+        GetModelImportFlags(job->preserveHierarchy), job->vertexFormat,
+        imported.vertexData, imported.vertexDataSize, imported.indexData, imported.indexDataSize);
+
+    if (imported.cacheFile.data)
+        UnmapFile(imported.cacheFile);
+}
+
+u32 LoadModel(App* app, const char* filename)
+{
+    std::string key = MakeAssetKey(filename);
+    u32 existingModelIdx = FindAsset(app->assets.models, key);
+    if (existingModelIdx != UINT32_MAX)
+        return existingModelIdx;
+
+    // Reserve the model and its mesh, a bounding proxy is drawn in their place until the import is committed
+    Mesh mesh = {};
+    mesh.aabbMin = glm::vec3(-0.5f);
+    mesh.aabbMax = glm::vec3(0.5f);
+    mesh.positionScale = glm::vec3(1.0f);
+    std::string cachePath = GetMeshCachePath(filename);
+    PeekMeshCacheBounds(cachePath.c_str(), GetFileLastWriteTimestamp(filename), GetModelImportFlags(app->preserveModelHierarchy),
+        app->vertexFormat, mesh.aabbMin, mesh.aabbMax);
+
+    app->meshes.push_back(mesh);
+    u32 meshIdx = (u32)app->meshes.size() - 1u;
+    RegisterAsset(app->assets.meshes, key, meshIdx);
+
+    app->models.push_back(Model{});
+    app->models.back().meshIdx = meshIdx;
+    u32 modelIdx = (u32)app->models.size() - 1u;
+    RegisterAsset(app->assets.models, key, modelIdx);
+
+    AssetJob* job = new AssetJob{};
+    job->type = AssetJob_Model;
+    job->assetIdx = modelIdx;
+    job->filepath = filename;
+    job->vertexFormat = app->vertexFormat;
+    job->preserveHierarchy = app->preserveModelHierarchy;
+    job->nativeObjImport = app->nativeObjImport;
+    SubmitAssetJob(app->assetLoader, job);
+
+    return modelIdx;
+}
+
+// Runs on a worker. Cooked or decoded pixels become the mip chain, whose levels that are
+// resident from the start are written into the upload ring.
+void PrepareTextureJobUpload(AssetJob* job)
+{
+    TextureMipChain& chain = job->chain;
+    if (job->cooked.view.header)
+    {
+        TakeCookedTextureMipChain(job->cooked.view, job->cooked.file, job->cooked.memory, chain);
+        job->cooked = {};
+    }
+    else
+    {
+        const Image& image = job->image;
+        BuildImageTextureMipChain((const u8*)image.pixels, image.size.x, image.size.y, image.nchannels, chain);
+        FreeImage(job->image);
+        job->image = {};
+    }
+
+    u32 firstMip = job->streamTexture ? GetInitialStreamedMip(chain) : 0;
+    PrepareTextureUpload(*job->uploadRing, chain, firstMip, job->upload);
+
+    if (!job->streamTexture)
+    {
+        UnmapFile(chain.file);
+        chain.memory = std::vector<u8>();
+    }
+}
+
+void ExecuteAssetJob(AssetJob* job)
+{
+    switch (job->type)
+    {
+    case AssetJob_Texture:
+        if (job->compressTexture)
+        {
+            job->succeeded = LoadCookedTexture(job);
+        }
+        else
+        {
+            job->image = LoadImage(job->filepath.c_str());
+            job->succeeded = job->image.pixels != NULL;
+        }
+        break;
+    case AssetJob_PackedTexture:
+        job->succeeded = LoadPackedTexture(job);
+        break;
+    case AssetJob_Model:
+        job->succeeded = ImportModel(job->filepath.c_str(), job->vertexFormat, job->preserveHierarchy, job->nativeObjImport, job->model);
+        break;
+    }
+
+    if (job->succeeded && job->type != AssetJob_Model)
+        PrepareTextureJobUpload(job);
+}
+
+void FinishAssetJob(App* app, AssetJob* job)
+{
+    app->startupTimeline.assets.push_back({ job->filepath, job->requestTime, job->finishTime, GetElapsedMilliseconds() });
+
+    // Committing a model submits its texture jobs first, so the in-flight count
+    // can't reach zero while those are still pending
+    delete job;
+    MarkAssetJobCommitted(app->assetLoader);
+}
+
+// Creates textures from the queued uploads until uploadBudgetBytes have been copied this frame.
+// At least one texture goes through per frame, however large it is.
+void UploadPendingTextures(App* app, u64 uploadBudgetBytes)
+{
+    TextureUploadRing& ring = app->textureUploadRing;
+    while (!app->pendingTextureUploads.empty())
+    {
+        AssetJob* job = app->pendingTextureUploads.front();
+        if (ring.frameTextures > 0 && ring.frameBytes + job->upload.size > uploadBudgetBytes)
+            break;
+
+        app->pendingTextureUploads.pop_front();
+        CommitTexture(app, job);
+        FinishAssetJob(app, job);
+    }
+}
+
+void ProcessFinishedAssetJobs(App* app, f32 budgetMs, u64 uploadBudgetBytes)
+{
+    f64 start = GetElapsedMilliseconds();
+
+    while (GetElapsedMilliseconds() - start < budgetMs)
+    {
+        AssetJob* job = PopFinishedAssetJob(app->assetLoader);
+        if (!job)
+            break;
+
+        switch (job->type)
+        {
+        case AssetJob_Texture:
+        case AssetJob_PackedTexture:
+            // The pixels are in the upload ring already, creating the texture waits for the upload budget
+            if (job->succeeded)
+            {
+                app->pendingTextureUploads.push_back(job);
+                continue;
+            }
+            break;
+        case AssetJob_Model:
+            CommitModel(app, job);
+            break;
+        }
+
+        FinishAssetJob(app, job);
+    }
+
+    UploadPendingTextures(app, uploadBudgetBytes);
+}
+
+void WaitForAssetLoads(App* app)
+{
+    while (HasPendingAssetJobs(app->assetLoader))
+    {
+        BeginTextureUploadFrame(app->textureUploadRing);
+        ProcessFinishedAssetJobs(app, FLT_MAX, UINT64_MAX);
+        std::this_thread::yield();
+    }
+}
+
+// CPU memory of the geometry of every mesh once uploaded, plus the meshlet and node instance copies
+GeometryFootprint GetCpuGeometryFootprint(App* app)
+{
+    GeometryFootprint footprint = {};
+    for (const Mesh& mesh : app->meshes)
+        AddMeshGeometryFootprint(mesh, footprint);
+
+    footprint.metadataBytes += app->meshlets.capacity() * sizeof(Meshlet) + app->nodeInstances.capacity() * sizeof(glm::mat4);
+    return footprint;
+}
+
+void ReportStartupTimeline(App* app)
+{
+    StartupTimeline& timeline = app->startupTimeline;
+
+    ILOG("Startup timeline: window %.2f ms, init %.2f ms, first frame %.2f ms, fully loaded %.2f ms",
+        timeline.windowCreated, timeline.initFinished, timeline.firstFrame, timeline.fullyLoaded);
+
+    for (const AssetTiming& asset : timeline.assets)
+    {
+        ILOG("    %-48s requested %8.2f  decoded %8.2f  committed %8.2f ms",
+            asset.filepath.c_str(), asset.requested, asset.decoded, asset.committed);
+    }
+
+    u64 residentTextureBytes = 0;
+    u64 textureBytes = 0;
+    u64 uncompressedTextureBytes = 0;
+    for (const Texture& texture : app->textures)
+    {
+        residentTextureBytes += texture.gpuSize;
+        textureBytes += texture.fullSize;
+        uncompressedTextureBytes += texture.uncompressedSize;
+    }
+    GeometryFootprint geometry = GetCpuGeometryFootprint(app);
+    ILOG("CPU geometry: %.2f MB kept, %.2f MB mapped, %.2f MB of submesh, meshlet and instance data",
+        geometry.keptBytes / (1024.0 * 1024.0), geometry.mappedBytes / (1024.0 * 1024.0), geometry.metadataBytes / (1024.0 * 1024.0));
+
+    ILOG("Texture memory: %.2f MB resident of %.2f MB, %.2f MB saved by block compression",
+        residentTextureBytes / (1024.0 * 1024.0), textureBytes / (1024.0 * 1024.0),
+        (uncompressedTextureBytes - textureBytes) / (1024.0 * 1024.0));
+}
+
+GLuint GetTextureHandle(App* app, u32 texIdx, u32 fallbackTexIdx)
+{
+    // Textures still streaming in (or that failed to load) show their placeholder
+    GLuint handle = texIdx < app->textures.size() ? app->textures[texIdx].handle : 0;
+    return handle ? handle : app->textures[fallbackTexIdx].handle;
+}
+
+// Same as GetTextureHandle, for pooled textures
+MaterialTextureLayer GetTextureLayer(App* app, u32 texIdx, u32 fallbackTexIdx)
+{
+    const Texture& tex = texIdx < app->textures.size() && app->textures[texIdx].handle ? app->textures[texIdx] : app->textures[fallbackTexIdx];
+    return MaterialTextureLayer{ tex.arrayPool, tex.arrayLayer };
+}
+
+// Points the materials at the layers of their textures, once those are in their pools
+void UpdateMaterialTextureLayers(App* app)
+{
+    if (!app->materialLayersDirty)
+        return;
+
+    for (Material& material : app->materials)
+    {
+        material.albedoLayer = GetTextureLayer(app, material.albedoTextureIdx, app->whiteTexIdx);
+        material.ormLayer = GetTextureLayer(app, material.ormTextureIdx, app->ormTexIdx);
+    }
+    app->materialLayersDirty = false;
+}
+
+MaterialParamsBlock MakeMaterialParams(const Material& material)
+{
+    MaterialParamsBlock params = {};
+    params.albedo = material.albedo;
+    params.smoothness = material.smoothness;
+    params.emissive = material.emissive;
+    params.bumpiness = material.bumpiness;
+    params.minLayers = material.minLayers;
+    params.maxLayers = material.maxLayers;
+    return params;
+}
+
+// Rewrites the material buffer after materials were added, growing it when they don't fit
+void UpdateMaterialParams(App* app)
+{
+    if (!app->materialParamsDirty)
+        return;
+
+    std::vector<MaterialParamsBlock> params(app->materials.size());
+    for (u32 i = 0; i < app->materials.size(); ++i)
+        params[i] = MakeMaterialParams(app->materials[i]);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->materialParamsBuffer);
+    if (params.size() > app->materialParamsCapacity)
+    {
+        app->materialParamsCapacity = glm::max((u32)params.size(), 2 * app->materialParamsCapacity);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, app->materialParamsCapacity * sizeof(MaterialParamsBlock), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, params.size() * sizeof(MaterialParamsBlock), params.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    app->materialParamsDirty = false;
+    app->materialParamsWrites++;
+}
+
+// After a material was edited, only its entry is written
+void WriteMaterialParams(App* app, u32 materialIdx)
+{
+    if (app->materialParamsDirty || materialIdx >= app->materialParamsCapacity)
+    {
+        app->materialParamsDirty = true;
+        return;
+    }
+
+    MaterialParamsBlock params = MakeMaterialParams(app->materials[materialIdx]);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->materialParamsBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, materialIdx * sizeof(MaterialParamsBlock), sizeof(params), &params);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    app->materialParamsWrites++;
+}
+
+// Material with no textures, for parameters that don't come from a model file
+u32 CreateParameterMaterial(App* app, const char* name)
+{
+    Material material = {};
+    material.name = name;
+    material.albedo = vec3(1.0f);
+    material.albedoTextureIdx = UINT32_MAX;
+    material.emissiveTextureIdx = UINT32_MAX;
+    material.specularTextureIdx = UINT32_MAX;
+    material.ormTextureIdx = UINT32_MAX;
+    material.normalHeightTextureIdx = UINT32_MAX;
+    material.minLayers = 8.0f;
+    material.maxLayers = 32.0f;
+    app->materials.push_back(material);
+
+    app->materialLayersDirty = true;
+    app->materialParamsDirty = true;
+    return (u32)app->materials.size() - 1u;
+}
+
+u32 CreateReliefMaterial(App* app, const char* name, f32 bumpiness, f32 minLayers, f32 maxLayers)
+{
+    u32 materialIdx = CreateParameterMaterial(app, name);
+    Material& material = app->materials[materialIdx];
+    material.bumpiness = bumpiness;
+    material.minLayers = minLayers;
+    material.maxLayers = maxLayers;
+    return materialIdx;
+}
+
+u32 CreateProxyMesh(App* app)
+{
+    // Unit cube with the same vertex format ProcessAssimpMesh produces, stretched over
+    // the bounds of meshes that haven't finished loading
+    const glm::vec3 faceNormals[] = { {1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1} };
+
+    Submesh submesh = {};
+    for (const glm::vec3& n : faceNormals)
+    {
+        glm::vec3 tangent = glm::abs(n.y) > 0.5f ? glm::vec3(1, 0, 0) : glm::normalize(glm::cross(glm::vec3(0, 1, 0), n));
+        glm::vec3 bitangent = glm::cross(n, tangent);
+
+        u32 baseVertex = submesh.vertices.size() / 14;
+        const glm::vec2 corners[] = { {-1, -1}, {1, -1}, {1, 1}, {-1, 1} };
+        for (const glm::vec2& corner : corners)
+        {
+            glm::vec3 position = 0.5f * (n + corner.x * tangent + corner.y * bitangent);
+            glm::vec2 uv = corner * 0.5f + 0.5f;
+            const float vertex[] = { position.x, position.y, position.z, n.x, n.y, n.z, uv.x, uv.y,
+                tangent.x, tangent.y, tangent.z, bitangent.x, bitangent.y, bitangent.z };
+            submesh.vertices.insert(submesh.vertices.end(), vertex, vertex + ARRAY_COUNT(vertex));
+        }
+
+        const u32 quad[] = { 0, 1, 2, 0, 2, 3 };
+        for (u32 index : quad)
+            submesh.indices.push_back(baseVertex + index);
+    }
+
+    submesh.vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 0, 3, 0, VertexAttribute_Float });
+    submesh.vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 1, 3, 3 * sizeof(float), VertexAttribute_Float });
+    submesh.vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 2, 2, 6 * sizeof(float), VertexAttribute_Float });
+    submesh.vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 3, 3, 8 * sizeof(float), VertexAttribute_Float });
+    submesh.vertexBufferLayout.attributes.push_back(VertexBufferAttribute{ 4, 3, 11 * sizeof(float), VertexAttribute_Float });
+    submesh.vertexBufferLayout.stride = 14 * sizeof(float);
+
+    Mesh mesh = {};
+    mesh.aabbMin = glm::vec3(-0.5f);
+    mesh.aabbMax = glm::vec3(0.5f);
+    mesh.isLoaded = true;
+    mesh.submeshes.push_back(submesh);
+
+    // Same vertex format as the meshes it stands in for, the shaders are built for one of them
+    std::vector<u8> vertexData, indexData;
+    GetPositionDequantization(app->vertexFormat, mesh.aabbMin, mesh.aabbMax, mesh.positionScale, mesh.positionOffset);
+    PackMeshGeometry(mesh, app->vertexFormat, mesh.aabbMin, mesh.aabbMax, vertexData, indexData);
+    UploadMesh(app, mesh, vertexData.data(), indexData.data());
+
+    app->meshes.push_back(mesh);
+    return (u32)app->meshes.size() - 1u;
+}
+#pragma endregion
+// Every attribute the program reads has to be in the layout of the submesh
+bool ProvidesVertexInputs(const Submesh& submesh, const Program& program)
+{
+    for (const VertexShaderAttribute& input : program.vertexInputLayout.attributes)
+    {
+        bool attributeWasLinked = false;
+        for (const VertexBufferAttribute& attribute : submesh.vertexBufferLayout.attributes)
+        {
+            if (attribute.location == input.location)
+            {
+                attributeWasLinked = true;
+                break;
+            }
+        }
+
+        if (!attributeWasLinked)
+            return false;
+    }
+    return true;
+}
+
+// Instances of a submesh placed by the node tree, or the identity once for flattened models
+NodeInstanceRange GetSubmeshInstances(const Model& model, u32 submeshIdx)
+{
+    return model.submeshInstances.empty() ? NodeInstanceRange{ 0, 1 } : model.submeshInstances[submeshIdx];
+}
+
+// The mesh programs read the node transform of every instance from binding 4
+void BindNodeInstances(App* app)
+{
+    if (app->nodeInstanceBufferDirty)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->nodeInstanceBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, app->nodeInstances.size() * sizeof(glm::mat4), app->nodeInstances.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        app->nodeInstanceBufferDirty = false;
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, app->nodeInstanceBuffer);
+}
+
+void DrawSubmesh(App* app, const Submesh& submesh, Program& program, GeometryBinding& binding, u32 lod = 0,
+    NodeInstanceRange instances = NodeInstanceRange{ 0, 1 })
+{
+    assert(ProvidesVertexInputs(submesh, program));
+    BindSubmeshGeometry(app->geometryArena, submesh, binding);
+    app->uniformUploader.UploadUniformInt(program, UNIFORM("uFirstNodeInstance"), (GLint)instances.first);
+    DrawSubmeshGeometry(app->geometryArena, submesh, lod, instances.count);
+}
+
+// Draws the indices the meshlet culling pass kept for this draw
+void DrawCulledSubmesh(App* app, const Submesh& submesh, Program& program, GeometryBinding& binding, u32 command,
+    NodeInstanceRange instances)
+{
+    assert(ProvidesVertexInputs(submesh, program));
+    BindSubmeshGeometry(app->geometryArena, submesh, binding);
+    app->uniformUploader.UploadUniformInt(program, UNIFORM("uFirstNodeInstance"), (GLint)instances.first);
+    if (binding.indexBuffer != app->culledIndexBuffer)
+    {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, app->culledIndexBuffer);
+        binding.indexBuffer = app->culledIndexBuffer;
+    }
+
+    glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(command * sizeof(DrawElementsIndirectCommand)));
+}
+
+#pragma region Meshlet culling
+// World space planes of the frustum, normals pointing inwards
+void GetFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+{
+    const glm::mat4 m = glm::transpose(viewProjection);
+    planes[0] = m[3] + m[0];
+    planes[1] = m[3] - m[0];
+    planes[2] = m[3] + m[1];
+    planes[3] = m[3] - m[1];
+    planes[4] = m[3] + m[2];
+    planes[5] = m[3] - m[2];
+
+    for (u32 i = 0; i < 6; ++i)
+        planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+/**
+ * Gives every draw of LOD 0 with meshlets and a single instance an indirect command, and dispatches the culling of
+ * its meshlets. The indices of the ones that survive are appended to the range of the culled
+ * index buffer reserved for the draw, and the command counts them.
+ */
+void CullMeshlets(App* app)
+{
+    app->meshletCommands.clear();
+    app->meshletsTested = 0;
+    app->meshletIndicesSubmitted = 0;
+    if (!app->meshletCulling || app->meshlets.empty())
+        return;
+
+    if (app->meshletBufferDirty)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->meshletBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, app->meshlets.size() * sizeof(Meshlet), app->meshlets.data(), GL_STATIC_DRAW);
+        app->meshletBufferDirty = false;
+    }
+
+    u32 culledIndexCount = 0;
+    for (ModelDraw& draw : app->modelDraws)
+    {
+        const Entity& entity = app->entities[draw.entityIdx];
+        const Model& model = app->models[entity.modelIndex];
+        const Submesh& submesh = app->meshes[model.meshIdx].submeshes[draw.submeshIdx];
+        if (entity.lod != 0 || submesh.meshletCount == 0 || GetSubmeshInstances(model, draw.submeshIdx).count != 1)
+            continue;
+
+        DrawElementsIndirectCommand command = {};
+        command.instanceCount = 1;
+        command.firstIndex = culledIndexCount;
+        command.baseVertex = GetSubmeshGeometryLocation(app->geometryArena, submesh).baseVertex;
+
+        draw.cullCommand = (u32)app->meshletCommands.size();
+        app->meshletCommands.push_back(command);
+        culledIndexCount += submesh.lods[0].indexCount;
+    }
+
+    if (app->meshletCommands.empty())
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+        return;
+    }
+
+    // Room for every index, in case nothing is culled
+    if (culledIndexCount > app->culledIndexCapacity)
+    {
+        app->culledIndexCapacity = glm::max(culledIndexCount, 2 * app->culledIndexCapacity);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->culledIndexBuffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, app->culledIndexCapacity * sizeof(u32), NULL, GL_DYNAMIC_COPY);
+    }
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->meshletCommandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, app->meshletCommands.size() * sizeof(DrawElementsIndirectCommand),
+        app->meshletCommands.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    Program& cullingProgram = app->programs[app->meshletCullingShader];
+    glUseProgram(cullingProgram.handle);
+
+    glm::vec4 frustumPlanes[6];
+    GetFrustumPlanes(app->camera->GetViewProjection(), frustumPlanes);
+    app->uniformUploader.UploadUniformFloat4Array(cullingProgram, UNIFORM("uFrustumPlanes"), frustumPlanes, ARRAY_COUNT(frustumPlanes));
+    app->uniformUploader.UploadUniformFloat3(cullingProgram, UNIFORM("uCameraPosition"), app->camera->GetPosition());
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, app->meshletBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, app->culledIndexBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, app->meshletCommandBuffer);
+
+    for (const ModelDraw& draw : app->modelDraws)
+    {
+        if (draw.cullCommand == UINT32_MAX)
+            continue;
+
+        const Entity& entity = app->entities[draw.entityIdx];
+        const Model& model = app->models[entity.modelIndex];
+        const Submesh& submesh = app->meshes[model.meshIdx].submeshes[draw.submeshIdx];
+        const GeometryLocation location = GetSubmeshGeometryLocation(app->geometryArena, submesh);
+
+        glm::mat4 world = entity.GetTransform() * app->nodeInstances[GetSubmeshInstances(model, draw.submeshIdx).first];
+        glm::vec3 scale(glm::length(glm::vec3(world[0])), glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2])));
+        f32 maxScale = glm::max(scale.x, glm::max(scale.y, scale.z));
+        f32 minScale = glm::min(scale.x, glm::min(scale.y, scale.z));
+
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, location.indexBuffer);
+        app->uniformUploader.UploadUniformMat4(cullingProgram, UNIFORM("uWorld"), world);
+        app->uniformUploader.UploadUniformMat3(cullingProgram, UNIFORM("uNormalMatrix"), glm::transpose(glm::inverse(glm::mat3(world))));
+        app->uniformUploader.UploadUniformFloat(cullingProgram, UNIFORM("uWorldScale"), maxScale);
+        app->uniformUploader.UploadUniformInt(cullingProgram, UNIFORM("uConeCulling"), maxScale - minScale <= 0.01f * maxScale ? 1 : 0);
+        app->uniformUploader.UploadUniformUInt(cullingProgram, UNIFORM("uFirstMeshlet"), submesh.firstMeshlet);
+        app->uniformUploader.UploadUniformUInt(cullingProgram, UNIFORM("uMeshletCount"), submesh.meshletCount);
+        app->uniformUploader.UploadUniformUInt(cullingProgram, UNIFORM("uSourceFirstIndex"), location.indexOffset / submesh.indexSize);
+        app->uniformUploader.UploadUniformUInt(cullingProgram, UNIFORM("uIndexSize"), submesh.indexSize);
+        app->uniformUploader.UploadUniformUInt(cullingProgram, UNIFORM("uCommand"), draw.cullCommand);
+
+        glDispatchCompute((submesh.meshletCount + 63) / 64, 1, 1);
+        app->meshletsTested += submesh.meshletCount;
+    }
+
+    for (u32 binding = 0; binding < 4; ++binding)
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, 0);
+    glUseProgram(0);
+
+    // The geometry pass reads the commands and the indices written above
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT);
+    app->meshletIndicesSubmitted = culledIndexCount;
+
+    if (app->meshletCullingStats)
+    {
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        std::vector<DrawElementsIndirectCommand> commands(app->meshletCommands.size());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->meshletCommandBuffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+        app->meshletIndicesVisible = 0;
+        for (const DrawElementsIndirectCommand& command : commands)
+            app->meshletIndicesVisible += command.count;
+    }
+}
+#pragma endregion
+
+// Height of the bounding sphere on screen, as a fraction of the viewport height
+f32 GetProjectedSize(App* app, const Mesh& mesh, const glm::mat4& world)
+{
+    glm::vec3 center = glm::vec3(world * glm::vec4(0.5f * (mesh.aabbMin + mesh.aabbMax), 1.0f));
+    f32 scale = glm::max(glm::length(glm::vec3(world[0])), glm::max(glm::length(glm::vec3(world[1])), glm::length(glm::vec3(world[2]))));
+    f32 radius = 0.5f * glm::length(mesh.aabbMax - mesh.aabbMin) * scale;
+
+    f32 distance = glm::length(center - app->camera->GetPosition());
+    if (distance <= radius)
+        return FLT_MAX;
+
+    return radius * app->camera->GetProjection()[1][1] / distance;
+}
+
+#pragma region Texture streaming
+// Moves the finest resident level of a streamed texture to mip, returns the bytes that freed up
+i64 SetTextureResidency(App* app, u32 texIdx, u32 mip)
+{
+    Texture& tex = app->textures[texIdx];
+    u64 previousSize = tex.gpuSize;
+    tex.handle = SetTextureResidentMip(app->textureUploadRing, tex.handle, tex.residency, mip);
+    tex.gpuSize = GetMipChainSize(tex.residency.chain, mip);
+    return (i64)previousSize - (i64)tex.gpuSize;
+}
+
+void RequestTextureResidency(App* app, u32 texIdx, f32 pixelSize)
+{
+    if (texIdx >= app->textures.size())
+        return;
+
+    TextureResidency& residency = app->textures[texIdx].residency;
+    if (residency.chain.mipCount > 0)
+        RequestTextureMip(residency, GetTextureMipForScreenSize(residency, pixelSize), app->textureStreamingFrame);
+}
+
+// Every texture the materials of the model sample, for something pixelSize pixels tall on screen
+void RequestModelTextureResidency(App* app, const Model& model, f32 pixelSize)
+{
+    for (u32 materialIdx : model.materialIdx)
+    {
+        const Material& material = app->materials[materialIdx];
+        RequestTextureResidency(app, material.albedoTextureIdx, pixelSize);
+        RequestTextureResidency(app, material.emissiveTextureIdx, pixelSize);
+        RequestTextureResidency(app, material.specularTextureIdx, pixelSize);
+        RequestTextureResidency(app, material.ormTextureIdx, pixelSize);
+        RequestTextureResidency(app, material.normalHeightTextureIdx, pixelSize);
+    }
+}
+
+// Brings the textures of a model to the detail of pixelSize right away, regardless of the budget
+void MakeModelTexturesResident(App* app, const Model& model, f32 pixelSize)
+{
+    RequestModelTextureResidency(app, model, pixelSize);
+    for (u32 materialIdx : model.materialIdx)
+    {
+        const Material& material = app->materials[materialIdx];
+        const u32 texIdxs[] = { material.albedoTextureIdx, material.emissiveTextureIdx, material.specularTextureIdx,
+            material.ormTextureIdx, material.normalHeightTextureIdx };
+        for (u32 texIdx : texIdxs)
+        {
+            if (texIdx >= app->textures.size() || !app->textures[texIdx].handle)
+                continue;
+
+            const TextureResidency& residency = app->textures[texIdx].residency;
+            if (residency.chain.mipCount > 0 && residency.wantedMip < residency.residentMip)
+                SetTextureResidency(app, texIdx, residency.wantedMip);
+        }
+    }
+}
+
+/**
+ * Drops the finest levels of the least recently used texture that has more than it needs.
+ * Textures drawn this frame keep the levels they asked for, the others go back to the levels
+ * they were loaded with. Returns the bytes freed, 0 when nothing can go.
+ */
+u64 EvictTextureMips(App* app, u32 keepTexIdx)
+{
+    const u64 frame = app->textureStreamingFrame;
+    u32 victimIdx = UINT32_MAX;
+    u32 victimMip = 0;
+    for (u32 i = 0; i < app->textures.size(); ++i)
+    {
+        const TextureResidency& residency = app->textures[i].residency;
+        if (i == keepTexIdx || residency.chain.mipCount == 0 || !app->textures[i].handle)
+            continue;
+
+        u32 floorMip = residency.lastUsedFrame == frame ? residency.wantedMip : GetInitialStreamedMip(residency.chain);
+        if (residency.residentMip >= floorMip)
+            continue;
+
+        if (victimIdx == UINT32_MAX || residency.lastUsedFrame < app->textures[victimIdx].residency.lastUsedFrame)
+        {
+            victimIdx = i;
+            victimMip = floorMip;
+        }
+    }
+
+    if (victimIdx == UINT32_MAX)
+        return 0;
+
+    app->textureMipsEvicted++;
+    return (u64)SetTextureResidency(app, victimIdx, victimMip);
+}
+
+// Runs after the entities asked for their textures this frame
+void UpdateTextureStreaming(App* app)
+{
+    const u64 budget = (u64)(app->textureBudgetMB * 1024.0f * 1024.0f);
+    const u64 uploadBudget = (u64)(app->textureUploadBudgetMB * 1024.0f * 1024.0f);
+    const u64 frame = app->textureStreamingFrame;
+    TextureUploadRing& ring = app->textureUploadRing;
+    app->textureMipsRaised = 0;
+    app->textureMipsEvicted = 0;
+
+    // The textured quad covers the whole window
+    if (app->mode == Mode::Mode_TexturedQuad)
+        RequestTextureResidency(app, app->diceTexIdx, (f32)app->displaySize.y);
+
+    u64 residentBytes = 0;
+    std::vector<u32> wanting;
+    for (u32 i = 0; i < app->textures.size(); ++i)
+    {
+        Texture& tex = app->textures[i];
+        residentBytes += tex.gpuSize;
+
+        TextureResidency& residency = tex.residency;
+        if (residency.chain.mipCount == 0 || !tex.handle)
+            continue;
+
+        UpdateTextureFade(tex.handle, residency);
+        if (residency.lastUsedFrame == frame && residency.wantedMip < residency.residentMip)
+            wanting.push_back(i);
+    }
+
+    // The budget may have been lowered
+    while (residentBytes > budget)
+    {
+        u64 freed = EvictTextureMips(app, UINT32_MAX);
+        if (freed == 0)
+            break;
+        residentBytes -= freed;
+    }
+
+    // The textures missing the most detail go first, one level per frame keeps each upload small
+    std::sort(wanting.begin(), wanting.end(), [app](u32 a, u32 b)
+    {
+        const TextureResidency& ra = app->textures[a].residency;
+        const TextureResidency& rb = app->textures[b].residency;
+        return ra.residentMip - ra.wantedMip > rb.residentMip - rb.wantedMip;
+    });
+
+    for (u32 texIdx : wanting)
+    {
+        const TextureResidency& residency = app->textures[texIdx].residency;
+        const u32 mip = residency.residentMip - 1;
+        const u64 levelSize = residency.chain.mips[mip].size;
+        if (ring.frameBytes > 0 && ring.frameBytes + levelSize > uploadBudget)
+            break;
+
+        while (residentBytes + levelSize > budget)
+        {
+            u64 freed = EvictTextureMips(app, texIdx);
+            if (freed == 0)
+                break;
+            residentBytes -= freed;
+        }
+        if (residentBytes + levelSize > budget)
+            break;
+
+        SetTextureResidency(app, texIdx, mip);
+        residentBytes += levelSize;
+        app->textureMipsRaised++;
+    }
+
+    for (Texture& tex : app->textures)
+        BeginTextureResidencyFrame(tex.residency);
+    app->textureStreamingFrame++;
+}
+#pragma endregion
+
+#pragma region Impostors
+u32 BakeImpostor(App* app, u32 modelIdx)
+{
+    Model& model = app->models[modelIdx];
+    Mesh& mesh = app->meshes[model.meshIdx];
+    Program& bakeProgram = app->programs[app->impostorBakeShader];
+
+    Impostor impostor = {};
+    impostor.framesPerSide = app->impostorFramesPerSide;
+    impostor.center = 0.5f * (mesh.aabbMin + mesh.aabbMax);
+    impostor.radius = glm::max(0.5f * glm::length(mesh.aabbMax - mesh.aabbMin), 1e-3f);
+
+    const u32 frameSize = app->impostorFrameSize;
+    const u32 atlasSize = frameSize * impostor.framesPerSide;
+    const u32 mipCount = 4; // Down to 16 pixel frames, smaller ones bleed into their neighbours
+
+    // Frames are rendered once, streamed textures need the detail of a whole frame now
+    MakeModelTexturesResident(app, model, (f32)frameSize);
+
+    GLuint* atlases[] = { &impostor.albedoTexture, &impostor.normalDepthTexture };
+    for (GLuint* atlas : atlases)
+    {
+        glGenTextures(1, atlas);
+        glBindTexture(GL_TEXTURE_2D, *atlas);
+        glTexStorage2D(GL_TEXTURE_2D, mipCount, GL_RGBA8, atlasSize, atlasSize);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    GLuint depthBuffer = 0;
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, atlasSize, atlasSize);
+
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4];
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+    glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+    GLuint framebuffer = 0;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, impostor.albedoTexture, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, impostor.normalDepthTexture, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(ARRAY_COUNT(drawBuffers), drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE)
+    {
+        // Empty texels have no coverage and a flat normal at the back of the sphere
+        const GLfloat clearAlbedo[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        const GLfloat clearNormalDepth[] = { 0.5f, 0.5f, 1.0f, 1.0f };
+        glViewport(0, 0, atlasSize, atlasSize);
+        glClearBufferfv(GL_COLOR, 0, clearAlbedo);
+        glClearBufferfv(GL_COLOR, 1, clearNormalDepth);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+
+        glUseProgram(bakeProgram.handle);
+        BindNodeInstances(app);
+        app->uniformUploader.UploadUniformFloat3(bakeProgram, UNIFORM("uPositionScale"), mesh.positionScale);
+        app->uniformUploader.UploadUniformFloat3(bakeProgram, UNIFORM("uPositionOffset"), mesh.positionOffset);
+        app->uniformUploader.UploadUniformInt(bakeProgram, UNIFORM("uTexture"), 0);
+        glActiveTexture(GL_TEXTURE0);
+
+        GeometryBinding binding = {};
+        const f32 r = impostor.radius;
+        for (u32 y = 0; y < impostor.framesPerSide; ++y)
+        {
+            for (u32 x = 0; x < impostor.framesPerSide; ++x)
+            {
+                // Frame centers cover the octahedral map of view directions, see ImpostorBasis in the shader
+                glm::vec2 frame = (glm::vec2(x, y) + 0.5f) / (f32)impostor.framesPerSide;
+                glm::vec3 direction = DecodeOctahedral(frame * 2.0f - 1.0f);
+                glm::vec3 upHint = glm::abs(direction.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+
+                glm::mat4 view = glm::lookAt(impostor.center + direction * 2.0f * r, impostor.center, upHint);
+                glm::mat4 projection = glm::ortho(-r, r, -r, r, r, 3.0f * r);
+                app->uniformUploader.UploadUniformMat4(bakeProgram, UNIFORM("uViewProjection"), projection * view);
+
+                glViewport(x * frameSize, y * frameSize, frameSize, frameSize);
+                for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+                {
+                    const Material& material = app->materials[model.materialIdx[i]];
+                    glBindTexture(GL_TEXTURE_2D, GetTextureHandle(app, material.albedoTextureIdx, app->whiteTexIdx));
+                    DrawSubmesh(app, mesh.submeshes[i], bakeProgram, binding, 0, GetSubmeshInstances(model, i));
+                }
+            }
+        }
+
+        glBindVertexArray(0);
+        glUseProgram(0);
+    }
+    else
+    {
+        ELOG("Impostor framebuffer is incomplete, model %u keeps its mesh at every distance", modelIdx);
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depthBuffer);
+
+    for (GLuint* atlas : atlases)
+    {
+        glBindTexture(GL_TEXTURE_2D, *atlas);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    app->impostors.push_back(impostor);
+    return (u32)app->impostors.size() - 1u;
+}
+
+// Bakes the models of the entities once nothing is loading, so their textures are final
+void BakePendingImpostors(App* app)
+{
+    if (!app->impostorsEnabled || HasPendingAssetJobs(app->assetLoader))
+        return;
+
+    for (const Entity& entity : app->entities)
+    {
+        Model& model = app->models[entity.modelIndex];
+        const Mesh& mesh = app->meshes[model.meshIdx];
+        if (entity.hasRelief || model.impostorIdx != UINT32_MAX || !mesh.isLoaded || mesh.submeshes.empty())
+            continue;
+
+        f64 bakeStart = GetElapsedMilliseconds();
+        model.impostorIdx = BakeImpostor(app, entity.modelIndex);
+        ILOG("Baked impostor of model %u in %.2f ms", entity.modelIndex, GetElapsedMilliseconds() - bakeStart);
+    }
+}
+
+// Groups the world matrices of the impostor entities by model, for one instanced draw each
+void BuildImpostorBatches(App* app, const std::vector<std::pair<u32, u32>>& impostorEntities)
+{
+    app->impostorInstances.clear();
+    app->impostorBatches.clear();
+
+    for (const std::pair<u32, u32>& impostorEntity : impostorEntities)
+    {
+        if (app->impostorBatches.empty() || app->impostorBatches.back().modelIdx != impostorEntity.first)
+            app->impostorBatches.push_back(ImpostorBatch{ impostorEntity.first, (u32)app->impostorInstances.size(), 0 });
+
+        app->impostorInstances.push_back(app->entities[impostorEntity.second].GetTransform());
+        app->impostorBatches.back().instanceCount++;
+    }
+
+    // Orphan the storage, last frame's draws may still read it
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, app->impostorInstanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, app->impostorInstances.size() * sizeof(glm::mat4), app->impostorInstances.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+// Grid of Patricks in front of the camera, most of it past the impostor distance
+void SpawnImpostorBenchmark(App* app, u32 sideCount)
+{
+    u32 patrick = LoadModel(app, "Patrick/Patrick.obj");
+
+    for (u32 z = 0; z < sideCount; ++z)
+    {
+        for (u32 x = 0; x < sideCount; ++x)
+        {
+            Entity entity = {};
+            entity.PushEntity(patrick);
+            entity.position = vec3(((f32)x - 0.5f * sideCount) * 1.25f, 0.0f, -15.0f - (f32)z * 1.25f);
+            entity.scale = vec3(1.0f);
+            entity.rotation = vec3(0.0f, (f32)((x * 7 + z * 13) % 16) * 0.4f, 0.0f);
+            entity.textureIdx = -1;
+            entity.normalHeightIdx = -1;
+            app->entities.push_back(entity);
+        }
+    }
+
+    app->impostorBenchmark = ImpostorBenchmark{};
+    app->impostorBenchmark.entityCount = sideCount * sideCount;
+}
+
+void ClearImpostorBenchmark(App* app)
+{
+    // Logged so both averages can be compared after the run
+    const ImpostorBenchmark& benchmark = app->impostorBenchmark;
+    f64 averages[2] = {};
+    for (u32 i = 0; i < 2; ++i)
+        averages[i] = benchmark.frameCount[i] > 0 ? benchmark.frameTimeSum[i] / benchmark.frameCount[i] : 0.0;
+    ILOG("Impostor benchmark of %u entities: meshes only %.2f ms over %u frames, impostors %.2f ms over %u frames",
+        benchmark.entityCount, averages[0], benchmark.frameCount[0], averages[1], benchmark.frameCount[1]);
+
+    app->entities.resize(app->entities.size() - app->impostorBenchmark.entityCount);
+    app->impostorBenchmark = ImpostorBenchmark{};
+}
+
+/**
+ * The benchmark of -impostor-benchmark: once the startup assets are loaded spawns the scene, times
+ * impostorBenchmarkFrames frames with meshes only and as many with impostors, logs both and quits.
+ */
+void UpdateImpostorBenchmarkRun(App* app)
+{
+    ImpostorBenchmark& benchmark = app->impostorBenchmark;
+    if (benchmark.entityCount == 0)
+    {
+        SpawnImpostorBenchmark(app, 64);
+        app->impostorsEnabled = false;
+    }
+    else if (!app->impostorsEnabled && benchmark.frameCount[0] >= app->impostorBenchmarkFrames)
+    {
+        app->impostorsEnabled = true;
+    }
+    else if (app->impostorsEnabled && benchmark.frameCount[1] >= app->impostorBenchmarkFrames)
+    {
+        ClearImpostorBenchmark(app);
+        app->impostorBenchmarkFrames = 0;
+        app->isRunning = false;
+    }
+}
+#pragma endregion
+
+u32 SelectLod(App* app, f32 projectedSize, u32 currentLod, u32 lodCount)
+{
+    if (!app->automaticLod)
+        return glm::min((u32)app->forcedLod, lodCount - 1);
+
+    // A threshold has to be passed by the hysteresis margin before switching, both ways
+    u32 lod = glm::min(currentLod, lodCount - 1);
+    while (lod + 1 < lodCount && projectedSize < app->lodScreenSizes[lod] * (1.0f - app->lodHysteresis))
+        lod++;
+    while (lod > 0 && projectedSize > app->lodScreenSizes[lod - 1] * (1.0f + app->lodHysteresis))
+        lod--;
+    return lod;
+}
+
+void UnloadModel(App* app, u32 modelIdx)
+{
+    Model& model = app->models[modelIdx];
+    Mesh& mesh = app->meshes[model.meshIdx];
+    if (!mesh.isLoaded)
     {
-        if (submesh.vaos[i].programHandle == program.handle)
-            return submesh.vaos[i].handle;
+        ELOG("Model %u is still loading, it can't be unloaded yet", modelIdx);
+        return;
     }
 
-    u32 vaoHandle = 0;
+    for (Submesh& submesh : mesh.submeshes)
+        FreeSubmeshGeometry(app->geometryArena, submesh);
 
-    glGenVertexArrays(1, &vaoHandle);
-    glBindVertexArray(vaoHandle);
+    FreeMeshGeometrySource(mesh);
+    mesh.submeshes.clear();
+    model.materialIdx.clear();
 
-    glBindBuffer(GL_ARRAY_BUFFER, mesh.vertexBufferHandle);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBufferHandle);
-
-    for (u32 i = 0; i < program.vertexInputLayout.attributes.size(); ++i)
+    if (model.impostorIdx != UINT32_MAX)
     {
-        bool attributeWasLinked = false;
-
-        for (u32 j = 0; j < submesh.vertexBufferLayout.attributes.size(); ++j)
-        {
-            if (program.vertexInputLayout.attributes[i].location == submesh.vertexBufferLayout.attributes[j].location)
-            {
-                const u32 index = submesh.vertexBufferLayout.attributes[j].location;
-                const u32 ncomp = submesh.vertexBufferLayout.attributes[j].componentCount;
-                const u32 offset = submesh.vertexBufferLayout.attributes[j].offset + submesh.vertexOffset;
-                const u32 stride = submesh.vertexBufferLayout.stride;
-
-                glVertexAttribPointer(index, ncomp, GL_FLOAT, GL_FALSE, stride, (void*)(u64)offset);
-                glEnableVertexAttribArray(index);
-
-                attributeWasLinked = true;
-                break;
-            }
-        }
-        assert(attributeWasLinked);
+        Impostor& impostor = app->impostors[model.impostorIdx];
+        glDeleteTextures(1, &impostor.albedoTexture);
+        glDeleteTextures(1, &impostor.normalDepthTexture);
+        impostor = Impostor{};
+        model.impostorIdx = UINT32_MAX;
     }
 
-    glBindVertexArray(0);
-
-    Vao vao = { vaoHandle, program.handle };
-    submesh.vaos.push_back(vao);
+    // Loading the file again imports it into new slots
+    for (auto it = app->assets.models.begin(); it != app->assets.models.end();)
+        it = it->second == modelIdx ? app->assets.models.erase(it) : std::next(it);
+    for (auto it = app->assets.meshes.begin(); it != app->assets.meshes.end();)
+        it = it->second == model.meshIdx ? app->assets.meshes.erase(it) : std::next(it);
 
-    return vaoHandle;
+    DefragmentGeometryArena(app->geometryArena);
 }
 
 void Init(App* app)
@@ -595,18 +2496,43 @@ void Init(App* app)
     // - programs (and retrieve uniform indices)
     // - textures
 
+    f64 initStart = GetElapsedMilliseconds();
+
+    u32 assetWorkerCount = app->serialAssetLoading ? 0 : GetDefaultAssetWorkerCount();
+    StartAssetLoader(app->assetLoader, assetWorkerCount, ExecuteAssetJob);
+
+    InitGeometryArena(app->geometryArena);
+    InitTextureUploadRing(app->textureUploadRing);
+
     app->shadingType = ShadingType::FORWARD;
     app->renderTarget = RenderTarget::RENDER_ALBEDO;
 
     GenerateQuadVao(app);
 
-    app->quadFBshader = LoadProgram(app, "quadFrameBuffer.glsl", "QUAD_FRAMEBUFFER");
+    // Variants compiled up front are for a scene with both light types, see Update for the real key
+    app->shaderKey = MakeShaderPermutationKey(app, true, true);
+
+    app->quadPermutations = LoadProgramPermutations(app, "quadFrameBuffer.glsl", "QUAD_FRAMEBUFFER", ShaderFeature_RenderTarget | ShaderFeature_Exposure);
 
     app->lightShader = LoadProgram(app, "lightShader.glsl", "LIGHT_SHADER");
 
     app->bloomShader = LoadProgram(app, "bloomShader.glsl", "BLOOM_SHADER");
 
-    app->quadDeferredShader = LoadProgram(app, "DeferredShader.glsl", "QUAD_DEFERRED");
+    app->deferredPermutations = LoadProgramPermutations(app, "DeferredShader.glsl", "QUAD_DEFERRED", ShaderFeature_LightTypes | ShaderFeature_Exposure);
+
+    app->impostorBakeShader = LoadProgram(app, "impostorShader.glsl", "IMPOSTOR_BAKE");
+    app->impostorPermutations = LoadProgramPermutations(app, "impostorShader.glsl", "IMPOSTOR", ShaderFeature_RenderTarget | ShaderFeature_LightTypes);
+    glGenVertexArrays(1, &app->impostorVao);
+    glGenBuffers(1, &app->impostorInstanceBuffer);
+
+    app->meshletCullingShader = LoadComputeProgram(app, "meshletCulling.glsl", "MESHLET_CULLING");
+
+    app->nodeInstances.push_back(glm::mat4(1.0f));
+    app->nodeInstanceBufferDirty = true;
+    glGenBuffers(1, &app->nodeInstanceBuffer);
+    glGenBuffers(1, &app->meshletBuffer);
+    glGenBuffers(1, &app->culledIndexBuffer);
+    glGenBuffers(1, &app->meshletCommandBuffer);
     
     app->camera = std::make_shared<EditorCamera>(app->displaySize.x, app->displaySize.y, 0.1f, 100.0f);
 
@@ -634,9 +2560,9 @@ void Init(App* app)
     glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &app->maxUniformBufferSize);
     glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &app->uniformBlockAlignment);
     
-    // Bind buffer handle   
-    app->uniformBuffer = CreateBuffer(app->maxUniformBufferSize, GL_UNIFORM_BUFFER, GL_STATIC_DRAW);
-    app->globalParamsOffset = app->uniformBuffer.head;
+    // Pages are written a frame at a time and each block is bound on its own, so they can be
+    // larger than a block may be
+    InitUniformRing(app->uniformRing, app->uniformBlockAlignment, glm::max((u32)app->maxUniformBufferSize, (u32)UNIFORM_RING_PAGE_SIZE));
 
 
 
@@ -673,9 +2599,14 @@ void Init(App* app)
 
     app->diceTexIdx = LoadTexture2D(app, "dice.png");
     app->whiteTexIdx = LoadTexture2D(app, "color_white.png");
-    app->blackTexIdx = LoadTexture2D(app, "color_black.png");
-    app->normalTexIdx = LoadTexture2D(app, "color_normal.png");
+    app->blackTexIdx = LoadTexture2D(app, "color_black.png", TextureUsage_Height);
+    app->normalTexIdx = LoadPackedTexture2D(app, MakeNormalHeightPackDesc("color_normal.png", ""), TextureUsage_NormalHeight);
     app->magentaTexIdx = LoadTexture2D(app, "color_magenta.png");
+    app->ormTexIdx = LoadPackedTexture2D(app, MakeOrmPackDesc("", "", ""), TextureUsage_Color);
+
+    // Placeholders for everything loaded from here on, they have to be ready for the first frame
+    WaitForAssetLoads(app);
+    app->proxyMeshIdx = CreateProxyMesh(app);
 #pragma endregion
      
     // ------- Lights -------
@@ -811,12 +2742,10 @@ void Init(App* app)
     // Textures
     // Load model texture and get texture ID from the vectors of textures.
     app->modelTexture = LoadTexture2D(app, "Relief/bricks2.jpg");
-    app->modelNormalTexture = LoadTexture2D(app, "Relief/bricks2_normal.jpg");
-    app->modelBumpTexture = LoadTexture2D(app, "Relief/bricks2_disp.jpg");
+    app->modelNormalHeightTexture = LoadPackedTexture2D(app, MakeNormalHeightPackDesc("Relief/bricks2_normal.jpg", "Relief/bricks2_disp.jpg"), TextureUsage_NormalHeight);
 
    u32 wallColor = LoadTexture2D(app, "Relief/Wall2/WallAlbedo.jpg");
-   u32 wallNormal = LoadTexture2D(app, "Relief/Wall2/WallNormal.jpg");
-   u32 wallHeight = LoadTexture2D(app, "Relief/Wall2/WallHeight.png");
+   u32 wallNormalHeight = LoadPackedTexture2D(app, MakeNormalHeightPackDesc("Relief/Wall2/WallNormal.jpg", "Relief/Wall2/WallHeight.png"), TextureUsage_NormalHeight);
 
 
     //
@@ -831,6 +2760,9 @@ void Init(App* app)
     u32 model5 = LoadModel(app, "Barbaro/barbaraso.obj"); 
     
     
+    glGenBuffers(1, &app->materialParamsBuffer);
+    app->defaultMaterialIdx = CreateParameterMaterial(app, "Default");
+
     Entity ent2 = {};
     ent2.PushEntity(model2);
     ent2.position = vec3(9.0f, 0.0f, 0.0f);
@@ -838,11 +2770,7 @@ void Init(App* app)
     ent2.rotation = vec3(0.0f);
     ent2.hasRelief = false;
     ent2.textureIdx = -1;
-    ent2.normalIdx = -1;
-    ent2.bumpIdx = -1;
-    ent2.bumpiness = -1.0f;
-    ent2.minLayers = -1.0f;
-    ent2.maxLayers = -1.0f;
+    ent2.normalHeightIdx = -1;
     app->entities.push_back(ent2);
 
     Entity ent3 = {};
@@ -852,11 +2780,7 @@ void Init(App* app)
     ent3.rotation = vec3(0.0f);
     ent3.hasRelief = false;
     ent3.textureIdx = -1;
-    ent3.normalIdx = -1;
-    ent3.bumpIdx = -1;
-    ent3.bumpiness = -1.0f;
-    ent3.minLayers = -1.0f;
-    ent3.maxLayers = -1.0f;
+    ent3.normalHeightIdx = -1;
     app->entities.push_back(ent3);
         
     Entity ent4 = {};
@@ -866,11 +2790,8 @@ void Init(App* app)
     ent4.rotation = vec3(0.0f);
     ent4.hasRelief = true;
     ent4.textureIdx = app->modelTexture;
-    ent4.normalIdx = app->modelNormalTexture;
-    ent4.bumpIdx = app->modelBumpTexture;
-    ent4.bumpiness = 0.2f;
-    ent4.minLayers = 8.0f;
-    ent4.maxLayers = 32.0f;
+    ent4.normalHeightIdx = app->modelNormalHeightTexture;
+    ent4.reliefMaterialIdx = CreateReliefMaterial(app, "Relief ground", 0.2f, 8.0f, 32.0f);
     app->entities.push_back(ent4);
 
     Entity ent5 = {};
@@ -880,11 +2801,8 @@ void Init(App* app)
     ent5.rotation = vec3(0.0f);
     ent5.hasRelief = true;
     ent5.textureIdx = wallColor;
-    ent5.normalIdx = wallNormal;
-    ent5.bumpIdx = wallHeight;
-    ent5.bumpiness = -0.2f;
-    ent5.minLayers = 8.0f;
-    ent5.maxLayers = 32.0f;
+    ent5.normalHeightIdx = wallNormalHeight;
+    ent5.reliefMaterialIdx = CreateReliefMaterial(app, "Relief wall", -0.2f, 8.0f, 32.0f);
     app->entities.push_back(ent5);
 
     Entity ent6 = {};
@@ -894,29 +2812,13 @@ void Init(App* app)
     ent6.rotation = vec3(0.0f);
     ent6.hasRelief = false;
     ent6.textureIdx = -1;
-    ent6.normalIdx = -1;
-    ent6.bumpIdx = -1;
-    ent6.bumpiness = -1;
-    ent6.minLayers = -1;
-    ent6.maxLayers = -1;
+    ent6.normalHeightIdx = -1;
     app->entities.push_back(ent6);
     
-    // Load shader and get shader Id, but this Id is for the vector of shaders, it's not actually the renderer ID
-    app->modelShaderID = LoadProgram(app, "meshShader.glsl", "MESH_GEOMETRY");
-    app->reliefShaderID = LoadProgram(app, "reliefShader.glsl", "MESH_GEOMETRY_RELIEF");
-   
- 
-    
-
-    // Get shader itself
-    Program& shaderModel = app->programs[app->modelShaderID];
-    // Get uniform location from the texture for later use
-    app->modelShaderTextureUniformLocation = glGetUniformLocation(shaderModel.handle, "uTexture");
-    
-    Program& shaderModelRelief = app->programs[app->reliefShaderID];
-    app->modelShaderTextureReliefUniformLocation = glGetUniformLocation(shaderModelRelief.handle, "uTexture");
-    app->modelShaderNormalTextureUniformLocation = glGetUniformLocation(shaderModelRelief.handle, "normalMap");
-    app->modelShaderBumpTextureUniformLocation = glGetUniformLocation(shaderModelRelief.handle, "depthMap");
+    // Load shader and get shader Id, but this Id is for the vector of shaders, it's not actually the renderer ID.
+    // Each is a set of variants, the samplers are set by name on whichever one is drawn with.
+    app->modelPermutations = LoadProgramPermutations(app, "meshShader.glsl", "MESH_GEOMETRY", ShaderFeature_RenderTarget | ShaderFeature_LightTypes);
+    app->reliefPermutations = LoadProgramPermutations(app, "reliefShader.glsl", "MESH_GEOMETRY_RELIEF", ShaderFeature_RenderTarget | ShaderFeature_LightTypes | ShaderFeature_ReliefQuality);
 
 
     // End Mesh Program
@@ -934,6 +2836,13 @@ void Init(App* app)
     }
 
     app->mode = Mode::Mode_Count;
+
+    if (!app->progressiveLoading)
+        WaitForAssetLoads(app);
+
+    app->startupTimeline.initFinished = GetElapsedMilliseconds();
+
+    ILOG("Init finished in %.2f ms (%u asset workers)", app->startupTimeline.initFinished - initStart, assetWorkerCount);
 }
 
 void Gui(App* app)
@@ -1021,6 +2930,96 @@ void Gui(App* app)
             ImGui::EndMenu();
         }
 
+        if (ImGui::BeginMenu("LOD"))
+        {
+            ImGui::Checkbox("Automatic LOD", &app->automaticLod);
+
+            if (app->automaticLod)
+            {
+                ImGui::Text("Screen size thresholds");
+                ImGui::SliderFloat("##LOD 1", &app->lodScreenSizes[0], 0.0f, 1.0f, "LOD 1 below %.2f");
+                ImGui::SliderFloat("##LOD 2", &app->lodScreenSizes[1], 0.0f, 1.0f, "LOD 2 below %.2f");
+                ImGui::SliderFloat("##LOD 3", &app->lodScreenSizes[2], 0.0f, 1.0f, "LOD 3 below %.2f");
+                ImGui::Text("Hysteresis");
+                ImGui::SliderFloat("##Hysteresis", &app->lodHysteresis, 0.0f, 0.5f, "%.2f");
+            }
+            else
+            {
+                ImGui::Text("Forced LOD");
+                ImGui::SliderInt("##Forced LOD", &app->forcedLod, 0, MESH_MAX_LODS - 1);
+            }
+
+            ImGui::EndMenu();
+        }
+
+        if (ImGui::BeginMenu("Import"))
+        {
+            // Only models loaded afterwards, and their cache files, see the change
+            ImGui::Checkbox("Keep node hierarchy", &app->preserveModelHierarchy);
+            ImGui::Checkbox("Native OBJ parser", &app->nativeObjImport);
+
+            ImGui::Separator();
+            if (ImGui::Button("Benchmark OBJ import"))
+                BenchmarkObjImport(app);
+            for (const ObjImportBenchmark& benchmark : app->objImportBenchmarks)
+            {
+                ImGui::Text("%s: native %.2f ms (%u threads), Assimp %.2f ms", benchmark.filepath.c_str(),
+                    benchmark.nativeMs, benchmark.threadCount, benchmark.assimpMs);
+            }
+
+            ImGui::EndMenu();
+        }
+
+        if (ImGui::BeginMenu("Impostors"))
+        {
+            ImGui::Checkbox("Enabled", &app->impostorsEnabled);
+            ImGui::Text("Distance");
+            ImGui::SliderFloat("##Impostor Distance", &app->impostorDistance, 1.0f, 100.0f, "%.1f");
+            ImGui::Text("Impostors drawn: %u in %u batches", (u32)app->impostorInstances.size(), (u32)app->impostorBatches.size());
+
+            ImGui::Separator();
+            ImpostorBenchmark& benchmark = app->impostorBenchmark;
+            if (benchmark.entityCount == 0)
+            {
+                if (ImGui::Button("Spawn benchmark scene"))
+                    SpawnImpostorBenchmark(app, 64);
+            }
+            else
+            {
+                ImGui::Text("%u Patricks, toggle impostors to compare", benchmark.entityCount);
+                for (u32 i = 0; i < 2; ++i)
+                {
+                    f64 average = benchmark.frameCount[i] > 0 ? benchmark.frameTimeSum[i] / benchmark.frameCount[i] : 0.0;
+                    ImGui::Text("%s: %.2f ms over %u frames", i ? "Impostors" : "Meshes only", average, benchmark.frameCount[i]);
+                }
+                if (ImGui::Button("Reset timings"))
+                {
+                    u32 entityCount = benchmark.entityCount;
+                    benchmark = ImpostorBenchmark{};
+                    benchmark.entityCount = entityCount;
+                }
+                if (ImGui::Button("Remove benchmark scene"))
+                    ClearImpostorBenchmark(app);
+            }
+
+            ImGui::EndMenu();
+        }
+
+        if (ImGui::BeginMenu("Culling"))
+        {
+            ImGui::Checkbox("Meshlet culling", &app->meshletCulling);
+            ImGui::Text("%u meshlets tested of %u loaded", app->meshletsTested, (u32)app->meshlets.size());
+
+            ImGui::Checkbox("Count visible triangles (stalls)", &app->meshletCullingStats);
+            if (app->meshletCullingStats && app->meshletIndicesSubmitted > 0)
+            {
+                ImGui::Text("%u of %u triangles kept (%.1f%%)", app->meshletIndicesVisible / 3, app->meshletIndicesSubmitted / 3,
+                    100.0f * app->meshletIndicesVisible / app->meshletIndicesSubmitted);
+            }
+
+            ImGui::EndMenu();
+        }
+
         if (ImGui::BeginMenu("Utils"))
         {
             static float speed = 10.0f;
@@ -1069,6 +3068,146 @@ void Gui(App* app)
 
     ImGui::Begin("Info");
     ImGui::Text("FPS: %f", 1.0f/app->deltaTime);
+
+    if (ImGui::CollapsingHeader("Geometry arena"))
+    {
+        GeometryArenaStats stats = GetGeometryArenaStats(app->geometryArena);
+        ImGui::Text("Vertex layouts (VAOs): %u", stats.vertexPoolCount);
+        ImGui::Text("Pages: %u, %.2f MB", stats.pageCount, stats.capacity / (1024.0 * 1024.0));
+        ImGui::Text("Used: %.2f MB, largest free range: %.2f MB", stats.usedSize / (1024.0 * 1024.0), stats.largestFreeRange / (1024.0 * 1024.0));
+        ImGui::Text("Draws: %u, defragments: %u", (u32)app->modelDraws.size(), app->geometryArena.defragmentCount);
+
+        GeometryFootprint footprint = GetCpuGeometryFootprint(app);
+        ImGui::Text("CPU copies: %.2f MB kept, %.2f MB mapped, %.2f MB metadata", footprint.keptBytes / (1024.0 * 1024.0),
+            footprint.mappedBytes / (1024.0 * 1024.0), footprint.metadataBytes / (1024.0 * 1024.0));
+
+        const char* residencyNames[GeometryResidency_Count];
+        for (u32 i = 0; i < GeometryResidency_Count; ++i)
+            residencyNames[i] = GetGeometryResidencyName((GeometryResidency)i);
+
+        // Only meshes loaded afterwards, the ones below switch on their own
+        int defaultResidency = app->geometryResidency;
+        if (ImGui::Combo("CPU geometry of new meshes", &defaultResidency, residencyNames, GeometryResidency_Count))
+            app->geometryResidency = (GeometryResidency)defaultResidency;
+
+        u32 modelToUnload = UINT32_MAX;
+        for (const auto& model : app->assets.models)
+        {
+            if (ImGui::Button(("Unload##" + model.first).c_str()))
+                modelToUnload = model.second;
+            ImGui::SameLine();
+
+            Mesh& mesh = app->meshes[app->models[model.second].meshIdx];
+            int residency = mesh.geometrySource.residency;
+            ImGui::SetNextItemWidth(80.0f);
+            if (mesh.isLoaded && ImGui::Combo(("##Residency" + model.first).c_str(), &residency, residencyNames, GeometryResidency_Count))
+                SetMeshGeometryResidency(mesh, (GeometryResidency)residency);
+            ImGui::SameLine();
+            ImGui::Text("%s", model.first.c_str());
+        }
+
+        if (modelToUnload != UINT32_MAX)
+            UnloadModel(app, modelToUnload);
+    }
+
+    if (ImGui::CollapsingHeader("Texture uploads"))
+    {
+        const TextureUploadRing& ring = app->textureUploadRing;
+        ImGui::Text("Ring: %.2f / %.2f MB in use%s", GetTextureUploadRingUsage(app->textureUploadRing) / (1024.0 * 1024.0),
+            ring.size / (1024.0 * 1024.0), ring.mapped ? "" : " (unavailable, uploading from memory)");
+        ImGui::Text("This frame: %u textures, %.2f MB, %u queued", ring.frameTextures, ring.frameBytes / (1024.0 * 1024.0), (u32)app->pendingTextureUploads.size());
+        ImGui::Text("Total: %u textures, %.2f MB, %u from memory", ring.totalTextures, ring.totalBytes / (1024.0 * 1024.0), ring.memoryUploads);
+        ImGui::Text("Budget");
+        ImGui::SliderFloat("##Texture Upload Budget", &app->textureUploadBudgetMB, 1.0f, 64.0f, "%.0f MB per frame");
+    }
+
+    if (ImGui::CollapsingHeader("Uniform ring"))
+    {
+        const UniformRing& ring = app->uniformRing;
+        ImGui::Text("%u pages of %u KB, %u frames in flight, %.2f MB%s", (u32)ring.pages.size(), ring.pageSize / 1024,
+            UNIFORM_RING_FRAMES, GetUniformRingSize(ring) / (1024.0 * 1024.0), ring.persistent ? "" : " (mapped every frame)");
+        ImGui::Text("This frame: %.2f KB in %u pages", ring.frameBytes / 1024.0, ring.framePages);
+        ImGui::Text("Waits on the GPU: %u this frame, %u total", ring.frameWaits, ring.totalWaits);
+    }
+
+    if (ImGui::CollapsingHeader("Program uniforms"))
+    {
+        const BasicUniformUploader& uploader = app->uniformUploader;
+        ImGui::Text("Last frame: %u uploaded, %u skipped as unchanged", uploader.uploadCount, uploader.skippedCount);
+        ImGui::Text("Material buffer: %u materials, %u writes since startup", (u32)app->materials.size(), app->materialParamsWrites);
+        for (const Program& program : app->programs)
+        {
+            ImGui::Text("%s: %u uniforms, %u blocks", program.programName.c_str(), (u32)program.uniforms.size(),
+                (u32)program.uniformBlocks.size());
+        }
+    }
+
+    if (ImGui::CollapsingHeader("Shader permutations"))
+    {
+        // Takes effect with the next key, a quality not drawn with before compiles on its first frame
+        const char* qualities[] = { "Parallax offset", "Steep parallax", "Parallax occlusion" };
+        int quality = (int)app->reliefQuality;
+        if (ImGui::Combo("Relief quality", &quality, qualities, IM_ARRAYSIZE(qualities)))
+            app->reliefQuality = (ReliefQuality)quality;
+
+        ImGui::Text("Key: 0x%03x", app->shaderKey);
+        for (const ProgramPermutations& permutations : app->programPermutations)
+            ImGui::Text("%s: %u variants", permutations.programName.c_str(), (u32)permutations.variants.size());
+    }
+
+    if (ImGui::CollapsingHeader("Texture streaming"))
+    {
+        u64 residentBytes = 0;
+        u64 fullBytes = 0;
+        u32 streamedCount = 0;
+        for (const Texture& tex : app->textures)
+        {
+            residentBytes += tex.gpuSize;
+            fullBytes += tex.fullSize;
+            streamedCount += tex.residency.chain.mipCount > 0 ? 1 : 0;
+        }
+
+        // Textures loaded before the change keep the way they were loaded
+        ImGui::Checkbox("Stream textures", &app->textureStreaming);
+        ImGui::Text("Budget");
+        ImGui::SliderFloat("##Texture Budget", &app->textureBudgetMB, 16.0f, 2048.0f, "%.0f MB");
+        ImGui::Text("Resident: %.2f MB of %.2f MB, %u of %u textures streamed", residentBytes / (1024.0 * 1024.0),
+            fullBytes / (1024.0 * 1024.0), streamedCount, (u32)app->textures.size());
+        ImGui::Text("This frame: %u levels raised, %u textures evicted", app->textureMipsRaised, app->textureMipsEvicted);
+    }
+
+    if (ImGui::CollapsingHeader("Texture arrays"))
+    {
+        ImGui::Text("%s, set at startup", app->textureArrays ? "Enabled" : "Disabled");
+        u32 layerCount = 0;
+        u64 poolBytes = 0;
+        for (const TextureArrayPool& pool : app->texturePools.pools)
+        {
+            layerCount += (u32)pool.layerOwners.size();
+            poolBytes += GetTextureArrayPoolSize(pool);
+        }
+        ImGui::Text("Pools: %u, %u layers, %.2f MB allocated, grown %u times", (u32)app->texturePools.pools.size(),
+            layerCount, poolBytes / (1024.0 * 1024.0), app->texturePools.growCount);
+        ImGui::Text("Texture binds this frame: %u for %u draws", app->textureBindChanges, (u32)app->modelDraws.size());
+    }
+
+    if (ImGui::CollapsingHeader("Vertex cache"))
+    {
+        for (const auto& model : app->assets.models)
+        {
+            const Mesh& mesh = app->meshes[app->models[model.second].meshIdx];
+            if (!ImGui::TreeNode(model.first.c_str()))
+                continue;
+
+            for (u32 i = 0; i < mesh.submeshes.size(); ++i)
+            {
+                const VertexCacheStats& stats = mesh.submeshes[i].cacheStats;
+                ImGui::Text("Submesh %u: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", i,
+                    stats.acmrBefore, stats.acmrAfter, stats.atvrBefore, stats.atvrAfter);
+            }
+            ImGui::TreePop();
+        }
+    }
     ImGui::End();
 
     // Show demo window enjain
@@ -1078,11 +3217,20 @@ void Gui(App* app)
     ImGui::Text("Cam Pos: %f, %f, %f", app->camera->GetPosition().x, app->camera->GetPosition().y, app->camera->GetPosition().z);
     ImGui::End();
 
-    for (u32 i = 0; i < app->entities.size(); ++i)
+    // The benchmark scene is too big to list
+    for (u32 i = 0; i < app->entities.size() - app->impostorBenchmark.entityCount; ++i)
     {
         ImGui::Begin("Entities Info");
         ImGui::PushID(i);
-        ImGui::Text("Entity %d", i);
+        ImGui::Text("Entity %d, LOD %u", i, app->entities[i].lod);
+        const Model& model = app->models[app->entities[i].modelIndex];
+        if (!model.nodes.empty())
+        {
+            u32 instanceCount = 0;
+            for (const NodeInstanceRange& instances : model.submeshInstances)
+                instanceCount += instances.count;
+            ImGui::Text("%u nodes, %u submesh instances", (u32)model.nodes.size(), instanceCount);
+        }
         glm::vec3& position = app->entities[i].position;
         glm::vec3& scale = app->entities[i].scale;
        
@@ -1127,18 +3275,23 @@ void Gui(App* app)
         {
             ImGui::Text("Relief Options");
 
+            // Only the edited material's entry of the buffer is rewritten
+            Material& material = app->materials[app->entities[i].reliefMaterialIdx];
+            bool edited = false;
             ImGui::Text("Bumpiness");
             ImGui::SameLine();
-            ImGui::DragFloat("##Bumpiness", &app->entities[i].bumpiness, 0.05f, -20.0f, 100.0f, "%.2f");
+            edited |= ImGui::DragFloat("##Bumpiness", &material.bumpiness, 0.05f, -20.0f, 100.0f, "%.2f");
 
             ImGui::Text("Min Layers");
             ImGui::SameLine();
-            ImGui::DragFloat("##Min Layers", &app->entities[i].minLayers, 1.0f, 0.0f, 1000.0f, "%.2f");
+            edited |= ImGui::DragFloat("##Min Layers", &material.minLayers, 1.0f, 0.0f, 1000.0f, "%.2f");
 
             ImGui::Text("Max Layers");
             ImGui::SameLine();
-            ImGui::DragFloat("##Max Layers", &app->entities[i].maxLayers, 1.0f, 0.0f, 1000.0f, "%.2f");
+            edited |= ImGui::DragFloat("##Max Layers", &material.maxLayers, 1.0f, 0.0f, 1000.0f, "%.2f");
 
+            if (edited)
+                WriteMaterialParams(app, app->entities[i].reliefMaterialIdx);
         }
 
         ImGui::PopItemWidth();
@@ -1241,59 +3394,159 @@ void Gui(App* app)
 
 void Update(App* app)
 {
+    app->uniformUploader.ResetStats();
+
+    // Upload whatever the asset workers finished since last frame
+    BeginTextureUploadFrame(app->textureUploadRing);
+    ProcessFinishedAssetJobs(app, app->assetUploadBudgetMs, (u64)(app->textureUploadBudgetMB * 1024.0f * 1024.0f));
+    StartupTimeline& timeline = app->startupTimeline;
+    if (timeline.fullyLoaded == 0.0 && !HasPendingAssetJobs(app->assetLoader))
+        timeline.fullyLoaded = GetElapsedMilliseconds();
+
+    if (!timeline.reported && timeline.fullyLoaded != 0.0 && timeline.firstFrame != 0.0)
+    {
+        ReportStartupTimeline(app);
+        timeline.reported = true;
+    }
+
     // Update Camera
     app->camera->Update(app->input, app->deltaTime);
 
-#pragma region Update Uniform buffers
-    // ------ Update uniform buffer lights -------
-    MapBuffer(app->uniformBuffer, GL_WRITE_ONLY);
+    BakePendingImpostors(app);
 
-    app->globalParamsOffset = app->uniformBuffer.head;
+    if (app->impostorBenchmarkFrames > 0 && timeline.reported)
+        UpdateImpostorBenchmarkRun(app);
 
-    PushVec3(app->uniformBuffer, app->camera->GetPosition());
-    PushUInt(app->uniformBuffer, app->lights.size());
-
-    for (u32 i = 0; i < app->lights.size(); ++i)
+    ImpostorBenchmark& benchmark = app->impostorBenchmark;
+    if (benchmark.entityCount > 0)
     {
-        AlignHead(app->uniformBuffer, sizeof(vec4));
+        benchmark.frameTimeSum[app->impostorsEnabled ? 1 : 0] += app->deltaTime * 1000.0;
+        benchmark.frameCount[app->impostorsEnabled ? 1 : 0]++;
+    }
 
-        Light& light = app->lights[i];
-        PushUInt(app->uniformBuffer, light.type);
-        PushVec3(app->uniformBuffer, light.color);
-        PushVec3(app->uniformBuffer, light.direction);
-        PushVec3(app->uniformBuffer, light.position);
-        PushVec3(app->uniformBuffer, light.intensity);
+#pragma region Update Uniform buffers
+    // Blocks go straight into the slot of this frame, the GPU may still be reading the last two
+    BeginUniformRingFrame(app->uniformRing);
+
+    // ------ Update uniform buffer lights -------
+    // The range covers the whole block the shaders declare, only the lights in use are written
+    // Directional lights are written first so the shaders loop over each type without branching on it
+    u32 directionalLightCount = 0;
+    for (const Light& light : app->lights)
+        directionalLightCount += light.type == LightType_Directional ? 1 : 0;
+    directionalLightCount = glm::min(directionalLightCount, (u32)UNIFORM_MAX_LIGHTS);
+    const u32 lightCount = glm::min((u32)app->lights.size(), (u32)UNIFORM_MAX_LIGHTS);
+    app->shaderKey = MakeShaderPermutationKey(app, directionalLightCount > 0, lightCount > directionalLightCount);
+
+    UniformBlock globalBlock = AllocateUniformBlock(app->uniformRing, sizeof(GlobalParamsBlock));
+    Buffer globalParams = { sizeof(GlobalParamsBlock), GL_UNIFORM_BUFFER, globalBlock.buffer, globalBlock.data, 0 };
+
+    PushVec3(globalParams, app->camera->GetPosition());
+    PushUInt(globalParams, lightCount);
+    PushUInt(globalParams, directionalLightCount);
+
+    u32 writtenLightCount = 0;
+    for (u32 pass = 0; pass < 2; ++pass)
+    {
+        const LightType passType = pass == 0 ? LightType_Directional : LightType_Point;
+        for (const Light& light : app->lights)
+        {
+            if (light.type != passType || writtenLightCount == lightCount)
+                continue;
+
+            AlignHead(globalParams, sizeof(vec4));
+            PushUInt(globalParams, light.type);
+            PushVec3(globalParams, light.color);
+            PushVec3(globalParams, light.direction);
+            PushVec3(globalParams, light.position);
+            PushVec3(globalParams, light.intensity);
+            ++writtenLightCount;
+        }
     }
+    ASSERT(globalParams.head <= sizeof(GlobalParamsBlock), "GlobalParams overflowed its block");
 
-    app->globalParamsSize = app->uniformBuffer.head - app->globalParamsOffset;
+    app->globalParamsBuffer = globalBlock.buffer;
+    app->globalParamsOffset = globalBlock.offset;
+    app->globalParamsSize = sizeof(GlobalParamsBlock);
 
     // ------ Update uniform buffer lights End -------
 
 
     // ------  Update uniform buffer entities -------
 
+    std::vector<std::pair<u32, u32>> impostorEntities; // Model and entity
+
     for (u32 i = 0; i < app->entities.size(); ++i)
     {
-        AlignHead(app->uniformBuffer, app->uniformBlockAlignment);
-
         Entity& entity = app->entities[i];
         glm::mat4 world = entity.GetTransform();
-        glm::mat4 mvp = app->camera->GetViewProjection() * entity.GetTransform();
-        glm::mat4 view = app->camera->GetView();
 
-        entity.localParamsOffset = app->uniformBuffer.head;
-        PushMat4(app->uniformBuffer, world);
-        PushMat4(app->uniformBuffer, mvp);
-        PushMat4(app->uniformBuffer, view);
+        // Past the impostor distance the entity is one instance of its model's impostor
+        const Model& model = app->models[entity.modelIndex];
+        entity.isImpostor = false;
+        if (app->impostorsEnabled && model.impostorIdx != UINT32_MAX && !entity.hasRelief)
+        {
+            const Impostor& impostor = app->impostors[model.impostorIdx];
+            glm::vec3 center = glm::vec3(world * glm::vec4(impostor.center, 1.0f));
+            entity.isImpostor = glm::length(center - app->camera->GetPosition()) > app->impostorDistance;
+        }
+
+        if (entity.isImpostor)
+        {
+            impostorEntities.push_back(std::make_pair(entity.modelIndex, i));
+            continue;
+        }
+
+        // Stretch the proxy cube over the bounds of a mesh that is still loading
+        const Mesh* mesh = &app->meshes[app->models[entity.modelIndex].meshIdx];
+        if (!mesh->isLoaded)
+        {
+            glm::vec3 center = 0.5f * (mesh->aabbMin + mesh->aabbMax);
+            glm::vec3 extent = glm::max(mesh->aabbMax - mesh->aabbMin, glm::vec3(0.01f));
+            world = world * glm::translate(center) * glm::scale(extent);
+            mesh = &app->meshes[app->proxyMeshIdx];
+        }
+
+        if (mesh->isLoaded)
+        {
+            u32 lodCount = 1;
+            for (const Submesh& submesh : mesh->submeshes)
+                lodCount = glm::max(lodCount, submesh.lodCount);
+            f32 projectedSize = GetProjectedSize(app, *mesh, world);
+            entity.lod = SelectLod(app, projectedSize, entity.lod, lodCount);
+
+            f32 pixelSize = projectedSize * app->displaySize.y;
+            RequestModelTextureResidency(app, app->models[entity.modelIndex], pixelSize);
+            RequestTextureResidency(app, entity.textureIdx, pixelSize);
+            RequestTextureResidency(app, entity.normalHeightIdx, pixelSize);
+        }
+
+        glm::mat4 mvp = app->camera->GetViewProjection() * world;
+        glm::mat4 view = app->camera->GetView();
 
-        entity.localParamsSize = app->uniformBuffer.head - entity.localParamsOffset;
+        UniformBlock localBlock = AllocateUniformBlock(app->uniformRing, sizeof(LocalParamsBlock));
+        Buffer localParams = { sizeof(LocalParamsBlock), GL_UNIFORM_BUFFER, localBlock.buffer, localBlock.data, 0 };
+        PushMat4(localParams, world);
+        PushMat4(localParams, mvp);
+        PushMat4(localParams, view);
+        PushVec3(localParams, mesh->positionScale);
+        PushVec3(localParams, mesh->positionOffset);
+
+        entity.localParamsBuffer = localBlock.buffer;
+        entity.localParamsOffset = localBlock.offset;
+        entity.localParamsSize = sizeof(LocalParamsBlock);
     }
 
-    UnmapBuffer(app->uniformBuffer);
+    FinishUniformRingWrites(app->uniformRing);
 
     // ------ Update uniform buffer entities End -------  
 #pragma endregion
 
+    std::stable_sort(impostorEntities.begin(), impostorEntities.end(),
+        [](const std::pair<u32, u32>& a, const std::pair<u32, u32>& b) { return a.first < b.first; });
+    BuildImpostorBatches(app, impostorEntities);
+    UpdateTextureStreaming(app);
+
 }
 
 void Render(App* app)
@@ -1395,102 +3648,269 @@ void Render(App* app)
 
         default:;
     }
+
+    // The draws reading this frame's uniform blocks are submitted, the slot is reused two frames on
+    EndUniformRingFrame(app->uniformRing);
+}
+
+void RenderProxy(App* app, const Entity& entity)
+{
+    Program& shaderModel = app->programs[GetProgramVariant(app, app->modelPermutations)];
+    glUseProgram(shaderModel.handle);
+
+    app->uniformUploader.UploadUniformFloat(shaderModel, UNIFORM("bloomRange"), app->bloomRange);
+    app->uniformUploader.UploadUniformInt(shaderModel, UNIFORM("uMaterialIndex"), (int)app->defaultMaterialIdx);
+
+    // Update already stretched the local params over the bounds of the pending mesh
+    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING(1), entity.localParamsBuffer, entity.localParamsOffset, entity.localParamsSize);
+
+    app->uniformUploader.UploadUniformInt(shaderModel, UNIFORM("uTexture"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, app->textures[app->whiteTexIdx].handle);
+
+    GeometryBinding binding = {};
+    DrawSubmesh(app, app->meshes[app->proxyMeshIdx].submeshes[0], shaderModel, binding);
+    glBindVertexArray(0);
+}
+
+// Sorted by program, then VAO and pages, then material, so consecutive draws share their state
+void BuildModelDraws(App* app)
+{
+    app->modelDraws.clear();
+
+    for (u32 i = 0; i < app->entities.size(); ++i)
+    {
+        const Entity& entity = app->entities[i];
+        const Model& model = app->models[entity.modelIndex];
+        const Mesh& mesh = app->meshes[model.meshIdx];
+        if (!mesh.isLoaded || entity.isImpostor)
+            continue;
+
+        for (u32 j = 0; j < mesh.submeshes.size(); ++j)
+        {
+            // Meshes of the file no node places
+            if (GetSubmeshInstances(model, j).count == 0)
+                continue;
+
+            // Relief textures come from the entity, mesh textures from the material. Pooled
+            // textures only need the same arrays bound, whatever the material.
+            const u64 program = entity.hasRelief ? 1 : 0;
+            u64 state = entity.hasRelief ? i : model.materialIdx[j];
+            if (app->textureArrays)
+            {
+                const Material& material = app->materials[model.materialIdx[j]];
+                const MaterialTextureLayer color = entity.hasRelief ? GetTextureLayer(app, entity.textureIdx, app->whiteTexIdx) : material.albedoLayer;
+                const MaterialTextureLayer maps = entity.hasRelief ? GetTextureLayer(app, entity.normalHeightIdx, app->normalTexIdx) : material.ormLayer;
+                state = ((u64)(color.pool & 0xFFFF) << 16) | (maps.pool & 0xFFFF);
+            }
+            const u64 geometry = GetSubmeshGeometryKey(app->geometryArena, mesh.submeshes[j]);
+
+            ModelDraw draw = {};
+            draw.sortKey = (program << 63) | (geometry << 31) | (state & 0x7FFFFFFF);
+            draw.entityIdx = i;
+            draw.submeshIdx = j;
+            draw.cullCommand = UINT32_MAX;
+            app->modelDraws.push_back(draw);
+        }
+    }
+
+    std::sort(app->modelDraws.begin(), app->modelDraws.end(),
+        [](const ModelDraw& a, const ModelDraw& b) { return a.sortKey < b.sortKey; });
 }
 
 void RenderModels(App* app)
 {
     // Bind buffer handle for lights
-    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING(0), app->uniformBuffer.handle, app->globalParamsOffset, app->globalParamsSize);
+    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING(0), app->globalParamsBuffer, app->globalParamsOffset, app->globalParamsSize);
+
+    // Draws only pass their index into the materials
+    UpdateMaterialParams(app);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, app->materialParamsBuffer);
 
     for (u32 i = 0; i < app->entities.size(); ++i)
     {
-        if (app->entities[i].hasRelief)
+        if (!app->meshes[app->models[app->entities[i].modelIndex].meshIdx].isLoaded)
+            RenderProxy(app, app->entities[i]);
+    }
+
+    // Both variants are looked up before the draws hold references to programs
+    const u32 modelProgramIdx = GetProgramVariant(app, app->modelPermutations);
+    const u32 reliefProgramIdx = GetProgramVariant(app, app->reliefPermutations);
+
+    UpdateMaterialTextureLayers(app);
+    BuildModelDraws(app);
+    CullMeshlets(app);
+    BindNodeInstances(app);
+    if (!app->meshletCommands.empty())
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, app->meshletCommandBuffer);
+
+    GeometryBinding binding = {};
+    u32 currentProgram = UINT32_MAX;
+    u32 currentEntity = UINT32_MAX;
+    u32 currentMaterial = UINT32_MAX;
+    MaterialTextureLayer currentLayers[2] = {};
+    u32 currentPools[2] = { TEXTURE_ARRAY_INVALID_POOL, TEXTURE_ARRAY_INVALID_POOL };
+    app->textureBindChanges = 0;
+
+    for (const ModelDraw& draw : app->modelDraws)
+    {
+        Entity& entity = app->entities[draw.entityIdx];
+        Model& model = app->models[entity.modelIndex];
+        Submesh& submesh = app->meshes[model.meshIdx].submeshes[draw.submeshIdx];
+
+        const u32 programIdx = entity.hasRelief ? reliefProgramIdx : modelProgramIdx;
+        Program& shaderModel = app->programs[programIdx];
+
+        if (programIdx != currentProgram)
         {
-            Program& shaderModel = app->programs[app->reliefShaderID];
             glUseProgram(shaderModel.handle);
 
-            u32 renderModeUniform = glGetUniformLocation(shaderModel.handle, "renderMode");
-            glUniform1i(renderModeUniform, (int)app->renderTarget);
-            // Bind buffer handle for models
-            glBindBufferRange(GL_UNIFORM_BUFFER, BINDING(1), app->uniformBuffer.handle, app->entities[i].localParamsOffset, app->entities[i].localParamsSize);
+            app->uniformUploader.UploadUniformFloat(shaderModel, UNIFORM("bloomRange"), app->bloomRange);
+            app->uniformUploader.UploadUniformInt(shaderModel, UNIFORM("uTexture"), 0);
 
-            Model& model = app->models[app->entities[i].modelIndex];
-            Mesh& mesh = app->meshes[model.meshIdx];
+            if (entity.hasRelief)
+            {
+                app->uniformUploader.UploadUniformFloat3(shaderModel, UNIFORM("viewPos"), app->camera->GetPosition());
+                app->uniformUploader.UploadUniformInt(shaderModel, UNIFORM("normalMap"), 1);
+            }
+            else
+            {
+                app->uniformUploader.UploadUniformInt(shaderModel, UNIFORM("uOrmMap"), 1);
+            }
 
-            for (u32 j = 0; j < mesh.submeshes.size(); ++j)
+            // Texture units are shared by both programs, the layers are uniforms of each
+            currentProgram = programIdx;
+            currentEntity = UINT32_MAX;
+            currentMaterial = UINT32_MAX;
+            currentLayers[0].layer = currentLayers[1].layer = UINT32_MAX;
+        }
+
+        if (draw.entityIdx != currentEntity)
+        {
+            // Bind buffer handle for models
+            glBindBufferRange(GL_UNIFORM_BUFFER, BINDING(1), entity.localParamsBuffer, entity.localParamsOffset, entity.localParamsSize);
+
+            if (entity.hasRelief)
             {
-                u32 vao = FindVao(mesh, j, shaderModel);
-                glBindVertexArray(vao);
-
-                u32 submeshMaterialIdx = model.materialIdx[j];
-                Material& submeshMaterial = app->materials[submeshMaterialIdx];
-
-                app->uniformUploader.UploadUniformFloat(shaderModel, "bloomRange", app->bloomRange);
-                app->uniformUploader.UploadUniformFloat(shaderModel, "bumpiness", app->entities[i].bumpiness);
-                app->uniformUploader.UploadUniformFloat(shaderModel, "minLayers", app->entities[i].minLayers);
-                app->uniformUploader.UploadUniformFloat(shaderModel, "maxLayers", app->entities[i].maxLayers);
-                app->uniformUploader.UploadUniformFloat3(shaderModel, "viewPos", app->camera->GetPosition());
-                glUniform1i(app->modelShaderTextureReliefUniformLocation, 0);
-                glActiveTexture(GL_TEXTURE0);
-                GLuint textureHandle = app->textures[app->entities[i].textureIdx].handle;
-                glBindTexture(GL_TEXTURE_2D, textureHandle);
+                if (!app->textureArrays)
+                {
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(GL_TEXTURE_2D, GetTextureHandle(app, entity.textureIdx, app->whiteTexIdx));
+                    glActiveTexture(GL_TEXTURE1);
+                    glBindTexture(GL_TEXTURE_2D, GetTextureHandle(app, entity.normalHeightIdx, app->normalTexIdx));
+                    glActiveTexture(GL_TEXTURE0);
+                    app->textureBindChanges++;
+                }
+            }
+            currentEntity = draw.entityIdx;
+        }
 
-                glUniform1i(app->modelShaderNormalTextureUniformLocation, 1);
-                glActiveTexture(GL_TEXTURE1);
-                textureHandle = app->textures[app->entities[i].normalIdx].handle;
-                glBindTexture(GL_TEXTURE_2D, textureHandle);
+        const u32 submeshMaterialIdx = model.materialIdx[draw.submeshIdx];
+        app->uniformUploader.UploadUniformInt(shaderModel, UNIFORM("uMaterialIndex"), (int)(entity.hasRelief ? entity.reliefMaterialIdx : submeshMaterialIdx));
 
-                glUniform1i(app->modelShaderBumpTextureUniformLocation, 2);
-                glActiveTexture(GL_TEXTURE2);
-                textureHandle = app->textures[app->entities[i].bumpIdx].handle;
-                glBindTexture(GL_TEXTURE_2D, textureHandle);
+        if (app->textureArrays)
+        {
+            const Material& submeshMaterial = app->materials[submeshMaterialIdx];
+            MaterialTextureLayer layers[2] = { submeshMaterial.albedoLayer, submeshMaterial.ormLayer };
+            if (entity.hasRelief)
+            {
+                layers[0] = GetTextureLayer(app, entity.textureIdx, app->whiteTexIdx);
+                layers[1] = GetTextureLayer(app, entity.normalHeightIdx, app->normalTexIdx);
+            }
 
+            // Draws are sorted by pools, most material changes are just new layers
+            if (layers[0].pool != currentPools[0] || layers[1].pool != currentPools[1])
+            {
                 glActiveTexture(GL_TEXTURE0);
-                Submesh& submesh = mesh.submeshes[j];
-                glDrawElements(GL_TRIANGLES, submesh.indices.size(), GL_UNSIGNED_INT, (void*)(u64)submesh.indexOffset);
-                glBindVertexArray(0);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, app->texturePools.pools[layers[0].pool].handle);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, app->texturePools.pools[layers[1].pool].handle);
+                glActiveTexture(GL_TEXTURE0);
+                currentPools[0] = layers[0].pool;
+                currentPools[1] = layers[1].pool;
+                app->textureBindChanges++;
+            }
+
+            if (layers[0].layer != currentLayers[0].layer || layers[1].layer != currentLayers[1].layer)
+            {
+                app->uniformUploader.UploadUniformInt2(shaderModel, UNIFORM("uMaterialLayers"), glm::ivec2(layers[0].layer, layers[1].layer));
+                currentLayers[0] = layers[0];
+                currentLayers[1] = layers[1];
             }
         }
-        else
+        else if (!entity.hasRelief && submeshMaterialIdx != currentMaterial)
         {
-            Program& shaderModel = app->programs[app->modelShaderID];
-            glUseProgram(shaderModel.handle);
+            Material& submeshMaterial = app->materials[submeshMaterialIdx];
+
+            glActiveTexture(GL_TEXTURE0);
+            glBindTexture(GL_TEXTURE_2D, GetTextureHandle(app, submeshMaterial.albedoTextureIdx, app->whiteTexIdx));
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, GetTextureHandle(app, submeshMaterial.ormTextureIdx, app->ormTexIdx));
+            glActiveTexture(GL_TEXTURE0);
+            currentMaterial = submeshMaterialIdx;
+            app->textureBindChanges++;
+        }
 
-            u32 renderModeUniform = glGetUniformLocation(shaderModel.handle, "renderMode");
-            glUniform1i(renderModeUniform, (int)app->renderTarget);
+        const NodeInstanceRange instances = GetSubmeshInstances(model, draw.submeshIdx);
+        if (draw.cullCommand != UINT32_MAX)
+            DrawCulledSubmesh(app, submesh, shaderModel, binding, draw.cullCommand, instances);
+        else
+            DrawSubmesh(app, submesh, shaderModel, binding, entity.lod, instances);
+    }
 
-            app->uniformUploader.UploadUniformFloat(shaderModel, "bloomRange", app->bloomRange);
+    if (app->textureArrays)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    }
 
-            // Bind buffer handle for models
-            glBindBufferRange(GL_UNIFORM_BUFFER, BINDING(1), app->uniformBuffer.handle, app->entities[i].localParamsOffset, app->entities[i].localParamsSize);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+    glUseProgram(0);
 
-            Model& model = app->models[app->entities[i].modelIndex];
-            Mesh& mesh = app->meshes[model.meshIdx];
+    RenderImpostors(app);
+}
 
-            for (u32 j = 0; j < mesh.submeshes.size(); ++j)
-            {
-                u32 vao = FindVao(mesh, j, shaderModel);
-                glBindVertexArray(vao);
+void RenderImpostors(App* app)
+{
+    if (app->impostorBatches.empty())
+        return;
 
-                u32 submeshMaterialIdx = model.materialIdx[j];
-                Material& submeshMaterial = app->materials[submeshMaterialIdx];
+    Program& impostorProgram = app->programs[GetProgramVariant(app, app->impostorPermutations)];
+    glUseProgram(impostorProgram.handle);
 
-                glUniform1i(app->modelShaderTextureUniformLocation, 0);
-                glActiveTexture(GL_TEXTURE0);
-                GLuint textureHandle = app->textures[submeshMaterial.albedoTextureIdx].handle;
-                glBindTexture(GL_TEXTURE_2D, textureHandle);
+    app->uniformUploader.UploadUniformMat4(impostorProgram, UNIFORM("uViewProjection"), app->camera->GetViewProjection());
+    app->uniformUploader.UploadUniformFloat3(impostorProgram, UNIFORM("uViewPosition"), app->camera->GetPosition());
+    app->uniformUploader.UploadUniformFloat(impostorProgram, UNIFORM("bloomRange"), app->bloomRange);
+    app->uniformUploader.UploadUniformInt(impostorProgram, UNIFORM("uImpostorAlbedo"), 0);
+    app->uniformUploader.UploadUniformInt(impostorProgram, UNIFORM("uImpostorNormalDepth"), 1);
 
-                glUniform1i(app->modelShaderNormalTextureUniformLocation, 1);
-                glActiveTexture(GL_TEXTURE1);
-                textureHandle = app->textures[submeshMaterial.normalsTextureIdx].handle;
-                glBindTexture(GL_TEXTURE_2D, textureHandle);
-               
-                Submesh& submesh = mesh.submeshes[j];
-                glDrawElements(GL_TRIANGLES, submesh.indices.size(), GL_UNSIGNED_INT, (void*)(u64)submesh.indexOffset);
-                glBindVertexArray(0);
-            }
-        }
+    // Quads are built from gl_VertexID, the VAO has no attributes
+    glBindVertexArray(app->impostorVao);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, app->impostorInstanceBuffer);
+
+    for (const ImpostorBatch& batch : app->impostorBatches)
+    {
+        const Impostor& impostor = app->impostors[app->models[batch.modelIdx].impostorIdx];
+
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, impostor.albedoTexture);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, impostor.normalDepthTexture);
+
+        app->uniformUploader.UploadUniformFloat3(impostorProgram, UNIFORM("uImpostorCenter"), impostor.center);
+        app->uniformUploader.UploadUniformFloat(impostorProgram, UNIFORM("uImpostorRadius"), impostor.radius);
+        app->uniformUploader.UploadUniformFloat(impostorProgram, UNIFORM("uFramesPerSide"), (f32)impostor.framesPerSide);
+        app->uniformUploader.UploadUniformInt(impostorProgram, UNIFORM("uFirstInstance"), (int)batch.firstInstance);
+
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, batch.instanceCount);
     }
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, 0);
+    glBindVertexArray(0);
     glUseProgram(0);
 }
 
@@ -1500,32 +3920,33 @@ void RenderLights(App* app, bool active)
     {
         Program& lightShader = app->programs[app->lightShader];
         glUseProgram(lightShader.handle);
+        BindNodeInstances(app);
 
-        app->uniformUploader.UploadUniformMat4(lightShader, "view", app->camera->GetView());
-        app->uniformUploader.UploadUniformMat4(lightShader, "projection", app->camera->GetProjection());
+        app->uniformUploader.UploadUniformMat4(lightShader, UNIFORM("view"), app->camera->GetView());
+        app->uniformUploader.UploadUniformMat4(lightShader, UNIFORM("projection"), app->camera->GetProjection());
 
+        // Every light shape shares the same few pages
+        GeometryBinding binding = {};
         for (u32 i = 0; i < app->lights.size(); ++i)
         {
             Light& light = app->lights[i];
             Model& model = app->models[light.model];
             Mesh& mesh = app->meshes[model.meshIdx];
 
-            app->uniformUploader.UploadUniformMat4(lightShader, "model", light.GetTransformMat());
-            app->uniformUploader.UploadUniformFloat3(lightShader, "lightColor", light.color);
-            app->uniformUploader.UploadUniformFloat3(lightShader, "intensity", light.intensity);
+            // Light shapes only need positions, their dequantization happens before the node transform
+            glm::mat4 dequantize = glm::translate(mesh.positionOffset) * glm::scale(mesh.positionScale);
+            app->uniformUploader.UploadUniformMat4(lightShader, UNIFORM("model"), light.GetTransformMat());
+            app->uniformUploader.UploadUniformMat4(lightShader, UNIFORM("dequantize"), dequantize);
+            app->uniformUploader.UploadUniformFloat3(lightShader, UNIFORM("lightColor"), light.color);
+            app->uniformUploader.UploadUniformFloat3(lightShader, UNIFORM("intensity"), light.intensity);
 
 
             for (u32 j = 0; j < mesh.submeshes.size(); ++j)
-            {
-                u32 vao = FindVao(mesh, j, lightShader);
-                glBindVertexArray(vao);
-
-                Submesh& submesh = mesh.submeshes[j];
-                glDrawElements(GL_TRIANGLES, submesh.indices.size(), GL_UNSIGNED_INT, (void*)(u64)submesh.indexOffset);
-                glBindVertexArray(0);
-            }
+                DrawSubmesh(app, mesh.submeshes[j], lightShader, binding, 0, GetSubmeshInstances(model, j));
         }
 
+        glBindVertexArray(0);
+
         glUseProgram(0);
     }
 }
@@ -1556,15 +3977,13 @@ void DrawQuadVao(App* app)
 
 void DrawForwardRendering(App* app)
 {
-    Program& quadShader = app->programs[app->quadFBshader];
+    Program& quadShader = app->programs[GetProgramVariant(app, app->quadPermutations)];
     glUseProgram(quadShader.handle);
     glEnable(GL_BLEND);
-    app->uniformUploader.UploadUniformFloat(quadShader, "exposureLevel", app->exposureLevel);
-    app->uniformUploader.UploadUniformInt(quadShader, "exposureActive", app->exposureActive);
+    app->uniformUploader.UploadUniformFloat(quadShader, UNIFORM("exposureLevel"), app->exposureLevel);
 
 
-    u32 colorLocation = glGetUniformLocation(quadShader.handle, "screenTexture");
-    glUniform1i(colorLocation, 0);
+    app->uniformUploader.UploadUniformInt(quadShader, UNIFORM("screenTexture"), 0);
     glActiveTexture(GL_TEXTURE0);
     switch (app->renderTarget)
     {
@@ -1591,11 +4010,7 @@ void DrawForwardRendering(App* app)
     }
 
 
-    u32 renderLocationUniform = glGetUniformLocation(quadShader.handle, "renderTarget");
-    glUniform1i(renderLocationUniform, (int)app->renderTarget);
-
-    u32 bloomUniformTexture = glGetUniformLocation(quadShader.handle, "bloomBlur");
-    glUniform1i(bloomUniformTexture, 1);
+    app->uniformUploader.UploadUniformInt(quadShader, UNIFORM("bloomBlur"), 1);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, app->modelBloomed);
 }
@@ -1603,24 +4018,16 @@ void DrawForwardRendering(App* app)
 void DrawDeferredRendering(App* app)
 {
     glDisable(GL_BLEND);
-    Program& quadShader = app->programs[app->quadDeferredShader];
+    Program& quadShader = app->programs[GetProgramVariant(app, app->deferredPermutations)];
     glUseProgram(quadShader.handle);
     
-    app->uniformUploader.UploadUniformFloat(quadShader, "exposureLevel", app->exposureLevel);
-    app->uniformUploader.UploadUniformInt(quadShader, "exposureActive", app->exposureActive);
-
-
-    u32 colorLocation = glGetUniformLocation(quadShader.handle, "gColor");
-    glUniform1i(colorLocation, 0);
-
-    colorLocation = glGetUniformLocation(quadShader.handle, "gNormal");
-    glUniform1i(colorLocation, 1);
+    app->uniformUploader.UploadUniformFloat(quadShader, UNIFORM("exposureLevel"), app->exposureLevel);
 
-    colorLocation = glGetUniformLocation(quadShader.handle, "gPosition");
-    glUniform1i(colorLocation, 2);
 
-    colorLocation = glGetUniformLocation(quadShader.handle, "gAlbedoSpec");
-    glUniform1i(colorLocation, 3);
+    app->uniformUploader.UploadUniformInt(quadShader, UNIFORM("gColor"), 0);
+    app->uniformUploader.UploadUniformInt(quadShader, UNIFORM("gNormal"), 1);
+    app->uniformUploader.UploadUniformInt(quadShader, UNIFORM("gPosition"), 2);
+    app->uniformUploader.UploadUniformInt(quadShader, UNIFORM("gAlbedoSpec"), 3);
 
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, app->framebuffer->colorAttachments[0]);
@@ -1634,8 +4041,7 @@ void DrawDeferredRendering(App* app)
     glActiveTexture(GL_TEXTURE3);
     glBindTexture(GL_TEXTURE_2D, app->framebuffer->colorAttachments[3]);
 
-    u32 bloomUniformTexture = glGetUniformLocation(quadShader.handle, "bloomBlur");
-    glUniform1i(bloomUniformTexture, 4);
+    app->uniformUploader.UploadUniformInt(quadShader, UNIFORM("bloomBlur"), 4);
     glActiveTexture(GL_TEXTURE4);
     glBindTexture(GL_TEXTURE_2D, app->modelBloomed);
 }
@@ -1646,15 +4052,14 @@ u32 CalculateBloom(App* app, u32 attachmentToBloom, std::vector<std::shared_ptr<
     int amount = app->bloomIterations;
     Program& shaderBloom = app->programs[app->bloomShader];
     glUseProgram(shaderBloom.handle);
-    GLuint iterations = glGetUniformLocation(shaderBloom.handle, "iterations");
-    glUniform1i(iterations, amount);
+    app->uniformUploader.UploadUniformInt(shaderBloom, UNIFORM("iterations"), amount);
     glDisable(GL_DEPTH_TEST);
     for (u32 i = 0; i < amount; ++i)
     {
         buffers[horizontal]->Bind();
         glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        app->uniformUploader.UploadUniformInt(shaderBloom, "horizontal", horizontal);
+        app->uniformUploader.UploadUniformInt(shaderBloom, UNIFORM("horizontal"), horizontal);
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, firstIteration ? attachmentToBloom : buffers[!horizontal]->colorAttachments[0]);
         DrawQuadVao(app);
@@ -9,6 +9,13 @@
 #include "Lights.h"
 #include "Camera.h"
 #include "FrameBuffer.h"
+#include "AssetRegistry.h"
+#include "AssetLoader.h"
+#include "GeometryArena.h"
+#include "TextureArrays.h"
+#include "UniformRing.h"
+#include <unordered_map>
+#include <type_traits>
 
 typedef glm::vec2  vec2;
 typedef glm::vec3  vec3;
@@ -17,18 +24,58 @@ typedef glm::ivec2 ivec2;
 typedef glm::ivec3 ivec3;
 typedef glm::ivec4 ivec4;
 
-struct Image
+struct Texture
 {
-    void* pixels;
-    ivec2 size;
-    i32   nchannels;
-    i32   stride;
+    GLuint       handle;
+    std::string  filepath;
+    TextureUsage usage;
+    u64          gpuSize;          // Bytes of the resident levels in video memory
+    u64          fullSize;         // Bytes of the whole mip chain
+    u64          uncompressedSize; // Bytes the same chain takes as RGB8/RGBA8
+    TextureResidency residency;
+
+    // Pool and layer with texture arrays, the handle is then a view of the layer
+    u32          arrayPool = TEXTURE_ARRAY_INVALID_POOL;
+    u32          arrayLayer;
 };
 
-struct Texture
+// FNV-1a of a uniform name, the key programs look their uniforms up by
+constexpr u64 HashUniformName(const char* name)
 {
-    GLuint      handle;
-    std::string filepath;
+    u64 hash = 0xcbf29ce484222325ull;
+    for (; *name; ++name)
+        hash = (hash ^ (u8)*name) * 0x100000001b3ull;
+    return hash;
+}
+
+// Uniform name interned at compile time: uploads look it up by the precomputed hash, the name is
+// only compared with the reflected one so a hash collision can't reach the wrong uniform
+struct UniformName
+{
+    const char* name;
+    u64         hash;
+};
+
+#define UNIFORM(name) UniformName{ name, std::integral_constant<u64, HashUniformName(name)>::value }
+
+#define UNIFORM_CACHED_VALUE_SIZE 64 // A mat4, larger arrays are always uploaded
+
+// Active uniform of a program, reflected once when it's linked
+struct ProgramUniform
+{
+    std::string name; // Without [0] for arrays
+    GLint  location;
+    GLenum type;
+    GLint  arraySize;
+    bool   hasValue; // The last value uploaded through BasicUniformUploader is in value
+    u8     value[UNIFORM_CACHED_VALUE_SIZE];
+};
+
+struct ProgramUniformBlock
+{
+    std::string name;
+    GLint       binding;
+    GLint       dataSize;
 };
 
 struct Program
@@ -38,53 +85,167 @@ struct Program
     std::string        programName;
     u64                lastWriteTimestamp; // What is this for?
     VertexShaderLayout vertexInputLayout;
+
+    std::unordered_map<u64, ProgramUniform> uniforms; // Keyed by HashUniformName, array names without [0]
+    std::vector<ProgramUniformBlock>        uniformBlocks;
 };
 
+// Uniforms the program doesn't have are ignored, and so are values equal to the last one uploaded
 struct BasicUniformUploader
 {
-    void UploadUniformInt(Program& shader, const std::string& name, int value)
+    u32 uploadCount;  // Since the last ResetStats
+    u32 skippedCount;
+
+    // Active uniform of the program, NULL when it doesn't have it. Never asks GL.
+    ProgramUniform* FindUniform(Program& shader, const UniformName& name)
+    {
+        auto it = shader.uniforms.find(name.hash);
+        if (it == shader.uniforms.end())
+            return nullptr;
+
+        if (strcmp(it->second.name.c_str(), name.name) != 0)
+        {
+            ELOG("Uniform %s hashes like %s in program %s, it is not uploaded", name.name, it->second.name.c_str(), shader.programName.c_str());
+            return nullptr;
+        }
+        return &it->second;
+    }
+
+    // Location of an active uniform, -1 when the program doesn't have it
+    GLint GetUniformLocation(Program& shader, const UniformName& name)
+    {
+        ProgramUniform* uniform = FindUniform(shader, name);
+        return uniform ? uniform->location : -1;
+    }
+
+    // The uniform to upload value to, NULL when it's not active or already holds the value
+    ProgramUniform* PrepareUpload(Program& shader, const UniformName& name, const void* value, u32 size)
+    {
+        ProgramUniform* found = FindUniform(shader, name);
+        if (!found)
+            return nullptr;
+
+        ProgramUniform& uniform = *found;
+        if (size > UNIFORM_CACHED_VALUE_SIZE)
+        {
+            uniform.hasValue = false;
+        }
+        else if (uniform.hasValue && memcmp(uniform.value, value, size) == 0)
+        {
+            skippedCount++;
+            return nullptr;
+        }
+        else
+        {
+            memcpy(uniform.value, value, size);
+            uniform.hasValue = true;
+        }
+        uploadCount++;
+        return &uniform;
+    }
+
+    void ResetStats()
+    {
+        uploadCount = 0;
+        skippedCount = 0;
+    }
+
+    void UploadUniformInt(Program& shader, const UniformName& name, int value)
+    {
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, &value, sizeof(value)))
+            glUniform1i(uniform->location, value);
+    }
+
+    void UploadUniformInt2(Program& shader, const UniformName& name, const glm::ivec2& values)
+    {
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, &values, sizeof(values)))
+            glUniform2i(uniform->location, values.x, values.y);
+    }
+
+    void UploadUniformUInt(Program& shader, const UniformName& name, u32 value)
+    {
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, &value, sizeof(value)))
+            glUniform1ui(uniform->location, value);
+    }
+
+    void UploadUniformFloat(Program& shader, const UniformName& name, float value)
     {
-        GLint location = glGetUniformLocation(shader.handle, name.c_str());
-        glUniform1i(location, value);
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, &value, sizeof(value)))
+            glUniform1f(uniform->location, value);
     }
 
-    void UploadUniformFloat(Program& shader, const std::string& name, float value)
+    void UploadUniformFloat2(Program& shader, const UniformName& name, const glm::vec2& values)
     {
-        GLint location = glGetUniformLocation(shader.handle, name.c_str());
-        glUniform1f(location, value);
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, &values, sizeof(values)))
+            glUniform2f(uniform->location, values.x, values.y);
     }
 
-    void UploadUniformFloat2(Program& shader, const std::string& name, const glm::vec2& values)
+    void UploadUniformFloat3(Program& shader, const UniformName& name, const glm::vec3& values)
     {
-        GLint location = glGetUniformLocation(shader.handle, name.c_str());
-        glUniform2f(location, values.x, values.y);
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, &values, sizeof(values)))
+            glUniform3f(uniform->location, values.x, values.y, values.z);
     }
 
-    void UploadUniformFloat3(Program& shader, const std::string& name, const glm::vec3& values)
+    void UploadUniformFloat4(Program& shader, const UniformName& name, const glm::vec4& values)
     {
-        GLint location = glGetUniformLocation(shader.handle, name.c_str());
-        glUniform3f(location, values.x, values.y, values.z);
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, &values, sizeof(values)))
+            glUniform4f(uniform->location, values.x, values.y, values.z, values.w);
     }
 
-    void UploadUniformFloat4(Program& shader, const std::string& name, const glm::vec4& values)
+    void UploadUniformFloat4Array(Program& shader, const UniformName& name, const glm::vec4* values, u32 count)
     {
-        GLint location = glGetUniformLocation(shader.handle, name.c_str());
-        glUniform4f(location, values.x, values.y, values.z, values.w);
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, values, count * sizeof(glm::vec4)))
+            glUniform4fv(uniform->location, count, glm::value_ptr(values[0]));
     }
 
-    void UploadUniformMat3(Program& shader, const std::string& name, const glm::mat3& matrix)
+    void UploadUniformMat3(Program& shader, const UniformName& name, const glm::mat3& matrix)
     {
-        GLint location = glGetUniformLocation(shader.handle, name.c_str());
-        glUniformMatrix3fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, &matrix, sizeof(matrix)))
+            glUniformMatrix3fv(uniform->location, 1, GL_FALSE, glm::value_ptr(matrix));
     }
 
-    void UploadUniformMat4(Program& shader, const std::string& name, const glm::mat4& matrix)
+    void UploadUniformMat4(Program& shader, const UniformName& name, const glm::mat4& matrix)
     {
-        GLint location = glGetUniformLocation(shader.handle, name.c_str());
-        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(matrix));
+        if (ProgramUniform* uniform = PrepareUpload(shader, name, &matrix, sizeof(matrix)))
+            glUniformMatrix4fv(uniform->location, 1, GL_FALSE, glm::value_ptr(matrix));
     }
 };
 
+// Switches shaders are compiled for instead of branching on a uniform. Programs loaded as
+// permutations name the features that change them, the other bits of a key don't apply.
+enum ShaderFeature
+{
+    ShaderFeature_RenderTarget  = 1 << 0, // RENDER_TARGET, lit colour or one of the G-buffer views
+    ShaderFeature_LightTypes    = 1 << 1, // DIRECTIONAL_LIGHTS and POINT_LIGHTS, loops only for those in the scene
+    ShaderFeature_Exposure      = 1 << 2, // EXPOSURE, tone mapping of the final colour
+    ShaderFeature_ReliefQuality = 1 << 3, // RELIEF_QUALITY, how the relief shader walks the height map
+};
+
+// Packed value of every feature, see MakeShaderPermutationKey
+#define SHADER_KEY_RENDER_TARGET_MASK  0x07u
+#define SHADER_KEY_DIRECTIONAL_LIGHTS  (1u << 3)
+#define SHADER_KEY_POINT_LIGHTS        (1u << 4)
+#define SHADER_KEY_EXPOSURE            (1u << 5)
+#define SHADER_KEY_RELIEF_QUALITY_SHIFT 6
+#define SHADER_KEY_RELIEF_QUALITY_MASK (0x03u << SHADER_KEY_RELIEF_QUALITY_SHIFT)
+
+enum ReliefQuality
+{
+    ReliefQuality_Offset = 0,  // One parallax offset, no height map walk
+    ReliefQuality_Steep,       // Steps through the layers, no refinement
+    ReliefQuality_Occlusion,   // Steps and interpolates between the last two layers
+    ReliefQuality_Count
+};
+
+// Variants of one program, compiled the first time a key needs them
+struct ProgramPermutations
+{
+    std::string filepath;
+    std::string programName;
+    u32 features;                          // ShaderFeature mask
+    std::unordered_map<u32, u32> variants; // Key masked to the features -> App::programs
+};
+
 enum class Mode
 {
     Mode_TexturedQuad,
@@ -156,6 +317,68 @@ enum class ShadingType
     DEFERRED
 };
 
+// Octahedral impostor of a model: views from every direction around its bounding sphere,
+// baked into a grid of framesPerSide x framesPerSide frames
+struct Impostor
+{
+    GLuint    albedoTexture;      // rgb albedo, a coverage
+    GLuint    normalDepthTexture; // rgb normal in model space, a depth across the bounding sphere
+    u32       framesPerSide;
+    glm::vec3 center;             // Bounding sphere in model space
+    f32       radius;
+};
+
+// Impostors of one model drawn with a single instanced draw
+struct ImpostorBatch
+{
+    u32 modelIdx;
+    u32 firstInstance;
+    u32 instanceCount;
+};
+
+// Best of a few imports of one .obj with each importer
+struct ObjImportBenchmark
+{
+    std::string filepath;
+    f64 nativeMs;
+    f64 assimpMs;
+    u32 threadCount;
+};
+
+// Frame times of the benchmark scene with impostors on and off
+struct ImpostorBenchmark
+{
+    u32 entityCount;
+    f64 frameTimeSum[2];
+    u32 frameCount[2];
+};
+
+struct ModelDraw
+{
+    u64 sortKey;
+    u32 entityIdx;
+    u32 submeshIdx;
+    u32 cullCommand; // Indirect command written by the meshlet culling pass, UINT32_MAX draws the whole LOD
+};
+
+struct AssetTiming
+{
+    std::string filepath;
+    f64 requested; // All times in ms since the program started
+    f64 decoded;
+    f64 committed;
+};
+
+struct StartupTimeline
+{
+    f64 windowCreated;
+    f64 initFinished;
+    f64 firstFrame;
+    f64 fullyLoaded;
+    std::vector<AssetTiming> assets;
+    bool reported;
+};
+
 struct App
 {
     // Loop
@@ -192,9 +415,9 @@ struct App
     // bloom shader
     u32 bloomShader;
 
-    // Framebuffer image shader
-    u32 quadFBshader;
-    u32 quadDeferredShader;
+    // Framebuffer image shaders, App::programPermutations
+    u32 quadPermutations;
+    u32 deferredPermutations;
     u32 quadVao;
     u32 quadVbo;
 
@@ -204,19 +427,122 @@ struct App
     std::vector<Mesh> meshes;
     std::vector<Model> models;
     std::vector<Program>  programs;
-
+    std::vector<ProgramPermutations> programPermutations;
+    u32 shaderKey;           // Features of this frame, from MakeShaderPermutationKey
+    ReliefQuality reliefQuality = ReliefQuality_Occlusion;
+
+    // Lookup of loaded assets by path, so repeated loads share them
+    AssetRegistry assets;
+
+    // Worker threads decoding images and importing models
+    AssetLoader assetLoader;
+    bool serialAssetLoading = false; // Load everything on the GL thread, to compare startup times
+
+    // Progressive startup: render right away with placeholder textures and bounding
+    // proxies, and commit at most assetUploadBudgetMs of finished loads per frame
+    bool progressiveLoading = true;
+    f32 assetUploadBudgetMs = 4.0f;
+    u32 proxyMeshIdx;
+    StartupTimeline startupTimeline;
+
+    // Textures are cooked to BC1/BC3/BC4/BC5 containers and uploaded compressed
+    bool compressTextures = true;
+
+    // Workers write mip chains into a persistently mapped unpack buffer, the GL thread
+    // creates at most textureUploadBudgetMB worth of textures from it per frame
+    TextureUploadRing textureUploadRing;
+    std::deque<AssetJob*> pendingTextureUploads;
+    f32 textureUploadBudgetMB = 16.0f;
+
+    // Streamed textures load their coarse levels only, finer ones follow the on-screen size of the
+    // entities using them while the resident levels fit in textureBudgetMB, least recently used go first
+    bool textureStreaming = true;
+    f32 textureBudgetMB = 256.0f;
+    u64 textureStreamingFrame = 0;
+    u32 textureMipsRaised = 0;  // This frame
+    u32 textureMipsEvicted = 0; // This frame
+
+    // Textures of the same size and format share array textures, so models are drawn with one
+    // set of texture binds and per-draw layers. Read when the shaders are built, so it's fixed at
+    // startup. Array levels are shared by every layer, pooled textures are never streamed.
+    bool textureArrays = false;
+    TextureArrays texturePools;
+    bool materialLayersDirty = false;
+    u32 textureBindChanges = 0; // Texture bind sets RenderModels went through this frame
+
+    // Parameters of every material in one storage buffer, draws only pass an index into it.
+    // Rewritten when materials are added, an edited material rewrites its own entry.
+    u32 materialParamsBuffer;
+    u32 materialParamsCapacity = 0; // Entries
+    bool materialParamsDirty = true;
+    u32 materialParamsWrites = 0;   // Since startup, whole rewrites and single entries
+    u32 defaultMaterialIdx;         // For draws without a material of their own, like the loading proxy
+
+    // Layout every mesh is packed with, the mesh shaders are compiled for it
+    VertexFormat vertexFormat = VertexFormat_Compressed;
+
+    // Keep the node tree of imported files, repeated meshes are stored once and drawn instanced
+    bool preserveModelHierarchy = true;
+
+    // .obj files are read by ObjImporter, Assimp only takes the ones it fails on. Models found in
+    // the mesh cache skip both.
+    bool nativeObjImport = true;
+    std::vector<ObjImportBenchmark> objImportBenchmarks;
+    std::vector<glm::mat4> nodeInstances; // Model space, slot 0 is the identity flattened models use
+    bool nodeInstanceBufferDirty;
+    u32 nodeInstanceBuffer;
+
+    // LOD of each entity from the height its bounding sphere takes on screen. Below
+    // lodScreenSizes[i] the entity switches to LOD i + 1, once past the hysteresis margin.
+    bool automaticLod = true;
+    i32 forcedLod = 0;
+    f32 lodScreenSizes[MESH_MAX_LODS - 1] = { 0.5f, 0.25f, 0.12f };
+    f32 lodHysteresis = 0.15f;
+
+    // Entities further than impostorDistance are drawn as impostors of their model
+    bool impostorsEnabled = true;
+    f32 impostorDistance = 40.0f;
+    u32 impostorFramesPerSide = 8;
+    u32 impostorFrameSize = 128;
+    u32 impostorBakeShader;
+    u32 impostorPermutations;
+    u32 impostorVao;
+    u32 impostorInstanceBuffer;
+    std::vector<Impostor> impostors;
+    std::vector<glm::mat4> impostorInstances; // World matrices, grouped by batch
+    std::vector<ImpostorBatch> impostorBatches;
+    ImpostorBenchmark impostorBenchmark;
+    u32 impostorBenchmarkFrames = 0; // Run from the command line: frames timed each way before quitting
+
+    // Draws of LOD 0 go through a compute pass that drops off-screen and back-facing meshlets
+    bool meshletCulling = true;
+    u32 meshletCullingShader;
+    std::vector<Meshlet> meshlets; // Of every uploaded submesh, see Submesh::firstMeshlet
+    bool meshletBufferDirty;
+    u32 meshletBuffer;
+    u32 culledIndexBuffer;
+    u32 culledIndexCapacity; // In indices
+    u32 meshletCommandBuffer;
+    std::vector<DrawElementsIndirectCommand> meshletCommands;
+    u32 meshletsTested;
+    bool meshletCullingStats; // Reads the commands back every frame, stalls the pipeline
+    u32 meshletIndicesSubmitted;
+    u32 meshletIndicesVisible;
+
+    // Vertices and indices of every mesh, and the model draws of a frame sorted by VAO and page
+    GeometryArena geometryArena;
+    std::vector<ModelDraw> modelDraws;
+
+    // What meshes loaded from now on keep on the CPU after the upload. Mapped costs nothing
+    // until something reads the geometry back, then the mesh cache is mapped for the read.
+    GeometryResidency geometryResidency = GeometryResidency_Mapped;
 
     // Model test
     u32 model;
-    u32 modelShaderID;
-    u32 modelShaderTextureUniformLocation;
-    u32 reliefShaderID;
-    u32 modelShaderTextureReliefUniformLocation;
-    u32 modelShaderNormalTextureUniformLocation;
-    u32 modelShaderBumpTextureUniformLocation;
+    u32 modelPermutations;
+    u32 reliefPermutations;
     u32 modelTexture;
-    u32 modelNormalTexture;
-    u32 modelBumpTexture;
+    u32 modelNormalHeightTexture;
 
     // Uniforms helper
     BasicUniformUploader uniformUploader;
@@ -241,10 +567,11 @@ struct App
     i32 maxUniformBufferSize;
     i32 uniformBlockAlignment;
 
-    // Local Uniform buffers
-    Buffer uniformBuffer;
+    // Local and global blocks of the frame, triple buffered
+    UniformRing uniformRing;
 
     // Global uniform buffer
+    u32 globalParamsBuffer;
     u32 globalParamsOffset;
     u32 globalParamsSize;
     // --------- Uniform buffers mesh Shader end ---------
@@ -256,8 +583,9 @@ struct App
     u32 diceTexIdx;
     u32 whiteTexIdx;
     u32 blackTexIdx;
-    u32 normalTexIdx;
+    u32 normalTexIdx; // Flat normal, zero height
     u32 magentaTexIdx;
+    u32 ormTexIdx;    // Full occlusion, medium roughness, no metal
 
     //Render Target
     RenderTarget renderTarget;
@@ -289,7 +617,9 @@ void Update(App* app);
 void Render(App* app);
 
 void RenderModels(App* app);
+void UnloadModel(App* app, u32 modelIdx);
 void RenderLights(App* app, bool active);
+void RenderImpostors(App* app);
 
 void GenerateQuadVao(App* app);
 
@@ -12,13 +12,20 @@
 #else
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <unistd.h>
+#include <dirent.h>
 #endif
 
 #include "engine.h"
+#include "GLExtensions.h"
+#include "AssetArchive.h"
 
 #include <GLFW/glfw3.h>
 #include <stdio.h>
+#include <string.h>
+#include <chrono>
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
@@ -31,6 +38,8 @@
 u8* GlobalFrameArenaMemory = NULL;
 u32 GlobalFrameArenaHead = 0;
 
+static const std::chrono::steady_clock::time_point GlobalStartTime = std::chrono::steady_clock::now();
+
 void OnGlfwError(int errorCode, const char *errorMessage)
 {
 	fprintf(stderr, "glfw failed with error %d: %s\n", errorCode, errorMessage);
@@ -138,13 +147,29 @@ void OnGlfwCloseWindow(GLFWwindow* window)
     app->isRunning = false;
 }
 
-int main()
+int main(int argc, char** argv)
 {
+    // Packaging run: bundles the working directory into an archive and quits
+    if (argc == 3 && strcmp(argv[1], "-pack") == 0)
+    {
+        return WriteAssetArchive(argv[2], ".") ? 0 : 1;
+    }
+
+    // Loose files are only read when there's no archive or it lacks them
+    MountAssetArchive(ASSET_ARCHIVE_FILENAME);
+
     App app         = {};
     app.deltaTime   = 1.0f/60.0f;
     app.displaySize = ivec2(WINDOW_WIDTH, WINDOW_HEIGHT);
     app.isRunning   = true;
 
+    // Loads every asset on the GL thread, the startup the asset workers are compared against
+    app.serialAssetLoading = argc == 2 && strcmp(argv[1], "-serial") == 0;
+
+    // Times the impostor benchmark scene for this many frames each way, logs the averages and quits
+    if (argc == 3 && strcmp(argv[1], "-impostor-benchmark") == 0)
+        app.impostorBenchmarkFrames = (u32)atoi(argv[2]);
+
 		glfwSetErrorCallback(OnGlfwError);
 
     if (!glfwInit())
@@ -165,6 +190,8 @@ int main()
         return -1;
     }
 
+    app.startupTimeline.windowCreated = GetElapsedMilliseconds();
+
     glfwSetWindowUserPointer(window, &app);
 
     glfwSetMouseButtonCallback(window, OnGlfwMouseEvent);
@@ -183,6 +210,7 @@ int main()
         ELOG("Failed to initialize OpenGL context\n");
         return -1;
     }
+    LoadGLExtensions((GLADloadproc) glfwGetProcAddress);
 
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -290,6 +318,9 @@ int main()
         // Present image on screen
         glfwSwapBuffers(window);
 
+        if (app.startupTimeline.firstFrame == 0.0)
+            app.startupTimeline.firstFrame = GetElapsedMilliseconds();
+
         // Frame time
         f64 currentFrameTime = glfwGetTime();
         app.deltaTime = (f32)(currentFrameTime - lastFrameTime);
@@ -311,6 +342,8 @@ int main()
 
     glfwTerminate();
 
+    UnmountAssetArchive();
+
     return 0;
 }
 
@@ -393,6 +426,20 @@ String ReadTextFile(const char* filepath)
 {
     String fileText = {};
 
+    if (const AssetArchiveEntry* entry = FindAssetArchiveEntry(filepath))
+    {
+        MappedFile archived = {};
+        if (OpenAssetArchiveEntry(*entry, archived))
+        {
+            fileText.len = (u32)archived.size;
+            fileText.str = (char*)PushSize(fileText.len + 1);
+            memcpy(fileText.str, archived.data, fileText.len);
+            fileText.str[fileText.len] = '\0';
+            UnmapFile(archived);
+        }
+        return fileText;
+    }
+
     FILE* file = fopen(filepath, "rb");
 
     if (file)
@@ -417,6 +464,13 @@ String ReadTextFile(const char* filepath)
 
 u64 GetFileLastWriteTimestamp(const char* filepath)
 {
+    u64 overlayTimestamp = 0;
+    if (FindAssetArchiveOverlayFile(filepath, nullptr, &overlayTimestamp))
+        return overlayTimestamp;
+
+    if (const AssetArchiveEntry* entry = FindAssetArchiveEntry(filepath))
+        return entry->timestamp;
+
 #ifdef _WIN32
     union Filetime2u64 {
         FILETIME filetime;
@@ -439,6 +493,167 @@ u64 GetFileLastWriteTimestamp(const char* filepath)
     return 0;
 }
 
+f64 GetElapsedMilliseconds()
+{
+    return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - GlobalStartTime).count();
+}
+
+void ListDirectoryFiles(const char* directory, std::vector<std::string>& filepaths)
+{
+    // Directories still to visit, relative to the one given
+    std::vector<std::string> pending(1, std::string());
+    while (!pending.empty())
+    {
+        std::string relative = pending.back();
+        pending.pop_back();
+        std::string absolute = relative.empty() ? std::string(directory) : std::string(directory) + "/" + relative;
+        std::string prefix = relative.empty() ? std::string() : relative + "/";
+
+#ifdef _WIN32
+        WIN32_FIND_DATAA findData;
+        HANDLE findHandle = FindFirstFileA((absolute + "/*").c_str(), &findData);
+        if (findHandle == INVALID_HANDLE_VALUE)
+            continue;
+
+        do {
+            if (strcmp(findData.cFileName, ".") == 0 || strcmp(findData.cFileName, "..") == 0)
+                continue;
+            if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                pending.push_back(prefix + findData.cFileName);
+            else
+                filepaths.push_back(prefix + findData.cFileName);
+        } while (FindNextFileA(findHandle, &findData));
+        FindClose(findHandle);
+#else
+        DIR* dir = opendir(absolute.c_str());
+        if (!dir)
+            continue;
+
+        while (struct dirent* dirEntry = readdir(dir)) {
+            if (strcmp(dirEntry->d_name, ".") == 0 || strcmp(dirEntry->d_name, "..") == 0)
+                continue;
+            struct stat attrib;
+            if (stat((absolute + "/" + dirEntry->d_name).c_str(), &attrib) != 0)
+                continue;
+            if (S_ISDIR(attrib.st_mode))
+                pending.push_back(prefix + dirEntry->d_name);
+            else
+                filepaths.push_back(prefix + dirEntry->d_name);
+        }
+        closedir(dir);
+#endif
+    }
+}
+
+static MappedFile MapDiskFile(const char* filepath)
+{
+    MappedFile file = {};
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+        return file;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(fileHandle);
+        return file;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mappingHandle)
+    {
+        CloseHandle(fileHandle);
+        return file;
+    }
+
+    file.data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!file.data)
+    {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return file;
+    }
+
+    file.size = (u64)fileSize.QuadPart;
+    file.fileHandle = fileHandle;
+    file.mappingHandle = mappingHandle;
+#else
+    int fd = open(filepath, O_RDONLY);
+    if (fd < 0)
+        return file;
+
+    struct stat attrib;
+    if (fstat(fd, &attrib) != 0 || attrib.st_size == 0)
+    {
+        close(fd);
+        return file;
+    }
+
+    void* data = mmap(NULL, attrib.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return file;
+
+    file.data = data;
+    file.size = (u64)attrib.st_size;
+#endif
+
+    return file;
+}
+
+MappedFile MapFile(const char* filepath)
+{
+    MappedFile file = {};
+    if (FindAssetArchiveOverlayFile(filepath, &file, nullptr))
+        return file;
+
+    if (const AssetArchiveEntry* entry = FindAssetArchiveEntry(filepath))
+    {
+        OpenAssetArchiveEntry(*entry, file);
+        return file;
+    }
+
+    return MapDiskFile(filepath);
+}
+
+MappedFile MapGeneratedFile(const char* filepath)
+{
+    // Recooked caches are always written to disk, the archived copy is the one that went stale
+    MappedFile file = MapDiskFile(filepath);
+    if (file.data)
+        return file;
+
+    if (const AssetArchiveEntry* entry = FindAssetArchiveEntry(filepath))
+        OpenAssetArchiveEntry(*entry, file);
+    return file;
+}
+
+void UnmapFile(MappedFile& file)
+{
+    if (!file.data)
+        return;
+
+    if (file.source != MappedFile_Disk)
+    {
+        if (file.source == MappedFile_Heap)
+            free(file.data);
+        file = {};
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(file.data);
+    CloseHandle((HANDLE)file.mappingHandle);
+    CloseHandle((HANDLE)file.fileHandle);
+#else
+    munmap(file.data, file.size);
+#endif
+
+    file = {};
+}
+
 void LogString(const char* str)
 {
 #ifdef _WIN32
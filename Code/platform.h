@@ -84,9 +84,53 @@ String ReadTextFile(const char *filepath);
 /**
  * It retrieves a timestamp indicating the last time the file was modified.
  * Can be useful in order to check for file modifications to implement hot reloads.
+ * Files in the mounted asset archive report the time they had when they were packed.
  */
 u64 GetFileLastWriteTimestamp(const char *filepath);
 
+/**
+ * Appends the path of every file under directory, recursively and relative to it.
+ */
+void ListDirectoryFiles(const char *directory, std::vector<std::string>& filepaths);
+
+/**
+ * Milliseconds elapsed since the program started. Safe to call from any thread.
+ */
+f64 GetElapsedMilliseconds();
+
+enum MappedFileSource
+{
+    MappedFile_Disk,    // Own mapping of a loose file
+    MappedFile_Archive, // View into the mounted asset archive or its overlay files
+    MappedFile_Heap     // Decompressed copy of an archive entry
+};
+
+struct MappedFile
+{
+    void*            data;
+    u64              size;
+    void*            fileHandle;
+    void*            mappingHandle;
+    MappedFileSource source;
+};
+
+/**
+ * Maps a whole file into memory in read-only mode. If the file does not exist or
+ * cannot be mapped, the returned MappedFile has a NULL data pointer. Files in the
+ * mounted asset archive are returned from it before looking at the disk.
+ * Every mapped file must be released with UnmapFile.
+ */
+MappedFile MapFile(const char *filepath);
+
+/**
+ * Like MapFile, for the caches the engine cooks itself (.meshcache, .ctex). Those are
+ * rewritten as loose files whenever the archived copy doesn't match the current settings,
+ * so the disk is looked at before the archive.
+ */
+MappedFile MapGeneratedFile(const char* filepath);
+
+void UnmapFile(MappedFile& file);
+
 /**
  * It logs a string to whichever outputs are configured in the platform layer.
  * By default, the string is printed in the output console of VisualStudio.
@@ -41,6 +41,7 @@ layout(binding = 0, std140) uniform GlobalParams
 {
 	vec3 uCameraPosition;
 	unsigned int uLightCount;
+	unsigned int uDirectionalLightCount; // uLight holds the directional lights, then the point lights
 	Light uLight[16];
 };
 
@@ -54,7 +55,6 @@ uniform sampler2D gAlbedoSpec;
 
 uniform sampler2D bloomBlur;
 uniform float exposureLevel;
-uniform int exposureActive;
 
 
 void main()
@@ -68,73 +68,70 @@ void main()
 	vec3 lighting = vec3(0.0);
 	vec3 viewDir = normalize(uCameraPosition - FragPos);
 	Normal = normalize(Normal);
-	for (int i = 0; i < uLightCount; ++i)
+#ifdef DIRECTIONAL_LIGHTS
+	for (uint i = 0; i < uDirectionalLightCount; ++i)
 	{
-		if (uLight[i].type == 0)
-		{
-			vec3 lightDir = normalize(uLight[i].direction);
-			
-			Normal = normalize(Normal);
-			// Diffuse light
-			float diff = max(dot(Normal, lightDir), 0.0);
-			vec3 diffuse = diff * uLight[i].color * uLight[i].intensity;
-			
-			float ambientStrength = 0.1;
-			vec3 ambientLight = ambientStrength * uLight[i].color;
-
-
-			// Specular light
-			vec3 reflectDir = reflect(lightDir, Normal);
-			float spec = pow(max(dot(viewDir, reflectDir), 0.0), 128.0);
-			vec3 specularLight = Specular * spec * uLight[i].color * uLight[i].intensity;
-			
-			
-			lighting += (ambientLight + diffuse + specularLight) * Diffuse;
-		}
-		else if (uLight[i].type == 1)
-		{
-			vec3 ambient = 0.1 * uLight[i].color;
-
-			vec3 lightDir = normalize(uLight[i].position - FragPos);
-			vec3 halfwayDir = normalize(lightDir + viewDir);
-			Normal = normalize(Normal);
-			vec3 diffuse = max(dot(Normal, lightDir), 0.0) * uLight[i].color * uLight[i].intensity;
+		vec3 lightDir = normalize(uLight[i].direction);
+		
+		Normal = normalize(Normal);
+		// Diffuse light
+		float diff = max(dot(Normal, lightDir), 0.0);
+		vec3 diffuse = diff * uLight[i].color * uLight[i].intensity;
+		
+		float ambientStrength = 0.1;
+		vec3 ambientLight = ambientStrength * uLight[i].color;
+
+
+		// Specular light
+		vec3 reflectDir = reflect(lightDir, Normal);
+		float spec = pow(max(dot(viewDir, reflectDir), 0.0), 128.0);
+		vec3 specularLight = Specular * spec * uLight[i].color * uLight[i].intensity;
+		
+		
+		lighting += (ambientLight + diffuse + specularLight) * Diffuse;
+	}
+#endif
+#ifdef POINT_LIGHTS
+	for (uint i = uDirectionalLightCount; i < uLightCount; ++i)
+	{
+		vec3 ambient = 0.1 * uLight[i].color;
+
+		vec3 lightDir = normalize(uLight[i].position - FragPos);
+		vec3 halfwayDir = normalize(lightDir + viewDir);
+		Normal = normalize(Normal);
+		vec3 diffuse = max(dot(Normal, lightDir), 0.0) * uLight[i].color * uLight[i].intensity;
 	
-			// Specular light
-			vec3 reflectDir = reflect(-lightDir, Normal);
-			float spec = pow(max(dot(Normal, halfwayDir), 0.0), 128.0);
-			vec3 specularLight = Specular * spec * uLight[i].color * uLight[i].intensity;
-			
-			float distance = length(uLight[i].position - FragPos);
-			float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * (distance * distance));
-
-			ambient  *= attenuation; 
-			diffuse  *= attenuation;
-			specularLight *= attenuation;   
-
-			lighting += (ambient + diffuse + specularLight) * Diffuse;
-		}
+		// Specular light
+		vec3 reflectDir = reflect(-lightDir, Normal);
+		float spec = pow(max(dot(Normal, halfwayDir), 0.0), 128.0);
+		vec3 specularLight = Specular * spec * uLight[i].color * uLight[i].intensity;
 		
+		float distance = length(uLight[i].position - FragPos);
+		float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * (distance * distance));
+
+		ambient  *= attenuation; 
+		diffuse  *= attenuation;
+		specularLight *= attenuation;   
+
+		lighting += (ambient + diffuse + specularLight) * Diffuse;
 	}
+#endif
 	
 
-	if (exposureActive == 1)
-	{
-		const float gamma = 2.2;
-		vec3 hdrColor = lighting.rgb;
+#ifdef EXPOSURE
+	const float gamma = 2.2;
+	vec3 hdrColor = lighting.rgb;
  
-		vec3 tone = vec3(1.0) - exp(-hdrColor * exposureLevel);
+	vec3 tone = vec3(1.0) - exp(-hdrColor * exposureLevel);
 		
-		tone = pow(tone, vec3(1.0 / gamma));
+	tone = pow(tone, vec3(1.0 / gamma));
   
-		oColor = vec4(tone, 1.0);
-		oColor += texture(bloomBlur, TexCoords);
-	}
-	else if(exposureActive == 0)
-	{
-		oColor = vec4(lighting, 1.0);
-		oColor += texture(bloomBlur, TexCoords);
-	}
+	oColor = vec4(tone, 1.0);
+	oColor += texture(bloomBlur, TexCoords);
+#else
+	oColor = vec4(lighting, 1.0);
+	oColor += texture(bloomBlur, TexCoords);
+#endif
 }
 
 #endif
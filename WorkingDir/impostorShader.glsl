@@ -0,0 +1,279 @@
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
+// Bakes one frame of an octahedral impostor atlas: albedo, and the object
+// space normal with the depth across the bounding sphere in alpha.
+#ifdef IMPOSTOR_BAKE
+
+#if defined(VERTEX) ///////////////////////////////////////////////////
+
+#ifdef COMPRESSED_VERTICES
+layout(location=0) in vec4 aPosition; // xyz in the mesh bounds, w is the bitangent sign
+layout(location=1) in vec2 aNormal;   // Octahedral
+layout(location=2) in vec2 aTexCoord;
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+#else
+layout(location=0) in vec3 aPosition;
+layout(location=1) in vec3 aNormal;
+layout(location=2) in vec2 aTexCoord;
+#endif
+
+layout(binding = 4, std430) readonly buffer NodeInstances
+{
+	mat4 uNodeTransforms[];
+};
+
+uniform int uFirstNodeInstance;
+uniform mat4 uViewProjection;
+uniform vec3 uPositionScale;
+uniform vec3 uPositionOffset;
+
+out vec2 vTexCoord;
+out vec3 vNormal;
+
+void main()
+{
+#ifdef COMPRESSED_VERTICES
+	vec3 position = aPosition.xyz * uPositionScale + uPositionOffset;
+	vec3 normal = DecodeOctahedral(aNormal);
+#else
+	vec3 position = aPosition;
+	vec3 normal = aNormal;
+#endif
+
+	mat4 node = uNodeTransforms[uFirstNodeInstance + gl_InstanceID];
+	position = vec3(node * vec4(position, 1.0));
+	normal = mat3(node) * normal;
+
+	vTexCoord = aTexCoord;
+	vNormal = normal;
+	gl_Position = uViewProjection * vec4(position, 1.0);
+}
+
+#elif defined(FRAGMENT) ///////////////////////////////////////////////
+
+in vec2 vTexCoord;
+in vec3 vNormal;
+
+uniform sampler2D uTexture;
+
+layout(location=0) out vec4 albedoColor;
+layout(location=1) out vec4 normalDepth;
+
+void main()
+{
+	albedoColor = vec4(texture(uTexture, vTexCoord).rgb, 1.0);
+	normalDepth = vec4(normalize(vNormal) * 0.5 + 0.5, gl_FragCoord.z);
+}
+
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
+// Draws every impostor of one model as a quad facing the closest baked view.
+#ifdef IMPOSTOR
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+vec2 EncodeOctahedral(vec3 n)
+{
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0)
+		e = (1.0 - abs(e.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+	return e;
+}
+
+// Same basis glm::lookAt builds when the frame is baked
+void ImpostorBasis(vec3 direction, out vec3 right, out vec3 up)
+{
+	vec3 forward = -direction;
+	vec3 upHint = abs(direction.y) > 0.99 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+	right = normalize(cross(forward, upHint));
+	up = cross(right, forward);
+}
+
+uniform mat4 uViewProjection;
+uniform vec3 uImpostorCenter; // Bounding sphere in model space
+uniform float uImpostorRadius;
+uniform float uFramesPerSide;
+
+#if defined(VERTEX) ///////////////////////////////////////////////////
+
+layout(binding = 2, std430) readonly buffer ImpostorInstances
+{
+	mat4 uInstanceWorld[];
+};
+
+uniform int uFirstInstance;
+uniform vec3 uViewPosition;
+
+out vec2 vAtlasCoord;
+out vec3 vPositionOS;
+flat out vec3 vDirectionOS;
+flat out mat4 vWorld;
+
+void main()
+{
+	mat4 world = uInstanceWorld[uFirstInstance + gl_InstanceID];
+
+	// Snap the direction to the camera, in model space, to the closest baked frame
+	vec3 centerWS = vec3(world * vec4(uImpostorCenter, 1.0));
+	vec3 toCamera = normalize(inverse(mat3(world)) * (uViewPosition - centerWS));
+	vec2 frame = min(floor((EncodeOctahedral(toCamera) * 0.5 + 0.5) * uFramesPerSide), vec2(uFramesPerSide - 1.0));
+	vec3 direction = DecodeOctahedral((frame + 0.5) / uFramesPerSide * 2.0 - 1.0);
+
+	vec3 right, up;
+	ImpostorBasis(direction, right, up);
+
+	// Triangle strip corners
+	vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	vec3 position = uImpostorCenter + (right * corner.x + up * corner.y) * uImpostorRadius;
+
+	vAtlasCoord = (frame + corner * 0.5 + 0.5) / uFramesPerSide;
+	vPositionOS = position;
+	vDirectionOS = direction;
+	vWorld = world;
+	gl_Position = uViewProjection * world * vec4(position, 1.0);
+}
+
+#elif defined(FRAGMENT) ///////////////////////////////////////////////
+
+in vec2 vAtlasCoord;
+in vec3 vPositionOS;
+flat in vec3 vDirectionOS;
+flat in mat4 vWorld;
+
+uniform sampler2D uImpostorAlbedo;
+uniform sampler2D uImpostorNormalDepth;
+uniform float bloomRange;
+
+struct Light
+{
+	unsigned int type;
+	vec3 color;
+	vec3 direction;
+	vec3 position;
+	vec3 intensity;
+};
+
+layout(binding = 0, std140) uniform GlobalParams
+{
+	vec3 uCameraPosition;
+	unsigned int uLightCount;
+	unsigned int uDirectionalLightCount; // uLight holds the directional lights, then the point lights
+	Light uLight[16];
+};
+
+layout(location=0) out vec4 albedoColor;
+layout(location=1) out vec4 normalColor;
+layout(location=2) out vec4 positionColor;
+layout(location=3) out vec4 specularColor;
+layout(location=4) out vec4 brightColor;
+
+vec3 CalcDirLight(vec3 normal, Light dirLight, vec3 viewDirection);
+vec3 CalcPointLight(vec3 normal, Light pointLight, vec3 viewDirection);
+
+vec3 vPosition;
+float specularStrength = 0.5;
+
+void main()
+{
+	vec4 albedo = texture(uImpostorAlbedo, vAtlasCoord);
+	if (albedo.a < 0.5)
+		discard;
+
+	// The bake maps depth 0..1 to 1..3 radii from its eye, the quad is at 2
+	vec4 normalDepth = texture(uImpostorNormalDepth, vAtlasCoord);
+	vec3 surface = vPositionOS - vDirectionOS * (normalDepth.a * 2.0 - 1.0) * uImpostorRadius;
+	vPosition = vec3(vWorld * vec4(surface, 1.0));
+
+	vec4 clip = uViewProjection * vec4(vPosition, 1.0);
+	gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+
+	vec3 normal = normalize(transpose(inverse(mat3(vWorld))) * (normalDepth.xyz * 2.0 - 1.0));
+	vec3 viewDir = normalize(uCameraPosition - vPosition);
+	vec3 diffuse = albedo.rgb;
+
+	vec3 finalLight = vec3(0.0);
+#if RENDER_TARGET == 0
+#ifdef DIRECTIONAL_LIGHTS
+	for (uint i = 0; i < uDirectionalLightCount; ++i)
+		finalLight += CalcDirLight(normal, uLight[i], viewDir) * diffuse;
+#endif
+#ifdef POINT_LIGHTS
+	for (uint i = uDirectionalLightCount; i < uLightCount; ++i)
+		finalLight += CalcPointLight(normal, uLight[i], viewDir) * diffuse;
+#endif
+#endif
+	albedoColor = vec4(finalLight, 1.0);
+
+	float brightness = dot(albedoColor.rgb, vec3(0.2126, 0.7152, 0.0722));
+	if (brightness > bloomRange)
+		brightColor = vec4(albedoColor.rgb, 1.0);
+	else
+		brightColor = vec4(0.0, 0.0, 0.0, 1.0);
+
+	normalColor = vec4(normal, 1.0);
+	positionColor = vec4(vPosition, 1.0);
+	specularColor = vec4(diffuse, specularStrength);
+}
+
+vec3 CalcDirLight(vec3 normal, Light dirLight, vec3 viewDirection)
+{
+	vec3 lightDir = normalize(dirLight.direction);
+
+	float diff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuse = diff * dirLight.color * dirLight.intensity;
+
+	float ambientStrength = 0.1;
+	vec3 ambientLight = ambientStrength * dirLight.color;
+
+	vec3 reflectDir = reflect(lightDir, normal);
+	float spec = pow(max(dot(viewDirection, reflectDir), 0.0), 128.0);
+	vec3 specularLight = specularStrength * spec * dirLight.color * dirLight.intensity;
+
+	return diffuse + ambientLight + specularLight;
+}
+
+vec3 CalcPointLight(vec3 normal, Light pointLight, vec3 viewDirection)
+{
+	vec3 lightDir = normalize(pointLight.position - vPosition);
+	vec3 halfwayDir = normalize(lightDir + viewDirection);
+
+	float diff = max(dot(normal, lightDir), 0.0);
+	vec3 diffuse = diff * pointLight.color * pointLight.intensity;
+
+	float ambientStrength = 0.1;
+	vec3 ambientLight = ambientStrength * pointLight.color;
+
+	float spec = pow(max(dot(normal, halfwayDir), 0.0), 128.0);
+	vec3 specularLight = specularStrength * spec * pointLight.color * pointLight.intensity;
+
+	float distance = length(pointLight.position - vPosition);
+	float attenuation = 1.0 / (1.0 + 0.09 * distance + 0.032 * (distance * distance));
+
+	ambientLight *= attenuation;
+	diffuse *= attenuation;
+	specularLight *= attenuation;
+
+	return diffuse + ambientLight + specularLight;
+}
+
+#endif
+#endif
@@ -5,22 +5,36 @@
 
 #if defined(VERTEX) ///////////////////////////////////////////////////
 
+#ifdef COMPRESSED_VERTICES
+layout(location=0) in vec4 aPosition; // Dequantized by the dequantize matrix
+layout(location=2) in vec2 aTexCoord;
+#else
 layout(location=0) in vec3 aPosition;
 layout(location=1) in vec3 aNormal;
 layout(location=2) in vec2 aTexCoord;
 layout(location=3) in vec3 aTangent;
 layout(location=4) in vec3 aBiTangent;
+#endif
+
+layout(binding = 4, std430) readonly buffer NodeInstances
+{
+	mat4 uNodeTransforms[];
+};
+
+uniform int uFirstNodeInstance;
 
 out vec2 vTexCoord;
 
 uniform mat4 model;
+uniform mat4 dequantize;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
+	mat4 node = uNodeTransforms[uFirstNodeInstance + gl_InstanceID];
 	vTexCoord = aTexCoord;
-	gl_Position = projection * view * model * vec4(aPosition, 1.0);
+	gl_Position = projection * view * model * node * dequantize * vec4(aPosition.xyz, 1.0);
 }
 
 #elif defined(FRAGMENT) ///////////////////////////////////////////////
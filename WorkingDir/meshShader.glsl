@@ -10,13 +10,38 @@ layout(binding = 1, std140) uniform LocalParams
 	mat4 uWorldMatrix;
 	mat4 uWorldViewProjectionMatrix;
 	mat4 uWorldViewMatrix;
+	vec3 uPositionScale;  // Dequantization of compressed positions
+	vec3 uPositionOffset;
 };
 
+#ifdef COMPRESSED_VERTICES
+layout(location=0) in vec4 aPosition; // xyz in the mesh bounds, w is the bitangent sign
+layout(location=1) in vec2 aNormal;   // Octahedral
+layout(location=2) in vec2 aTexCoord;
+layout(location=3) in vec2 aTangent;  // Octahedral
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+#else
 layout(location=0) in vec3 aPosition;
 layout(location=1) in vec3 aNormal;
 layout(location=2) in vec2 aTexCoord;
 layout(location=3) in vec3 aTangent;
 layout(location=4) in vec3 aBiTangent;
+#endif
+
+// Transform of every instance the node tree places, for the whole scene
+layout(binding = 4, std430) readonly buffer NodeInstances
+{
+	mat4 uNodeTransforms[];
+};
+
+uniform int uFirstNodeInstance;
 
 out vec2 vTexCoord;
 out vec3 vPosition;
@@ -24,12 +49,24 @@ out vec3 vNormal;
 
 void main()
 {
+#ifdef COMPRESSED_VERTICES
+	vec3 position = aPosition.xyz * uPositionScale + uPositionOffset;
+	vec3 normal = DecodeOctahedral(aNormal);
+#else
+	vec3 position = aPosition;
+	vec3 normal = aNormal;
+#endif
+
+	mat4 node = uNodeTransforms[uFirstNodeInstance + gl_InstanceID];
+	position = vec3(node * vec4(position, 1.0));
+	normal = mat3(node) * normal;
+
 	vTexCoord = aTexCoord;
 	
-	vPosition = vec3(uWorldMatrix * vec4(aPosition, 1.0));
-	vNormal = vec3(uWorldMatrix * vec4(aNormal, 0.0));
+	vPosition = vec3(uWorldMatrix * vec4(position, 1.0));
+	vNormal = vec3(uWorldMatrix * vec4(normal, 0.0));
 	
-	gl_Position = uWorldViewProjectionMatrix * vec4(aPosition, 1.0);
+	gl_Position = uWorldViewProjectionMatrix * vec4(position, 1.0);
 
 }
 
@@ -39,10 +76,37 @@ in vec2 vTexCoord;
 in vec3 vNormal;
 in vec3 vPosition;
 
+#ifdef TEXTURE_ARRAYS
+uniform sampler2DArray uTexture;
+uniform sampler2DArray uOrmMap;
+uniform ivec2 uMaterialLayers; // Layer of each map in its array, set per draw
+#define SampleAlbedo(uv) texture(uTexture, vec3(uv, uMaterialLayers.x))
+#define SampleOrm(uv) texture(uOrmMap, vec3(uv, uMaterialLayers.y))
+#else
 uniform sampler2D uTexture;
-uniform int renderMode;
+uniform sampler2D uOrmMap; // Occlusion, roughness, metallic
+#define SampleAlbedo(uv) texture(uTexture, uv)
+#define SampleOrm(uv) texture(uOrmMap, uv)
+#endif
 uniform float bloomRange;
 
+struct MaterialParams
+{
+	vec3 albedo;
+	float smoothness;
+	vec3 emissive;
+	float bumpiness; // Relief materials only
+	float minLayers;
+	float maxLayers;
+};
+
+layout(binding = 5, std430) readonly buffer Materials
+{
+	MaterialParams uMaterials[];
+};
+
+uniform int uMaterialIndex;
+
 struct Light
 {
 	unsigned int type;
@@ -56,6 +120,7 @@ layout(binding = 0, std140) uniform GlobalParams
 {
 	vec3 uCameraPosition;
 	unsigned int uLightCount;
+	unsigned int uDirectionalLightCount; // uLight holds the directional lights, then the point lights
 	Light uLight[16];
 };
 
@@ -68,30 +133,30 @@ layout(location=4) out vec4 brightColor;
 vec3 CalcDirLight(vec3 normal, Light dirLight, vec3 viewDirection);
 vec3 CalcPointLight(vec3 normal, Light pointLight, vec3 viewDirection);
 
+float ambientOcclusion;
+float specularStrength;
+
 void main()
 {
-	vec3 diffuse = texture(uTexture, vTexCoord).rgb;
+	vec3 diffuse = SampleAlbedo(vTexCoord).rgb;
+	vec3 orm = SampleOrm(vTexCoord).rgb;
+	ambientOcclusion = orm.r;
+	specularStrength = 1.0 - orm.g;
 	vec3 finalLight = vec3(0.0);
-	if (renderMode == 0)
-	{
-		for (int i = 0; i < uLightCount; ++i)
-		{
-			if (uLight[i].type == 0)
-			{
-				vec3 norm = normalize(vNormal);
-				vec3 viewDir = normalize(uCameraPosition - vPosition);
-				
-				finalLight += CalcDirLight(norm, uLight[i], viewDir) * diffuse;
-			}
-			else if (uLight[i].type == 1)
-			{
-				vec3 norm = normalize(vNormal);
-				vec3 viewDir = normalize(uCameraPosition - vPosition);
-
-				finalLight += CalcPointLight(norm, uLight[i], viewDir) * diffuse;
-			}
-		}
-	}	
+#if RENDER_TARGET == 0
+	vec3 norm = normalize(vNormal);
+	vec3 viewDir = normalize(uCameraPosition - vPosition);
+#ifdef DIRECTIONAL_LIGHTS
+	for (uint i = 0; i < uDirectionalLightCount; ++i)
+		finalLight += CalcDirLight(norm, uLight[i], viewDir) * diffuse;
+#endif
+#ifdef POINT_LIGHTS
+	for (uint i = uDirectionalLightCount; i < uLightCount; ++i)
+		finalLight += CalcPointLight(norm, uLight[i], viewDir) * diffuse;
+#endif
+	finalLight += uMaterials[uMaterialIndex].emissive;
+#endif
+
 	// Store albedo color
 	albedoColor = vec4(finalLight, 1.0);
 
@@ -106,11 +171,11 @@ void main()
 	positionColor = vec4(vPosition, 1.0);
 
 	// Store albedo and specular component
-	specularColor.rgb = texture(uTexture, vTexCoord).rgb;
+	specularColor.rgb = SampleAlbedo(vTexCoord).rgb;
 	
 	// If there's texture use the first one, if not, the second
 	//specularColor.a = texture(uTexture, vTexCoord).r;
-	specularColor.a = 0.5;
+	specularColor.a = specularStrength;
 }
 
 vec3 CalcDirLight(vec3 normal, Light dirLight, vec3 viewDirection)
@@ -120,10 +185,9 @@ vec3 CalcDirLight(vec3 normal, Light dirLight, vec3 viewDirection)
 	float diff = max(dot(normal, lightDir), 0.0);
 	vec3 diffuse = diff * dirLight.color * dirLight.intensity;
 	
-	float ambientStrength = 0.1;
+	float ambientStrength = 0.1 * ambientOcclusion;
 	vec3 ambientLight = ambientStrength * dirLight.color;
 	
-	float specularStrength = 0.5;
 	vec3 reflectDir = reflect(lightDir, normal);
 	float spec = pow(max(dot(viewDirection, reflectDir), 0.0), 128.0);
 	vec3 specularLight = specularStrength * spec * dirLight.color * dirLight.intensity;
@@ -139,10 +203,9 @@ vec3 CalcPointLight(vec3 normal, Light pointLight, vec3 viewDirection)
 	float diff = max(dot(normal, lightDir), 0.0);
 	vec3 diffuse = diff * pointLight.color * pointLight.intensity;
 	
-	float ambientStrength = 0.1;
+	float ambientStrength = 0.1 * ambientOcclusion;
 	vec3 ambientLight = ambientStrength * pointLight.color;
 	
-	float specularStrength = 0.5;
 	vec3 reflectDir = reflect(-lightDir, normal);
 	float spec = pow(max(dot(normal, halfwayDir), 0.0), 128.0);
 	vec3 specularLight = specularStrength * spec * pointLight.color * pointLight.intensity;
@@ -0,0 +1,107 @@
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////
+// Culls the meshlets of one submesh draw against the frustum and their normal cone, and
+// appends the indices of the survivors to the culled index buffer of the frame.
+#ifdef MESHLET_CULLING
+
+#if defined(COMPUTE) //////////////////////////////////////////////////
+
+layout(local_size_x = 64) in;
+
+struct Meshlet
+{
+	vec4 sphere; // Center and radius, in model space
+	vec4 cone;   // Axis and cutoff
+	uint firstIndex;
+	uint indexCount;
+	uint padding0;
+	uint padding1;
+};
+
+struct DrawCommand
+{
+	uint count;
+	uint instanceCount;
+	uint firstIndex;
+	int  baseVertex;
+	uint baseInstance;
+};
+
+layout(binding = 0, std430) readonly buffer Meshlets
+{
+	Meshlet meshlets[];
+};
+
+// Index page of the geometry arena, 16 bit indices are read two at a time
+layout(binding = 1, std430) readonly buffer SourceIndices
+{
+	uint sourceIndices[];
+};
+
+layout(binding = 2, std430) writeonly buffer CulledIndices
+{
+	uint culledIndices[];
+};
+
+layout(binding = 3, std430) buffer DrawCommands
+{
+	DrawCommand commands[];
+};
+
+uniform mat4 uWorld;
+uniform mat3 uNormalMatrix;
+uniform float uWorldScale;     // Largest scale of uWorld, for the radius
+uniform bool uConeCulling;     // Off when uWorld scales unevenly and bends the cones
+uniform vec4 uFrustumPlanes[6]; // World space, pointing inwards
+uniform vec3 uCameraPosition;
+
+uniform uint uFirstMeshlet;
+uniform uint uMeshletCount;
+uniform uint uSourceFirstIndex; // In indices of uIndexSize from the start of the page
+uniform uint uIndexSize;
+uniform uint uCommand;
+
+uint ReadIndex(uint index)
+{
+	if (uIndexSize == 2)
+	{
+		uint word = sourceIndices[index >> 1];
+		return (index & 1) == 0 ? word & 0xFFFF : word >> 16;
+	}
+	return sourceIndices[index];
+}
+
+void main()
+{
+	uint meshletIdx = gl_GlobalInvocationID.x;
+	if (meshletIdx >= uMeshletCount)
+		return;
+
+	Meshlet meshlet = meshlets[uFirstMeshlet + meshletIdx];
+	vec3 center = vec3(uWorld * vec4(meshlet.sphere.xyz, 1.0));
+	float radius = meshlet.sphere.w * uWorldScale;
+
+	for (int i = 0; i < 6; ++i)
+	{
+		if (dot(uFrustumPlanes[i].xyz, center) + uFrustumPlanes[i].w < -radius)
+			return;
+	}
+
+	// Every triangle faces away when the view direction is inside the cone mirrored by the cutoff
+	if (uConeCulling && meshlet.cone.w < 1.0)
+	{
+		vec3 axis = normalize(uNormalMatrix * meshlet.cone.xyz);
+		vec3 toCenter = center - uCameraPosition;
+		if (dot(toCenter, axis) >= meshlet.cone.w * length(toCenter) + radius)
+			return;
+	}
+
+	uint offset = atomicAdd(commands[uCommand].count, meshlet.indexCount);
+	uint first = commands[uCommand].firstIndex + offset;
+	for (uint i = 0; i < meshlet.indexCount; ++i)
+		culledIndices[first + i] = ReadIndex(uSourceFirstIndex + meshlet.firstIndex + i);
+}
+
+#endif
+#endif
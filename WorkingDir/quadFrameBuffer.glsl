@@ -25,9 +25,7 @@ in vec2 TexCoords;
 uniform sampler2D screenTexture;
 uniform sampler2D bloomBlur;
 
-uniform int renderTarget;
 uniform float exposureLevel;
-uniform int exposureActive;
 
 layout(location=0) out vec4 oColor;
 
@@ -43,46 +41,34 @@ float LinearizeDepth(float depth)
 void main()
 {
 	
-	switch(renderTarget)
-	{
-	 case 0:
-	 
-	 if (exposureActive == 1)
-	 {
-		const float gamma = 2.2;
-		vec3 hdrColor = texture(screenTexture, TexCoords).rgb;
+#if RENDER_TARGET == 0
+#ifdef EXPOSURE
+	const float gamma = 2.2;
+	vec3 hdrColor = texture(screenTexture, TexCoords).rgb;
  
-		vec3 tone = vec3(1.0) - exp(-hdrColor * exposureLevel);
+	vec3 tone = vec3(1.0) - exp(-hdrColor * exposureLevel);
 	
-		tone = pow(tone, vec3(1.0 / gamma));
+	tone = pow(tone, vec3(1.0 / gamma));
   
-		oColor = vec4(tone, 1.0);
-		oColor += texture(bloomBlur, TexCoords);
-	 }
-	 else if (exposureActive == 0)
-	 {
-		oColor = texture(screenTexture, TexCoords);
-		oColor += texture(bloomBlur, TexCoords);
-	 }
-
-	 break;
-	 case 1:
-		vec4 normalColor = texture(screenTexture, TexCoords);
-		oColor = normalColor;
-	 break;
-	 case 2:
-	    oColor = texture(screenTexture, TexCoords);
-	 break;
-	 case 3:
-		oColor = vec4(vec3(texture(screenTexture, TexCoords).a), 1.0);
-	 break;
-	 case 4:
-		// First is regular depth, second is linear one
-		//float depth = texture(screenTexture, TexCoords).r;
-		float depth = LinearizeDepth(texture(screenTexture, TexCoords).r) / far; // divide by far for demonstration
-		oColor = vec4(vec3(depth), 1.0);
-	 break;
-	}
+	oColor = vec4(tone, 1.0);
+	oColor += texture(bloomBlur, TexCoords);
+#else
+	oColor = texture(screenTexture, TexCoords);
+	oColor += texture(bloomBlur, TexCoords);
+#endif
+#elif RENDER_TARGET == 1
+	vec4 normalColor = texture(screenTexture, TexCoords);
+	oColor = normalColor;
+#elif RENDER_TARGET == 2
+	oColor = texture(screenTexture, TexCoords);
+#elif RENDER_TARGET == 3
+	oColor = vec4(vec3(texture(screenTexture, TexCoords).a), 1.0);
+#elif RENDER_TARGET == 4
+	// First is regular depth, second is linear one
+	//float depth = texture(screenTexture, TexCoords).r;
+	float depth = LinearizeDepth(texture(screenTexture, TexCoords).r) / far; // divide by far for demonstration
+	oColor = vec4(vec3(depth), 1.0);
+#endif
 	
 }
 
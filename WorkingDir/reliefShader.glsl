@@ -10,13 +10,38 @@ layout(binding = 1, std140) uniform LocalParams
 	mat4 uWorldMatrix;
 	mat4 uWorldViewProjectionMatrix;
 	mat4 uWorldViewMatrix;
+	vec3 uPositionScale;  // Dequantization of compressed positions
+	vec3 uPositionOffset;
 };
 
+#ifdef COMPRESSED_VERTICES
+layout(location=0) in vec4 aPosition; // xyz in the mesh bounds, w is the bitangent sign
+layout(location=1) in vec2 aNormal;   // Octahedral
+layout(location=2) in vec2 aTexCoord;
+layout(location=3) in vec2 aTangent;  // Octahedral
+
+vec3 DecodeOctahedral(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+#else
 layout(location=0) in vec3 aPosition;
 layout(location=1) in vec3 aNormal;
 layout(location=2) in vec2 aTexCoord;
 layout(location=3) in vec3 aTangent;
 layout(location=4) in vec3 aBiTangent;
+#endif
+
+// Transform of every instance the node tree places, for the whole scene
+layout(binding = 4, std430) readonly buffer NodeInstances
+{
+	mat4 uNodeTransforms[];
+};
+
+uniform int uFirstNodeInstance;
 
 out VS_OUT
 {
@@ -35,12 +60,30 @@ out vec3 vNormal;
 
 void main()
 {
-	vs_out.fragPos = vec3(uWorldMatrix * vec4(aPosition, 1.0));
+#ifdef COMPRESSED_VERTICES
+	vec3 position = aPosition.xyz * uPositionScale + uPositionOffset;
+	vec3 normal = DecodeOctahedral(aNormal);
+	vec3 tangent = DecodeOctahedral(aTangent);
+	vec3 bitangent = cross(normal, tangent) * aPosition.w;
+#else
+	vec3 position = aPosition;
+	vec3 normal = aNormal;
+	vec3 tangent = aTangent;
+	vec3 bitangent = aBiTangent;
+#endif
+
+	mat4 node = uNodeTransforms[uFirstNodeInstance + gl_InstanceID];
+	position = vec3(node * vec4(position, 1.0));
+	normal = mat3(node) * normal;
+	tangent = mat3(node) * tangent;
+	bitangent = mat3(node) * bitangent;
+
+	vs_out.fragPos = vec3(uWorldMatrix * vec4(position, 1.0));
 	vs_out.texCoords = aTexCoord;
 
-	vec3 T = normalize(mat3(uWorldMatrix) * aTangent);
-	vec3 B = normalize(mat3(uWorldMatrix) * aBiTangent);
-	vec3 N = normalize(mat3(uWorldMatrix) * aNormal);
+	vec3 T = normalize(mat3(uWorldMatrix) * tangent);
+	vec3 B = normalize(mat3(uWorldMatrix) * bitangent);
+	vec3 N = normalize(mat3(uWorldMatrix) * normal);
 	mat3 TBN = transpose(mat3(T, B, N));
 
 	vs_out.tbn = TBN;
@@ -49,10 +92,10 @@ void main()
 
 	vTexCoord = aTexCoord;
 	
-	vPosition = vec3(uWorldMatrix * vec4(aPosition, 1.0));
-	vNormal = vec3(uWorldMatrix * vec4(aNormal, 0.0));
+	vPosition = vec3(uWorldMatrix * vec4(position, 1.0));
+	vNormal = vec3(uWorldMatrix * vec4(normal, 0.0));
 	
-	gl_Position = uWorldViewProjectionMatrix * vec4(aPosition, 1.0);
+	gl_Position = uWorldViewProjectionMatrix * vec4(position, 1.0);
 
 }
 
@@ -70,13 +113,35 @@ in vec2 vTexCoord;
 in vec3 vNormal;
 in vec3 vPosition;
 
+#ifdef TEXTURE_ARRAYS
+uniform sampler2DArray uTexture;
+uniform sampler2DArray normalMap;
+uniform ivec2 uMaterialLayers; // Layer of each map in its array, set per draw
+#define SampleAlbedo(uv) texture(uTexture, vec3(uv, uMaterialLayers.x))
+#define SampleNormalHeight(uv) texture(normalMap, vec3(uv, uMaterialLayers.y))
+#else
 uniform sampler2D uTexture;
-uniform sampler2D normalMap;
-uniform sampler2D depthMap;
-uniform int renderMode;
-uniform float bumpiness;
-uniform float minLayers;
-uniform float maxLayers;
+uniform sampler2D normalMap; // Normal in rg, height in a
+#define SampleAlbedo(uv) texture(uTexture, uv)
+#define SampleNormalHeight(uv) texture(normalMap, uv)
+#endif
+
+struct MaterialParams
+{
+	vec3 albedo;
+	float smoothness;
+	vec3 emissive;
+	float bumpiness; // Relief materials only
+	float minLayers;
+	float maxLayers;
+};
+
+layout(binding = 5, std430) readonly buffer Materials
+{
+	MaterialParams uMaterials[];
+};
+
+uniform int uMaterialIndex;
 
 struct Light
 {
@@ -91,6 +156,7 @@ layout(binding = 0, std140) uniform GlobalParams
 {
 	vec3 uCameraPosition;
 	unsigned int uLightCount;
+	unsigned int uDirectionalLightCount; // uLight holds the directional lights, then the point lights
 	Light uLight[16];
 };
 
@@ -111,30 +177,27 @@ void main()
 
 	vec3 viewDir = normalize(fs_in.tangentViewPos - fs_in.tangentFragPos);
 	vec2 newTexCoords = ParallaxMapping(fs_in.texCoords, viewDir);
-	vec3 diffuse = texture(uTexture, newTexCoords).rgb;
+	vec3 diffuse = SampleAlbedo(newTexCoords).rgb;
 
 	if(newTexCoords.x > 1.0 || newTexCoords.y > 1.0 || newTexCoords.x < 0.0 || newTexCoords.y < 0.0)
 	{
 		discard;
 	}
 
-	vec3 normal = texture(normalMap, newTexCoords).rgb;
-	normal = normalize(normal * 2.0 - 1.0);
+	// Only x and y of the normal are stored
+	vec2 normalXY = SampleNormalHeight(newTexCoords).rg * 2.0 - 1.0;
+	vec3 normal = normalize(vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0))));
 
-	if (renderMode == 0)
-	{
-		for (int i = 0; i < uLightCount; ++i)
-		{
-			if (uLight[i].type == 0)
-			{				
-				finalLight += CalcDirLight(normal, uLight[i], viewDir) * diffuse;
-			}
-			else if (uLight[i].type == 1)
-			{
-				finalLight += CalcPointLight(normal, uLight[i], viewDir) * diffuse;
-			}
-		}
-	}	
+#if RENDER_TARGET == 0
+#ifdef DIRECTIONAL_LIGHTS
+	for (uint i = 0; i < uDirectionalLightCount; ++i)
+		finalLight += CalcDirLight(normal, uLight[i], viewDir) * diffuse;
+#endif
+#ifdef POINT_LIGHTS
+	for (uint i = uDirectionalLightCount; i < uLightCount; ++i)
+		finalLight += CalcPointLight(normal, uLight[i], viewDir) * diffuse;
+#endif
+#endif
 	// Store albedo color
 	albedoColor = vec4(finalLight, 1.0);
 
@@ -149,7 +212,7 @@ void main()
 	positionColor = vec4(vPosition, 1.0);
 
 	// Store albedo and specular component
-	specularColor.rgb = texture(uTexture, newTexCoords).rgb;
+	specularColor.rgb = SampleAlbedo(newTexCoords).rgb;
 	
 	// If there's texture use the first one, if not, the second
 	//specularColor.a = texture(uTexture, newTexCoords).r;
@@ -200,37 +263,49 @@ vec3 CalcPointLight(vec3 normal, Light pointLight, vec3 viewDirection)
 	return diffuse + ambientLight + specularLight;
 }
 
+// RELIEF_QUALITY 0 offsets once by the height under the texel, 1 steps through the layers
+// until it's below the surface, 2 also interpolates between the last two layers
 vec2 ParallaxMapping(vec2 texCoords, vec3 viewDir)
 {
-	const float numLayers = mix(maxLayers, minLayers, abs(dot(vec3(0.0, 0.0, 1.0), viewDir)));
+	const MaterialParams material = uMaterials[uMaterialIndex];
+#if RELIEF_QUALITY == 0
+	float height = SampleNormalHeight(texCoords).a;
+	return texCoords - viewDir.xy / viewDir.z * (height * material.bumpiness);
+#else
+	const float numLayers = mix(material.maxLayers, material.minLayers, abs(dot(vec3(0.0, 0.0, 1.0), viewDir)));
 	float layerDepth = 1.0 / numLayers;
 
 	float currentLayerDepth = 0.0;
 
-	vec2 P = viewDir.xy / viewDir.z * bumpiness;
+	vec2 P = viewDir.xy / viewDir.z * material.bumpiness;
 	vec2 deltaTexCoords = P / numLayers;
 
 	vec2 currentTexCoords = texCoords;
-	float currentDepthMapValue = texture(depthMap, currentTexCoords).r;
+	float currentDepthMapValue = SampleNormalHeight(currentTexCoords).a;
 
 	while(currentLayerDepth < currentDepthMapValue)
 	{
 		currentTexCoords -= deltaTexCoords;
 		
-		currentDepthMapValue = texture(depthMap, currentTexCoords).r;  
+		currentDepthMapValue = SampleNormalHeight(currentTexCoords).a;  
    
 		currentLayerDepth += layerDepth;  
     }
 
+#if RELIEF_QUALITY == 1
+	return currentTexCoords;
+#else
 	vec2 prevTexCoords = currentTexCoords + deltaTexCoords;
 
 	float afterDepth = currentDepthMapValue - currentLayerDepth;
-	float beforeDepth = texture(depthMap, prevTexCoords).r - currentLayerDepth + layerDepth;
+	float beforeDepth = SampleNormalHeight(prevTexCoords).a - currentLayerDepth + layerDepth;
 
     float weight = afterDepth / (afterDepth - beforeDepth);
 	vec2 finalTexCoords = prevTexCoords * weight + currentTexCoords * (1.0 - weight);
     
 	return finalTexCoords;
+#endif
+#endif
 }
 
 #endif